@@ -0,0 +1,255 @@
+/*
+  Compiler throughput, in process.
+
+  Generates a program with ProgramGenerator and runs it through
+  Lexer::lex, Parser::parse, SyntaxAnalyzer::analyzeSemantics and
+  Generator::generate (one codegen thread) RUNS times, each run on fresh
+  objects. Reports the median time of each phase as MB/s of source and
+  statements/s, with the median user-space instruction count
+  (perf_event_open, "-" where the counters are unavailable), and compares
+  them with a baseline file saved by an earlier run of the same shape: a
+  phase with more than 2% more instructions is a regression, and the exit
+  status is 1. Being more than TOLERANCE percent slower only counts when
+  the baseline was measured on this machine (see machine.hpp) and the
+  instruction counts confirm the run can be measured; otherwise the
+  change is only printed.
+
+  Usage: compiler_throughput [--declarations=N] [--statements=N]
+                             [--cout-chain=N] [--literals=PERCENT]
+                             [--depth=N] [--seed=N] [--runs=N]
+                             [--write=<file.mcpp>] [--baseline=<file>]
+                             [--save-baseline] [--tolerance=PERCENT]
+*/
+#include "../src/common/PerfCounters.hpp"
+#include "../src/generator/Generator.hpp"
+#include "../src/generator/Target.hpp"
+#include "../src/lexer/Lexer.hpp"
+#include "../src/parser/Parser.hpp"
+#include "../src/semantic/SyntaxAnalyzer.hpp"
+#include "machine.hpp"
+#include "program_generator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const char *PHASES[] = {"lex", "parse", "analyze", "generate"};
+static const int PHASE_COUNT = 4;
+
+// instructions within this many percent are the same
+static const double EXACT_TOLERANCE = 2;
+
+static double since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+static double median(std::vector<double> samples) {
+  if (samples.empty()) {
+    return -1;
+  }
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+static std::string number(double value, const char *format) {
+  if (value < 0) {
+    return "-";
+  }
+  char text[32];
+  std::snprintf(text, sizeof(text), format, value);
+  return text;
+}
+
+// times a phase, and counts its instructions where the counters work
+class Measure {
+public:
+  Measure(const PerfCounters &counters, std::vector<double> &seconds,
+          std::vector<double> &instructions)
+      : counters(counters), seconds(seconds), instructions(instructions),
+        counted(counters.read()), start(std::chrono::steady_clock::now()) {}
+
+  ~Measure() {
+    seconds.push_back(since(start));
+    PerfCounters::Sample end = counters.read();
+    if (counted.valid[PerfCounters::INSTRUCTIONS] &&
+        end.valid[PerfCounters::INSTRUCTIONS]) {
+      instructions.push_back(end.values[PerfCounters::INSTRUCTIONS] -
+                             counted.values[PerfCounters::INSTRUCTIONS]);
+    }
+  }
+
+private:
+  const PerfCounters &counters;
+  std::vector<double> &seconds;
+  std::vector<double> &instructions;
+  PerfCounters::Sample counted;
+  std::chrono::steady_clock::time_point start;
+};
+
+// the shape a baseline was measured with, results of others do not compare
+static std::string describe(const ProgramShape &shape) {
+  return "declarations=" + std::to_string(shape.declarations) +
+         " statements=" + std::to_string(shape.statements) +
+         " cout-chain=" + std::to_string(shape.cout_chain) +
+         " literals=" + std::to_string(shape.literal_percent) +
+         " depth=" + std::to_string(shape.depth) +
+         " seed=" + std::to_string(shape.seed);
+}
+
+int main(int argc, char *argv[]) {
+  ProgramShape shape;
+  int runs = 5;
+  double tolerance = 10;
+  std::string write, baseline;
+  bool save = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (shape.set(arg)) {
+    } else if (arg.rfind("--runs=", 0) == 0) {
+      runs = std::max(1, std::atoi(arg.c_str() + 7));
+    } else if (arg.rfind("--write=", 0) == 0) {
+      write = arg.substr(8);
+    } else if (arg.rfind("--baseline=", 0) == 0) {
+      baseline = arg.substr(11);
+    } else if (arg == "--save-baseline") {
+      save = true;
+    } else if (arg.rfind("--tolerance=", 0) == 0) {
+      tolerance = std::atof(arg.c_str() + 12);
+    } else {
+      std::printf("Unknown option: %s\n", arg.c_str());
+      return 1;
+    }
+  }
+
+  GeneratedProgram program = ProgramGenerator(shape).generate();
+  if (!write.empty()) {
+    std::ofstream(write) << program.source;
+  }
+  double megabytes = program.source.size() / 1e6;
+
+  std::unique_ptr<Target> target = Target::create(Target::host());
+  PerfCounters counters;
+  if (!counters.error().empty()) {
+    std::printf("instruction counts unavailable: %s\n",
+                counters.error().c_str());
+  }
+  std::vector<double> samples[PHASE_COUNT], instructions[PHASE_COUNT];
+  for (int run = 0; run < runs; run++) {
+    std::vector<TOKEN> tokens;
+    {
+      Measure measure(counters, samples[0], instructions[0]);
+      tokens = Lexer(program.source).lex();
+    }
+    std::vector<std::shared_ptr<node::Node>> nodes;
+    {
+      Measure measure(counters, samples[1], instructions[1]);
+      nodes = parser::Parser(tokens).parse();
+    }
+    {
+      Measure measure(counters, samples[2], instructions[2]);
+      SyntaxAnalyzer(nodes).analyzeSemantics();
+    }
+    {
+      Measure measure(counters, samples[3], instructions[3]);
+      assembler::Module module =
+          Generator(nodes, *target, false, 1).generate();
+    }
+  }
+
+  // phase -> MB/s and instructions of the baseline
+  struct Before {
+    double mb_per_s;
+    double instructions;
+  };
+  std::map<std::string, Before> before;
+  std::string machine = machineId(), before_machine;
+  if (!baseline.empty() && !save) {
+    std::ifstream file(baseline);
+    std::string line;
+    std::getline(file, line);
+    if (line != "# " + describe(shape)) {
+      if (file) {
+        std::printf("baseline %s is of another shape, not compared\n",
+                    baseline.c_str());
+      }
+    } else {
+      while (std::getline(file, line)) {
+        if (line.rfind("# machine ", 0) == 0) {
+          before_machine = line.substr(10);
+          continue;
+        }
+        std::istringstream fields(line);
+        std::string phase, count = "-";
+        double mb_per_s, statements_per_s;
+        if (fields >> phase >> mb_per_s >> statements_per_s) {
+          fields >> count; // absent from older baselines
+          before[phase] = {mb_per_s,
+                           count == "-" ? -1 : std::atof(count.c_str())};
+        }
+      }
+    }
+  }
+  bool gate_time = before_machine == machine &&
+                   counters.available(PerfCounters::INSTRUCTIONS);
+  if (!before.empty() && !gate_time) {
+    std::string why = "no instruction counts to confirm them";
+    if (before_machine != machine) {
+      why = "the baseline is from " +
+            (before_machine.empty() ? "another machine" : before_machine) +
+            ", this is " + machine;
+    }
+    std::printf("times only printed: %s\n", why.c_str());
+  }
+
+  std::printf("%.2f MB, %ld statements, %d runs (%s)\n", megabytes,
+              program.statements, runs, describe(shape).c_str());
+  std::printf("%-10s %12s %10s %14s %14s %12s %8s\n", "phase", "median(ms)",
+              "MB/s", "statements/s", "instructions", "baseline", "change");
+  std::string saved =
+      "# " + describe(shape) + "\n# machine " + machine + "\n";
+  bool regressed = false;
+  for (int phase = 0; phase < PHASE_COUNT; phase++) {
+    double seconds = median(samples[phase]);
+    double mb_per_s = megabytes / seconds;
+    double statements_per_s = program.statements / seconds;
+    double counted = median(instructions[phase]);
+    std::printf("%-10s %12.2f %10.2f %14.0f %14s", PHASES[phase],
+                seconds * 1000, mb_per_s, statements_per_s,
+                number(counted, "%.0f").c_str());
+    auto found = before.find(PHASES[phase]);
+    if (found != before.end()) {
+      const Before &old = found->second;
+      double change = (mb_per_s / old.mb_per_s - 1) * 100;
+      std::string flags;
+      if (change < -tolerance) {
+        // printed in lowercase when it does not count
+        flags += gate_time ? "  SLOWER" : "  (slower)";
+        regressed |= gate_time;
+      }
+      if (old.instructions > 0 && counted > 0 &&
+          counted > old.instructions * (1 + EXACT_TOLERANCE / 100)) {
+        flags += "  MORE-INSTRUCTIONS";
+        regressed = true;
+      }
+      std::printf(" %12.2f %+7.1f%%%s", old.mb_per_s, change, flags.c_str());
+    }
+    std::printf("\n");
+    saved += std::string(PHASES[phase]) + " " + std::to_string(mb_per_s) +
+             " " + std::to_string(statements_per_s) + " " +
+             number(counted, "%.0f") + "\n";
+  }
+
+  if (save && !baseline.empty()) {
+    std::ofstream(baseline) << saved;
+    std::printf("saved %s\n", baseline.c_str());
+  }
+  return regressed ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+#ifndef MACHINE_HPP
+#define MACHINE_HPP
+
+#include <fstream>
+#include <string>
+#include <thread>
+
+/*
+  The machine a benchmark ran on, stored with its baseline: wall clock
+  times only compare with a baseline measured on the same machine. It is
+  the CPU model and the number of logical CPUs, as one word.
+*/
+inline std::string machineId() {
+  std::string model = "unknown";
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.rfind("model name", 0) == 0 && line.find(':') != line.npos) {
+      model = line.substr(line.find(':') + 1);
+      break;
+    }
+  }
+  std::string id;
+  for (char c : model) {
+    if (c != ' ' && c != '\t') {
+      id += c;
+    } else if (!id.empty() && id.back() != '_') {
+      id += '_';
+    }
+  }
+  if (!id.empty() && id.back() == '_') {
+    id.pop_back();
+  }
+  return id + "/" + std::to_string(std::thread::hardware_concurrency());
+}
+
+#endif // !MACHINE_HPP
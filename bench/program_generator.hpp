@@ -0,0 +1,176 @@
+#ifndef PROGRAM_GENERATOR_HPP
+#define PROGRAM_GENERATOR_HPP
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+/*
+  Deterministic generator of large .mcpp programs for the benchmarks.
+
+  The same shape and seed always give the same program, byte for byte.
+  The shape sets how many variables are declared, how many statements
+  follow, how long a cout chain is, how many operands are literals and
+  how deeply expressions nest (through calls of small functions, the
+  language's expressions having two operands).
+*/
+struct ProgramShape {
+  int declarations = 200;   // variables, declared first
+  int statements = 20000;   // statements after them, nested ones included
+  int cout_chain = 6;       // operands of a cout
+  int literal_percent = 40; // operands that are constants or strings
+  int depth = 4;            // calls nested in a deep expression
+  unsigned seed = 12345;
+
+  // takes "--name=value" when it is one of the fields above
+  bool set(const std::string &arg) {
+    static const struct {
+      const char *name;
+      int ProgramShape::*field;
+    } FIELDS[] = {{"--declarations=", &ProgramShape::declarations},
+                  {"--statements=", &ProgramShape::statements},
+                  {"--cout-chain=", &ProgramShape::cout_chain},
+                  {"--literals=", &ProgramShape::literal_percent},
+                  {"--depth=", &ProgramShape::depth}};
+    for (const auto &field : FIELDS) {
+      std::string name = field.name;
+      if (arg.rfind(name, 0) == 0) {
+        this->*field.field = std::atoi(arg.c_str() + name.size());
+        return true;
+      }
+    }
+    if (arg.rfind("--seed=", 0) == 0) {
+      seed = std::strtoul(arg.c_str() + 7, nullptr, 10);
+      return true;
+    }
+    return false;
+  }
+};
+
+struct GeneratedProgram {
+  std::string source;
+  long statements = 0;
+};
+
+class ProgramGenerator {
+public:
+  explicit ProgramGenerator(const ProgramShape &shape)
+      : shape(shape), state(shape.seed) {}
+
+  GeneratedProgram generate() {
+    static const char *TYPES[] = {"int", "long", "int", "short"};
+    static const char *STEPS[] = {"int step0(int p) { return p + 3; }",
+                                  "int step1(int p) { return p * 5; }",
+                                  "int step2(int p) { return p - 7; }",
+                                  "long step3(long p) { return p + p; }"};
+    for (const char *step : STEPS) {
+      out << step << "\n";
+      program.statements += 2;
+    }
+    variables = shape.declarations < 2 ? 2 : shape.declarations;
+    for (int i = 0; i < variables; i++) {
+      out << TYPES[i % 4] << " v" << i << " = " << next(1000) << ";\n";
+      program.statements++;
+    }
+    out << "int i = 0;\n";
+    program.statements++;
+    long header = program.statements;
+    while (program.statements - header < shape.statements) {
+      statement(0);
+    }
+    program.source = out.str();
+    return program;
+  }
+
+private:
+  ProgramShape shape;
+  unsigned state;
+  int variables = 0;
+  std::ostringstream out;
+  GeneratedProgram program;
+
+  // same LCG as the other benchmarks, no dependence on the C library
+  int next(int bound) {
+    state = state * 1103515245 + 12345;
+    return static_cast<int>((state >> 16) % bound);
+  }
+
+  std::string variable() { return "v" + std::to_string(next(variables)); }
+
+  std::string operand() {
+    if (next(100) < shape.literal_percent) {
+      return std::to_string(next(10000));
+    }
+    return variable();
+  }
+
+  // the operands of + are evaluated in no set order, so each draw of
+  // the generator is a statement of its own
+  std::string binary() {
+    static const char *OPS[] = {" + ", " - ", " * "};
+    std::string left = operand();
+    std::string op = OPS[next(3)];
+    return left + op + operand();
+  }
+
+  std::string deep(int depth) {
+    if (depth == 0) {
+      return binary();
+    }
+    std::string call = "step" + std::to_string(next(4)) + "(";
+    std::string inner = deep(depth - 1);
+    return call + inner + ") + " + operand();
+  }
+
+  void indent(int level) { out << std::string(2 * level, ' '); }
+
+  void statement(int level) {
+    program.statements++;
+    int kind = next(level ? 4 : 6);
+    indent(level);
+    switch (kind) {
+    case 0:
+      out << variable() << " = " << binary() << ";\n";
+      break;
+    case 1:
+      out << variable() << " = " << deep(shape.depth) << ";\n";
+      break;
+    case 2:
+    case 3: {
+      out << "cout";
+      for (int i = 0; i < shape.cout_chain; i++) {
+        if (next(100) < shape.literal_percent / 2) {
+          out << " << \"s" << next(1000) << " text \"";
+        } else {
+          out << " << " << (next(2) ? operand() : binary());
+        }
+      }
+      out << ";\n";
+      break;
+    }
+    case 4:
+      out << "if (" << operand() << " < " << operand() << ") {\n";
+      statement(level + 1);
+      statement(level + 1);
+      indent(level);
+      out << "} else {\n";
+      statement(level + 1);
+      indent(level);
+      out << "}\n";
+      break;
+    case 5:
+      out << "i = 0;\n";
+      indent(level);
+      out << "while (i < 3) {\n";
+      statement(level + 1);
+      indent(level + 1);
+      out << "i = i + 1;\n";
+      indent(level);
+      out << "}\n";
+      program.statements += 2;
+      break;
+    }
+  }
+};
+
+#endif // !PROGRAM_GENERATOR_HPP
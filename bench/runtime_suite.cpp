@@ -0,0 +1,329 @@
+/*
+  Runtime of generated programs, per backend.
+
+  Builds every .mcpp program of a corpus directory in each configuration
+  below and runs it RUNS times with stdin from <program>.in (or
+  /dev/null) and stdout to a file. Records the fastest wall clock of the
+  runs (the one least disturbed by the rest of the machine), the median
+  user-space instruction count (perf_event_open, "-" where the
+  counters are unavailable) and the size of the executable. The output
+  of every configuration must be the same as the first one's.
+
+    native          default native backend, SIMD picked at startup
+    native-scalar   --simd=scalar
+    freestanding    -ffreestanding, no C runtime (Linux)
+    c               --backend=c, gcc -O2
+    jit             --run, compiled in memory on every run
+
+  With --baseline=<file> the results are compared with an earlier run
+  saved by --save-baseline: a program with more than 2% more instructions
+  or a larger executable is a regression, as is wrong output, and the
+  exit status is 1. Wall clock times only vary with the machine and its
+  load, so being more than TOLERANCE percent slower only fails when the
+  baseline was measured on this machine (see machine.hpp) and the
+  instruction counts confirm the run can be measured at all; otherwise
+  the change is only printed.
+
+  Usage: runtime_suite <compiler> <corpus> <build directory> <runs>
+                       [--baseline=<file>] [--save-baseline]
+                       [--tolerance=PERCENT]
+*/
+#include "../src/common/PerfCounters.hpp"
+#include "machine.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <spawn.h>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char **environ;
+
+struct Config {
+  const char *name;
+  std::vector<std::string> flags;
+  bool executable; // false: the compiler runs the program itself
+};
+
+static const Config CONFIGS[] = {
+    {"native", {}, true},
+    {"native-scalar", {"--simd=scalar"}, true},
+#ifdef __linux__
+    {"freestanding", {"-ffreestanding"}, true},
+#endif
+    {"c", {"--backend=c"}, true},
+    {"jit", {"--run"}, false},
+};
+
+// instructions and size within this many percent are the same
+static const double EXACT_TOLERANCE = 2;
+
+struct Result {
+  double ms = -1;
+  double instructions = -1;
+  double size = -1;
+};
+
+static bool spawnOnce(const std::vector<std::string> &args,
+                      const std::string &input, const std::string &output) {
+  std::vector<char *> argv;
+  for (const auto &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 0, input.c_str(), O_RDONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, 1, output.c_str(),
+                                   O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+  pid_t pid;
+  int failed =
+      posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (failed) {
+    std::perror(argv[0]);
+    return false;
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static std::string readFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::ostringstream bytes;
+  bytes << file.rdbuf();
+  return bytes.str();
+}
+
+static std::vector<std::string> programs(const std::string &corpus) {
+  std::vector<std::string> names;
+  if (DIR *dir = opendir(corpus.c_str())) {
+    while (dirent *entry = readdir(dir)) {
+      std::string name = entry->d_name;
+      if (name.size() > 5 && name.substr(name.size() - 5) == ".mcpp") {
+        names.push_back(name.substr(0, name.size() - 5));
+      }
+    }
+    closedir(dir);
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+static double median(std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+static std::string number(double value, const char *format) {
+  if (value < 0) {
+    return "-";
+  }
+  char text[32];
+  std::snprintf(text, sizeof(text), format, value);
+  return text;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 5) {
+    std::printf("Usage: %s <compiler> <corpus> <build directory> <runs> "
+                "[--baseline=<file>] [--save-baseline] "
+                "[--tolerance=PERCENT]\n",
+                argv[0]);
+    return 1;
+  }
+  std::string compiler = argv[1];
+  std::string corpus = argv[2];
+  std::string build = argv[3];
+  int runs = std::max(1, std::atoi(argv[4]));
+  std::string baseline;
+  bool save = false;
+  double tolerance = 10;
+  for (int i = 5; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind("--baseline=", 0) == 0) {
+      baseline = arg.substr(11);
+    } else if (arg == "--save-baseline") {
+      save = true;
+    } else if (arg.rfind("--tolerance=", 0) == 0) {
+      tolerance = std::atof(arg.c_str() + 12);
+    } else {
+      std::printf("Unknown option: %s\n", arg.c_str());
+      return 1;
+    }
+  }
+  mkdir(build.c_str(), 0755);
+
+  // "program config" -> the baseline result
+  std::map<std::string, Result> before;
+  std::string machine = machineId(), before_machine;
+  if (!baseline.empty() && !save) {
+    std::ifstream file(baseline);
+    std::string line;
+    while (std::getline(file, line)) {
+      if (line.rfind("# machine ", 0) == 0) {
+        before_machine = line.substr(10);
+        continue;
+      }
+      std::istringstream fields(line);
+      std::string program, config, ms, instructions, size;
+      if (fields >> program >> config >> ms >> instructions >> size) {
+        auto value = [](const std::string &text) {
+          return text == "-" ? -1 : std::atof(text.c_str());
+        };
+        before[program + " " + config] = {value(ms), value(instructions),
+                                          value(size)};
+      }
+    }
+  }
+
+  PerfCounters counters;
+  if (!counters.error().empty()) {
+    std::printf("instruction counts unavailable: %s\n",
+                counters.error().c_str());
+  }
+  bool gate_time = before_machine == machine &&
+                   counters.available(PerfCounters::INSTRUCTIONS);
+  if (!before.empty() && !gate_time) {
+    std::string why = "no instruction counts to confirm them";
+    if (before_machine != machine) {
+      why = "the baseline is from " +
+            (before_machine.empty() ? "another machine" : before_machine) +
+            ", this is " + machine;
+    }
+    std::printf("times only printed: %s\n", why.c_str());
+  }
+
+  std::printf("%d runs\n", runs);
+  std::printf("%-14s %-14s %11s %14s %9s %11s %8s\n", "program", "config",
+              "best(ms)", "instructions", "size", "baseline", "change");
+  std::string saved = "# machine " + machine + "\n";
+  bool regressed = false;
+  for (const auto &program : programs(corpus)) {
+    std::string source = corpus + "/" + program + ".mcpp";
+    std::string input = corpus + "/" + program + ".in";
+    if (access(input.c_str(), R_OK) != 0) {
+      input = "/dev/null";
+    }
+    std::string expected;
+    bool first = true;
+
+    for (const auto &config : CONFIGS) {
+      std::string exe = build + "/" + program + "." + config.name;
+      std::string output = exe + ".out";
+      std::vector<std::string> command;
+      if (config.executable) {
+        std::vector<std::string> compile = {compiler};
+        compile.insert(compile.end(), config.flags.begin(),
+                       config.flags.end());
+        compile.push_back(source);
+        compile.push_back(exe);
+        if (!spawnOnce(compile, "/dev/null", "/dev/null")) {
+          std::printf("%-14s %-14s compile failed\n", program.c_str(),
+                      config.name);
+          regressed = true;
+          continue;
+        }
+        command = {exe};
+      } else {
+        command = {compiler};
+        command.insert(command.end(), config.flags.begin(),
+                       config.flags.end());
+        command.push_back(source);
+      }
+
+      // the warm-up run gives the output to check
+      bool ran = spawnOnce(command, input, output);
+      std::string got = readFile(output);
+      if (first) {
+        expected = got;
+        first = false;
+      }
+      if (!ran || got != expected) {
+        std::printf("%-14s %-14s %s\n", program.c_str(), config.name,
+                    ran ? "WRONG OUTPUT" : "run failed");
+        regressed = true;
+        continue;
+      }
+
+      std::vector<double> times, instructions;
+      for (int run = 0; run < runs; run++) {
+        PerfCounters::Sample start = counters.read();
+        auto begin = std::chrono::steady_clock::now();
+        spawnOnce(command, input, output);
+        times.push_back(std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - begin)
+                            .count());
+        // the child is counted into the inherited counter when it exits
+        PerfCounters::Sample end = counters.read();
+        if (start.valid[PerfCounters::INSTRUCTIONS] &&
+            end.valid[PerfCounters::INSTRUCTIONS]) {
+          instructions.push_back(end.values[PerfCounters::INSTRUCTIONS] -
+                                 start.values[PerfCounters::INSTRUCTIONS]);
+        }
+      }
+
+      Result result;
+      result.ms = *std::min_element(times.begin(), times.end());
+      if (!instructions.empty()) {
+        result.instructions = median(instructions);
+      }
+      struct stat info;
+      if (config.executable && stat(exe.c_str(), &info) == 0) {
+        result.size = info.st_size;
+      }
+
+      std::printf("%-14s %-14s %11.2f %14s %9s", program.c_str(), config.name,
+                  result.ms, number(result.instructions, "%.0f").c_str(),
+                  number(result.size, "%.0f").c_str());
+      auto found = before.find(program + " " + config.name);
+      if (found != before.end()) {
+        const Result &old = found->second;
+        double change = (result.ms / old.ms - 1) * 100;
+        std::string flags;
+        bool failed = false;
+        if (change > tolerance) {
+          // printed in lowercase when it does not count
+          flags += gate_time ? " SLOWER" : " (slower)";
+          failed |= gate_time;
+        }
+        if (old.instructions > 0 && result.instructions > 0 &&
+            result.instructions >
+                old.instructions * (1 + EXACT_TOLERANCE / 100)) {
+          flags += " MORE-INSTRUCTIONS";
+          failed = true;
+        }
+        if (old.size > 0 && result.size > 0 &&
+            result.size > old.size * (1 + EXACT_TOLERANCE / 100)) {
+          flags += " LARGER";
+          failed = true;
+        }
+        regressed |= failed;
+        std::printf(" %11.2f %+7.1f%%%s", old.ms, change, flags.c_str());
+      }
+      std::printf("\n");
+      saved += program + " " + config.name + " " + number(result.ms, "%.3f") +
+               " " + number(result.instructions, "%.0f") + " " +
+               number(result.size, "%.0f") + "\n";
+    }
+  }
+
+  if (save && !baseline.empty()) {
+    std::ofstream(baseline) << saved;
+    std::printf("saved %s\n", baseline.c_str());
+  }
+  return regressed ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+/*
+  Whole-array operations lowered with each --simd setting.
+
+  Generates a program that repeats a few whole-array statements on int
+  arrays of LENGTH elements ITERATIONS times, builds it once per setting
+  and times the executables with stdout on /dev/null:
+
+    scalar    one element per iteration of the loop
+    sse2      4 elements per iteration
+    avx2      8 elements per iteration, skipped without AVX2
+    auto      the CPU check at startup picks AVX2 or SSE2
+
+  The outputs of all builds are compared first, they have to be equal.
+
+  Usage: simd_arrays <compiler> <length> <iterations> <runs>
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <vector>
+
+extern char **environ;
+
+static double spawnOnce(const std::vector<std::string> &args,
+                        posix_spawn_file_actions_t *actions) {
+  std::vector<char *> argv;
+  for (const auto &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  auto start = std::chrono::steady_clock::now();
+
+  pid_t pid;
+  if (posix_spawn(&pid, argv[0], actions, nullptr, argv.data(), environ) !=
+      0) {
+    std::perror(argv[0]);
+    std::exit(EXIT_FAILURE);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    std::fprintf(stderr, "%s failed\n", argv[0]);
+    std::exit(EXIT_FAILURE);
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void writeProgram(const std::string &path, long length,
+                         long iterations) {
+  std::ofstream out(path);
+  out << "int a[" << length << "];\n"
+      << "int b[" << length << "];\n"
+      << "int c[" << length << "];\n"
+      << "int i = 0;\n"
+      << "while (i < " << length << ") {\n"
+      << "  a[i] = i;\n"
+      << "  b[i] = 3 - i;\n"
+      << "  i = i + 1;\n"
+      << "}\n"
+      << "int k = 0;\n"
+      << "while (k < " << iterations << ") {\n"
+      << "  c = a + b;\n"
+      << "  a = c * b;\n"
+      << "  b = a - k;\n"
+      << "  k = k + 1;\n"
+      << "}\n"
+      << "cout << a[0] << b[" << length / 2 << "] << c[" << length - 1
+      << "];\n";
+}
+
+static std::string readFile(const std::string &path) {
+  std::ifstream in(path);
+  return std::string(std::istreambuf_iterator<char>(in), {});
+}
+
+static void report(const char *name, std::vector<double> samples,
+                   double baseline) {
+  std::sort(samples.begin(), samples.end());
+  double median = samples[samples.size() / 2];
+  std::printf("%-12s %10.2f %10.2f %9.2fx\n", name, samples.front(), median,
+              baseline / median);
+}
+
+static bool hasAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 5) {
+    std::printf("Usage: %s <compiler> <length> <iterations> <runs>\n",
+                argv[0]);
+    return 1;
+  }
+
+  std::string compiler = argv[1];
+  long length = std::atol(argv[2]);
+  long iterations = std::atol(argv[3]);
+  int runs = std::atoi(argv[4]);
+  std::string program = "bench/simd_program.mcpp";
+  writeProgram(program, length, iterations);
+
+  std::vector<std::string> settings = {"scalar", "sse2", "auto"};
+  if (hasAvx2()) {
+    settings.insert(settings.begin() + 2, "avx2");
+  }
+
+  posix_spawn_file_actions_t quiet;
+  posix_spawn_file_actions_init(&quiet);
+  posix_spawn_file_actions_addopen(&quiet, 1, "/dev/null", O_WRONLY, 0);
+  posix_spawn_file_actions_addopen(&quiet, 2, "/dev/null", O_WRONLY, 0);
+
+  std::string expected;
+  for (const auto &setting : settings) {
+    std::string exe = "bench/simd_" + setting;
+    spawnOnce({compiler, "--simd=" + setting, program, exe}, &quiet);
+
+    // the run that checks the output also warms up the executable
+    posix_spawn_file_actions_t capture;
+    posix_spawn_file_actions_init(&capture);
+    posix_spawn_file_actions_addopen(&capture, 1, "bench/simd_output",
+                                     O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    spawnOnce({exe}, &capture);
+    posix_spawn_file_actions_destroy(&capture);
+    std::string output = readFile("bench/simd_output");
+    if (expected.empty()) {
+      expected = output;
+    } else if (output != expected) {
+      std::fprintf(stderr, "--simd=%s prints different results\n",
+                   setting.c_str());
+      return 1;
+    }
+  }
+
+  std::vector<std::vector<double>> samples(settings.size());
+  for (int run = 0; run < runs; run++) {
+    for (size_t i = 0; i < settings.size(); i++) {
+      samples[i].push_back(spawnOnce({"bench/simd_" + settings[i]}, &quiet));
+    }
+  }
+
+  std::vector<double> scalar = samples[0];
+  std::sort(scalar.begin(), scalar.end());
+  std::printf("%ld elements, %ld iterations, %d runs\n", length, iterations,
+              runs);
+  std::printf("%-12s %10s %10s %10s\n", "--simd=", "min(ms)", "median(ms)",
+              "speedup");
+  for (size_t i = 0; i < settings.size(); i++) {
+    report(settings[i].c_str(), samples[i], scalar[scalar.size() / 2]);
+  }
+
+  posix_spawn_file_actions_destroy(&quiet);
+  return 0;
+}
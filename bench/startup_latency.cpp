@@ -0,0 +1,75 @@
+/*
+  Startup latency benchmark for generated executables.
+
+  Spawns every executable given on the command line RUNS times with stdin
+  and stdout redirected to /dev/null and reports how long a full
+  spawn-to-exit round trip takes. Meant to compare the default libc-linked
+  output against -ffreestanding output of the same program.
+
+  Usage: startup_latency <runs> <executable>...
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <vector>
+
+extern char **environ;
+
+static double spawnOnce(const char *path, posix_spawn_file_actions_t *actions) {
+  char *const argv[] = {const_cast<char *>(path), nullptr};
+  auto start = std::chrono::steady_clock::now();
+
+  pid_t pid;
+  if (posix_spawn(&pid, path, actions, nullptr, argv, environ) != 0) {
+    std::perror(path);
+    std::exit(EXIT_FAILURE);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::printf("Usage: %s <runs> <executable>...\n", argv[0]);
+    return 1;
+  }
+
+  int runs = std::atoi(argv[1]);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+
+  std::printf("%-40s %10s %10s %10s\n", "executable", "min(us)", "median(us)",
+              "mean(us)");
+  for (int i = 2; i < argc; i++) {
+    // warm the page cache before measuring
+    spawnOnce(argv[i], &actions);
+
+    std::vector<double> samples;
+    samples.reserve(runs);
+    for (int run = 0; run < runs; run++) {
+      samples.push_back(spawnOnce(argv[i], &actions));
+    }
+    std::sort(samples.begin(), samples.end());
+
+    double total = 0;
+    for (double sample : samples) {
+      total += sample;
+    }
+    std::printf("%-40s %10.1f %10.1f %10.1f\n", argv[i], samples.front(),
+                samples[samples.size() / 2], total / samples.size());
+  }
+
+  posix_spawn_file_actions_destroy(&actions);
+  return 0;
+}
@@ -0,0 +1,156 @@
+/*
+  Bytecode VM against native output.
+
+  Generates a straight-line program of STATEMENTS statements (arithmetic on
+  a few dozen variables and cout), then times with stdin and stdout on
+  /dev/null:
+
+    native build    compiler <program> <exe>
+    native run      <exe>
+    jit             compiler --run <program>
+    interpret       compiler --interpret <program>
+
+  "native build + run" against "interpret" is the time saved by skipping
+  native compilation for a short-running program.
+
+  Usage: vm_vs_native <compiler> <statements> <runs>
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <vector>
+
+extern char **environ;
+
+static const int VARIABLES = 32;
+
+static double spawnOnce(const std::vector<std::string> &args,
+                        posix_spawn_file_actions_t *actions) {
+  std::vector<char *> argv;
+  for (const auto &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+  auto start = std::chrono::steady_clock::now();
+
+  pid_t pid;
+  if (posix_spawn(&pid, argv[0], actions, nullptr, argv.data(), environ) !=
+      0) {
+    std::perror(argv[0]);
+    std::exit(EXIT_FAILURE);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    std::fprintf(stderr, "%s failed\n", argv[0]);
+    std::exit(EXIT_FAILURE);
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void writeProgram(const std::string &path, int statements) {
+  std::ofstream out(path);
+  for (int i = 0; i < VARIABLES; i++) {
+    out << "int v" << i << " = " << i * 7 + 1 << ";\n";
+  }
+
+  // fixed seed, every run measures the same program
+  unsigned seed = 12345;
+  auto next = [&seed](int bound) {
+    seed = seed * 1103515245 + 12345;
+    return static_cast<int>((seed >> 16) % bound);
+  };
+
+  for (int i = 0; i < statements; i++) {
+    int a = next(VARIABLES), b = next(VARIABLES), c = next(VARIABLES);
+    switch (next(5)) {
+    case 0:
+      out << "v" << a << " = v" << b << " + v" << c << ";\n";
+      break;
+    case 1:
+      out << "v" << a << " = v" << b << " - " << next(100) << ";\n";
+      break;
+    case 2:
+      out << "cout << v" << b << " + v" << c << ";\n";
+      break;
+    case 3:
+      out << "cout << v" << b << ";\n";
+      break;
+    case 4:
+      out << "cout << \"value\" << v" << b << " - " << next(100) << ";\n";
+      break;
+    }
+  }
+}
+
+static void report(const char *name, std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  double total = 0;
+  for (double sample : samples) {
+    total += sample;
+  }
+  std::printf("%-24s %10.2f %10.2f %10.2f\n", name, samples.front(),
+              samples[samples.size() / 2], total / samples.size());
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    std::printf("Usage: %s <compiler> <statements> <runs>\n", argv[0]);
+    return 1;
+  }
+
+  std::string compiler = argv[1];
+  int statements = std::atoi(argv[2]);
+  int runs = std::atoi(argv[3]);
+  std::string program = "bench/vm_program.mcpp";
+  std::string exe = "bench/vm_program";
+  writeProgram(program, statements);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+
+  std::vector<std::vector<std::string>> commands = {
+      {compiler, program, exe},
+      {exe},
+      {compiler, "--run", program},
+      {compiler, "--interpret", program}};
+  std::vector<std::vector<double>> samples(commands.size());
+
+  // warm up, this also builds the native executable
+  for (const auto &command : commands) {
+    spawnOnce(command, &actions);
+  }
+  for (int run = 0; run < runs; run++) {
+    for (size_t i = 0; i < commands.size(); i++) {
+      samples[i].push_back(spawnOnce(commands[i], &actions));
+    }
+  }
+
+  std::vector<double> native(runs);
+  for (int run = 0; run < runs; run++) {
+    native[run] = samples[0][run] + samples[1][run];
+  }
+
+  std::printf("%d statements, %d runs\n", statements, runs);
+  std::printf("%-24s %10s %10s %10s\n", "", "min(ms)", "median(ms)",
+              "mean(ms)");
+  report("native build", samples[0]);
+  report("native run", samples[1]);
+  report("native build + run", native);
+  report("jit (--run)", samples[2]);
+  report("interpret", samples[3]);
+
+  posix_spawn_file_actions_destroy(&actions);
+  return 0;
+}
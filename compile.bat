@@ -1 +1,12 @@
-g++ src/main.cpp src/lexer/Lexer.cpp src/parser/Parser.cpp src/parser/AssignmentNode/AssignmentNode.cpp src/parser/CinNode/CinNode.cpp src/parser/ConstantNode/ConstantNode.cpp src/parser/CoutNode/CoutNode.cpp src/parser/DeclarationNode/DeclarationNode.cpp src/parser/ExpressionNode/ExpressionNode.cpp src/parser/IdentifierNode/IdentifierNode.cpp src/parser/SequenceNode/SequenceNode.cpp src/parser/StringLiteralNode/StringLiteralNode.cpp src/semantic/SyntaxAnalyzer.cpp src/semantic/SymbolTable.cpp src/generator/Generator.cpp -o mcompiler
+@echo off
+setlocal
+set VERSION=
+rem the version --cache-dir keys on: a hash of the sources, as in the Makefile
+set SOURCES=%TEMP%\mcompiler-sources
+type nul > "%SOURCES%"
+for /r src %%f in (*.cpp *.hpp) do type "%%f" >> "%SOURCES%"
+for /f "skip=1 tokens=*" %%h in ('certutil -hashfile "%SOURCES%" SHA256') do if not defined VERSION set VERSION=%%h
+del "%SOURCES%"
+if defined VERSION set VERSION=%VERSION: =%
+if defined VERSION set VERSION=%VERSION:~0,16%
+g++ -pthread "-DMCOMPILER_VERSION=\"%VERSION%\"" src/main.cpp src/lexer/Lexer.cpp src/parser/Parser.cpp src/parser/ArrayDeclarationNode/ArrayDeclarationNode.cpp src/parser/AssignmentNode/AssignmentNode.cpp src/parser/CinNode/CinNode.cpp src/parser/ConditionNode/ConditionNode.cpp src/parser/ConstantNode/ConstantNode.cpp src/parser/CoutNode/CoutNode.cpp src/parser/DeclarationNode/DeclarationNode.cpp src/parser/ElementAssignmentNode/ElementAssignmentNode.cpp src/parser/ExpressionNode/ExpressionNode.cpp src/parser/FunctionNode/FunctionNode.cpp src/parser/CallNode/CallNode.cpp src/parser/ReturnNode/ReturnNode.cpp src/parser/IdentifierNode/IdentifierNode.cpp src/parser/IfNode/IfNode.cpp src/parser/IndexNode/IndexNode.cpp src/parser/SequenceNode/SequenceNode.cpp src/parser/StringLiteralNode/StringLiteralNode.cpp src/parser/WhileNode/WhileNode.cpp src/semantic/SyntaxAnalyzer.cpp src/semantic/SymbolTable.cpp src/generator/Generator.cpp src/generator/Target.cpp src/generator/StorageLayout.cpp src/generator/ControlFlowGraph.cpp src/generator/Inliner.cpp src/jit/Jit.cpp src/vm/BytecodeCompiler.cpp src/vm/VM.cpp src/cbackend/CGenerator.cpp src/common/EmitBuffer.cpp src/common/Process.cpp src/common/Sha256.cpp src/common/Allocations.cpp src/common/PerfCounters.cpp src/driver/Compilation.cpp src/driver/Cache.cpp src/driver/PhaseReport.cpp src/driver/ThreadPool.cpp src/driver/Batch.cpp src/server/Protocol.cpp src/server/Server.cpp src/assembler/Module.cpp src/assembler/Encoder.cpp src/assembler/ObjectWriter.cpp src/assembler/AsmPrinter.cpp -o mcompiler
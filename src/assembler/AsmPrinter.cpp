@@ -0,0 +1,334 @@
+#include "AsmPrinter.hpp"
+
+#include <algorithm>
+
+namespace assembler {
+
+namespace {
+
+const char *registerName(Reg r, uint8_t size) {
+  static const char *vectors[2][16] = {
+      {"xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "xmm8",
+       "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15"},
+      {"ymm0", "ymm1", "ymm2", "ymm3", "ymm4", "ymm5", "ymm6", "ymm7", "ymm8",
+       "ymm9", "ymm10", "ymm11", "ymm12", "ymm13", "ymm14", "ymm15"}};
+  if (size >= 16) {
+    return vectors[size == 32][static_cast<int>(r)];
+  }
+  static const char *names[4][16] = {
+      {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil", "r8b", "r9b",
+       "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"},
+      {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di", "r8w", "r9w", "r10w",
+       "r11w", "r12w", "r13w", "r14w", "r15w"},
+      {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi", "r8d", "r9d",
+       "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"},
+      {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9",
+       "r10", "r11", "r12", "r13", "r14", "r15"}};
+  int row = size == 1 ? 0 : size == 2 ? 1 : size == 4 ? 2 : 3;
+  return names[row][static_cast<int>(r)];
+}
+
+const char *sizeName(uint8_t size) {
+  switch (size) {
+  case 1:
+    return "byte ";
+  case 2:
+    return "word ";
+  case 4:
+    return "dword ";
+  case 8:
+    return "qword ";
+  }
+  return "";
+}
+
+// the start of each instruction's line, operands are appended to it
+const char *mnemonic(const Instruction &insn) {
+  // ymm operands take the AVX spelling
+  bool avx = insn.dst.size == 32 || insn.src.size == 32;
+  static const char *jumps[16] = {
+      "",         "",         "\t\tjb ",  "\t\tjae ", "\t\tje ",  "\t\tjne ",
+      "\t\tjbe ", "\t\tja ",  "\t\tjs ",  "\t\tjns ", "",         "",
+      "\t\tjl ",  "\t\tjge ", "\t\tjle ", "\t\tjg "};
+  switch (insn.op) {
+  case Opcode::MOV:
+    return "\t\tmov ";
+  case Opcode::MOVZX:
+    return "\t\tmovzx ";
+  case Opcode::MOVSX:
+    return "\t\tmovsx ";
+  case Opcode::MOVSXD:
+    return "\t\tmovsxd ";
+  case Opcode::LEA:
+    return "\t\tlea ";
+  case Opcode::ADD:
+    return "\t\tadd ";
+  case Opcode::SUB:
+    return "\t\tsub ";
+  case Opcode::AND:
+    return "\t\tand ";
+  case Opcode::OR:
+    return "\t\tor ";
+  case Opcode::XOR:
+    return "\t\txor ";
+  case Opcode::CMP:
+    return "\t\tcmp ";
+  case Opcode::TEST:
+    return "\t\ttest ";
+  case Opcode::IMUL:
+    return "\t\timul ";
+  case Opcode::DIV:
+    return "\t\tdiv ";
+  case Opcode::NEG:
+    return "\t\tneg ";
+  case Opcode::INC:
+    return "\t\tinc ";
+  case Opcode::DEC:
+    return "\t\tdec ";
+  case Opcode::SHR:
+    return "\t\tshr ";
+  case Opcode::PUSH:
+    return "\t\tpush ";
+  case Opcode::POP:
+    return "\t\tpop ";
+  case Opcode::CALL:
+    return "\t\tcall ";
+  case Opcode::JMP:
+    return "\t\tjmp ";
+  case Opcode::JCC:
+    return jumps[static_cast<int>(insn.cond)];
+  case Opcode::RET:
+    return "\t\tret";
+  case Opcode::SYSCALL:
+    return "\t\tsyscall";
+  case Opcode::REP_MOVSB:
+    return "\t\trep movsb";
+  case Opcode::CPUID:
+    return "\t\tcpuid";
+  case Opcode::XGETBV:
+    return "\t\txgetbv";
+  case Opcode::MOVD:
+    return "\t\tmovd ";
+  case Opcode::MOVDQA:
+    return avx ? "\t\tvmovdqa " : "\t\tmovdqa ";
+  case Opcode::PADDD:
+    return avx ? "\t\tvpaddd " : "\t\tpaddd ";
+  case Opcode::PSUBD:
+    return avx ? "\t\tvpsubd " : "\t\tpsubd ";
+  case Opcode::PMULLD:
+    return avx ? "\t\tvpmulld " : "\t\tpmulld ";
+  case Opcode::PMULUDQ:
+    return avx ? "\t\tvpmuludq " : "\t\tpmuludq ";
+  case Opcode::PSHUFD:
+    return "\t\tpshufd ";
+  case Opcode::PUNPCKLDQ:
+    return avx ? "\t\tvpunpckldq " : "\t\tpunpckldq ";
+  case Opcode::VPBROADCASTD:
+    return "\t\tvpbroadcastd ";
+  case Opcode::VZEROUPPER:
+    return "\t\tvzeroupper";
+  case Opcode::LABEL:
+    break;
+  }
+  return "";
+}
+
+} // namespace
+
+AsmPrinter::AsmPrinter(const Module &module, std::string readOnly)
+    : module(module), readOnly(std::move(readOnly)) {}
+
+void AsmPrinter::operand(EmitBuffer &out, const Operand &op, bool sized) {
+  switch (op.kind) {
+  case Operand::Kind::REG:
+    out << registerName(op.base, op.size);
+    return;
+  case Operand::Kind::IMM:
+    out << op.value;
+    return;
+  case Operand::Kind::SYMBOL:
+    out << module.symbols[op.symbol].name;
+    return;
+  case Operand::Kind::MEM:
+    if (sized) {
+      out << sizeName(op.size);
+    }
+    out << '[';
+    if (op.base == Reg::RIP) {
+      out << module.symbols[op.symbol].name;
+    } else {
+      out << registerName(op.base, 8);
+      if (op.index != Reg::NONE) {
+        out << " + " << registerName(op.index, 8);
+        if (op.scale > 1) {
+          out << '*' << static_cast<int>(op.scale);
+        }
+      }
+    }
+    if (op.value > 0) {
+      out << " + " << op.value;
+    } else if (op.value < 0) {
+      out << " - " << -op.value;
+    }
+    out << ']';
+    return;
+  case Operand::Kind::NONE:
+    break;
+  }
+}
+
+void AsmPrinter::data(EmitBuffer &out, const DataItem &item) {
+  if (item.unit != 1) {
+    out << (item.unit == 2 ? " dw " : item.unit == 4 ? " dd " : " dq ");
+    for (uint64_t i = 0; i < item.count; i++) {
+      // sign extend the little endian element
+      int64_t value = 0;
+      for (int b = item.unit - 1; b >= 0; b--) {
+        value = value << 8 | item.bytes[i * item.unit + b];
+      }
+      int shift = 64 - 8 * item.unit;
+      value = static_cast<int64_t>(static_cast<uint64_t>(value) << shift) >>
+              shift;
+      if (i) {
+        out << ", ";
+      }
+      out << value;
+    }
+    return;
+  }
+
+  // printable runs are quoted, everything else is written as a number
+  out << " db ";
+  bool quoted = false;
+  for (size_t i = 0; i < item.bytes.size(); i++) {
+    uint8_t byte = item.bytes[i];
+    bool printable = byte >= 0x20 && byte < 0x7F && byte != '"';
+    if (printable && !quoted) {
+      out << (i ? ", \"" : "\"");
+      quoted = true;
+    } else if (!printable && quoted) {
+      out << '"';
+      quoted = false;
+    }
+    if (printable) {
+      out << static_cast<char>(byte);
+    } else {
+      if (i) {
+        out << ", ";
+      }
+      out << byte;
+    }
+  }
+  if (quoted) {
+    out << '"';
+  }
+}
+
+void AsmPrinter::print(EmitBuffer &out) {
+  out << "default rel\n";
+  for (const auto &symbol : module.symbols) {
+    if (symbol.section == SectionKind::NONE) {
+      out << "extern " << symbol.name << '\n';
+    }
+  }
+
+  static const char *reserve[9] = {"",      " resb ", " resw ", "", " resd ",
+                                   "",      "",       "",       " resq "};
+  // nasm does not align items to their element size like the encoder does,
+  // so the padding is spelled out wherever an item would be misaligned
+  uint64_t offset = 0;
+  auto aligned = [&](const DataItem &item) {
+    uint8_t align = std::max(item.unit, item.align);
+    bool pad = item.align > item.unit || offset % align != 0;
+    offset = (offset + align - 1) / align * align +
+             static_cast<uint64_t>(item.unit) * item.count;
+    return pad ? align : 0;
+  };
+
+  // the sections start on the strictest boundary an item asks for, nasm's
+  // defaults are smaller than the cache line and vector alignments
+  auto section = [&](const char *name, const std::vector<DataItem> &items) {
+    uint8_t align = 1;
+    for (const auto &item : items) {
+      align = std::max({align, item.unit, item.align});
+    }
+    out << "section " << name;
+    if (align > 1) {
+      out << " align=" << align;
+    }
+    out << " \n";
+  };
+
+  section(".bss", module.bss);
+  for (const auto &item : module.bss) {
+    if (uint8_t align = aligned(item)) {
+      out << "    alignb " << align << '\n';
+    }
+    out << "    " << module.symbols[item.symbol].name << reserve[item.unit]
+        << item.count << '\n';
+  }
+
+  section(".data", module.data);
+  offset = 0;
+  for (const auto &item : module.data) {
+    if (uint8_t align = aligned(item)) {
+      out << "    align " << align << ", db 0\n";
+    }
+    out << "    " << module.symbols[item.symbol].name;
+    data(out, item);
+    out << '\n';
+  }
+
+  section(readOnly.c_str(), module.rodata);
+  for (const auto &item : module.rodata) {
+    if (item.align > 1) {
+      out << "    align " << item.align << ", db 0\n";
+    }
+    out << "    " << module.symbols[item.symbol].name;
+    data(out, item);
+    out << '\n';
+  }
+
+  out << "segment .text \n";
+  for (const auto &symbol : module.symbols) {
+    if (symbol.global) {
+      out << "    global " << symbol.name << '\n';
+    }
+  }
+
+  for (const auto &insn : module.text) {
+    if (insn.op == Opcode::LABEL) {
+      out << "    " << module.symbols[insn.dst.symbol].name << ":\n";
+      continue;
+    }
+
+    // the access size is spelled out when no register operand implies it
+    bool sized = (insn.dst.kind != Operand::Kind::REG &&
+                  insn.src.kind != Operand::Kind::REG) ||
+                 insn.op == Opcode::MOVZX || insn.op == Opcode::MOVSX ||
+                 insn.op == Opcode::MOVSXD;
+
+    out << mnemonic(insn);
+    if (insn.dst.kind != Operand::Kind::NONE) {
+      operand(out, insn.dst, sized);
+    }
+    if (insn.src.kind != Operand::Kind::NONE) {
+      out << ", ";
+      if (insn.op == Opcode::MOV && insn.dst.kind == Operand::Kind::REG &&
+          insn.src.kind == Operand::Kind::IMM &&
+          (insn.src.value < INT32_MIN || insn.src.value > INT32_MAX)) {
+        out << "0x";
+        out.hex(insn.src.value, 16);
+      } else {
+        operand(out, insn.src, sized);
+      }
+    }
+    if (insn.extra.kind != Operand::Kind::NONE) {
+      out << ", ";
+      operand(out, insn.extra, sized);
+    }
+    out << '\n';
+  }
+}
+
+} // namespace assembler
@@ -0,0 +1,33 @@
+#ifndef ASM_PRINTER_HPP
+#define ASM_PRINTER_HPP
+
+#include "../common/EmitBuffer.hpp"
+#include "Module.hpp"
+
+#include <string>
+
+namespace assembler {
+
+/*
+  Renders a Module as NASM source, as written by -S. Assembling the output
+  with nasm gives the same program the Encoder produces.
+*/
+class AsmPrinter {
+public:
+  // readOnly: name of the read-only data section in the object format
+  AsmPrinter(const Module &module, std::string readOnly = ".rodata");
+
+  void print(EmitBuffer &out);
+
+private:
+  const Module &module;
+  std::string readOnly;
+
+  void operand(EmitBuffer &out, const Operand &operand, bool sized);
+
+  void data(EmitBuffer &out, const DataItem &item);
+};
+
+} // namespace assembler
+
+#endif // !ASM_PRINTER_HPP
@@ -0,0 +1,567 @@
+#include "Encoder.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace assembler {
+
+namespace {
+
+int num(Reg r) { return static_cast<int>(r); }
+
+bool fitsInt8(int64_t value) { return value >= -128 && value <= 127; }
+
+bool fitsInt32(int64_t value) {
+  return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+// spl, bpl, sil and dil only exist with a REX prefix
+bool needsRex(const Operand &operand) {
+  return operand.kind == Operand::Kind::REG && operand.size == 1 &&
+         num(operand.base) >= 4 && num(operand.base) <= 7;
+}
+
+/*
+  Writes the bytes of one instruction. `at` is the offset of the instruction
+  in the text section, relocations are only recorded on the final pass.
+*/
+struct InstructionWriter {
+  std::vector<uint8_t> &out;
+  size_t start;
+  uint64_t at;
+  const Module &module;
+  std::vector<Relocation> *relocations;
+
+  uint64_t position() const { return at + (out.size() - start); }
+
+  void byte(uint8_t value) { out.push_back(value); }
+
+  void immediate(int64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+      out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+  }
+
+  /*
+    Operand size prefix, REX, opcode and ModRM/SIB/displacement for an
+    instruction whose reg field is `r` (a register or an opcode extension)
+    and whose r/m operand is `rm`. `trailing` is the number of immediate
+    bytes that will follow.
+  */
+  void op(std::initializer_list<uint8_t> opcode, uint8_t size, int r,
+          bool forceRex, const Operand &rm, int trailing) {
+    if (size == 2) {
+      byte(0x66);
+    }
+
+    int x = 0;
+    int b = 0;
+    if (rm.kind == Operand::Kind::REG) {
+      b = num(rm.base);
+    } else {
+      if (rm.base != Reg::RIP && rm.base != Reg::NONE) {
+        b = num(rm.base);
+      }
+      if (rm.index != Reg::NONE) {
+        x = num(rm.index);
+      }
+    }
+
+    uint8_t rex = 0x40 | (size == 8) << 3 | ((r >> 3) & 1) << 2 |
+                  ((x >> 3) & 1) << 1 | ((b >> 3) & 1);
+    if (rex != 0x40 || forceRex || needsRex(rm)) {
+      byte(rex);
+    }
+
+    for (uint8_t opcodeByte : opcode) {
+      byte(opcodeByte);
+    }
+    modrm(r, rm, trailing);
+  }
+
+  void modrm(int r, const Operand &rm, int trailing) {
+    if (rm.kind == Operand::Kind::REG) {
+      byte(0xC0 | (r & 7) << 3 | (num(rm.base) & 7));
+      return;
+    }
+
+    if (rm.base == Reg::RIP) {
+      byte(0x05 | (r & 7) << 3);
+      uint64_t field = position();
+      const Symbol &target = module.symbols.at(rm.symbol);
+      if (target.section == SectionKind::TEXT) {
+        immediate(target.offset + rm.value - (field + 4 + trailing), 4);
+      } else {
+        immediate(0, 4);
+        if (relocations) {
+          relocations->push_back({field, rm.symbol, rm.value,
+                                  static_cast<uint8_t>(trailing),
+                                  RelocationKind::PC32});
+        }
+      }
+      return;
+    }
+
+    int base = num(rm.base);
+    int64_t disp = rm.value;
+    int mod = 2;
+    if (disp == 0 && (base & 7) != 5) {
+      mod = 0;
+    } else if (fitsInt8(disp)) {
+      mod = 1;
+    }
+
+    if (rm.index != Reg::NONE) {
+      int scale = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+      byte(mod << 6 | (r & 7) << 3 | 4);
+      byte(scale << 6 | (num(rm.index) & 7) << 3 | (base & 7));
+    } else if ((base & 7) == 4) {
+      byte(mod << 6 | (r & 7) << 3 | 4);
+      byte(0x24);
+    } else {
+      byte(mod << 6 | (r & 7) << 3 | (base & 7));
+    }
+
+    if (mod == 1) {
+      immediate(disp, 1);
+    } else if (mod == 2) {
+      immediate(disp, 4);
+    }
+  }
+
+  // SSE instructions take the 66 prefix ahead of the REX prefix
+  void sse(std::initializer_list<uint8_t> opcode, int r, const Operand &rm,
+           int trailing) {
+    byte(0x66);
+    op(opcode, 4, r, false, rm, trailing);
+  }
+
+  /*
+    VEX prefix, opcode and ModRM of an AVX instruction with the implied 66
+    prefix. `map` is 1 for the 0F opcode map and 2 for 0F38, `v` the
+    register of the extra source operand and `wide` selects ymm operands.
+  */
+  void vex(uint8_t map, bool wide, int v, uint8_t opcode, int r,
+           const Operand &rm) {
+    int x = 0;
+    int b = 0;
+    if (rm.kind == Operand::Kind::REG) {
+      b = num(rm.base);
+    } else {
+      if (rm.base != Reg::RIP && rm.base != Reg::NONE) {
+        b = num(rm.base);
+      }
+      if (rm.index != Reg::NONE) {
+        x = num(rm.index);
+      }
+    }
+    uint8_t last = (~v & 15) << 3 | wide << 2 | 1;
+    if (map == 1 && x < 8 && b < 8) {
+      byte(0xC5);
+      byte((~r & 8) << 4 | last);
+    } else {
+      byte(0xC4);
+      byte((~r & 8) << 4 | (~x & 8) << 3 | (~b & 8) << 2 | map);
+      byte(last);
+    }
+    byte(opcode);
+    modrm(r, rm, 0);
+  }
+
+  void branchTarget(uint32_t symbol, int bytes) {
+    const Symbol &target = module.symbols.at(symbol);
+    if (target.section != SectionKind::TEXT) {
+      throw std::runtime_error("Jump to undefined label '" + target.name +
+                               "'.");
+    }
+    immediate(target.offset - (position() + bytes), bytes);
+  }
+};
+
+// opcode extension of the group 1 arithmetic instructions
+int aluDigit(Opcode op) {
+  switch (op) {
+  case Opcode::ADD:
+    return 0;
+  case Opcode::OR:
+    return 1;
+  case Opcode::AND:
+    return 4;
+  case Opcode::SUB:
+    return 5;
+  case Opcode::XOR:
+    return 6;
+  case Opcode::CMP:
+    return 7;
+  default:
+    throw std::logic_error("not an arithmetic instruction");
+  }
+}
+
+// opcode map and byte of the vector arithmetic instructions
+std::pair<uint8_t, uint8_t> vectorOpcode(Opcode op) {
+  switch (op) {
+  case Opcode::PADDD:
+    return {1, 0xFE};
+  case Opcode::PSUBD:
+    return {1, 0xFA};
+  case Opcode::PMULUDQ:
+    return {1, 0xF4};
+  case Opcode::PUNPCKLDQ:
+    return {1, 0x62};
+  case Opcode::PMULLD:
+    return {2, 0x40};
+  default:
+    throw std::logic_error("not a vector arithmetic instruction");
+  }
+}
+
+} // namespace
+
+Encoder::Encoder(Module &module) : module(module) {}
+
+ObjectCode Encoder::encode() {
+  layoutData();
+  layoutText();
+
+  for (size_t i = 0; i < module.text.size(); i++) {
+    encodeInstruction(module.text[i], i, code.text, true);
+  }
+
+  return std::move(code);
+}
+
+void Encoder::layoutData() {
+  /*
+    Every item is aligned to its element size, so dd variables never straddle
+    a boundary even when they follow a string, or further when it asks to.
+  */
+  for (auto &item : module.data) {
+    uint8_t align = std::max(item.unit, item.align);
+    while (code.data.size() % align != 0) {
+      code.data.push_back(0);
+    }
+    module.symbols[item.symbol].offset = code.data.size();
+    code.data.insert(code.data.end(), item.bytes.begin(), item.bytes.end());
+    code.data_align = std::max(code.data_align, align);
+  }
+
+  for (auto &item : module.rodata) {
+    uint8_t align = std::max(item.unit, item.align);
+    while (code.rodata.size() % align != 0) {
+      code.rodata.push_back(0);
+    }
+    module.symbols[item.symbol].offset = code.rodata.size();
+    code.rodata.insert(code.rodata.end(), item.bytes.begin(),
+                       item.bytes.end());
+    code.rodata_align = std::max(code.rodata_align, align);
+  }
+
+  for (auto &item : module.bss) {
+    uint8_t align = std::max(item.unit, item.align);
+    code.bss_size = (code.bss_size + align - 1) / align * align;
+    module.symbols[item.symbol].offset = code.bss_size;
+    code.bss_size += item.unit * item.count;
+    code.bss_align = std::max(code.bss_align, align);
+  }
+}
+
+void Encoder::layoutText() {
+  /*
+    Branch relaxation: every jump starts out as a rel8 and is widened to a
+    rel32 when its target is out of range. Widening a jump can only move
+    other targets further away, so this settles after a few passes.
+  */
+  std::vector<size_t> sizes(module.text.size());
+  std::vector<uint64_t> offsets(module.text.size());
+  std::vector<uint8_t> scratch;
+
+  long_jumps.assign(module.text.size(), false);
+
+  for (size_t i = 0; i < module.text.size(); i++) {
+    const Instruction &insn = module.text[i];
+    if (insn.op != Opcode::JMP && insn.op != Opcode::JCC) {
+      scratch.clear();
+      sizes[i] = encodeInstruction(insn, i, scratch, false);
+    }
+  }
+
+  bool changed = true;
+  while (changed) {
+    uint64_t offset = 0;
+    for (size_t i = 0; i < module.text.size(); i++) {
+      const Instruction &insn = module.text[i];
+      offsets[i] = offset;
+      if (insn.op == Opcode::LABEL) {
+        module.symbols[insn.dst.symbol].offset = offset;
+      } else if (insn.op == Opcode::JMP) {
+        offset += long_jumps[i] ? 5 : 2;
+      } else if (insn.op == Opcode::JCC) {
+        offset += long_jumps[i] ? 6 : 2;
+      } else {
+        offset += sizes[i];
+      }
+    }
+
+    changed = false;
+    for (size_t i = 0; i < module.text.size(); i++) {
+      const Instruction &insn = module.text[i];
+      if ((insn.op != Opcode::JMP && insn.op != Opcode::JCC) || long_jumps[i]) {
+        continue;
+      }
+      const Symbol &target = module.symbols.at(insn.dst.symbol);
+      int64_t disp = static_cast<int64_t>(target.offset) -
+                     static_cast<int64_t>(offsets[i] + 2);
+      if (target.section != SectionKind::TEXT || !fitsInt8(disp)) {
+        long_jumps[i] = true;
+        changed = true;
+      }
+    }
+  }
+}
+
+size_t Encoder::encodeInstruction(const Instruction &insn, size_t index,
+                                  std::vector<uint8_t> &out, bool record) {
+  using Kind = Operand::Kind;
+
+  size_t start = out.size();
+  uint64_t at = record ? out.size() : 0;
+  InstructionWriter w{out, start, at, module,
+                      record ? &code.relocations : nullptr};
+
+  const Operand &d = insn.dst;
+  const Operand &s = insn.src;
+  uint8_t size = d.kind == Kind::REG   ? d.size
+                 : s.kind == Kind::REG ? s.size
+                                       : d.size;
+  int immBytes = size == 8 ? 4 : size;
+
+  switch (insn.op) {
+  case Opcode::LABEL:
+    break;
+  case Opcode::MOV:
+    if (s.kind == Kind::IMM && d.kind == Kind::REG) {
+      int r = num(d.base);
+      if (size == 8 && (s.value < 0 || s.value > 0xFFFFFFFFLL)) {
+        if (fitsInt32(s.value)) {
+          w.op({0xC7}, 8, 0, false, d, 4);
+          w.immediate(s.value, 4);
+        } else {
+          w.byte(0x48 | (r >> 3));
+          w.byte(0xB8 + (r & 7));
+          w.immediate(s.value, 8);
+        }
+      } else {
+        // a 32-bit move clears the upper half, so it also serves 64-bit
+        if (size == 2) {
+          w.byte(0x66);
+        }
+        if (r >= 8 || needsRex(d)) {
+          w.byte(0x40 | (r >> 3));
+        }
+        w.byte((size == 1 ? 0xB0 : 0xB8) + (r & 7));
+        w.immediate(s.value, immBytes);
+      }
+    } else if (s.kind == Kind::IMM) {
+      w.op({static_cast<uint8_t>(size == 1 ? 0xC6 : 0xC7)}, size, 0, false, d,
+           immBytes);
+      w.immediate(s.value, immBytes);
+    } else if (s.kind == Kind::MEM) {
+      w.op({static_cast<uint8_t>(size == 1 ? 0x8A : 0x8B)}, size, num(d.base),
+           needsRex(d), s, 0);
+    } else {
+      w.op({static_cast<uint8_t>(size == 1 ? 0x88 : 0x89)}, size, num(s.base),
+           needsRex(s), d, 0);
+    }
+    break;
+  case Opcode::MOVZX:
+    w.op({0x0F, static_cast<uint8_t>(s.size == 1 ? 0xB6 : 0xB7)}, d.size,
+         num(d.base), false, s, 0);
+    break;
+  case Opcode::MOVSX:
+    w.op({0x0F, static_cast<uint8_t>(s.size == 1 ? 0xBE : 0xBF)}, d.size,
+         num(d.base), false, s, 0);
+    break;
+  case Opcode::MOVSXD:
+    w.op({0x63}, 8, num(d.base), false, s, 0);
+    break;
+  case Opcode::LEA:
+    w.op({0x8D}, d.size, num(d.base), false, s, 0);
+    break;
+  case Opcode::ADD:
+  case Opcode::OR:
+  case Opcode::AND:
+  case Opcode::SUB:
+  case Opcode::XOR:
+  case Opcode::CMP: {
+    int digit = aluDigit(insn.op);
+    if (s.kind == Kind::IMM) {
+      if (size == 1) {
+        w.op({0x80}, 1, digit, false, d, 1);
+        w.immediate(s.value, 1);
+      } else if (fitsInt8(s.value)) {
+        w.op({0x83}, size, digit, false, d, 1);
+        w.immediate(s.value, 1);
+      } else {
+        w.op({0x81}, size, digit, false, d, 4);
+        w.immediate(s.value, 4);
+      }
+    } else if (s.kind == Kind::MEM) {
+      w.op({static_cast<uint8_t>(digit * 8 + (size == 1 ? 2 : 3))}, size,
+           num(d.base), needsRex(d), s, 0);
+    } else {
+      w.op({static_cast<uint8_t>(digit * 8 + (size == 1 ? 0 : 1))}, size,
+           num(s.base), needsRex(s), d, 0);
+    }
+    break;
+  }
+  case Opcode::TEST:
+    if (s.kind == Kind::IMM) {
+      w.op({static_cast<uint8_t>(size == 1 ? 0xF6 : 0xF7)}, size, 0, false, d,
+           immBytes);
+      w.immediate(s.value, immBytes);
+    } else {
+      w.op({static_cast<uint8_t>(size == 1 ? 0x84 : 0x85)}, size, num(s.base),
+           needsRex(s), d, 0);
+    }
+    break;
+  case Opcode::IMUL:
+    if (insn.extra.kind == Kind::IMM && fitsInt8(insn.extra.value)) {
+      w.op({0x6B}, size, num(d.base), false, s, 1);
+      w.immediate(insn.extra.value, 1);
+    } else if (insn.extra.kind == Kind::IMM) {
+      w.op({0x69}, size, num(d.base), false, s, 4);
+      w.immediate(insn.extra.value, 4);
+    } else {
+      w.op({0x0F, 0xAF}, size, num(d.base), false, s, 0);
+    }
+    break;
+  case Opcode::DIV:
+    w.op({static_cast<uint8_t>(size == 1 ? 0xF6 : 0xF7)}, size, 6, false, d, 0);
+    break;
+  case Opcode::NEG:
+    w.op({static_cast<uint8_t>(size == 1 ? 0xF6 : 0xF7)}, size, 3, false, d, 0);
+    break;
+  case Opcode::INC:
+    w.op({static_cast<uint8_t>(size == 1 ? 0xFE : 0xFF)}, size, 0, false, d, 0);
+    break;
+  case Opcode::DEC:
+    w.op({static_cast<uint8_t>(size == 1 ? 0xFE : 0xFF)}, size, 1, false, d, 0);
+    break;
+  case Opcode::SHR:
+    if (s.value == 1) {
+      w.op({static_cast<uint8_t>(size == 1 ? 0xD0 : 0xD1)}, size, 5, false, d,
+           0);
+    } else {
+      w.op({static_cast<uint8_t>(size == 1 ? 0xC0 : 0xC1)}, size, 5, false, d,
+           1);
+      w.immediate(s.value, 1);
+    }
+    break;
+  case Opcode::PUSH:
+  case Opcode::POP:
+    if (num(d.base) >= 8) {
+      w.byte(0x41);
+    }
+    w.byte((insn.op == Opcode::PUSH ? 0x50 : 0x58) + (num(d.base) & 7));
+    break;
+  case Opcode::CALL: {
+    w.byte(0xE8);
+    const Symbol &target = module.symbols.at(d.symbol);
+    if (target.section == SectionKind::TEXT) {
+      w.branchTarget(d.symbol, 4);
+    } else {
+      uint64_t field = w.position();
+      w.immediate(0, 4);
+      if (record) {
+        code.relocations.push_back(
+            {field, d.symbol, 0, 0, RelocationKind::CALL});
+      }
+    }
+    break;
+  }
+  case Opcode::JMP:
+  case Opcode::JCC:
+    if (record && !long_jumps[index]) {
+      w.byte(insn.op == Opcode::JMP ? 0xEB
+                                    : 0x70 + static_cast<uint8_t>(insn.cond));
+      w.branchTarget(d.symbol, 1);
+    } else if (record) {
+      if (insn.op == Opcode::JMP) {
+        w.byte(0xE9);
+      } else {
+        w.byte(0x0F);
+        w.byte(0x80 + static_cast<uint8_t>(insn.cond));
+      }
+      w.branchTarget(d.symbol, 4);
+    }
+    break;
+  case Opcode::RET:
+    w.byte(0xC3);
+    break;
+  case Opcode::SYSCALL:
+    w.byte(0x0F);
+    w.byte(0x05);
+    break;
+  case Opcode::REP_MOVSB:
+    w.byte(0xF3);
+    w.byte(0xA4);
+    break;
+  case Opcode::CPUID:
+    w.byte(0x0F);
+    w.byte(0xA2);
+    break;
+  case Opcode::XGETBV:
+    w.byte(0x0F);
+    w.byte(0x01);
+    w.byte(0xD0);
+    break;
+  case Opcode::MOVD:
+    w.sse({0x0F, 0x6E}, num(d.base), s, 0);
+    break;
+  case Opcode::MOVDQA: {
+    // loads are 6F, stores 7F with the register in the reg field
+    bool load = d.kind == Kind::REG;
+    const Operand &r = load ? d : s;
+    const Operand &rm = load ? s : d;
+    uint8_t opcode = load ? 0x6F : 0x7F;
+    if (r.size == 32) {
+      w.vex(1, true, 0, opcode, num(r.base), rm);
+    } else {
+      w.sse({0x0F, opcode}, num(r.base), rm, 0);
+    }
+    break;
+  }
+  case Opcode::PADDD:
+  case Opcode::PSUBD:
+  case Opcode::PMULLD:
+  case Opcode::PMULUDQ:
+  case Opcode::PUNPCKLDQ: {
+    auto [map, opcode] = vectorOpcode(insn.op);
+    if (d.size == 32) {
+      w.vex(map, true, num(s.base), opcode, num(d.base), insn.extra);
+    } else if (map == 2) {
+      w.sse({0x0F, 0x38, opcode}, num(d.base), s, 0);
+    } else {
+      w.sse({0x0F, opcode}, num(d.base), s, 0);
+    }
+    break;
+  }
+  case Opcode::PSHUFD:
+    w.sse({0x0F, 0x70}, num(d.base), s, 1);
+    w.immediate(insn.extra.value, 1);
+    break;
+  case Opcode::VPBROADCASTD:
+    w.vex(2, d.size == 32, 0, 0x58, num(d.base), s);
+    break;
+  case Opcode::VZEROUPPER:
+    w.byte(0xC5);
+    w.byte(0xF8);
+    w.byte(0x77);
+    break;
+  }
+
+  return out.size() - start;
+}
+
+} // namespace assembler
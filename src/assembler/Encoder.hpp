@@ -0,0 +1,65 @@
+#ifndef ENCODER_HPP
+#define ENCODER_HPP
+
+#include "Module.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace assembler {
+
+enum class RelocationKind : uint8_t {
+  PC32, // rip relative data reference
+  CALL  // rel32 of a call to a symbol in another object
+};
+
+struct Relocation {
+  uint64_t offset; // of the 32-bit field in the text section
+  uint32_t symbol; // module symbol the field refers to
+  int64_t addend;  // added to the symbol address
+  uint8_t trailing; // instruction bytes after the field (immediates)
+  RelocationKind kind;
+};
+
+/*
+  Machine code and section contents of a Module. Every relocation is relative
+  to the end of its instruction: the field must end up holding
+  symbol + addend - (offset + 4 + trailing). The object writers translate
+  that into their own relocation types.
+*/
+struct ObjectCode {
+  std::vector<uint8_t> text;
+  std::vector<uint8_t> data;
+  std::vector<uint8_t> rodata;
+  uint64_t bss_size = 0;
+  uint8_t data_align = 1;
+  uint8_t rodata_align = 1;
+  uint8_t bss_align = 1;
+  std::vector<Relocation> relocations;
+};
+
+class Encoder {
+public:
+  Encoder(Module &module);
+
+  // lays out the sections, assigns symbol offsets and encodes the text
+  ObjectCode encode();
+
+private:
+  Module &module;
+  ObjectCode code;
+
+  // jumps that do not fit in a rel8, found by relaxation
+  std::vector<bool> long_jumps;
+
+  void layoutData();
+
+  void layoutText();
+
+  size_t encodeInstruction(const Instruction &insn, size_t index,
+                           std::vector<uint8_t> &out, bool record);
+};
+
+} // namespace assembler
+
+#endif // !ENCODER_HPP
@@ -0,0 +1,72 @@
+#include "Module.hpp"
+
+#include <stdexcept>
+
+namespace assembler {
+
+uint32_t Module::symbol(const std::string &name) {
+  auto it = symbol_ids.find(name);
+  if (it != symbol_ids.end()) {
+    return it->second;
+  }
+  uint32_t id = symbols.size();
+  symbols.push_back({name});
+  symbol_ids.emplace(name, id);
+  return id;
+}
+
+bool Module::isDefined(uint32_t id) const {
+  return symbols.at(id).section != SectionKind::NONE;
+}
+
+void Module::emit(Opcode op, Operand dst, Operand src, Operand extra) {
+  text.push_back({op, Cond::E, dst, src, extra});
+}
+
+void Module::jump(Cond cond, uint32_t target) {
+  text.push_back({Opcode::JCC, cond, sym(target), {}, {}});
+}
+
+void Module::label(uint32_t id, bool global) {
+  if (isDefined(id)) {
+    throw std::runtime_error("Symbol '" + symbols[id].name +
+                             "' is already defined.");
+  }
+  symbols[id].section = SectionKind::TEXT;
+  symbols[id].global = global;
+  text.push_back({Opcode::LABEL, Cond::E, sym(id), {}, {}});
+}
+
+void Module::defineData(uint32_t id, uint8_t unit, std::vector<uint8_t> bytes,
+                        uint8_t align) {
+  if (isDefined(id)) {
+    throw std::runtime_error("Symbol '" + symbols[id].name +
+                             "' is already defined.");
+  }
+  symbols[id].section = SectionKind::DATA;
+  uint64_t count = bytes.size() / unit;
+  data.push_back({id, unit, count, std::move(bytes), align});
+}
+
+void Module::defineConstant(uint32_t id, std::vector<uint8_t> bytes,
+                            uint8_t align) {
+  if (isDefined(id)) {
+    throw std::runtime_error("Symbol '" + symbols[id].name +
+                             "' is already defined.");
+  }
+  symbols[id].section = SectionKind::RODATA;
+  uint64_t count = bytes.size();
+  rodata.push_back({id, 1, count, std::move(bytes), align});
+}
+
+void Module::reserve(uint32_t id, uint8_t unit, uint64_t count,
+                     uint8_t align) {
+  if (isDefined(id)) {
+    throw std::runtime_error("Symbol '" + symbols[id].name +
+                             "' is already defined.");
+  }
+  symbols[id].section = SectionKind::BSS;
+  bss.push_back({id, unit, count, {}, align});
+}
+
+} // namespace assembler
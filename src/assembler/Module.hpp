@@ -0,0 +1,221 @@
+#ifndef MODULE_HPP
+#define MODULE_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace assembler {
+
+/*
+  A Module is the x86-64 program the Generator builds: the instructions of the
+  text section, the contents of the data, read-only data and bss sections and
+  the symbols they reference. The Encoder turns it into machine code, the AsmPrinter into NASM
+  source for -S.
+*/
+
+// xmm and ymm registers share the numbers, told apart by operand size
+enum class Reg : uint8_t {
+  RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+  R8, R9, R10, R11, R12, R13, R14, R15,
+  RIP, // only as the base of a memory operand
+  NONE
+};
+
+enum class Opcode : uint8_t {
+  LABEL, // defines the symbol in dst at this point of the text section
+  MOV,
+  MOVZX,
+  MOVSX,
+  MOVSXD,
+  LEA,
+  ADD,
+  SUB,
+  AND,
+  OR,
+  XOR,
+  CMP,
+  TEST,
+  IMUL,
+  DIV,
+  NEG,
+  INC,
+  DEC,
+  SHR,
+  PUSH,
+  POP,
+  CALL,
+  JMP,
+  JCC,
+  RET,
+  SYSCALL,
+  REP_MOVSB,
+  CPUID,
+  XGETBV,
+  /*
+    Vector instructions on xmm (16 byte) or ymm (32 byte) operands. On xmm
+    they take the SSE form `dst, src`, on ymm the AVX form
+    `dst, src, extra` with three operands.
+  */
+  MOVD,
+  MOVDQA,
+  PADDD,
+  PSUBD,
+  PMULLD,
+  PMULUDQ,
+  PSHUFD, // xmm only, the lane order is in extra
+  PUNPCKLDQ,
+  VPBROADCASTD,
+  VZEROUPPER
+};
+
+// condition codes, numbered as in the Jcc opcodes
+enum class Cond : uint8_t {
+  B = 0x2,
+  AE = 0x3,
+  E = 0x4,
+  NE = 0x5,
+  BE = 0x6,
+  A = 0x7,
+  S = 0x8,
+  NS = 0x9,
+  L = 0xC,
+  GE = 0xD,
+  LE = 0xE,
+  G = 0xF
+};
+
+enum class SectionKind : uint8_t { NONE, TEXT, DATA, BSS, RODATA };
+
+constexpr uint32_t NO_SYMBOL = 0xFFFFFFFF;
+
+struct Operand {
+  enum class Kind : uint8_t { NONE, REG, IMM, MEM, SYMBOL };
+
+  Kind kind = Kind::NONE;
+  uint8_t size = 0;        // access width in bytes
+  Reg base = Reg::NONE;    // REG: the register, MEM: base register
+  Reg index = Reg::NONE;   // MEM: index register
+  uint32_t symbol = NO_SYMBOL; // MEM: rip relative target, SYMBOL: target
+  int64_t value = 0;       // IMM: the immediate, MEM: displacement
+  uint8_t scale = 1;       // MEM: 1, 2, 4 or 8 times the index
+};
+
+constexpr Operand reg(Reg r, uint8_t size = 8) {
+  return {Operand::Kind::REG, size, r, Reg::NONE, NO_SYMBOL, 0};
+}
+
+constexpr Operand imm(int64_t value) {
+  return {Operand::Kind::IMM, 0, Reg::NONE, Reg::NONE, NO_SYMBOL, value};
+}
+
+// [symbol], addressed relative to rip
+constexpr Operand mem(uint32_t symbol, uint8_t size = 0) {
+  return {Operand::Kind::MEM, size, Reg::RIP, Reg::NONE, symbol, 0};
+}
+
+// [base + disp]
+constexpr Operand mem(Reg base, int32_t disp, uint8_t size = 0) {
+  return {Operand::Kind::MEM, size, base, Reg::NONE, NO_SYMBOL, disp};
+}
+
+// [base + index + disp]
+constexpr Operand mem(Reg base, Reg index, int32_t disp, uint8_t size = 0) {
+  return {Operand::Kind::MEM, size, base, index, NO_SYMBOL, disp};
+}
+
+// [base + index * scale + disp]
+constexpr Operand mem(Reg base, Reg index, uint8_t scale, int32_t disp,
+                      uint8_t size) {
+  return {Operand::Kind::MEM, size, base, index, NO_SYMBOL, disp, scale};
+}
+
+// xmm register n, or the ymm register with size 32
+constexpr Operand xmm(uint8_t n, uint8_t size = 16) {
+  return reg(static_cast<Reg>(n), size);
+}
+
+// branch and call targets
+constexpr Operand sym(uint32_t symbol) {
+  return {Operand::Kind::SYMBOL, 0, Reg::NONE, Reg::NONE, symbol, 0};
+}
+
+namespace regs {
+constexpr Operand rax = reg(Reg::RAX), rcx = reg(Reg::RCX),
+                  rdx = reg(Reg::RDX), rbx = reg(Reg::RBX),
+                  rsp = reg(Reg::RSP), rbp = reg(Reg::RBP),
+                  rsi = reg(Reg::RSI), rdi = reg(Reg::RDI),
+                  r8 = reg(Reg::R8), r9 = reg(Reg::R9), r10 = reg(Reg::R10),
+                  r11 = reg(Reg::R11), r12 = reg(Reg::R12),
+                  r13 = reg(Reg::R13), r14 = reg(Reg::R14),
+                  r15 = reg(Reg::R15);
+constexpr Operand eax = reg(Reg::RAX, 4), ecx = reg(Reg::RCX, 4),
+                  edx = reg(Reg::RDX, 4), ebx = reg(Reg::RBX, 4),
+                  esi = reg(Reg::RSI, 4), edi = reg(Reg::RDI, 4),
+                  r8d = reg(Reg::R8, 4), r13d = reg(Reg::R13, 4),
+                  r14d = reg(Reg::R14, 4), r15d = reg(Reg::R15, 4);
+constexpr Operand ax = reg(Reg::RAX, 2);
+constexpr Operand al = reg(Reg::RAX, 1), dl = reg(Reg::RDX, 1);
+} // namespace regs
+
+struct Instruction {
+  Opcode op;
+  Cond cond; // JCC only
+  Operand dst;
+  Operand src;
+  Operand extra; // imul r, r/m, imm, pshufd's order or an AVX source
+};
+
+struct Symbol {
+  std::string name;
+  SectionKind section = SectionKind::NONE; // NONE: defined in another object
+  bool global = false;
+  uint64_t offset = 0; // offset in its section, set by the Encoder
+};
+
+struct DataItem {
+  uint32_t symbol;
+  uint8_t unit;               // element size: 1 for db/resb, 4 for dd/resd
+  uint64_t count;             // number of elements
+  std::vector<uint8_t> bytes; // initial contents, empty in bss
+  uint8_t align = 1;          // start alignment beyond the element size
+};
+
+class Module {
+public:
+  std::vector<Symbol> symbols;
+  std::vector<Instruction> text;
+  std::vector<DataItem> data;
+  std::vector<DataItem> bss;
+  std::vector<DataItem> rodata;
+
+  // returns the id of the symbol with this name, adding it if needed
+  uint32_t symbol(const std::string &name);
+
+  bool isDefined(uint32_t id) const;
+
+  void emit(Opcode op, Operand dst = {}, Operand src = {}, Operand extra = {});
+
+  void jump(Cond cond, uint32_t target);
+
+  void label(uint32_t id, bool global = false);
+
+  // dd/db style initialized data
+  void defineData(uint32_t id, uint8_t unit, std::vector<uint8_t> bytes,
+                  uint8_t align = 1);
+
+  // read-only bytes, starting at a multiple of `align`
+  void defineConstant(uint32_t id, std::vector<uint8_t> bytes,
+                      uint8_t align = 1);
+
+  // resd/resb style reservation
+  void reserve(uint32_t id, uint8_t unit, uint64_t count, uint8_t align = 1);
+
+private:
+  std::unordered_map<std::string, uint32_t> symbol_ids;
+};
+
+} // namespace assembler
+
+#endif // !MODULE_HPP
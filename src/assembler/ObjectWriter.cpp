@@ -0,0 +1,425 @@
+#include "ObjectWriter.hpp"
+
+#include <string>
+
+namespace assembler {
+
+namespace {
+
+// little endian output buffer
+struct Bytes {
+  std::vector<uint8_t> buffer;
+
+  void put(uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+      buffer.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+  }
+  void u8(uint64_t value) { put(value, 1); }
+  void u16(uint64_t value) { put(value, 2); }
+  void u32(uint64_t value) { put(value, 4); }
+  void u64(uint64_t value) { put(value, 8); }
+
+  void append(const std::vector<uint8_t> &bytes) {
+    buffer.insert(buffer.end(), bytes.begin(), bytes.end());
+  }
+
+  void align(size_t alignment) {
+    while (buffer.size() % alignment != 0) {
+      buffer.push_back(0);
+    }
+  }
+
+  size_t size() const { return buffer.size(); }
+};
+
+// null terminated string table
+struct StringTable {
+  std::vector<uint8_t> bytes;
+
+  StringTable(size_t reserved) : bytes(reserved, 0) {}
+
+  uint32_t add(const std::string &name) {
+    uint32_t offset = bytes.size();
+    bytes.insert(bytes.end(), name.begin(), name.end());
+    bytes.push_back(0);
+    return offset;
+  }
+};
+
+// ELF constants
+constexpr uint32_t SHT_PROGBITS = 1, SHT_SYMTAB = 2, SHT_STRTAB = 3,
+                   SHT_RELA = 4, SHT_NOBITS = 8;
+constexpr uint64_t SHF_WRITE = 0x1, SHF_ALLOC = 0x2, SHF_EXECINSTR = 0x4,
+                   SHF_INFO_LINK = 0x40;
+constexpr uint8_t STB_LOCAL = 0, STB_GLOBAL = 1, STT_NOTYPE = 0,
+                  STT_SECTION = 3, STT_FILE = 4;
+constexpr uint16_t SHN_ABS = 0xfff1;
+constexpr uint32_t R_X86_64_PC32 = 2, R_X86_64_PLT32 = 4;
+
+// COFF constants
+constexpr uint16_t IMAGE_FILE_MACHINE_AMD64 = 0x8664;
+constexpr uint32_t IMAGE_SCN_CNT_CODE = 0x20,
+                   IMAGE_SCN_CNT_INITIALIZED_DATA = 0x40,
+                   IMAGE_SCN_CNT_UNINITIALIZED_DATA = 0x80,
+                   IMAGE_SCN_MEM_EXECUTE = 0x20000000,
+                   IMAGE_SCN_MEM_READ = 0x40000000,
+                   IMAGE_SCN_MEM_WRITE = 0x80000000;
+constexpr uint8_t IMAGE_SYM_CLASS_EXTERNAL = 2, IMAGE_SYM_CLASS_STATIC = 3;
+constexpr uint16_t IMAGE_REL_AMD64_REL32 = 4;
+
+// IMAGE_SCN_ALIGN_<n>BYTES
+uint32_t coffAlignment(uint8_t alignment) {
+  uint32_t log = 0;
+  while ((1u << log) < alignment) {
+    log++;
+  }
+  return (log + 1) << 20;
+}
+
+uint16_t elfSectionIndex(SectionKind section) {
+  switch (section) {
+  case SectionKind::TEXT:
+    return 1;
+  case SectionKind::DATA:
+    return 2;
+  case SectionKind::BSS:
+    return 3;
+  case SectionKind::RODATA:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+} // namespace
+
+ObjectWriter::ObjectWriter(const Module &module, const ObjectCode &code,
+                           const std::string &source)
+    : module(module), code(code), source(source) {}
+
+std::vector<uint8_t> ObjectWriter::elf64() {
+  /*
+    Sections: null, .text, .data, .bss, .rodata, .rela.text, .symtab,
+    .strtab, .shstrtab and an empty .note.GNU-stack so the stack is not
+    executable.
+  */
+  enum {
+    TEXT = 1,
+    DATA,
+    BSS,
+    RODATA,
+    RELA,
+    SYMTAB,
+    STRTAB,
+    SHSTRTAB,
+    NOTE,
+    COUNT
+  };
+
+  StringTable shstrtab(1);
+  uint32_t names[COUNT] = {0,
+                           shstrtab.add(".text"),
+                           shstrtab.add(".data"),
+                           shstrtab.add(".bss"),
+                           shstrtab.add(".rodata"),
+                           shstrtab.add(".rela.text"),
+                           shstrtab.add(".symtab"),
+                           shstrtab.add(".strtab"),
+                           shstrtab.add(".shstrtab"),
+                           shstrtab.add(".note.GNU-stack")};
+
+  // symbols: null, the source file, the four section symbols, locals, then
+  // globals. Without the file symbol ld names the locals after the path it
+  // was given, which for a memfd is a descriptor number.
+  StringTable strtab(1);
+  Bytes symtab;
+  std::vector<uint32_t> symbol_index(module.symbols.size());
+
+  auto symbol = [&](uint32_t name, uint8_t info, uint16_t section,
+                    uint64_t value) {
+    symtab.u32(name);
+    symtab.u8(info);
+    symtab.u8(0);
+    symtab.u16(section);
+    symtab.u64(value);
+    symtab.u64(0);
+  };
+
+  symbol(0, 0, 0, 0);
+  symbol(strtab.add(source), STB_LOCAL << 4 | STT_FILE, SHN_ABS, 0);
+  const uint32_t first_section_symbol = 2;
+  for (uint16_t section = TEXT; section <= RODATA; section++) {
+    symbol(0, STB_LOCAL << 4 | STT_SECTION, section, 0);
+  }
+  uint32_t count = first_section_symbol + RODATA;
+  for (size_t i = 0; i < module.symbols.size(); i++) {
+    const Symbol &sym = module.symbols[i];
+    if (sym.section != SectionKind::NONE && !sym.global) {
+      symbol(strtab.add(sym.name), STB_LOCAL << 4 | STT_NOTYPE,
+             elfSectionIndex(sym.section), sym.offset);
+      symbol_index[i] = count++;
+    }
+  }
+  uint32_t first_global = count;
+  for (size_t i = 0; i < module.symbols.size(); i++) {
+    const Symbol &sym = module.symbols[i];
+    if (sym.section == SectionKind::NONE || sym.global) {
+      symbol(strtab.add(sym.name), STB_GLOBAL << 4 | STT_NOTYPE,
+             elfSectionIndex(sym.section), sym.offset);
+      symbol_index[i] = count++;
+    }
+  }
+
+  // references to local data go through the section symbol
+  Bytes rela;
+  for (const Relocation &reloc : code.relocations) {
+    const Symbol &target = module.symbols[reloc.symbol];
+    uint64_t index = symbol_index[reloc.symbol];
+    int64_t addend = reloc.addend - 4 - reloc.trailing;
+    if (target.section != SectionKind::NONE) {
+      index = first_section_symbol + elfSectionIndex(target.section) - TEXT;
+      addend += target.offset;
+    }
+    uint32_t type =
+        reloc.kind == RelocationKind::CALL ? R_X86_64_PLT32 : R_X86_64_PC32;
+    rela.u64(reloc.offset);
+    rela.u64(index << 32 | type);
+    rela.u64(addend);
+  }
+
+  Bytes out;
+  out.buffer.resize(64);
+
+  uint64_t offsets[COUNT] = {};
+  uint64_t sizes[COUNT] = {};
+  auto place = [&](int section, const std::vector<uint8_t> &bytes,
+                   size_t alignment) {
+    out.align(alignment);
+    offsets[section] = out.size();
+    sizes[section] = bytes.size();
+    out.append(bytes);
+  };
+  place(TEXT, code.text, 16);
+  place(DATA, code.data, code.data_align);
+  place(RODATA, code.rodata, code.rodata_align);
+  offsets[BSS] = out.size();
+  sizes[BSS] = code.bss_size;
+  place(RELA, rela.buffer, 8);
+  place(SYMTAB, symtab.buffer, 8);
+  place(STRTAB, strtab.bytes, 1);
+  place(SHSTRTAB, shstrtab.bytes, 1);
+  offsets[NOTE] = out.size();
+
+  out.align(8);
+  uint64_t section_headers = out.size();
+
+  auto header = [&](int section, uint32_t type, uint64_t flags, uint32_t link,
+                    uint32_t info, uint64_t alignment, uint64_t entsize) {
+    out.u32(names[section]);
+    out.u32(type);
+    out.u64(flags);
+    out.u64(0);
+    out.u64(offsets[section]);
+    out.u64(sizes[section]);
+    out.u32(link);
+    out.u32(info);
+    out.u64(alignment);
+    out.u64(entsize);
+  };
+  out.buffer.resize(out.size() + 64);
+  header(TEXT, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, 0, 16, 0);
+  header(DATA, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 0, 0, code.data_align, 0);
+  header(BSS, SHT_NOBITS, SHF_ALLOC | SHF_WRITE, 0, 0, code.bss_align, 0);
+  header(RODATA, SHT_PROGBITS, SHF_ALLOC, 0, 0, code.rodata_align, 0);
+  header(RELA, SHT_RELA, SHF_INFO_LINK, SYMTAB, TEXT, 8, 24);
+  header(SYMTAB, SHT_SYMTAB, 0, STRTAB, first_global, 8, 24);
+  header(STRTAB, SHT_STRTAB, 0, 0, 0, 1, 0);
+  header(SHSTRTAB, SHT_STRTAB, 0, 0, 0, 1, 0);
+  header(NOTE, SHT_PROGBITS, 0, 0, 0, 1, 0);
+
+  // ELF header
+  Bytes elf;
+  elf.u8(0x7F);
+  elf.u8('E');
+  elf.u8('L');
+  elf.u8('F');
+  elf.u8(2); // ELFCLASS64
+  elf.u8(1); // little endian
+  elf.u8(1); // EV_CURRENT
+  elf.buffer.resize(16);
+  elf.u16(1);  // ET_REL
+  elf.u16(62); // EM_X86_64
+  elf.u32(1);
+  elf.u64(0); // entry
+  elf.u64(0); // program headers
+  elf.u64(section_headers);
+  elf.u32(0);
+  elf.u16(64); // header size
+  elf.u16(0);
+  elf.u16(0);
+  elf.u16(64); // section header size
+  elf.u16(COUNT);
+  elf.u16(SHSTRTAB);
+  std::copy(elf.buffer.begin(), elf.buffer.end(), out.buffer.begin());
+
+  return std::move(out.buffer);
+}
+
+std::vector<uint8_t> ObjectWriter::coff() {
+  /*
+    Sections .text, .data, .bss and .rdata. The symbol table starts with a static
+    symbol (plus its auxiliary record) per section, followed by the module
+    symbols. COFF keeps relocation addends in the relocated field itself.
+  */
+  constexpr int SECTIONS = 4;
+
+  StringTable strings(4);
+  Bytes symbols;
+  std::vector<uint32_t> symbol_index(module.symbols.size());
+
+  auto name = [&](const std::string &text) {
+    if (text.size() <= 8) {
+      for (size_t i = 0; i < 8; i++) {
+        symbols.u8(i < text.size() ? text[i] : 0);
+      }
+    } else {
+      symbols.u32(0);
+      symbols.u32(strings.add(text));
+    }
+  };
+
+  std::vector<uint8_t> text = code.text;
+  Bytes relocations;
+  for (const Relocation &reloc : code.relocations) {
+    const Symbol &target = module.symbols[reloc.symbol];
+    int64_t stored = reloc.addend;
+    uint32_t index;
+    if (target.section != SectionKind::NONE) {
+      index = (elfSectionIndex(target.section) - 1) * 2;
+      stored += target.offset;
+    } else {
+      index = SECTIONS * 2; // patched below once symbol indices are known
+    }
+    for (int i = 0; i < 4; i++) {
+      text[reloc.offset + i] = static_cast<uint8_t>(stored >> (8 * i));
+    }
+    relocations.u32(reloc.offset);
+    relocations.u32(index);
+    relocations.u16(IMAGE_REL_AMD64_REL32 + reloc.trailing);
+  }
+
+  const char *section_names[SECTIONS] = {".text", ".data", ".bss", ".rdata"};
+  uint64_t section_sizes[SECTIONS] = {text.size(), code.data.size(),
+                                      code.bss_size, code.rodata.size()};
+  uint32_t section_relocs[SECTIONS] = {
+      static_cast<uint32_t>(code.relocations.size()), 0, 0, 0};
+  for (int i = 0; i < SECTIONS; i++) {
+    name(section_names[i]);
+    symbols.u32(0);
+    symbols.u16(i + 1);
+    symbols.u16(0);
+    symbols.u8(IMAGE_SYM_CLASS_STATIC);
+    symbols.u8(1);
+    // section definition auxiliary record
+    symbols.u32(section_sizes[i]);
+    symbols.u16(section_relocs[i]);
+    symbols.u16(0);
+    symbols.u32(0);
+    symbols.u16(0);
+    symbols.u8(0);
+    symbols.u8(0);
+    symbols.u16(0);
+  }
+
+  uint32_t count = SECTIONS * 2;
+  for (size_t i = 0; i < module.symbols.size(); i++) {
+    const Symbol &sym = module.symbols[i];
+    bool external = sym.section == SectionKind::NONE || sym.global;
+    name(sym.name);
+    symbols.u32(sym.offset);
+    symbols.u16(elfSectionIndex(sym.section));
+    symbols.u16(sym.section == SectionKind::TEXT ? 0x20 : 0);
+    symbols.u8(external ? IMAGE_SYM_CLASS_EXTERNAL : IMAGE_SYM_CLASS_STATIC);
+    symbols.u8(0);
+    symbol_index[i] = count++;
+  }
+
+  // relocations against external symbols refer to their own entry
+  for (size_t i = 0; i < code.relocations.size(); i++) {
+    const Relocation &reloc = code.relocations[i];
+    if (module.symbols[reloc.symbol].section == SectionKind::NONE) {
+      uint32_t index = symbol_index[reloc.symbol];
+      for (int b = 0; b < 4; b++) {
+        relocations.buffer[i * 10 + 4 + b] =
+            static_cast<uint8_t>(index >> (8 * b));
+      }
+    }
+  }
+
+  uint32_t string_size = strings.bytes.size();
+  for (int i = 0; i < 4; i++) {
+    strings.bytes[i] = static_cast<uint8_t>(string_size >> (8 * i));
+  }
+
+  /*
+    layout: header, section headers, .text, its relocations, .data, .rdata,
+    symbols
+  */
+  uint32_t text_offset = 20 + 40 * SECTIONS;
+  uint32_t reloc_offset = text_offset + text.size();
+  uint32_t data_offset = reloc_offset + relocations.size();
+  uint32_t rodata_offset = data_offset + code.data.size();
+  uint32_t symbol_offset = rodata_offset + code.rodata.size();
+
+  Bytes out;
+  out.u16(IMAGE_FILE_MACHINE_AMD64);
+  out.u16(SECTIONS);
+  out.u32(0); // timestamp
+  out.u32(symbol_offset);
+  out.u32(count);
+  out.u16(0); // optional header size
+  out.u16(0);
+
+  auto header = [&](const char *section, uint32_t size, uint32_t raw,
+                    uint32_t relocs, uint16_t reloc_count,
+                    uint32_t characteristics) {
+    for (size_t i = 0; i < 8; i++) {
+      out.u8(i < std::char_traits<char>::length(section) ? section[i] : 0);
+    }
+    out.u32(0);
+    out.u32(0);
+    out.u32(size);
+    out.u32(raw);
+    out.u32(relocs);
+    out.u32(0);
+    out.u16(reloc_count);
+    out.u16(0);
+    out.u32(characteristics);
+  };
+  header(".text", text.size(), text_offset,
+         code.relocations.empty() ? 0 : reloc_offset, code.relocations.size(),
+         IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ |
+             coffAlignment(16));
+  header(".data", code.data.size(), code.data.empty() ? 0 : data_offset, 0, 0,
+         IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ |
+             IMAGE_SCN_MEM_WRITE | coffAlignment(code.data_align));
+  header(".bss", code.bss_size, 0, 0, 0,
+         IMAGE_SCN_CNT_UNINITIALIZED_DATA | IMAGE_SCN_MEM_READ |
+             IMAGE_SCN_MEM_WRITE | coffAlignment(code.bss_align));
+  header(".rdata", code.rodata.size(), code.rodata.empty() ? 0 : rodata_offset,
+         0, 0,
+         IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ |
+             coffAlignment(code.rodata_align));
+
+  out.append(text);
+  out.append(relocations.buffer);
+  out.append(code.data);
+  out.append(code.rodata);
+  out.append(symbols.buffer);
+  out.append(strings.bytes);
+
+  return std::move(out.buffer);
+}
+
+} // namespace assembler
@@ -0,0 +1,37 @@
+#ifndef OBJECT_WRITER_HPP
+#define OBJECT_WRITER_HPP
+
+#include "Encoder.hpp"
+#include "Module.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace assembler {
+
+/*
+  Writes the encoded text, data and bss sections of a Module as a relocatable
+  object file, together with its symbol table and the text relocations.
+*/
+class ObjectWriter {
+public:
+  // source: the file name recorded in the object's symbol table
+  ObjectWriter(const Module &module, const ObjectCode &code,
+               const std::string &source);
+
+  // ELF64 object for the x86-64 System V linkers (nasm -f elf64)
+  std::vector<uint8_t> elf64();
+
+  // COFF object for the Windows x64 linkers (nasm -f win64)
+  std::vector<uint8_t> coff();
+
+private:
+  const Module &module;
+  const ObjectCode &code;
+  std::string source;
+};
+
+} // namespace assembler
+
+#endif // !OBJECT_WRITER_HPP
@@ -0,0 +1,533 @@
+#include "CGenerator.hpp"
+
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+
+// buffered stdin/stdout, with the same input rules as the native runtime
+const char *RUNTIME = R"(#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#define mc_sys_read _read
+#define mc_sys_write _write
+#else
+#include <unistd.h>
+#define mc_sys_read read
+#define mc_sys_write write
+#endif
+
+#define MC_BUFFER 65536
+
+static char mc_in[MC_BUFFER], mc_out[MC_BUFFER];
+static int mc_in_pos, mc_in_len, mc_out_len;
+
+static void mc_flush(void) {
+  int done = 0;
+  while (done < mc_out_len) {
+    int n = mc_sys_write(1, mc_out + done, mc_out_len - done);
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  mc_out_len = 0;
+}
+
+static void mc_write(const char *bytes, int length) {
+  while (length > 0) {
+    int chunk = MC_BUFFER - mc_out_len < length ? MC_BUFFER - mc_out_len
+                                                : length;
+    memcpy(mc_out + mc_out_len, bytes, chunk);
+    mc_out_len += chunk;
+    bytes += chunk;
+    length -= chunk;
+    if (mc_out_len == MC_BUFFER)
+      mc_flush();
+  }
+}
+
+static void mc_print_long(long long value) {
+  char digits[21];
+  char *p = digits + sizeof digits;
+  unsigned long long magnitude =
+      value < 0 ? 0ull - (unsigned long long)value : (unsigned long long)value;
+  *--p = '\n';
+  do {
+    *--p = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude);
+  if (value < 0)
+    *--p = '-';
+  mc_write(p, (int)(digits + sizeof digits - p));
+}
+
+static void mc_print_char(signed char value) {
+  char bytes[2];
+  bytes[0] = (char)value;
+  bytes[1] = '\n';
+  mc_write(bytes, 2);
+}
+
+/* -1 at end of input; pending output is flushed before blocking */
+static int mc_peek(void) {
+  if (mc_in_pos == mc_in_len) {
+    int n;
+    mc_flush();
+    n = mc_sys_read(0, mc_in, MC_BUFFER);
+    mc_in_pos = 0;
+    mc_in_len = n > 0 ? n : 0;
+    if (!mc_in_len)
+      return -1;
+  }
+  return (unsigned char)mc_in[mc_in_pos];
+}
+
+/* scanf("%lld"): on failure the variable keeps its value, 0 is returned */
+static int mc_read_value(long long *destination) {
+  unsigned long long value = 0;
+  int negative = 0;
+  int c;
+  while ((c = mc_peek()) == ' ' || (c >= '\t' && c <= '\r'))
+    mc_in_pos++;
+  if (c == '+' || c == '-') {
+    negative = c == '-';
+    mc_in_pos++;
+    c = mc_peek();
+  }
+  if (c < '0' || c > '9')
+    return 0;
+  while ((c = mc_peek()) >= '0' && c <= '9') {
+    value = value * 10 + (unsigned)(c - '0');
+    mc_in_pos++;
+  }
+  *destination = (long long)(negative ? 0 - value : value);
+  return 1;
+}
+
+/* narrower variables wrap around like the native stores truncate */
+static void mc_read_short(short *destination) {
+  long long value;
+  if (mc_read_value(&value))
+    *destination = (short)value;
+}
+
+static void mc_read_int(int *destination) {
+  long long value;
+  if (mc_read_value(&value))
+    *destination = (int)value;
+}
+
+static void mc_read_long(long long *destination) {
+  mc_read_value(destination);
+}
+
+/* cin >> char: the next character that is not whitespace */
+static void mc_read_char(signed char *destination) {
+  int c;
+  while ((c = mc_peek()) == ' ' || (c >= '\t' && c <= '\r'))
+    mc_in_pos++;
+  if (c < 0)
+    return;
+  *destination = (signed char)c;
+  mc_in_pos++;
+}
+
+)";
+
+// C keywords and library names a variable could collide with
+const std::unordered_set<std::string> RESERVED = {
+    "auto",     "break",    "case",   "char",   "const",   "continue",
+    "default",  "do",       "double", "else",   "enum",    "extern",
+    "float",    "for",      "goto",   "if",     "inline",  "int",
+    "long",     "register", "restrict", "return", "short", "signed",
+    "sizeof",   "static",   "struct", "switch", "typedef", "union",
+    "unsigned", "void",     "volatile", "while", "main",   "memcpy",
+    "read",     "write",    "_read",  "_write"};
+
+void quote(EmitBuffer &out, const std::string &literal) {
+  out << '"';
+  for (unsigned char c : literal) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << static_cast<char>(c);
+    } else if (c < 0x20 || c >= 0x7F) {
+      // three digit octal, a hex escape would swallow following digits
+      out << '\\' << static_cast<char>('0' + (c >> 6))
+          << static_cast<char>('0' + ((c >> 3) & 7))
+          << static_cast<char>('0' + (c & 7));
+    } else {
+      out << static_cast<char>(c);
+    }
+  }
+  out << "\\n\"";
+}
+
+} // namespace
+
+CGenerator::CGenerator(std::vector<std::shared_ptr<node::Node>> nodes)
+    : NODES(std::move(nodes)) {}
+
+void CGenerator::generate(EmitBuffer &out) {
+  this->out = &out;
+  out << RUNTIME;
+  for (auto node : NODES) {
+    if (auto functionNode = std::dynamic_pointer_cast<FunctionNode>(node)) {
+      processFunction(functionNode);
+    }
+  }
+  out << "int main(void) {\n";
+  for (auto node : NODES) {
+    hoistDeclarations(node, false);
+  }
+  for (auto node : NODES) {
+    if (!std::dynamic_pointer_cast<FunctionNode>(node)) {
+      nodeGenerator(node);
+    }
+  }
+  out << "  mc_flush();\n  return 0;\n}\n";
+}
+
+void CGenerator::processFunction(std::shared_ptr<FunctionNode> functionNode) {
+  // a function only sees its parameters and its own locals
+  std::unordered_map<std::string, uint8_t> enclosing;
+  enclosing.swap(declared);
+  const std::string &name = functionNode->identifier->identifier.lexeme;
+  functions[name] = functionNode->width();
+
+  *out << "static " << (functionNode->width() ? type(functionNode->width())
+                                               : "void ");
+  variable(name);
+  *out << '(';
+  for (size_t i = 0; i < functionNode->parameters.size(); i++) {
+    uint8_t width = functionNode->parameters[i]->width();
+    declared[functionNode->parameter(i)] = width;
+    *out << (i ? ", " : "") << type(width);
+    variable(functionNode->parameter(i));
+  }
+  *out << (functionNode->parameters.empty() ? "void) {\n" : ") {\n");
+
+  hoistDeclarations(functionNode->body, false);
+  nodeGenerator(functionNode->body);
+  if (functionNode->width()) {
+    *out << "  return 0;\n";
+  }
+  *out << "}\n\n";
+  declared.swap(enclosing);
+}
+
+const char *CGenerator::type(uint8_t width) {
+  return width == 1   ? "signed char "
+         : width == 2 ? "short "
+         : width == 8 ? "long long "
+                      : "int ";
+}
+
+void CGenerator::indent() {
+  for (int i = 0; i < depth; i++) {
+    *out << "  ";
+  }
+}
+
+void CGenerator::hoistDeclarations(std::shared_ptr<node::Node> node,
+                                   bool nested) {
+  if (auto ifNode = std::dynamic_pointer_cast<IfNode>(node)) {
+    hoistDeclarations(ifNode->then, true);
+    if (ifNode->otherwise) {
+      hoistDeclarations(ifNode->otherwise, true);
+    }
+  } else if (auto whileNode = std::dynamic_pointer_cast<WhileNode>(node)) {
+    hoistDeclarations(whileNode->body, true);
+  } else if (auto sequenceNode =
+                 std::dynamic_pointer_cast<SequenceNode>(node)) {
+    for (auto statement : sequenceNode->statements) {
+      hoistDeclarations(statement, nested);
+    }
+  } else if (auto declNode = std::dynamic_pointer_cast<DeclarationNode>(node)) {
+    if (!nested) {
+      return;
+    }
+    std::vector<std::shared_ptr<IdentifierNode>> ids;
+    if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+            declNode->product)) {
+      ids.push_back(
+          std::get<std::shared_ptr<AssignmentNode>>(declNode->product)
+              ->identifier);
+    } else {
+      ids = std::get<std::vector<std::shared_ptr<IdentifierNode>>>(
+          declNode->product);
+    }
+    // the declaration itself becomes an assignment or nothing
+    processDeclaration(std::make_shared<DeclarationNode>(declNode->type, ids));
+  } else if (auto arrayNode =
+                 std::dynamic_pointer_cast<ArrayDeclarationNode>(node)) {
+    if (nested) {
+      processArrayDeclaration(arrayNode);
+    }
+  }
+}
+
+void CGenerator::variable(const std::string &name) {
+  *out << name;
+  if (RESERVED.count(name) || name.rfind("mc_", 0) == 0) {
+    *out << '_';
+  }
+}
+
+int64_t CGenerator::constantValue(const TOKEN &constant) {
+  try {
+    return std::stoll(constant.lexeme);
+  } catch (std::out_of_range &) {
+    throw std::runtime_error("Constant " + constant.lexeme +
+                             " is out of range at line " +
+                             std::to_string(constant.line));
+  }
+}
+
+void CGenerator::processExpression(std::shared_ptr<node::Node> expression) {
+  if (auto constantNode = std::dynamic_pointer_cast<ConstantNode>(expression)) {
+    // constants that do not fit in an int are long like in C++
+    int64_t value = constantValue(constantNode->constant);
+    *out << value << (value > INT32_MAX ? "LL" : "");
+    return;
+  }
+  if (auto identifierNode =
+          std::dynamic_pointer_cast<IdentifierNode>(expression)) {
+    variable(identifierNode->identifier.lexeme);
+    if (elementwise && arrays.count(identifierNode->identifier.lexeme)) {
+      *out << "[mc_i]";
+    }
+    return;
+  }
+  if (auto indexNode = std::dynamic_pointer_cast<IndexNode>(expression)) {
+    variable(indexNode->identifier->identifier.lexeme);
+    *out << '[';
+    processExpression(indexNode->index);
+    *out << ']';
+    return;
+  }
+  if (auto callNode = std::dynamic_pointer_cast<CallNode>(expression)) {
+    processCall(callNode);
+    return;
+  }
+  auto expressionNode = std::dynamic_pointer_cast<ExpressionNode>(expression);
+  processExpression(expressionNode->left);
+  *out << ' ' << expressionNode->OP << ' ';
+  processExpression(expressionNode->right);
+}
+
+void CGenerator::processCall(std::shared_ptr<CallNode> callNode) {
+  variable(callNode->identifier->identifier.lexeme);
+  *out << '(';
+  for (size_t i = 0; i < callNode->arguments.size(); i++) {
+    *out << (i ? ", " : "");
+    processExpression(callNode->arguments[i]);
+  }
+  *out << ')';
+}
+
+void CGenerator::processCondition(
+    std::shared_ptr<ConditionNode> conditionNode) {
+  *out << '(';
+  processExpression(conditionNode->left);
+  *out << ' ' << conditionNode->OP << ' ';
+  processExpression(conditionNode->right);
+  *out << ')';
+}
+
+void CGenerator::processBlock(std::shared_ptr<SequenceNode> sequenceNode) {
+  *out << " {\n";
+  depth++;
+  nodeGenerator(sequenceNode);
+  depth--;
+  indent();
+  *out << '}';
+}
+
+void CGenerator::processValue(std::shared_ptr<node::Node> value,
+                              uint8_t width) {
+  auto constantNode = std::dynamic_pointer_cast<ConstantNode>(value);
+  if (!constantNode || width == 8) {
+    processExpression(value);
+    return;
+  }
+  // narrowed here so the C compiler does not warn about the conversion
+  int64_t narrowed = constantValue(constantNode->constant);
+  if (width == 1) {
+    narrowed = static_cast<int8_t>(narrowed);
+  } else if (width == 2) {
+    narrowed = static_cast<int16_t>(narrowed);
+  } else {
+    narrowed = static_cast<int32_t>(narrowed);
+  }
+  *out << narrowed;
+}
+
+void CGenerator::processDeclaration(
+    std::shared_ptr<DeclarationNode> declarationNode) {
+  uint8_t width = declarationNode->width();
+  if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+          declarationNode->product)) {
+    auto assignmentNode =
+        std::get<std::shared_ptr<AssignmentNode>>(declarationNode->product);
+    const std::string &name = assignmentNode->identifier->identifier.lexeme;
+    indent();
+    if (declared.emplace(name, width).second) {
+      *out << type(width);
+    }
+    variable(name);
+    *out << " = ";
+    processValue(assignmentNode->assignment, width);
+    *out << ";\n";
+    return;
+  }
+
+  // 0 like the bss variables of the native code
+  for (auto &id : std::get<std::vector<std::shared_ptr<IdentifierNode>>>(
+           declarationNode->product)) {
+    if (declared.emplace(id->identifier.lexeme, width).second) {
+      indent();
+      *out << type(width);
+      variable(id->identifier.lexeme);
+      *out << " = 0;\n";
+    }
+  }
+}
+
+void CGenerator::processArrayDeclaration(
+    std::shared_ptr<ArrayDeclarationNode> arrayDeclarationNode) {
+  // static so large arrays are zeroed in .bss instead of on the stack
+  const std::string &name =
+      arrayDeclarationNode->identifier->identifier.lexeme;
+  if (arrays.emplace(name, arrayDeclarationNode->size()).second) {
+    indent();
+    *out << "static int ";
+    variable(name);
+    *out << '[' << arrayDeclarationNode->size() << "];\n";
+  }
+}
+
+void CGenerator::processArrayAssignment(
+    std::shared_ptr<AssignmentNode> assignmentNode) {
+  const std::string &name = assignmentNode->identifier->identifier.lexeme;
+  indent();
+  *out << "for (long long mc_i = 0; mc_i < " << arrays.at(name)
+       << "; mc_i++)\n";
+  depth++;
+  indent();
+  variable(name);
+  *out << "[mc_i] = ";
+  elementwise = true;
+  processValue(assignmentNode->assignment, 4);
+  elementwise = false;
+  *out << ";\n";
+  depth--;
+}
+
+void CGenerator::processCout(std::shared_ptr<CoutNode> coutNode) {
+  for (auto &expr : coutNode->operands) {
+    if (auto literalNode = std::dynamic_pointer_cast<StringLiteralNode>(expr)) {
+      const std::string &literal = literalNode->literal.lexeme;
+      indent();
+      *out << "mc_write(";
+      quote(*out, literal);
+      *out << ", " << literal.size() + 1 << ");\n";
+    } else {
+      // a char variable prints as a character, other values as numbers
+      auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(expr);
+      auto callNode = std::dynamic_pointer_cast<CallNode>(expr);
+      bool character =
+          (identifierNode &&
+           declared.at(identifierNode->identifier.lexeme) == 1) ||
+          (callNode && functions.at(callNode->identifier->identifier.lexeme) ==
+                           1);
+      indent();
+      *out << (character ? "mc_print_char(" : "mc_print_long(");
+      processExpression(expr);
+      *out << ");\n";
+    }
+  }
+}
+
+void CGenerator::processCin(std::shared_ptr<CinNode> cinNode) {
+  for (auto &expr : cinNode->operands) {
+    if (std::dynamic_pointer_cast<IndexNode>(expr)) {
+      indent();
+      *out << "mc_read_int(&";
+      processExpression(expr);
+      *out << ");\n";
+      continue;
+    }
+    auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(expr);
+    static const char *read[9] = {
+        "", "mc_read_char(&", "mc_read_short(&", "", "mc_read_int(&",
+        "", "",               "",                "mc_read_long(&"};
+    indent();
+    *out << read[declared.at(identifierNode->identifier.lexeme)];
+    variable(identifierNode->identifier.lexeme);
+    *out << ");\n";
+  }
+}
+
+void CGenerator::nodeGenerator(std::shared_ptr<node::Node> node) {
+  if (auto declNode = std::dynamic_pointer_cast<DeclarationNode>(node)) {
+    processDeclaration(declNode);
+  } else if (auto arrayNode =
+                 std::dynamic_pointer_cast<ArrayDeclarationNode>(node)) {
+    processArrayDeclaration(arrayNode);
+  } else if (auto assignNode =
+                 std::dynamic_pointer_cast<AssignmentNode>(node)) {
+    const std::string &name = assignNode->identifier->identifier.lexeme;
+    if (arrays.count(name)) {
+      processArrayAssignment(assignNode);
+      return;
+    }
+    indent();
+    variable(name);
+    *out << " = ";
+    processValue(assignNode->assignment, declared.at(name));
+    *out << ";\n";
+  } else if (auto elementNode =
+                 std::dynamic_pointer_cast<ElementAssignmentNode>(node)) {
+    indent();
+    processExpression(elementNode->element);
+    *out << " = ";
+    processValue(elementNode->assignment, 4);
+    *out << ";\n";
+  } else if (auto cinNode = std::dynamic_pointer_cast<CinNode>(node)) {
+    processCin(cinNode);
+  } else if (auto coutNode = std::dynamic_pointer_cast<CoutNode>(node)) {
+    processCout(coutNode);
+  } else if (auto callNode = std::dynamic_pointer_cast<CallNode>(node)) {
+    indent();
+    processCall(callNode);
+    *out << ";\n";
+  } else if (auto returnNode = std::dynamic_pointer_cast<ReturnNode>(node)) {
+    indent();
+    *out << "return";
+    if (returnNode->value) {
+      *out << ' ';
+      processExpression(returnNode->value);
+    }
+    *out << ";\n";
+  } else if (auto ifNode = std::dynamic_pointer_cast<IfNode>(node)) {
+    indent();
+    *out << "if ";
+    processCondition(ifNode->condition);
+    processBlock(ifNode->then);
+    if (ifNode->otherwise) {
+      *out << " else";
+      processBlock(ifNode->otherwise);
+    }
+    *out << '\n';
+  } else if (auto whileNode = std::dynamic_pointer_cast<WhileNode>(node)) {
+    indent();
+    *out << "while ";
+    processCondition(whileNode->condition);
+    processBlock(whileNode->body);
+    *out << '\n';
+  } else if (auto sequenceNode =
+                 std::dynamic_pointer_cast<SequenceNode>(node)) {
+    for (auto statement : sequenceNode->statements) {
+      nodeGenerator(statement);
+    }
+  }
+}
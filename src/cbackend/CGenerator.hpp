@@ -0,0 +1,89 @@
+#ifndef C_GENERATOR_HPP
+#define C_GENERATOR_HPP
+
+#include "../common/EmitBuffer.hpp"
+#include "../parser/Node.hpp"
+#include "../parser/Parser.hpp"
+
+#include <string>
+#include <unordered_map>
+
+/*
+  Lowers the parse tree to a C program (--backend=c) for the host C compiler
+  to optimize. Variables become locals of main, cin and cout calls into a
+  small buffered I/O runtime written at the top of the file. if and while
+  statements stay structured, the C compiler builds its own control flow.
+  Functions become static C functions before main, which the C compiler
+  inlines as it sees fit.
+*/
+class CGenerator {
+public:
+  CGenerator(std::vector<std::shared_ptr<node::Node>> nodes);
+
+  void generate(EmitBuffer &out);
+
+private:
+  std::vector<std::shared_ptr<node::Node>> NODES;
+  EmitBuffer *out = nullptr;
+
+  // width in bytes of the locals declared so far
+  std::unordered_map<std::string, uint8_t> declared;
+
+  // width in bytes of the values the functions defined so far return
+  std::unordered_map<std::string, uint8_t> functions;
+
+  // length of the arrays declared so far
+  std::unordered_map<std::string, uint64_t> arrays;
+
+  // set while writing the body of a whole-array loop, where arrays stand
+  // for their element at the loop index
+  bool elementwise = false;
+
+  // blocks the statement being written is nested in
+  int depth = 1;
+
+  void indent();
+
+  // the C type of a variable of `width` bytes, with a trailing space
+  static const char *type(uint8_t width);
+
+  // declares the variables of nested blocks at the top of main or of their
+  // function, where they stay visible after their block like in the source
+  // language
+  void hoistDeclarations(std::shared_ptr<node::Node> node, bool nested);
+
+  // writes the C name of a variable
+  void variable(const std::string &name);
+
+  int64_t constantValue(const TOKEN &constant);
+
+  void processExpression(std::shared_ptr<node::Node> expression);
+
+  // the value assigned to a variable of `width` bytes
+  void processValue(std::shared_ptr<node::Node> value, uint8_t width);
+
+  void processDeclaration(std::shared_ptr<DeclarationNode> declarationNode);
+
+  void processArrayDeclaration(
+      std::shared_ptr<ArrayDeclarationNode> arrayDeclarationNode);
+
+  // an assignment to a whole array, as a loop over its elements
+  void processArrayAssignment(std::shared_ptr<AssignmentNode> assignmentNode);
+
+  void processCout(std::shared_ptr<CoutNode> coutNode);
+
+  void processCin(std::shared_ptr<CinNode> cinNode);
+
+  void processCondition(std::shared_ptr<ConditionNode> conditionNode);
+
+  void processFunction(std::shared_ptr<FunctionNode> functionNode);
+
+  void processCall(std::shared_ptr<CallNode> callNode);
+
+  // a braced block of statements
+  void processBlock(std::shared_ptr<SequenceNode> sequenceNode);
+
+  void nodeGenerator(std::shared_ptr<node::Node> node);
+};
+
+#endif // !C_GENERATOR_HPP
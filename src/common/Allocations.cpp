@@ -0,0 +1,43 @@
+#include "Allocations.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<bool> counting{false};
+std::atomic<uint64_t> calls{0};
+std::atomic<uint64_t> bytes{0};
+
+} // namespace
+
+namespace allocations {
+
+void enable() { counting.store(true, std::memory_order_relaxed); }
+
+Count current() {
+  return {calls.load(std::memory_order_relaxed),
+          bytes.load(std::memory_order_relaxed)};
+}
+
+} // namespace allocations
+
+// the array and nothrow forms of the standard library call this one, and
+// the default operator delete frees what malloc returned
+void *operator new(std::size_t size) {
+  if (counting.load(std::memory_order_relaxed)) {
+    calls.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+  for (;;) {
+    if (void *memory = std::malloc(size ? size : 1)) {
+      return memory;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
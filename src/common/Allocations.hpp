@@ -0,0 +1,26 @@
+#ifndef ALLOCATIONS_HPP
+#define ALLOCATIONS_HPP
+
+#include <cstdint>
+
+/*
+  Counts the calls of the global operator new of the compiler and the
+  bytes they asked for, across all threads. Counting is off until
+  enable() is called, and costs one relaxed load per allocation until
+  then.
+*/
+namespace allocations {
+
+struct Count {
+  uint64_t calls = 0;
+  uint64_t bytes = 0;
+};
+
+void enable();
+
+// the allocations since enable()
+Count current();
+
+} // namespace allocations
+
+#endif // !ALLOCATIONS_HPP
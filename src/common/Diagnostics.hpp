@@ -0,0 +1,41 @@
+#ifndef DIAGNOSTICS_HPP
+#define DIAGNOSTICS_HPP
+
+#include <iostream>
+
+/*
+  How much the compiler tells about its work: nothing by default, what the
+  phases did with -v, and a line per analyzed statement with -vv. A
+  message is only formatted when its level is on, so the default run pays
+  one predictable branch per message. The level is the compiling
+  thread's own, so the requests of --serve each have theirs. Built with
+  -DMCOMPILER_NO_DIAGNOSTICS the levels are constant and the messages are
+  not compiled at all.
+*/
+namespace diagnostics {
+
+enum Level { QUIET = 0, VERBOSE = 1, TRACE = 2 };
+
+#ifdef MCOMPILER_NO_DIAGNOSTICS
+constexpr bool enabled(Level) { return false; }
+inline void setLevel(int) {}
+#else
+// per thread, set before a compilation starts on it: by main from the
+// command line, by the daemon from the options of each request
+inline thread_local int level = QUIET;
+
+inline bool enabled(Level at) { return level >= at; }
+inline void setLevel(int value) { level = value; }
+#endif
+
+} // namespace diagnostics
+
+// prints `message`, a chain of << operands, on its own line when `at` is on
+#define DIAGNOSE(at, message)                                                  \
+  do {                                                                         \
+    if (diagnostics::enabled(diagnostics::at)) {                               \
+      std::cout << message << '\n';                                            \
+    }                                                                          \
+  } while (0)
+
+#endif // !DIAGNOSTICS_HPP
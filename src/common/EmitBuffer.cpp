@@ -0,0 +1,137 @@
+#include "EmitBuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <cstdio>
+#else
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+EmitBuffer &EmitBuffer::operator<<(std::string_view text) {
+  append(text.data(), text.size());
+  return *this;
+}
+
+EmitBuffer &EmitBuffer::operator<<(char c) {
+  if (used == CHUNK_SIZE) {
+    chunks.push_back(std::make_unique<char[]>(CHUNK_SIZE));
+    used = 0;
+  }
+  chunks.back()[used++] = c;
+  total++;
+  return *this;
+}
+
+EmitBuffer &EmitBuffer::decimal(uint64_t value) {
+  char digits[20];
+  char *end = digits + sizeof(digits);
+  char *p = end;
+  do {
+    *--p = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value);
+  append(p, end - p);
+  return *this;
+}
+
+void EmitBuffer::hex(uint64_t value, int digits) {
+  static const char *hexDigits = "0123456789ABCDEF";
+  char text[16];
+  for (int i = digits - 1; i >= 0; i--) {
+    text[i] = hexDigits[value & 0xF];
+    value >>= 4;
+  }
+  append(text, digits);
+}
+
+void EmitBuffer::append(const char *bytes, size_t length) {
+  total += length;
+  while (length > 0) {
+    if (used == CHUNK_SIZE) {
+      chunks.push_back(std::make_unique<char[]>(CHUNK_SIZE));
+      used = 0;
+    }
+    size_t count = std::min(length, CHUNK_SIZE - used);
+    std::memcpy(chunks.back().get() + used, bytes, count);
+    used += count;
+    bytes += count;
+    length -= count;
+  }
+}
+
+std::string EmitBuffer::str() const {
+  std::string text;
+  text.reserve(total);
+  for (size_t i = 0; i < chunks.size(); i++) {
+    text.append(chunks[i].get(), i + 1 == chunks.size() ? used : CHUNK_SIZE);
+  }
+  return text;
+}
+
+std::vector<std::string_view> EmitBuffer::parts() const {
+  std::vector<std::string_view> views;
+  views.reserve(chunks.size());
+  for (size_t i = 0; i < chunks.size(); i++) {
+    views.emplace_back(chunks[i].get(),
+                       i + 1 == chunks.size() ? used : CHUNK_SIZE);
+  }
+  return views;
+}
+
+#ifdef _WIN32
+
+void EmitBuffer::writeFile(const std::string &path) const {
+  FILE *file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    throw std::runtime_error("Could not write " + path);
+  }
+  for (size_t i = 0; i < chunks.size(); i++) {
+    std::fwrite(chunks[i].get(), 1,
+                i + 1 == chunks.size() ? used : CHUNK_SIZE, file);
+  }
+  std::fclose(file);
+}
+
+#else
+
+void EmitBuffer::writeFile(const std::string &path) const {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Could not write " + path);
+  }
+
+  std::vector<iovec> parts(chunks.size());
+  for (size_t i = 0; i < chunks.size(); i++) {
+    parts[i].iov_base = chunks[i].get();
+    parts[i].iov_len = i + 1 == chunks.size() ? used : CHUNK_SIZE;
+  }
+
+  // one writev unless the file is over IOV_MAX chunks or the write is short
+  size_t next = 0;
+  while (next < parts.size()) {
+    int count = std::min<size_t>(parts.size() - next, IOV_MAX);
+    ssize_t written = writev(fd, parts.data() + next, count);
+    if (written < 0) {
+      close(fd);
+      throw std::runtime_error("Could not write " + path);
+    }
+    while (next < parts.size() &&
+           static_cast<size_t>(written) >= parts[next].iov_len) {
+      written -= parts[next].iov_len;
+      next++;
+    }
+    if (next < parts.size()) {
+      parts[next].iov_base = static_cast<char *>(parts[next].iov_base) + written;
+      parts[next].iov_len -= written;
+    }
+  }
+  close(fd);
+}
+
+#endif
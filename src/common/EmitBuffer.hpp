@@ -0,0 +1,58 @@
+#ifndef EMIT_BUFFER_HPP
+#define EMIT_BUFFER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/*
+  Append-only output buffer for generated source (-S assembly, the C
+  backend). Text is copied once into fixed size chunks that never move, and
+  the chunks are written to the file with a single writev.
+*/
+class EmitBuffer {
+public:
+  static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+  EmitBuffer &operator<<(std::string_view text);
+  EmitBuffer &operator<<(char c);
+
+  // integers in decimal
+  template <typename T, typename = std::enable_if_t<
+                            std::is_integral_v<T> && !std::is_same_v<T, char> &&
+                            !std::is_same_v<T, bool>>>
+  EmitBuffer &operator<<(T value) {
+    if constexpr (std::is_signed_v<T>) {
+      if (value < 0) {
+        *this << '-';
+        return decimal(0 - static_cast<uint64_t>(value));
+      }
+    }
+    return decimal(static_cast<uint64_t>(value));
+  }
+
+  void hex(uint64_t value, int digits);
+
+  size_t size() const { return total; }
+
+  std::string str() const;
+
+  // the text as it is laid out in the chunks
+  std::vector<std::string_view> parts() const;
+
+  void writeFile(const std::string &path) const;
+
+private:
+  std::vector<std::unique_ptr<char[]>> chunks;
+  size_t used = CHUNK_SIZE; // bytes used in the last chunk
+  size_t total = 0;
+
+  void append(const char *bytes, size_t length);
+
+  EmitBuffer &decimal(uint64_t value);
+};
+
+#endif // !EMIT_BUFFER_HPP
@@ -0,0 +1,101 @@
+#include "PerfCounters.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char *PerfCounters::name(int event) {
+  static const char *NAMES[COUNT] = {"cycles", "instructions",
+                                     "branch-misses", "cache-misses",
+                                     "dTLB-misses"};
+  return NAMES[event];
+}
+
+#ifdef __linux__
+
+PerfCounters::PerfCounters() {
+  static const uint32_t TYPES[COUNT] = {
+      PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+      PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE};
+  static const uint64_t CONFIGS[COUNT] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+          PERF_COUNT_HW_CACHE_RESULT_MISS << 16};
+
+  int failure = 0;
+  for (int event = 0; event < COUNT; event++) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = TYPES[event];
+    attr.config = CONFIGS[event];
+    // user space only, which perf_event_paranoid 2 still allows
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds[event] = syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                         PERF_FLAG_FD_CLOEXEC);
+    if (fds[event] < 0) {
+      failure = errno;
+    }
+  }
+
+  for (int fd : fds) {
+    if (fd >= 0) {
+      return;
+    }
+  }
+  reason = std::strerror(failure);
+  if (failure == EACCES || failure == EPERM) {
+    reason += " (see /proc/sys/kernel/perf_event_paranoid)";
+  } else if (failure == ENOENT || failure == EOPNOTSUPP) {
+    reason += " (no hardware counters, as in most virtual machines)";
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (int fd : fds) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+PerfCounters::Sample PerfCounters::read() const {
+  Sample sample;
+  for (int event = 0; event < COUNT; event++) {
+    uint64_t values[3]; // the count, the time enabled and the time running
+    if (fds[event] < 0 ||
+        ::read(fds[event], values, sizeof(values)) != sizeof(values)) {
+      continue;
+    }
+    sample.values[event] = values[0];
+    if (values[2] && values[2] < values[1]) {
+      sample.values[event] =
+          static_cast<uint64_t>(double(values[0]) * values[1] / values[2]);
+    }
+    sample.valid[event] = values[2] != 0;
+  }
+  return sample;
+}
+
+#else
+
+PerfCounters::PerfCounters() : reason("perf_event_open is Linux only") {
+  for (int &fd : fds) {
+    fd = -1;
+  }
+}
+
+PerfCounters::~PerfCounters() {}
+
+PerfCounters::Sample PerfCounters::read() const { return Sample(); }
+
+#endif
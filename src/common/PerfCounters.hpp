@@ -0,0 +1,54 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <cstdint>
+#include <string>
+
+/*
+  Hardware counters of the process, user space only, through Linux's
+  perf_event_open: cycles, instructions, branch misses, cache misses and
+  dTLB misses. Each counter is opened on its own, so a CPU or a container
+  without one of them still gets the others, and one without any (no
+  PMU, perf_event_paranoid, seccomp, not Linux) only gets an error().
+  Threads and processes started while the counters are open (the codegen
+  threads, the linker) are counted into them when they exit. A counter
+  the kernel multiplexed is scaled up to the time it was enabled.
+*/
+class PerfCounters {
+public:
+  enum Event {
+    CYCLES,
+    INSTRUCTIONS,
+    BRANCH_MISSES,
+    CACHE_MISSES,
+    DTLB_MISSES
+  };
+  static constexpr int COUNT = 5;
+
+  static const char *name(int event);
+
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  struct Sample {
+    uint64_t values[COUNT] = {};
+    bool valid[COUNT] = {};
+  };
+
+  // the counts since the counters were opened
+  Sample read() const;
+
+  bool available(int event) const { return fds[event] >= 0; }
+
+  // why no counter could be opened, empty when one could
+  const std::string &error() const { return reason; }
+
+private:
+  int fds[COUNT];
+  std::string reason;
+};
+
+#endif // !PERF_COUNTERS_HPP
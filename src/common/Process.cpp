@@ -0,0 +1,331 @@
+#include "Process.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+extern char **environ;
+#endif
+
+Process::Process(std::vector<std::string> arguments)
+    : arguments(std::move(arguments)) {}
+
+std::string Process::command() const {
+  std::string line;
+  for (const auto &argument : arguments) {
+    if (!line.empty()) {
+      line += ' ';
+    }
+    line += argument;
+  }
+  return line;
+}
+
+void Process::inherit(const ObjectFile &object) {
+  inherited = object.descriptor();
+}
+
+#ifdef _WIN32
+
+namespace {
+
+std::string quote(const std::string &argument) {
+  if (argument.find_first_of(" \t\"") == std::string::npos) {
+    return argument;
+  }
+  std::string quoted = "\"";
+  for (char c : argument) {
+    if (c == '"') {
+      quoted += '\\';
+    }
+    quoted += c;
+  }
+  return quoted + '"';
+}
+
+} // namespace
+
+// no posix_spawn: the command goes through the shell and the input through
+// a file redirected to stdin
+void Process::run(const EmitBuffer *input) {
+  std::string line;
+  for (const auto &argument : arguments) {
+    line += (line.empty() ? "" : " ") + quote(argument);
+  }
+
+  std::string file;
+  if (input) {
+    file = std::tmpnam(nullptr);
+    input->writeFile(file);
+    line += " < " + quote(file);
+  }
+
+  int status = std::system(line.c_str());
+  if (!file.empty()) {
+    std::remove(file.c_str());
+  }
+  check(status, "");
+}
+
+void Process::check(int status, const std::string &errors) const {
+  if (status != 0) {
+    throw std::runtime_error(arguments[0] + " failed with exit status " +
+                             std::to_string(status));
+  }
+}
+
+ObjectFile::ObjectFile(const std::vector<uint8_t> &bytes,
+                       const std::string &fallback)
+    : name(fallback) {
+  std::ofstream file(name, std::ios::binary);
+  file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+  file.close();
+  if (!file) {
+    throw std::runtime_error("Could not write object file " + name);
+  }
+}
+
+ObjectFile::~ObjectFile() { std::remove(name.c_str()); }
+
+#else
+
+namespace {
+
+void closePipe(int &fd) {
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+// pipe ends stay in this process, the child only gets the dup2'd copies.
+// With pipe2 they are close-on-exec from the start, so a tool another
+// thread spawns meanwhile cannot inherit them and hold stderr open.
+bool openPipe(int fds[2]) {
+#ifdef __linux__
+  return pipe2(fds, O_CLOEXEC) == 0;
+#else
+  if (pipe(fds) < 0) {
+    return false;
+  }
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  return true;
+#endif
+}
+
+} // namespace
+
+void Process::run(const EmitBuffer *input) {
+  std::vector<char *> argv;
+  for (auto &argument : arguments) {
+    argv.push_back(const_cast<char *>(argument.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  int in[2] = {-1, -1};
+  int err[2] = {-1, -1};
+  if (!openPipe(err) || (input && !openPipe(in))) {
+    closePipe(err[0]);
+    closePipe(err[1]);
+    throw std::runtime_error("Could not create a pipe for " + arguments[0]);
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (input) {
+    posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+  }
+  posix_spawn_file_actions_adddup2(&actions, err[1], STDERR_FILENO);
+  if (inherited >= 0) {
+    posix_spawn_file_actions_adddup2(&actions, inherited,
+                                     ObjectFile::CHILD_FD);
+  }
+
+  // a tool that exits early makes writes fail with EPIPE instead of killing
+  // the compiler, the child gets the default handler back
+  signal(SIGPIPE, SIG_IGN);
+  posix_spawnattr_t attributes;
+  posix_spawnattr_init(&attributes);
+  sigset_t defaults;
+  sigemptyset(&defaults);
+  sigaddset(&defaults, SIGPIPE);
+  posix_spawnattr_setsigdefault(&attributes, &defaults);
+  posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF);
+
+  pid_t pid;
+  int error = posix_spawnp(&pid, argv[0], &actions, &attributes, argv.data(),
+                           environ);
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attributes);
+  closePipe(in[0]);
+  closePipe(err[1]);
+  if (error != 0) {
+    closePipe(in[1]);
+    closePipe(err[0]);
+    throw std::runtime_error("Could not run " + arguments[0] + ": " +
+                             std::strerror(error));
+  }
+
+  // feed stdin and drain stderr together so neither side blocks the other
+  std::vector<std::string_view> pending;
+  if (input) {
+    pending = input->parts();
+    fcntl(in[1], F_SETFL, O_NONBLOCK);
+  }
+  size_t next = 0;
+  size_t offset = 0;
+  if (next == pending.size()) {
+    closePipe(in[1]);
+  }
+
+  std::string errors;
+  while (in[1] >= 0 || err[0] >= 0) {
+    pollfd fds[2];
+    nfds_t count = 0;
+    if (in[1] >= 0) {
+      fds[count++] = {in[1], POLLOUT, 0};
+    }
+    if (err[0] >= 0) {
+      fds[count++] = {err[0], POLLIN, 0};
+    }
+    if (poll(fds, count, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    for (nfds_t i = 0; i < count; i++) {
+      if (!fds[i].revents) {
+        continue;
+      }
+      if (fds[i].fd == in[1]) {
+        std::string_view part = pending[next];
+        ssize_t written =
+            write(in[1], part.data() + offset, part.size() - offset);
+        if (written < 0) {
+          if (errno != EAGAIN && errno != EINTR) {
+            closePipe(in[1]); // the tool stopped reading
+          }
+          continue;
+        }
+        offset += written;
+        if (offset == part.size()) {
+          next++;
+          offset = 0;
+        }
+        if (next == pending.size()) {
+          closePipe(in[1]);
+        }
+      } else {
+        char buffer[4096];
+        ssize_t length = read(err[0], buffer, sizeof(buffer));
+        if (length > 0) {
+          errors.append(buffer, length);
+        } else if (length == 0 || errno != EINTR) {
+          closePipe(err[0]);
+        }
+      }
+    }
+  }
+  closePipe(in[1]);
+  closePipe(err[0]);
+
+  int status;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      throw std::runtime_error("Lost track of " + arguments[0]);
+    }
+  }
+  check(status, errors);
+}
+
+void Process::check(int status, const std::string &errors) const {
+  if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+    std::cerr << errors; // warnings are passed on
+    return;
+  }
+
+  std::string message = arguments[0];
+  if (WIFEXITED(status)) {
+    message += " failed with exit status " +
+               std::to_string(WEXITSTATUS(status));
+  } else {
+    message += " was killed by signal " + std::to_string(WTERMSIG(status));
+  }
+  if (!errors.empty()) {
+    message += ":\n" + errors.substr(0, errors.find_last_not_of('\n') + 1);
+  }
+  throw std::runtime_error(message);
+}
+
+ObjectFile::ObjectFile(const std::vector<uint8_t> &bytes,
+                       const std::string &fallback) {
+#ifdef __linux__
+  // close-on-exec so the linkers of other threads do not inherit it, only
+  // the tool it is passed to gets a copy
+  fd = memfd_create("object", MFD_CLOEXEC);
+  if (fd == CHILD_FD) {
+    // dup2 onto the same number would leave it close-on-exec
+    int moved = fcntl(fd, F_DUPFD_CLOEXEC, CHILD_FD + 1);
+    close(fd);
+    fd = moved;
+  }
+#endif
+  if (fd >= 0) {
+    name = "/proc/self/fd/" + std::to_string(CHILD_FD);
+  } else {
+    name = fallback;
+    fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Could not write object file " + name);
+    }
+  }
+
+  size_t done = 0;
+  while (done < bytes.size()) {
+    ssize_t written = write(fd, bytes.data() + done, bytes.size() - done);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      close(fd);
+      if (name == fallback) {
+        unlink(name.c_str());
+      }
+      throw std::runtime_error("Could not write object file " + name);
+    }
+    done += written;
+  }
+
+  // the fallback file is reopened by the linker, only the memfd stays open
+  if (name == fallback) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+ObjectFile::~ObjectFile() {
+  if (fd >= 0) {
+    close(fd);
+  } else {
+    unlink(name.c_str());
+  }
+}
+
+#endif
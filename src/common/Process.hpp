@@ -0,0 +1,66 @@
+#ifndef PROCESS_HPP
+#define PROCESS_HPP
+
+#include "EmitBuffer.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ObjectFile;
+
+/*
+  Runs an external tool (the linker, gcc for the C backend) straight from its
+  argument vector with posix_spawn, without a shell in between. Input is
+  streamed into the tool's stdin through a pipe and its stderr is collected,
+  so a failing tool is reported with its exit status and its own messages.
+*/
+class Process {
+public:
+  Process(std::vector<std::string> arguments);
+
+  // the command line, for printing
+  std::string command() const;
+
+  // passes the object's descriptor on to the tool, so it can open the path
+  void inherit(const ObjectFile &object);
+
+  // runs the tool to completion, throws when it cannot start or fails
+  void run(const EmitBuffer *input = nullptr);
+
+private:
+  std::vector<std::string> arguments;
+  int inherited = -1;
+
+  void check(int status, const std::string &errors) const;
+};
+
+/*
+  Object code handed to the linker by path. On Linux the bytes live in an
+  anonymous close-on-exec memfd, which Process::inherit hands to the tool as
+  descriptor CHILD_FD, opened there through /proc/self/fd/3. Elsewhere the
+  bytes are written to `fallback` and removed again.
+*/
+class ObjectFile {
+public:
+  ObjectFile(const std::vector<uint8_t> &bytes, const std::string &fallback);
+  ~ObjectFile();
+
+  ObjectFile(const ObjectFile &) = delete;
+  ObjectFile &operator=(const ObjectFile &) = delete;
+
+  // the descriptor number in the tool, the same for every object so the
+  // linked executable does not depend on it
+  static constexpr int CHILD_FD = 3;
+
+  const std::string &path() const { return name; }
+
+  // the memfd, or -1 when the object is the fallback file
+  int descriptor() const { return fd; }
+
+private:
+  int fd = -1;
+  std::string name;
+};
+
+#endif // !PROCESS_HPP
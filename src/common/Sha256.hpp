@@ -0,0 +1,28 @@
+#ifndef SHA256_HPP
+#define SHA256_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// SHA-256 (FIPS 180-4) of a stream of bytes, for naming cached files by
+// their content
+class Sha256 {
+public:
+  Sha256();
+
+  Sha256 &update(std::string_view bytes);
+
+  // the digest in lowercase hex, after which the hash cannot be updated
+  std::string hex();
+
+private:
+  uint32_t state[8];
+  uint8_t block[64];
+  size_t used = 0;    // bytes in `block`
+  uint64_t total = 0; // bytes hashed
+
+  void compress();
+};
+
+#endif // !SHA256_HPP
@@ -6,17 +6,33 @@
 enum class TokenType {
   ADDITION_OPERATOR,
   SUBTRACTION_OPERATOR,
+  MULTIPLICATION_OPERATOR,
+  RELATIONAL_OPERATOR, // < <= > >= == !=
   ASSIGNMENT_OPERATOR,
   COUT_KEYWORD,
   DELIMITER,
   PUNCTUATOR,
   IDENTIFIER,
+  CHAR_KEYWORD,
+  SHORT_KEYWORD,
   INT_KEYWORD,
+  LONG_KEYWORD,
   CONSTANT,
   LITERAL,
   COUT_OPERATOR,
   CIN_OPERATOR,
   CIN_KEYWORD,
+  IF_KEYWORD,
+  ELSE_KEYWORD,
+  WHILE_KEYWORD,
+  VOID_KEYWORD,
+  RETURN_KEYWORD,
+  LEFT_PARENTHESIS,
+  RIGHT_PARENTHESIS,
+  LEFT_BRACE,
+  RIGHT_BRACE,
+  LEFT_BRACKET,
+  RIGHT_BRACKET,
   UNKNOWN
 };
 
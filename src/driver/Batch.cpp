@@ -0,0 +1,126 @@
+#include "Batch.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+double since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+} // namespace
+
+Batch::Batch(const CompileOptions &options, std::string directory,
+             unsigned jobs)
+    : options(options), directory(std::move(directory)), jobs(jobs) {}
+
+std::vector<std::string> Batch::sources() const {
+  namespace fs = std::filesystem;
+  if (!fs::is_directory(directory)) {
+    throw std::runtime_error("Not a directory: " + directory);
+  }
+  std::vector<std::string> files;
+  for (const auto &entry : fs::recursive_directory_iterator(directory)) {
+    if (entry.is_regular_file() && entry.path().extension() == ".mcpp") {
+      files.push_back(entry.path().string());
+    }
+  }
+  // the report does not depend on the order the directory lists them in
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+Batch::Report Batch::run() {
+  auto start = std::chrono::steady_clock::now();
+  Report report;
+  std::vector<std::string> files = sources();
+  report.results.resize(files.size());
+
+  {
+    ThreadPool pool(jobs);
+    report.threads = pool.size();
+    for (size_t i = 0; i < files.size(); i++) {
+      report.results[i].file = files[i];
+      pool.submit([&, i] {
+        Result &result = report.results[i];
+        std::shared_ptr<Compilation> compiled;
+        auto begin = std::chrono::steady_clock::now();
+        try {
+          compiled = std::make_shared<Compilation>(
+              options, files[i], changeExtension(files[i], ""));
+          compiled->parse();
+          compiled->analyze();
+          compiled->generate();
+          if (options.assembly_only || options.object_only) {
+            compiled->write();
+          }
+        } catch (std::exception &e) {
+          result.compile_seconds = since(begin);
+          result.error = Compilation::message(e);
+          return;
+        }
+        result.compile_seconds = since(begin);
+        if (options.assembly_only || options.object_only) {
+          result.ok = true;
+          return;
+        }
+
+        // most likely run next by this worker, unless an idle one steals it
+        pool.submit([&result, compiled] {
+          auto begin = std::chrono::steady_clock::now();
+          try {
+            compiled->link();
+            result.ok = true;
+          } catch (std::exception &e) {
+            result.error = Compilation::message(e);
+          }
+          result.link_seconds = since(begin);
+        });
+      });
+    }
+    pool.wait();
+    report.steals = pool.steals();
+  }
+
+  for (const auto &result : report.results) {
+    report.failed += !result.ok;
+  }
+  report.seconds = since(start);
+  return report;
+}
+
+void Batch::print(const Report &report, std::ostream &out) {
+  double compile = 0;
+  double link = 0;
+  for (const auto &result : report.results) {
+    if (!result.ok) {
+      out << result.file << ": Error: " << result.error << std::endl;
+    }
+    compile += result.compile_seconds;
+    link += result.link_seconds;
+  }
+
+  size_t files = report.results.size();
+  out << std::fixed << std::setprecision(3);
+  out << "batch: " << files << " files, " << files - report.failed
+      << " compiled, " << report.failed << " failed in " << report.seconds
+      << " s";
+  if (report.seconds > 0) {
+    out << " (" << std::setprecision(1) << files / report.seconds
+        << " files/s)" << std::setprecision(3);
+  }
+  out << std::endl;
+  out << "threads: " << report.threads << ", " << report.steals
+      << " tasks stolen, " << compile << " s compiling, " << link
+      << " s linking" << std::endl;
+  out.unsetf(std::ios::floatfield);
+  out << std::setprecision(6);
+}
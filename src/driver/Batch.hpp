@@ -0,0 +1,51 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include "Compilation.hpp"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+  --batch: every .mcpp file under a directory compiled in one process, each
+  into an executable (with -S or -c its assembly or object) next to it. A
+  file is one task on a work-stealing ThreadPool that runs it through its
+  own pipeline, and its link is a task of its own, so the linkers other
+  files spawn run while the next files are compiled.
+*/
+class Batch {
+public:
+  // 0 jobs picks one per hardware thread
+  Batch(const CompileOptions &options, std::string directory,
+        unsigned jobs = 0);
+
+  struct Result {
+    std::string file;
+    bool ok = false;
+    std::string error;
+    double compile_seconds = 0; // parse through generate, and -S
+    double link_seconds = 0;
+  };
+
+  struct Report {
+    std::vector<Result> results; // in the order of the file names
+    unsigned threads = 0;
+    size_t steals = 0;
+    double seconds = 0; // wall clock of the whole batch
+    size_t failed = 0;
+  };
+
+  Report run();
+
+  static void print(const Report &report, std::ostream &out);
+
+private:
+  CompileOptions options;
+  std::string directory;
+  unsigned jobs;
+
+  std::vector<std::string> sources() const;
+};
+
+#endif // !BATCH_HPP
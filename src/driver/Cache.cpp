@@ -0,0 +1,270 @@
+#include "Cache.hpp"
+#include "../common/Sha256.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// a compiler built from other sources may generate different code for the
+// same program. The Makefile and compile.bat pass a hash of the sources;
+// other builds hash the running executable once, where the system names
+// it, and have no version elsewhere.
+std::string version() {
+#ifdef MCOMPILER_VERSION
+  return MCOMPILER_VERSION;
+#else
+  static const std::string hash = [] {
+    std::ifstream file("/proc/self/exe", std::ios::binary);
+    if (!file) {
+      return std::string();
+    }
+    Sha256 executable;
+    char buffer[1 << 16];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount()) {
+      executable.update(std::string_view(buffer, file.gcount()));
+    }
+    return executable.hex();
+  }();
+  return hash;
+#endif
+}
+
+// a name no other writer picks at the same time
+std::string temporary(const std::string &directory) {
+  static thread_local std::mt19937_64 random(std::random_device{}());
+  static const char DIGITS[] = "0123456789abcdef";
+  std::string name = directory + "/tmp.";
+  uint64_t bits = random();
+  for (int i = 0; i < 16; i++) {
+    name += DIGITS[(bits >> (4 * i)) & 15];
+  }
+  return name;
+}
+
+// the cached files: the ones in the subdirectories, but for the files
+// being written
+template <typename Visit>
+void cached(const std::string &directory, Visit visit) {
+  std::error_code error;
+  fs::recursive_directory_iterator it(directory, error), end;
+  for (; it != end; it.increment(error)) {
+    if (it.depth() == 1 && it->is_regular_file(error) &&
+        it->path().filename().string().rfind("tmp.", 0) != 0) {
+      visit(*it);
+    }
+  }
+}
+
+} // namespace
+
+Cache::Cache(std::string directory, uint64_t limit)
+    : directory(std::move(directory)), size_limit(limit) {
+  if (version().empty()) {
+    throw std::runtime_error("--cache-dir needs a compiler built with "
+                             "MCOMPILER_VERSION defined");
+  }
+  std::error_code error;
+  fs::create_directories(this->directory, error);
+  if (!fs::is_directory(this->directory)) {
+    throw std::runtime_error("Could not create the cache directory " +
+                             this->directory);
+  }
+}
+
+std::string Cache::key(const std::string &source,
+                       const CompileOptions &options) {
+  // every field is prefixed with its length, so no two lists of fields
+  // hash the same bytes
+  Sha256 hash;
+  auto field = [&](std::string_view value) {
+    hash.update(std::to_string(value.size())).update(":").update(value);
+  };
+  field(version());
+  field(source);
+  field(kind(options));
+  field(options.target);
+  field(options.backend);
+  field(options.freestanding ? "freestanding" : "hosted");
+  field(std::to_string(static_cast<int>(options.simd)));
+  return hash.hex();
+}
+
+std::string Cache::kind(const CompileOptions &options) {
+  if (options.assembly_only) {
+    return options.backend == "c" ? "c" : "asm";
+  }
+  return options.object_only ? "o" : "exe";
+}
+
+std::string Cache::entry(const std::string &key,
+                         const std::string &kind) const {
+  return directory + "/" + key.substr(0, 2) + "/" + key.substr(2) + "." +
+         kind;
+}
+
+void Cache::copy(const std::string &path, const std::string &to) const {
+  std::string parent = fs::path(to).parent_path().string();
+  std::string staged = temporary(parent.empty() ? "." : parent);
+  try {
+    fs::copy_file(path, staged, fs::copy_options::overwrite_existing);
+    fs::rename(staged, to);
+  } catch (...) {
+    std::error_code error;
+    fs::remove(staged, error);
+    throw;
+  }
+}
+
+bool Cache::fetch(const std::string &key, const std::string &kind,
+                  const std::string &path) {
+  std::string cached = entry(key, kind);
+  std::error_code error;
+  try {
+    copy(cached, path);
+  } catch (fs::filesystem_error &) {
+    // not cached, or evicted by another compiler meanwhile
+    update([](Stats &counts) { counts.misses++; });
+    return false;
+  }
+  fs::last_write_time(cached, fs::file_time_type::clock::now(), error);
+  update([](Stats &counts) { counts.hits++; });
+  return true;
+}
+
+void Cache::store(const std::string &key, const std::string &kind,
+                  const std::string &path) {
+  std::string cached = entry(key, kind);
+  fs::create_directories(fs::path(cached).parent_path());
+  std::error_code error;
+  uint64_t replaced = fs::file_size(cached, error);
+  if (error) {
+    replaced = 0; // not cached yet
+  }
+  copy(path, cached);
+  uint64_t added = fs::file_size(cached, error);
+  if (error) {
+    added = 0;
+  }
+
+  // the directory is only scanned once the tracked size is over the limit
+  update([&](Stats &counts) {
+    counts.bytes += added;
+    counts.bytes -= std::min(replaced, counts.bytes);
+    if (counts.bytes > size_limit) {
+      evict(counts);
+    }
+  });
+}
+
+void Cache::evict(Stats &counts) {
+  struct File {
+    fs::file_time_type used;
+    uint64_t size;
+    fs::path path;
+  };
+  std::vector<File> files;
+  uint64_t total = 0;
+  std::error_code error;
+  cached(directory, [&](const fs::directory_entry &entry) {
+    files.push_back({entry.last_write_time(error), entry.file_size(error),
+                     entry.path()});
+    total += files.back().size;
+  });
+
+  std::sort(files.begin(), files.end(),
+            [](const File &a, const File &b) { return a.used < b.used; });
+  for (const auto &file : files) {
+    if (total <= size_limit) {
+      break;
+    }
+    if (fs::remove(file.path, error)) {
+      total -= file.size;
+      counts.evictions++;
+    }
+  }
+  // the scan corrects what the other compilers' stores left out
+  counts.bytes = total;
+}
+
+void Cache::update(const std::function<void(Stats &)> &change) {
+#ifndef _WIN32
+  int lock = open((directory + "/lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+                  0644);
+  if (lock >= 0) {
+    flock(lock, LOCK_EX);
+  }
+#endif
+  bool sized = false;
+  Stats counts = counters(&sized);
+  if (!sized) {
+    // a cache from before sizes were tracked
+    std::error_code error;
+    cached(directory, [&](const fs::directory_entry &entry) {
+      counts.bytes += entry.file_size(error);
+    });
+  }
+  change(counts);
+  std::string staged = temporary(directory);
+  {
+    std::ofstream file(staged);
+    file << "hits " << counts.hits << "\nmisses " << counts.misses
+         << "\nevictions " << counts.evictions << "\nbytes " << counts.bytes
+         << "\n";
+  }
+  std::error_code error;
+  fs::rename(staged, directory + "/stats", error);
+#ifndef _WIN32
+  if (lock >= 0) {
+    close(lock); // releases the lock
+  }
+#endif
+}
+
+Cache::Stats Cache::counters(bool *sized) const {
+  Stats counts;
+  std::ifstream file(directory + "/stats");
+  std::string name;
+  uint64_t value;
+  while (file >> name >> value) {
+    if (name == "hits") {
+      counts.hits = value;
+    } else if (name == "misses") {
+      counts.misses = value;
+    } else if (name == "evictions") {
+      counts.evictions = value;
+    } else if (name == "bytes") {
+      counts.bytes = value;
+      if (sized) {
+        *sized = true;
+      }
+    }
+  }
+  return counts;
+}
+
+Cache::Stats Cache::stats() const {
+  // counted again, the tracked size may be behind
+  Stats counts = counters();
+  counts.bytes = 0;
+  std::error_code error;
+  cached(directory, [&](const fs::directory_entry &entry) {
+    counts.files++;
+    counts.bytes += entry.file_size(error);
+  });
+  return counts;
+}
@@ -0,0 +1,74 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include "Compilation.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/*
+  Compiled files kept on disk by the SHA-256 of what they are made of: the
+  source bytes, the version of the compiler and every option that changes
+  the output. A file is one of the kinds below, under
+  <directory>/<2 hex digits>/<the other 62>.<kind>.
+
+  Files are written under a temporary name and renamed into place, so a
+  reader never sees half of one, and compilers sharing the directory at
+  the same time are safe. A hit touches the file. Hits, misses, evictions
+  and the size of the cached files are counted in <directory>/stats, and
+  only a store that takes the size over the limit scans the directory,
+  evicting the least recently used files until the cache fits again.
+*/
+class Cache {
+public:
+  Cache(std::string directory,
+        uint64_t limit = CompileOptions::DEFAULT_CACHE_SIZE);
+
+  // the key of a source compiled with `options`
+  static std::string key(const std::string &source,
+                         const CompileOptions &options);
+
+  // the kind of file the options produce: asm, c, o or exe
+  static std::string kind(const CompileOptions &options);
+
+  // copies the cached file to `path`, false for a miss
+  bool fetch(const std::string &key, const std::string &kind,
+             const std::string &path);
+
+  // caches the file at `path`
+  void store(const std::string &key, const std::string &kind,
+             const std::string &path);
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t files = 0;
+    uint64_t bytes = 0;
+  };
+
+  Stats stats() const;
+
+  uint64_t limit() const { return size_limit; }
+
+private:
+  std::string directory;
+  uint64_t size_limit;
+
+  std::string entry(const std::string &key, const std::string &kind) const;
+
+  // `path` copied to `to` through a temporary file and a rename
+  void copy(const std::string &path, const std::string &to) const;
+
+  // removes files until the cache fits, counts is updated to match
+  void evict(Stats &counts);
+
+  // the counts in the stats file, `sized` set when it has the size
+  Stats counters(bool *sized = nullptr) const;
+
+  // changes the counts in the stats file, under a lock
+  void update(const std::function<void(Stats &)> &change);
+};
+
+#endif // !CACHE_HPP
@@ -0,0 +1,309 @@
+#include "Compilation.hpp"
+#include "../assembler/AsmPrinter.hpp"
+#include "../assembler/Encoder.hpp"
+#include "../cbackend/CGenerator.hpp"
+#include "../common/Diagnostics.hpp"
+#include "../common/Process.hpp"
+#include "../lexer/Lexer.hpp"
+#include "../parser/Parser.hpp"
+#include "../semantic/SyntaxAnalyzer.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+bool CompileOptions::set(const std::string &arg) {
+  auto number = [](const std::string &value) {
+    if (value.empty() ||
+        value.find_first_not_of("0123456789") != std::string::npos) {
+      throw std::runtime_error("Invalid number of jobs: " + value);
+    }
+    return static_cast<unsigned>(std::stoul(value));
+  };
+
+  if (arg == "-ffreestanding") {
+    freestanding = true;
+  } else if (arg == "-S") {
+    assembly_only = true;
+  } else if (arg == "-c") {
+    object_only = true;
+  } else if (arg.rfind("--backend=", 0) == 0) {
+    backend = arg.substr(10);
+    if (backend != "native" && backend != "c") {
+      throw std::runtime_error("Unknown backend: " + backend);
+    }
+  } else if (arg.rfind("--codegen-jobs=", 0) == 0) {
+    codegen_jobs = number(arg.substr(15));
+  } else if (arg.rfind("--simd=", 0) == 0) {
+    std::string value = arg.substr(7);
+    if (value == "scalar") {
+      simd = Generator::Simd::SCALAR;
+    } else if (value == "sse2") {
+      simd = Generator::Simd::SSE2;
+    } else if (value == "avx2") {
+      simd = Generator::Simd::AVX2;
+    } else if (value == "auto") {
+      simd = Generator::Simd::AUTO;
+    } else {
+      throw std::runtime_error("Unknown instruction set: " + value);
+    }
+  } else if (arg.rfind("--target=", 0) == 0) {
+    target = arg.substr(9);
+  } else if (arg == "-v" || arg == "-vv") {
+    verbosity += arg.size() - 1;
+  } else if (arg == "--dump-tokens") {
+    dump_tokens = true;
+  } else if (arg == "--dump-ast") {
+    dump_ast = true;
+  } else if (arg == "--dump-asm") {
+    dump_asm = true;
+  } else if (arg == "-ftime-report" || arg == "-ftime-report=json" ||
+             arg == "-fmem-report" || arg == "-fmem-report=json" ||
+             arg == "-fperf-report" || arg == "-fperf-report=json") {
+    report_columns.time |= arg.rfind("-ftime-report", 0) == 0;
+    report_columns.memory |= arg.rfind("-fmem-report", 0) == 0;
+    report_columns.counters |= arg.rfind("-fperf-report", 0) == 0;
+    if (arg.size() > 5 && arg.substr(arg.size() - 5) == "=json") {
+      report_format = PhaseReport::Format::JSON;
+    }
+  } else if (arg.rfind("--cache-dir=", 0) == 0) {
+    cache_dir = arg.substr(12);
+  } else if (arg.rfind("--cache-size=", 0) == 0) {
+    std::string value = arg.substr(13);
+    if (value.empty() || value.size() > 12 ||
+        value.find_first_not_of("0123456789") != std::string::npos) {
+      throw std::runtime_error("Invalid cache size: " + value);
+    }
+    cache_size = std::stoull(value) << 20;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void CompileOptions::check() const {
+  if (backend == "c" && freestanding) {
+    throw std::runtime_error("-ffreestanding needs the native backend");
+  }
+  if (backend == "c" && object_only && !assembly_only) {
+    throw std::runtime_error("-c needs the native backend");
+  }
+}
+
+Compilation::Compilation(const CompileOptions &options, std::string filename,
+                         std::string exename)
+    : options(options), filename(std::move(filename)),
+      exename(std::move(exename)),
+      log(diagnostics::enabled(diagnostics::VERBOSE) ? &std::cout : nullptr) {
+  output_target = options.run ? std::make_unique<JitTarget>()
+                              : Target::create(options.target);
+}
+
+const std::string &Compilation::sourceCode() {
+  if (!source_code) {
+    PhaseReport::Scope phase(phase_report, "read");
+    std::ifstream file(filename);
+    if (!file) {
+      throw std::runtime_error("Could not open file: " + filename);
+    }
+    std::ostringstream ss;
+    ss << file.rdbuf(); // Reading Code
+    source_code = ss.str();
+  }
+  return *source_code;
+}
+
+void Compilation::parse() { parse(sourceCode()); }
+
+void Compilation::parse(const std::string &code) {
+  {
+    PhaseReport::Scope phase(phase_report, "lex");
+    Lexer lexer(code);
+    token_list = lexer.lex();
+  }
+  {
+    PhaseReport::Scope phase(phase_report, "parse");
+    parser::Parser parser(token_list);
+    node_list = parser.parse();
+  }
+
+  if (options.dump_tokens) {
+    printTokens(std::cout);
+  }
+  if (options.dump_ast) {
+    std::cout << "Parse Tree: " << std::endl;
+    for (auto node : node_list) {
+      node->print();
+      std::cout << std::endl;
+    }
+  }
+}
+
+void Compilation::printTokens(std::ostream &out) const {
+  std::ostringstream table;
+  table << "Tokens: " << '\n'
+        << std::left << std::setw(30) << "Token Type" << std::setw(20)
+        << "Lexeme" << std::setw(10) << "Line" << '\n'
+        << std::string(60, '-') << '\n';
+  for (const auto &token : token_list) {
+    table << std::left << std::setw(30)
+          << parser::Parser::printTokenType(token.type) << std::setw(20)
+          << token.lexeme << std::setw(10) << token.line << '\n';
+  }
+  out << table.str() << std::flush;
+}
+
+void Compilation::analyze() {
+  PhaseReport::Scope phase(phase_report, "analyze");
+  SyntaxAnalyzer analyzer(node_list);
+  analyzer.analyzeSemantics();
+}
+
+void Compilation::generate() {
+  {
+    PhaseReport::Scope phase(phase_report, "generate");
+    if (options.backend == "c") {
+      CGenerator(node_list).generate(text);
+    } else {
+      native.emplace(node_list, *output_target, options.freestanding,
+                     options.codegen_jobs, options.simd);
+      code.emplace(native->generate());
+    }
+  }
+
+  if (options.dump_asm) {
+    std::cout << source().str() << std::flush;
+  }
+  if (log) {
+    report(*log);
+  }
+}
+
+const EmitBuffer &Compilation::source() {
+  if (options.backend == "native" && !printed) {
+    PhaseReport::Scope phase(phase_report, "assemble");
+    assembler::AsmPrinter(*code, output_target->readOnlySection())
+        .print(text);
+    printed = true;
+  }
+  return text;
+}
+
+std::vector<uint8_t> Compilation::object() {
+  PhaseReport::Scope phase(phase_report, "assemble");
+  assembler::ObjectCode object_code = assembler::Encoder(*code).encode();
+  if (log) {
+    *log << "text: " << object_code.text.size() << " bytes, data: "
+         << object_code.data.size() << " bytes, bss: "
+         << object_code.bss_size << " bytes" << std::endl;
+  }
+  // the file name without its directory, as gcc records it
+  std::string source = filename.substr(filename.find_last_of("/\\") + 1);
+  return output_target->object(*code, object_code, source);
+}
+
+std::string Compilation::outputName() const {
+  if (options.assembly_only) {
+    return changeExtension(filename, options.backend == "c" ? ".c" : ".asm");
+  }
+  return changeExtension(filename, ".o");
+}
+
+std::string Compilation::executable() const {
+  // the Windows linker gives it the extension .exe
+  if (output_target->name() == "win64" && options.backend == "native") {
+    return changeExtension(exename, ".exe");
+  }
+  return exename;
+}
+
+std::string Compilation::write() {
+  std::string newFile = outputName();
+  if (options.assembly_only) {
+    const EmitBuffer &assembly = source();
+    PhaseReport::Scope phase(phase_report, "write");
+    assembly.writeFile(newFile);
+    return newFile;
+  }
+  std::vector<uint8_t> bytes = object();
+  PhaseReport::Scope phase(phase_report, "write");
+  std::ofstream file(newFile, std::ios::binary);
+  file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+  file.close();
+  if (!file) {
+    throw std::runtime_error("Could not write " + newFile);
+  }
+  return newFile;
+}
+
+void Compilation::link() {
+  if (options.backend == "c") {
+    // the source is piped into gcc, -fwrapv: int arithmetic wraps around
+    // like the native backend's
+    PhaseReport::Scope phase(phase_report, "link");
+    Process gcc({"gcc", "-O2", "-fwrapv", "-x", "c", "-o", exename, "-"});
+    if (log) {
+      *log << gcc.command() << std::endl;
+    }
+    gcc.run(&text);
+    return;
+  }
+
+  // linked straight from memory, no .o is left next to the source
+  ObjectFile file(object(), changeExtension(filename, ".o"));
+  PhaseReport::Scope phase(phase_report, "link");
+  Process link(
+      output_target->link(file.path(), exename, options.freestanding));
+  link.inherit(file);
+  if (log) {
+    *log << link.command() << std::endl;
+  }
+  link.run();
+}
+
+void Compilation::report(std::ostream &out) const {
+  if (!native) {
+    return;
+  }
+  const StorageLayout::Report &storage = native->storageReport();
+  out << "variables: " << storage.variables << " in " << storage.bytes_before
+      << " bytes (" << storage.lines_before << " cache lines) -> "
+      << storage.slots << " slots in " << storage.bytes_after << " bytes ("
+      << storage.lines_after << " cache lines)" << std::endl;
+
+  const ControlFlowGraph::Stats &loops = native->loopReport();
+  if (loops.loops) {
+    out << "loops: " << loops.loops << ", " << loops.hoisted
+        << " invariant expressions hoisted, " << loops.reduced
+        << " multiplications reduced" << std::endl;
+  }
+  const Inliner::Stats &calls = native->inlineReport();
+  if (calls.functions) {
+    out << "functions: " << calls.functions << ", " << calls.inlined
+        << " calls inlined, " << calls.emitted << " emitted" << std::endl;
+  }
+}
+
+std::string Compilation::message(const std::exception &e) {
+  if (std::string(e.what()) == "bad optional access") {
+    return "Missing Delimiter at the end of File";
+  }
+  return e.what();
+}
+
+std::string changeExtension(const std::string &filename,
+                            const std::string &newExtension) {
+  // Find the last dot in the filename
+  size_t dotPos = filename.rfind('.');
+
+  // If there's no dot or it's the first character, return the filename
+  // unchanged
+  if (dotPos == std::string::npos || dotPos == 0) {
+    return filename;
+  }
+
+  // Return the filename up to the dot, then add the new extension
+  return filename.substr(0, dotPos) + newExtension;
+}
@@ -0,0 +1,163 @@
+#ifndef COMPILATION_HPP
+#define COMPILATION_HPP
+
+#include "../assembler/Module.hpp"
+#include "../common/EmitBuffer.hpp"
+#include "../generator/Generator.hpp"
+#include "../generator/Target.hpp"
+#include "PhaseReport.hpp"
+
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// how a source file is compiled, set from the command line
+struct CompileOptions {
+  // -ffreestanding: static Linux executable with its own _start and raw
+  // syscalls, no C runtime
+  bool freestanding = false;
+  // -S: stop after writing the assembly source, like gcc -S
+  bool assembly_only = false;
+  // -c: stop after writing the object file, like gcc -c
+  bool object_only = false;
+  // --run: code for the JIT, which runs it in memory
+  bool run = false;
+  // --target=win64|linux: platform of the executable, the host by default
+  std::string target = Target::host();
+  // --backend=native|c: machine code from the Generator, or C for gcc -O2
+  std::string backend = "native";
+  // --codegen-jobs=N: threads lowering statements, 0 for one per core
+  unsigned codegen_jobs = 0;
+  // --simd=scalar|sse2|avx2|auto: instructions of whole-array operations
+  Generator::Simd simd = Generator::Simd::AUTO;
+  // -v, -vv: what the phases did, and each analyzed statement
+  int verbosity = 0;
+  // --dump-tokens, --dump-ast, --dump-asm: the tokens and the parse tree
+  // after parse(), the assembly (or C) after generate(), on std::cout
+  bool dump_tokens = false;
+  bool dump_ast = false;
+  bool dump_asm = false;
+  // -ftime-report, -fmem-report and -fperf-report, =json for JSON: the
+  // wall and CPU time, the allocations and peak RSS, and the hardware
+  // counters of each phase
+  PhaseReport::Columns report_columns;
+  PhaseReport::Format report_format = PhaseReport::Format::TEXT;
+  // --cache-dir=<directory>: outputs kept by the hash of the source and
+  // options, --cache-size=<MB> bounds it
+  std::string cache_dir;
+  static constexpr uint64_t DEFAULT_CACHE_SIZE = 512ull << 20;
+  uint64_t cache_size = DEFAULT_CACHE_SIZE;
+
+  // whether the options print what the phases do, which a cached output
+  // would skip
+  bool prints() const {
+    return verbosity || dump_tokens || dump_ast || dump_asm;
+  }
+
+  // takes `arg` when it is one of the options above, throws when its
+  // value is not valid
+  bool set(const std::string &arg);
+
+  // throws when the options do not go together
+  void check() const;
+};
+
+/*
+  One source file through the pipeline, a phase at a time: parse() lexes
+  and parses it, analyze() checks it, generate() lowers it to a module or
+  to C, write() saves the assembly, C or object next to the source for -S
+  and -c and link() builds the executable. The phases throw
+  std::runtime_error, and nothing is shared between compilations, so they
+  can run on any thread.
+*/
+class Compilation {
+public:
+  Compilation(const CompileOptions &options, std::string filename,
+              std::string exename = "");
+
+  // the source bytes, read from the file the first time
+  const std::string &sourceCode();
+
+  // parses sourceCode(), then prints the tokens and the parse tree on
+  // std::cout for --dump-tokens and --dump-ast
+  void parse();
+
+  // `code` as the source of the file
+  void parse(const std::string &code);
+
+  void analyze();
+
+  // lowers the program, then prints the assembly or C on std::cout for
+  // --dump-asm and the report() on the log
+  void generate();
+
+  // the assembly, or the C with --backend=c
+  const EmitBuffer &source();
+
+  // the object file of the native code
+  std::vector<uint8_t> object();
+
+  // the file -S or -c writes, next to the source
+  std::string outputName() const;
+
+  // the file link() writes: the executable name, with .exe for win64
+  std::string executable() const;
+
+  // writes the source or the object for -S or -c, returns the file
+  std::string write();
+
+  void link();
+
+  // what the optimizations of the native backend did, printed by
+  // generate() on the log
+  void report(std::ostream &out) const;
+
+  const std::vector<TOKEN> &tokens() const { return token_list; }
+
+  // the table --dump-tokens prints
+  void printTokens(std::ostream &out) const;
+
+  const std::vector<std::shared_ptr<node::Node>> &nodes() const {
+    return node_list;
+  }
+
+  const Target &target() const { return *output_target; }
+
+  // where the sizes of the object and the link command are printed, by
+  // default std::cout with -v and nowhere without
+  void logTo(std::ostream &out) { log = &out; }
+
+  // the native code, after generate()
+  assembler::Module &module() { return *code; }
+
+  // what each phase cost, for -ftime-report and -fmem-report
+  PhaseReport &phases() { return phase_report; }
+
+  // the message an exception of a phase is reported with
+  static std::string message(const std::exception &e);
+
+private:
+  CompileOptions options;
+  std::string filename;
+  std::string exename;
+  std::optional<std::string> source_code;
+
+  std::ostream *log;
+  std::unique_ptr<Target> output_target;
+  std::vector<TOKEN> token_list;
+  std::vector<std::shared_ptr<node::Node>> node_list;
+
+  std::optional<Generator> native;
+  std::optional<assembler::Module> code;
+  EmitBuffer text; // the C source, or the assembly once printed
+  bool printed = false;
+  PhaseReport phase_report;
+};
+
+// `filename` with its extension replaced, unchanged when it has none
+std::string changeExtension(const std::string &filename,
+                            const std::string &newExtension);
+
+#endif // !COMPILATION_HPP
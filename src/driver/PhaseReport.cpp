@@ -0,0 +1,263 @@
+#include "PhaseReport.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// starts the peak RSS of a phase where the system lets it be reset (Linux
+// 4.0 and later), elsewhere it is the peak of the process so far
+void resetPeak() {
+#ifdef __linux__
+  std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+uint64_t peak() {
+#ifdef __linux__
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmHWM:", 0) == 0) {
+      return std::stoull(line.substr(6)) * 1024;
+    }
+  }
+#endif
+#ifndef _WIN32
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+    return usage.ru_maxrss; // bytes
+#else
+    return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+  }
+#endif
+  return 0;
+}
+
+} // namespace
+
+PhaseReport::Scope::Scope(PhaseReport &report, const char *name)
+    : report(report), name(name) {
+  if (report.memory) {
+    resetPeak();
+    allocated = allocations::current();
+  }
+  if (report.perf) {
+    counted = report.perf->read();
+  }
+  cpu = std::clock();
+  wall = std::chrono::steady_clock::now();
+}
+
+PhaseReport::Scope::~Scope() {
+  Phase phase;
+  phase.name = name;
+  phase.wall_seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - wall)
+                           .count();
+  phase.cpu_seconds = double(std::clock() - cpu) / CLOCKS_PER_SEC;
+  if (report.perf) {
+    PerfCounters::Sample now = report.perf->read();
+    for (int event = 0; event < PerfCounters::COUNT; event++) {
+      phase.counts.valid[event] = counted.valid[event] && now.valid[event];
+      if (phase.counts.valid[event]) {
+        phase.counts.values[event] =
+            now.values[event] - counted.values[event];
+      }
+    }
+  }
+  if (report.memory) {
+    allocations::Count now = allocations::current();
+    phase.allocations = now.calls - allocated.calls;
+    phase.allocated_bytes = now.bytes - allocated.bytes;
+    phase.peak_rss = peak();
+  }
+  report.add(phase);
+}
+
+void PhaseReport::measureMemory() {
+  memory = true;
+  allocations::enable();
+}
+
+void PhaseReport::measureCounters() {
+  if (!perf) {
+    perf = std::make_unique<PerfCounters>();
+  }
+}
+
+namespace {
+
+void addCounts(PerfCounters::Sample &sum, const PerfCounters::Sample &counts,
+               bool first) {
+  for (int event = 0; event < PerfCounters::COUNT; event++) {
+    sum.values[event] += counts.values[event];
+    // a sum is only known when every part of it is
+    sum.valid[event] = (first || sum.valid[event]) && counts.valid[event];
+  }
+}
+
+} // namespace
+
+void PhaseReport::add(const Phase &phase) {
+  auto same = std::find_if(list.begin(), list.end(), [&](const Phase &p) {
+    return p.name == phase.name;
+  });
+  if (same == list.end()) {
+    list.push_back(phase);
+    return;
+  }
+  same->wall_seconds += phase.wall_seconds;
+  same->cpu_seconds += phase.cpu_seconds;
+  same->allocations += phase.allocations;
+  same->allocated_bytes += phase.allocated_bytes;
+  same->peak_rss = std::max(same->peak_rss, phase.peak_rss);
+  addCounts(same->counts, phase.counts, false);
+}
+
+PhaseReport::Phase PhaseReport::total() const {
+  Phase sum;
+  sum.name = "total";
+  for (const auto &phase : list) {
+    addCounts(sum.counts, phase.counts, &phase == &list.front());
+    sum.wall_seconds += phase.wall_seconds;
+    sum.cpu_seconds += phase.cpu_seconds;
+    sum.allocations += phase.allocations;
+    sum.allocated_bytes += phase.allocated_bytes;
+    sum.peak_rss = std::max(sum.peak_rss, phase.peak_rss);
+  }
+  return sum;
+}
+
+namespace {
+
+// instructions per cycle, negative when a count is missing
+double ipc(const PerfCounters::Sample &counts) {
+  if (!counts.valid[PerfCounters::CYCLES] ||
+      !counts.valid[PerfCounters::INSTRUCTIONS] ||
+      !counts.values[PerfCounters::CYCLES]) {
+    return -1;
+  }
+  return double(counts.values[PerfCounters::INSTRUCTIONS]) /
+         counts.values[PerfCounters::CYCLES];
+}
+
+} // namespace
+
+void PhaseReport::print(std::ostream &out, Columns columns,
+                        Format format) const {
+  std::vector<Phase> rows = list;
+  rows.push_back(total());
+  // without any counter only the reason is printed
+  bool counters = columns.counters && perf && perf->error().empty();
+
+  std::ostringstream text;
+  text << std::fixed << std::setprecision(3);
+  if (format == Format::JSON) {
+    auto object = [&](const Phase &phase) {
+      text << "{\"name\": \"" << phase.name << "\"";
+      if (columns.time) {
+        text << ", \"wall_ms\": " << phase.wall_seconds * 1000
+             << ", \"cpu_ms\": " << phase.cpu_seconds * 1000;
+      }
+      if (columns.memory) {
+        text << ", \"allocations\": " << phase.allocations
+             << ", \"allocated_bytes\": " << phase.allocated_bytes
+             << ", \"peak_rss_bytes\": " << phase.peak_rss;
+      }
+      if (counters) {
+        for (int event = 0; event < PerfCounters::COUNT; event++) {
+          text << ", \"" << PerfCounters::name(event) << "\": ";
+          if (phase.counts.valid[event]) {
+            text << phase.counts.values[event];
+          } else {
+            text << "null";
+          }
+        }
+        text << ", \"ipc\": ";
+        if (ipc(phase.counts) >= 0) {
+          text << ipc(phase.counts);
+        } else {
+          text << "null";
+        }
+      }
+      text << "}";
+    };
+    text << "{\"phases\": [";
+    for (size_t i = 0; i + 1 < rows.size(); i++) {
+      text << (i ? ", " : "");
+      object(rows[i]);
+    }
+    text << "], \"total\": ";
+    object(rows.back());
+    if (columns.counters && !counters) {
+      text << ", \"counters_error\": \""
+           << (perf ? perf->error() : "not measured") << "\"";
+    }
+    text << "}\n";
+    out << text.str() << std::flush;
+    return;
+  }
+
+  if (columns.counters && !counters) {
+    text << "hardware counters unavailable: "
+         << (perf ? perf->error() : "not measured") << "\n";
+  }
+  if (columns.time || columns.memory || counters) {
+    text << std::left << std::setw(10) << "phase" << std::right;
+    if (columns.time) {
+      text << std::setw(12) << "wall ms" << std::setw(12) << "cpu ms";
+    }
+    if (columns.memory) {
+      text << std::setw(13) << "allocations" << std::setw(14)
+           << "allocated kB" << std::setw(14) << "peak RSS kB";
+    }
+    if (counters) {
+      for (int event = 0; event < PerfCounters::COUNT; event++) {
+        text << std::setw(15) << PerfCounters::name(event);
+      }
+      text << std::setw(7) << "IPC";
+    }
+    text << "\n";
+  }
+  for (const auto &phase : rows) {
+    if (!columns.time && !columns.memory && !counters) {
+      break;
+    }
+    text << std::left << std::setw(10) << phase.name << std::right;
+    if (columns.time) {
+      text << std::setw(12) << phase.wall_seconds * 1000 << std::setw(12)
+           << phase.cpu_seconds * 1000;
+    }
+    if (columns.memory) {
+      text << std::setw(13) << phase.allocations << std::setw(14)
+           << phase.allocated_bytes / 1024 << std::setw(14)
+           << phase.peak_rss / 1024;
+    }
+    if (counters) {
+      for (int event = 0; event < PerfCounters::COUNT; event++) {
+        if (phase.counts.valid[event]) {
+          text << std::setw(15) << phase.counts.values[event];
+        } else {
+          text << std::setw(15) << "-";
+        }
+      }
+      if (ipc(phase.counts) >= 0) {
+        text << std::setw(7) << std::setprecision(2) << ipc(phase.counts)
+             << std::setprecision(3);
+      } else {
+        text << std::setw(7) << "-";
+      }
+    }
+    text << "\n";
+  }
+  out << text.str() << std::flush;
+}
@@ -0,0 +1,86 @@
+#ifndef PHASE_REPORT_HPP
+#define PHASE_REPORT_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../common/Allocations.hpp"
+#include "../common/PerfCounters.hpp"
+
+/*
+  What each phase of a compilation cost: wall clock and CPU time, with
+  measureMemory() the allocations made and the peak resident set size,
+  and with measureCounters() the hardware counters. A phase is measured
+  by a Scope living as long as it runs; a phase run again adds to its
+  first entry. -ftime-report, -fmem-report and -fperf-report print it.
+*/
+class PhaseReport {
+public:
+  struct Phase {
+    std::string name;
+    double wall_seconds = 0;
+    double cpu_seconds = 0; // of every thread of the process
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+    uint64_t peak_rss = 0; // bytes
+    PerfCounters::Sample counts; // of the counters that were running
+  };
+
+  class Scope {
+  public:
+    Scope(PhaseReport &report, const char *name);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    PhaseReport &report;
+    const char *name;
+    std::chrono::steady_clock::time_point wall;
+    std::clock_t cpu;
+    allocations::Count allocated;
+    PerfCounters::Sample counted;
+  };
+
+  // also counts the allocations and the peak RSS of the phases
+  void measureMemory();
+
+  // also reads the hardware counters around the phases
+  void measureCounters();
+
+  // null until measureCounters()
+  const PerfCounters *counters() const { return perf.get(); }
+
+  const std::vector<Phase> &phases() const { return list; }
+
+  // the phases added up, the largest peak RSS
+  Phase total() const;
+
+  enum class Format { TEXT, JSON };
+
+  // which of -ftime-report, -fmem-report and -fperf-report to print
+  struct Columns {
+    bool time = false;
+    bool memory = false;
+    bool counters = false;
+
+    bool any() const { return time || memory || counters; }
+  };
+
+  void print(std::ostream &out, Columns columns, Format format) const;
+
+private:
+  std::vector<Phase> list;
+  bool memory = false;
+  std::unique_ptr<PerfCounters> perf;
+
+  void add(const Phase &phase);
+};
+
+#endif // !PHASE_REPORT_HPP
@@ -0,0 +1,104 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// the pool the calling thread works for and its deque there
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local size_t current_queue = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned threads) {
+  if (!threads) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (unsigned i = 0; i < threads; i++) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  for (unsigned i = 0; i < threads; i++) {
+    workers.emplace_back(&ThreadPool::work, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  wait();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  size_t index = current_pool == this
+                     ? current_queue
+                     : next.fetch_add(1) % queues.size();
+  {
+    // counted before it is published: a worker may take and finish it at
+    // once, and neither counter may drop below the tasks still pending
+    std::lock_guard<std::mutex> lock(mutex);
+    unfinished++;
+    queued++;
+  }
+  {
+    std::lock_guard<std::mutex> lock(queues[index]->mutex);
+    queues[index]->tasks.push_back(std::move(task));
+  }
+  wake.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [&] { return unfinished == 0; });
+}
+
+bool ThreadPool::take(size_t self, std::function<void()> &task) {
+  {
+    Queue &own = *queues[self];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      queued--;
+      return true;
+    }
+  }
+  for (size_t i = 1; i < queues.size(); i++) {
+    Queue &other = *queues[(self + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(other.mutex);
+    if (!other.tasks.empty()) {
+      task = std::move(other.tasks.front());
+      other.tasks.pop_front();
+      queued--;
+      stolen++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::work(size_t self) {
+  current_pool = this;
+  current_queue = self;
+  while (true) {
+    std::function<void()> task;
+    if (take(self, task)) {
+      task();
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--unfinished == 0) {
+        done.notify_all();
+      }
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [&] { return stopping || queued > 0; });
+    if (stopping && queued == 0) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+  A fixed set of threads with a deque of tasks each. A task submitted by a
+  worker goes on the back of its own deque and the worker takes its next
+  task from there too, so the follow-up of a task runs next on the same
+  thread while its data is still in the cache. Tasks from outside the pool
+  are dealt round-robin. A worker whose deque is empty steals the oldest
+  task from the front of another's. Tasks must not throw.
+*/
+class ThreadPool {
+public:
+  // 0 threads picks one per hardware thread
+  explicit ThreadPool(unsigned threads = 0);
+
+  // waits for the submitted tasks
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void submit(std::function<void()> task);
+
+  // blocks until every submitted task, and the tasks they submitted, ran
+  void wait();
+
+  unsigned size() const { return workers.size(); }
+
+  // tasks a worker took from the deque of another
+  size_t steals() const { return stolen; }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable wake; // a task was queued, or the pool stops
+  std::condition_variable done; // the last unfinished task finished
+  std::atomic<size_t> queued{0};
+  size_t unfinished = 0;
+  bool stopping = false;
+
+  std::atomic<size_t> next{0}; // deque of the next task from outside
+  std::atomic<size_t> stolen{0};
+
+  void work(size_t self);
+
+  bool take(size_t self, std::function<void()> &task);
+};
+
+#endif // !THREAD_POOL_HPP
@@ -0,0 +1,563 @@
+#include "ControlFlowGraph.hpp"
+
+#include <stdexcept>
+
+namespace {
+
+std::string operandText(const std::shared_ptr<node::Node> &node) {
+  if (auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(node)) {
+    return identifierNode->identifier.lexeme;
+  }
+  return std::dynamic_pointer_cast<ConstantNode>(node)->constant.lexeme;
+}
+
+std::shared_ptr<ConstantNode> constant(uint64_t value) {
+  TOKEN token{TokenType::CONSTANT, std::to_string(value), 0};
+  return std::make_shared<ConstantNode>(token, 0);
+}
+
+} // namespace
+
+ControlFlowGraph::ControlFlowGraph(
+    const std::vector<std::shared_ptr<node::Node>> &nodes) {
+  size_t current = newBlock(NONE, false);
+  for (auto node : nodes) {
+    current = build(node, current, NONE, false);
+  }
+}
+
+size_t ControlFlowGraph::newBlock(size_t loop, bool conditional) {
+  graph.emplace_back();
+  graph.back().loop = loop;
+  graph.back().conditional = conditional;
+  return graph.size() - 1;
+}
+
+size_t ControlFlowGraph::build(std::shared_ptr<node::Node> node,
+                               size_t current, size_t loop, bool conditional) {
+  if (auto sequenceNode = std::dynamic_pointer_cast<SequenceNode>(node)) {
+    for (auto statement : sequenceNode->statements) {
+      current = build(statement, current, loop, conditional);
+    }
+    return current;
+  }
+
+  if (auto ifNode = std::dynamic_pointer_cast<IfNode>(node)) {
+    size_t then = newBlock(loop, true);
+    graph[current].condition = ifNode->condition;
+    graph[current].taken = then;
+    graph[current].likely_taken = true;
+    size_t thenEnd = build(ifNode->then, then, loop, true);
+
+    size_t otherwiseEnd = current;
+    if (ifNode->otherwise) {
+      size_t otherwise = newBlock(loop, true);
+      graph[current].next = otherwise;
+      otherwiseEnd = build(ifNode->otherwise, otherwise, loop, true);
+    }
+    size_t join = newBlock(loop, conditional);
+    graph[thenEnd].next = join;
+    graph[otherwiseEnd].next = join;
+    return join;
+  }
+
+  if (auto whileNode = std::dynamic_pointer_cast<WhileNode>(node)) {
+    size_t id = loop_list.size();
+    loop_list.push_back({loop, current, 0, 0});
+    size_t body = newBlock(id, true);
+    size_t bodyEnd = build(whileNode->body, body, id, true);
+    size_t test = newBlock(id, true);
+    graph[bodyEnd].next = test;
+    size_t exit = newBlock(loop, conditional);
+    loop_list[id].first = body;
+    loop_list[id].last = test;
+
+    // the guard before the loop and the test at its bottom
+    for (size_t block : {current, test}) {
+      graph[block].condition = whileNode->condition;
+      graph[block].taken = body;
+      graph[block].next = exit;
+      graph[block].likely_taken = true;
+    }
+    return exit;
+  }
+
+  if (auto arrayNode = std::dynamic_pointer_cast<ArrayDeclarationNode>(node)) {
+    const std::string &name = arrayNode->identifier->identifier.lexeme;
+    widths[name] = 4;
+    array_index[name] = array_list.size();
+    array_list.push_back({name, arrayNode->size()});
+  } else if (auto declNode = std::dynamic_pointer_cast<DeclarationNode>(node)) {
+    if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+            declNode->product)) {
+      auto assignmentNode =
+          std::get<std::shared_ptr<AssignmentNode>>(declNode->product);
+      widths[assignmentNode->identifier->identifier.lexeme] =
+          declNode->width();
+    } else {
+      for (auto &id : std::get<std::vector<std::shared_ptr<IdentifierNode>>>(
+               declNode->product)) {
+        widths[id->identifier.lexeme] = declNode->width();
+      }
+    }
+  }
+  graph[current].statements.push_back(node);
+  if (std::dynamic_pointer_cast<ReturnNode>(node)) {
+    // nothing leads to what follows a return
+    return newBlock(loop, true);
+  }
+  return current;
+}
+
+const ControlFlowGraph::Array *
+ControlFlowGraph::array(const std::string &name) const {
+  auto it = array_index.find(name);
+  return it == array_index.end() ? nullptr : &array_list[it->second];
+}
+
+size_t ControlFlowGraph::resolve(size_t block) const {
+  while (block != NONE && graph[block].statements.empty() &&
+         !graph[block].condition && graph[block].next != NONE) {
+    block = graph[block].next;
+  }
+  return block;
+}
+
+uint8_t ControlFlowGraph::valueWidth(std::shared_ptr<node::Node> node) const {
+  if (auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(node)) {
+    return widths.at(identifierNode->identifier.lexeme) == 8 ? 8 : 4;
+  } else if (auto constantNode =
+                 std::dynamic_pointer_cast<ConstantNode>(node)) {
+    try {
+      return std::stoll(constantNode->constant.lexeme) > INT32_MAX ? 8 : 4;
+    } catch (std::out_of_range &) {
+      return 8; // reported by the code generator
+    }
+  } else if (auto expressionNode =
+                 std::dynamic_pointer_cast<ExpressionNode>(node)) {
+    return std::max(valueWidth(expressionNode->left),
+                    valueWidth(expressionNode->right));
+  }
+  return 4;
+}
+
+std::shared_ptr<IdentifierNode>
+ControlFlowGraph::temporary(const std::string &prefix, uint8_t width) {
+  // the dot keeps the name apart from any variable of the program
+  TOKEN token{TokenType::IDENTIFIER,
+              prefix + "." + std::to_string(temporaries.size()), 0};
+  auto identifier = std::make_shared<IdentifierNode>(token, 0);
+  widths[token.lexeme] = width;
+  temporaries.push_back(std::make_shared<DeclarationNode>(
+      width == 8 ? TokenType::LONG_KEYWORD : TokenType::INT_KEYWORD,
+      std::vector<std::shared_ptr<IdentifierNode>>{identifier}));
+  return identifier;
+}
+
+void ControlFlowGraph::definitions(
+    const std::shared_ptr<node::Node> &statement,
+    std::unordered_set<std::string> &defined) const {
+  if (auto assignNode = std::dynamic_pointer_cast<AssignmentNode>(statement)) {
+    defined.insert(assignNode->identifier->identifier.lexeme);
+  } else if (auto elementNode =
+                 std::dynamic_pointer_cast<ElementAssignmentNode>(statement)) {
+    defined.insert(elementNode->element->identifier->identifier.lexeme);
+  } else if (auto declNode =
+                 std::dynamic_pointer_cast<DeclarationNode>(statement)) {
+    if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+            declNode->product)) {
+      definitions(std::get<std::shared_ptr<AssignmentNode>>(declNode->product),
+                  defined);
+    }
+  } else if (auto cinNode = std::dynamic_pointer_cast<CinNode>(statement)) {
+    for (auto &operand : cinNode->operands) {
+      if (auto indexNode = std::dynamic_pointer_cast<IndexNode>(operand)) {
+        defined.insert(indexNode->identifier->identifier.lexeme);
+      } else {
+        defined.insert(std::dynamic_pointer_cast<IdentifierNode>(operand)
+                           ->identifier.lexeme);
+      }
+    }
+  }
+}
+
+template <typename Replace>
+std::shared_ptr<node::Node>
+ControlFlowGraph::rewrite(std::shared_ptr<node::Node> node, Replace replace) {
+  // the arguments of a call are operands of their own
+  auto replaceValue = [&](std::shared_ptr<node::Node> value) {
+    if (std::dynamic_pointer_cast<CallNode>(value)) {
+      return rewrite(value, replace);
+    }
+    return replace(value);
+  };
+
+  if (auto callNode = std::dynamic_pointer_cast<CallNode>(node)) {
+    std::vector<std::shared_ptr<node::Node>> arguments;
+    bool changed = false;
+    for (auto &argument : callNode->arguments) {
+      arguments.push_back(replaceValue(argument));
+      changed |= arguments.back() != argument;
+    }
+    if (changed) {
+      return std::make_shared<CallNode>(callNode->identifier, arguments);
+    }
+  } else if (auto returnNode = std::dynamic_pointer_cast<ReturnNode>(node)) {
+    if (returnNode->value) {
+      auto value = replaceValue(returnNode->value);
+      if (value != returnNode->value) {
+        return std::make_shared<ReturnNode>(value, returnNode->line);
+      }
+    }
+  } else if (auto assignNode =
+                 std::dynamic_pointer_cast<AssignmentNode>(node)) {
+    auto value = replaceValue(assignNode->assignment);
+    if (value != assignNode->assignment) {
+      return std::make_shared<AssignmentNode>(assignNode->identifier, value);
+    }
+  } else if (auto elementNode =
+                 std::dynamic_pointer_cast<ElementAssignmentNode>(node)) {
+    auto value = replaceValue(elementNode->assignment);
+    if (value != elementNode->assignment) {
+      return std::make_shared<ElementAssignmentNode>(elementNode->element,
+                                                     value);
+    }
+  } else if (auto declNode = std::dynamic_pointer_cast<DeclarationNode>(node)) {
+    if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+            declNode->product)) {
+      auto assignment =
+          std::get<std::shared_ptr<AssignmentNode>>(declNode->product);
+      auto rewritten = rewrite(assignment, replace);
+      if (rewritten != assignment) {
+        return std::make_shared<DeclarationNode>(
+            declNode->type,
+            std::dynamic_pointer_cast<AssignmentNode>(rewritten));
+      }
+    }
+  } else if (auto coutNode = std::dynamic_pointer_cast<CoutNode>(node)) {
+    std::vector<std::shared_ptr<node::Node>> operands;
+    bool changed = false;
+    for (auto &operand : coutNode->operands) {
+      operands.push_back(
+          std::dynamic_pointer_cast<StringLiteralNode>(operand)
+              ? operand
+              : replaceValue(operand));
+      changed |= operands.back() != operand;
+    }
+    if (changed) {
+      return std::make_shared<CoutNode>(operands);
+    }
+  } else if (auto conditionNode =
+                 std::dynamic_pointer_cast<ConditionNode>(node)) {
+    auto left = replaceValue(conditionNode->left);
+    auto right = replaceValue(conditionNode->right);
+    if (left != conditionNode->left || right != conditionNode->right) {
+      return std::make_shared<ConditionNode>(left, conditionNode->OP, right,
+                                             conditionNode->line);
+    }
+  }
+  return node;
+}
+
+void ControlFlowGraph::optimize() {
+  for (size_t loop = loop_list.size(); loop-- > 0;) {
+    hoistInvariants(loop);
+    reduceStrength(loop);
+  }
+  summary.loops = loop_list.size();
+
+  // the entry block is never part of a loop
+  auto &entry = graph[0].statements;
+  entry.insert(entry.begin(), temporaries.begin(), temporaries.end());
+  temporaries.clear();
+}
+
+void ControlFlowGraph::hoistInvariants(size_t id) {
+  /*
+    An expression whose operands no statement of the loop assigns has the
+    same value on every iteration. It is computed into a temporary before
+    the loop, where the guard runs it once even when the loop body does not
+    run at all; the expressions cannot fault, so that is harmless.
+  */
+  const Loop loop = loop_list[id];
+  std::unordered_set<std::string> defined;
+  for (size_t block = loop.first; block <= loop.last; block++) {
+    for (auto &statement : graph[block].statements) {
+      definitions(statement, defined);
+    }
+  }
+
+  // array elements are not hoisted: the loop may guard their index
+  auto invariant = [&](const std::shared_ptr<node::Node> &operand) {
+    if (std::dynamic_pointer_cast<ConstantNode>(operand)) {
+      return true;
+    }
+    auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(operand);
+    return identifierNode && !array(identifierNode->identifier.lexeme) &&
+           !defined.count(identifierNode->identifier.lexeme);
+  };
+
+  std::unordered_map<std::string, std::shared_ptr<IdentifierNode>> hoisted;
+  auto replace =
+      [&](std::shared_ptr<node::Node> operand) -> std::shared_ptr<node::Node> {
+    auto expressionNode = std::dynamic_pointer_cast<ExpressionNode>(operand);
+    if (!expressionNode || !invariant(expressionNode->left) ||
+        !invariant(expressionNode->right)) {
+      return operand;
+    }
+    // two constants cost no more than loading the temporary
+    if (std::dynamic_pointer_cast<ConstantNode>(expressionNode->left) &&
+        std::dynamic_pointer_cast<ConstantNode>(expressionNode->right)) {
+      return operand;
+    }
+    std::string key = operandText(expressionNode->left) + expressionNode->OP +
+                      operandText(expressionNode->right);
+    auto it = hoisted.find(key);
+    if (it == hoisted.end()) {
+      auto temp = temporary("licm", valueWidth(expressionNode));
+      graph[loop.preheader].statements.push_back(
+          std::make_shared<AssignmentNode>(temp, expressionNode));
+      it = hoisted.emplace(key, temp).first;
+      summary.hoisted++;
+    }
+    return it->second;
+  };
+
+  for (size_t block = loop.first; block <= loop.last; block++) {
+    for (auto &statement : graph[block].statements) {
+      statement = rewrite(statement, replace);
+    }
+  }
+  for (size_t block : {loop.preheader, loop.last}) {
+    graph[block].condition = std::dynamic_pointer_cast<ConditionNode>(
+        rewrite(graph[block].condition, replace));
+  }
+}
+
+void ControlFlowGraph::reduceStrength(size_t id) {
+  /*
+    A basic induction variable is only assigned in the loop by steps
+    `i = i + c` or `i = i - c` with a constant c. Products `i * k` with a
+    constant k then follow i in a temporary that starts out as i * k before
+    the loop and is advanced by c * k right after each step, so the loop
+    multiplies nothing. Only int and long variables qualify: the products
+    must wrap around at the same width as the variable.
+  */
+  const Loop loop = loop_list[id];
+
+  // steps of every candidate, the ones assigned otherwise are dropped
+  std::unordered_map<std::string, std::vector<int64_t>> steps;
+  std::unordered_set<std::string> excluded;
+  auto step = [&](const std::shared_ptr<node::Node> &statement, int64_t &by)
+      -> std::string {
+    auto assignNode = std::dynamic_pointer_cast<AssignmentNode>(statement);
+    if (!assignNode) {
+      return "";
+    }
+    const std::string &name = assignNode->identifier->identifier.lexeme;
+    auto expressionNode =
+        std::dynamic_pointer_cast<ExpressionNode>(assignNode->assignment);
+    if (!expressionNode || expressionNode->OP == '*' ||
+        widths.at(name) < 4 || array(name)) {
+      return "";
+    }
+    auto self = std::dynamic_pointer_cast<IdentifierNode>(expressionNode->left);
+    auto amount =
+        std::dynamic_pointer_cast<ConstantNode>(expressionNode->right);
+    if (expressionNode->OP == '+' && !self) {
+      self = std::dynamic_pointer_cast<IdentifierNode>(expressionNode->right);
+      amount = std::dynamic_pointer_cast<ConstantNode>(expressionNode->left);
+    }
+    if (!self || !amount || self->identifier.lexeme != name ||
+        valueWidth(amount) > widths.at(name)) {
+      return "";
+    }
+    by = std::stoll(amount->constant.lexeme);
+    if (expressionNode->OP == '-') {
+      by = -by;
+    }
+    return name;
+  };
+
+  for (size_t block = loop.first; block <= loop.last; block++) {
+    for (auto &statement : graph[block].statements) {
+      int64_t by = 0;
+      std::string name = step(statement, by);
+      if (!name.empty()) {
+        steps[name].push_back(by);
+        continue;
+      }
+      std::unordered_set<std::string> defined;
+      definitions(statement, defined);
+      excluded.insert(defined.begin(), defined.end());
+    }
+  }
+  for (const auto &name : excluded) {
+    steps.erase(name);
+  }
+  if (steps.empty()) {
+    return;
+  }
+
+  struct Reduced {
+    std::shared_ptr<IdentifierNode> temp;
+    int64_t factor;
+  };
+  std::unordered_map<std::string, std::vector<Reduced>> reduced;
+  std::unordered_map<std::string, std::shared_ptr<IdentifierNode>> temps;
+  auto replace =
+      [&](std::shared_ptr<node::Node> operand) -> std::shared_ptr<node::Node> {
+    auto expressionNode = std::dynamic_pointer_cast<ExpressionNode>(operand);
+    if (!expressionNode || expressionNode->OP != '*') {
+      return operand;
+    }
+    auto variable =
+        std::dynamic_pointer_cast<IdentifierNode>(expressionNode->left);
+    auto factor =
+        std::dynamic_pointer_cast<ConstantNode>(expressionNode->right);
+    if (!variable || !factor) {
+      variable =
+          std::dynamic_pointer_cast<IdentifierNode>(expressionNode->right);
+      factor = std::dynamic_pointer_cast<ConstantNode>(expressionNode->left);
+    }
+    if (!variable || !factor || !steps.count(variable->identifier.lexeme)) {
+      return operand;
+    }
+    const std::string &name = variable->identifier.lexeme;
+    uint8_t width = widths.at(name);
+    if (valueWidth(factor) > width) {
+      return operand;
+    }
+
+    std::string key = name + "*" + factor->constant.lexeme;
+    auto it = temps.find(key);
+    if (it == temps.end()) {
+      auto temp = temporary("iv", width);
+      graph[loop.preheader].statements.push_back(
+          std::make_shared<AssignmentNode>(
+              temp, std::make_shared<ExpressionNode>('*', variable, factor)));
+      reduced[name].push_back({temp, std::stoll(factor->constant.lexeme)});
+      it = temps.emplace(key, temp).first;
+      summary.reduced++;
+    }
+    return it->second;
+  };
+
+  for (size_t block = loop.first; block <= loop.last; block++) {
+    for (auto &statement : graph[block].statements) {
+      statement = rewrite(statement, replace);
+    }
+  }
+  for (size_t block : {loop.preheader, loop.last}) {
+    graph[block].condition = std::dynamic_pointer_cast<ConditionNode>(
+        rewrite(graph[block].condition, replace));
+  }
+
+  // advance the temporaries right after every step of their variable
+  for (size_t block = loop.first; block <= loop.last; block++) {
+    auto &statements = graph[block].statements;
+    for (size_t i = 0; i < statements.size(); i++) {
+      int64_t by = 0;
+      std::string name = step(statements[i], by);
+      auto it = reduced.find(name);
+      if (name.empty() || it == reduced.end()) {
+        continue;
+      }
+      for (const auto &[temp, factor] : it->second) {
+        // the product wraps around like the variable it follows
+        uint64_t delta =
+            static_cast<uint64_t>(by) * static_cast<uint64_t>(factor);
+        if (widths.at(name) == 4) {
+          delta = static_cast<uint64_t>(
+              static_cast<int64_t>(static_cast<int32_t>(delta)));
+        }
+        bool negative = static_cast<int64_t>(delta) < 0;
+        auto update = std::make_shared<AssignmentNode>(
+            temp, std::make_shared<ExpressionNode>(
+                      negative ? '-' : '+', temp,
+                      constant(negative ? 0 - delta : delta)));
+        statements.insert(statements.begin() + ++i, update);
+      }
+    }
+  }
+}
+
+void ControlFlowGraph::layout() {
+  for (auto &block : graph) {
+    block.label = false;
+  }
+
+  // depth first, the unlikely successor first so the likely one ends up
+  // right after the branch in reverse postorder
+  auto successors = [&](size_t block) {
+    std::vector<size_t> list;
+    const Block &b = graph[block];
+    if (b.condition) {
+      size_t likely = resolve(b.likely_taken ? b.taken : b.next);
+      size_t unlikely = resolve(b.likely_taken ? b.next : b.taken);
+      list = {unlikely, likely};
+    } else if (b.next != NONE) {
+      list = {resolve(b.next)};
+    }
+    return list;
+  };
+
+  std::vector<bool> visited(graph.size(), false);
+  std::vector<size_t> postorder;
+  std::vector<std::pair<size_t, std::vector<size_t>>> stack;
+  size_t entry = resolve(0);
+  visited[entry] = true;
+  stack.push_back({entry, successors(entry)});
+  while (!stack.empty()) {
+    auto &[block, pending] = stack.back();
+    if (pending.empty()) {
+      postorder.push_back(block);
+      stack.pop_back();
+      continue;
+    }
+    size_t next = pending.front();
+    pending.erase(pending.begin());
+    if (!visited[next]) {
+      visited[next] = true;
+      stack.push_back({next, successors(next)});
+    }
+  }
+  placed.assign(postorder.rbegin(), postorder.rend());
+
+  for (size_t position = 0; position < placed.size(); position++) {
+    Terminator end = terminator(position);
+    for (size_t target : {end.branch, end.jump}) {
+      if (target != NONE) {
+        graph[target].label = true;
+      }
+    }
+  }
+}
+
+ControlFlowGraph::Terminator
+ControlFlowGraph::terminator(size_t position) const {
+  const Block &block = graph[placed[position]];
+  size_t follow =
+      position + 1 < placed.size() ? placed[position + 1] : NONE;
+  Terminator end;
+
+  size_t next = resolve(block.next);
+  size_t taken = block.condition ? resolve(block.taken) : next;
+  if (taken == next) {
+    // no branch, or both ways lead to the same block
+    end.jump = next == follow ? NONE : next;
+    return end;
+  }
+
+  end.condition = block.condition;
+  if (next == follow) {
+    end.branch = taken;
+  } else if (taken == follow) {
+    end.branch = next;
+    end.negate = true;
+  } else {
+    end.branch = taken;
+    end.jump = next;
+  }
+  return end;
+}
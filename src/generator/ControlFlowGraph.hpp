@@ -0,0 +1,142 @@
+#ifndef CONTROL_FLOW_GRAPH_HPP
+#define CONTROL_FLOW_GRAPH_HPP
+
+#include "../parser/Node.hpp"
+#include "../parser/Parser.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/*
+  The program as basic blocks of straight-line statements, each ending in a
+  branch on a condition or a jump. A while loop is rotated: its condition is
+  tested once before the loop, at the end of the block it follows (which is
+  also where code hoisted out of the loop goes), and again at the bottom,
+  so the body falls through into the test and the back edge is the taken
+  branch of the test:
+
+      before:  ...hoisted code, if (!condition) goto exit
+      body:    ...
+      test:    if (condition) goto body
+      exit:
+*/
+class ControlFlowGraph {
+public:
+  static constexpr size_t NONE = SIZE_MAX;
+
+  struct Block {
+    std::vector<std::shared_ptr<node::Node>> statements;
+    // with a condition the block branches to `taken` when it holds and
+    // continues at `next` otherwise, without one it continues at `next`
+    std::shared_ptr<ConditionNode> condition;
+    size_t taken = NONE;
+    size_t next = NONE; // NONE after the last block of the program
+    bool likely_taken = false;
+    size_t loop = NONE;       // innermost loop the block is part of
+    bool conditional = false; // may not run exactly once
+    bool label = false;       // jumped to, set by layout()
+  };
+
+  struct Loop {
+    size_t parent = NONE;
+    size_t preheader; // runs once before the loop
+    size_t first;     // blocks of the loop are first..last, the body starts
+    size_t last;      // at first and last is the test
+  };
+
+  // how a block ends in the layout
+  struct Terminator {
+    std::shared_ptr<ConditionNode> condition; // null for no branch
+    bool negate = false; // branch when the condition does not hold
+    size_t branch = NONE;
+    size_t jump = NONE; // unconditional jump after the branch, if any
+  };
+
+  struct Array {
+    std::string name;
+    uint64_t length;
+  };
+
+  struct Stats {
+    size_t loops = 0;
+    size_t hoisted = 0; // invariant expressions computed before their loop
+    size_t reduced = 0; // multiplications turned into additions
+  };
+
+  ControlFlowGraph(const std::vector<std::shared_ptr<node::Node>> &nodes);
+
+  // loop-invariant code motion and strength reduction, innermost loops first
+  void optimize();
+
+  /*
+    Orders the blocks in reverse postorder, visiting the likely successor of
+    a branch last so it directly follows the branch. Empty blocks are
+    skipped over.
+  */
+  void layout();
+
+  const std::vector<Block> &blocks() const { return graph; }
+
+  const std::vector<Loop> &loops() const { return loop_list; }
+
+  // blocks in the order they are emitted
+  const std::vector<size_t> &order() const { return placed; }
+
+  Terminator terminator(size_t position) const;
+
+  const Stats &stats() const { return summary; }
+
+  // arrays in declaration order
+  const std::vector<Array> &arrays() const { return array_list; }
+
+  // the array called `name`, or null for a variable
+  const Array *array(const std::string &name) const;
+
+private:
+  std::vector<Block> graph;
+  std::vector<Loop> loop_list;
+  std::vector<size_t> placed;
+  Stats summary;
+
+  // declared width of every variable
+  std::unordered_map<std::string, uint8_t> widths;
+
+  std::vector<Array> array_list;
+  std::unordered_map<std::string, size_t> array_index;
+
+  // temporaries introduced by the optimizations, declared at the start
+  std::vector<std::shared_ptr<node::Node>> temporaries;
+
+  size_t newBlock(size_t loop, bool conditional);
+
+  size_t build(std::shared_ptr<node::Node> node, size_t current, size_t loop,
+               bool conditional);
+
+  // first non-empty block reached from `block`
+  size_t resolve(size_t block) const;
+
+  uint8_t valueWidth(std::shared_ptr<node::Node> node) const;
+
+  std::shared_ptr<IdentifierNode> temporary(const std::string &prefix,
+                                            uint8_t width);
+
+  // variables a statement may change, which a call cannot do to the
+  // variables of its caller
+  void definitions(const std::shared_ptr<node::Node> &statement,
+                   std::unordered_set<std::string> &defined) const;
+
+  // applies `replace` to every operand a statement or condition reads,
+  // returning the statement rebuilt if any operand changed
+  template <typename Replace>
+  std::shared_ptr<node::Node> rewrite(std::shared_ptr<node::Node> node,
+                                      Replace replace);
+
+  void hoistInvariants(size_t loop);
+
+  void reduceStrength(size_t loop);
+};
+
+#endif // !CONTROL_FLOW_GRAPH_HPP
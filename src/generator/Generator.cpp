@@ -1,54 +1,380 @@
 #include "Generator.hpp"
 #include "../parser/Node.hpp"
 
-Generator::Generator(std::vector<std::shared_ptr<node::Node>> nodes)
-    : NODES(std::move(nodes)) {}
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
 
-std::string Generator::generate() {
+using namespace assembler;
+using namespace assembler::regs;
 
-  std::ostringstream headerCode;
-  std::ostringstream dynamicCode;
+Generator::Generator(std::vector<std::shared_ptr<node::Node>> nodes,
+                     const Target &target, bool freestanding, unsigned jobs,
+                     Simd simd)
+    : NODES(std::move(nodes)), target(target), freestanding(freestanding),
+      simd(simd), jobs(jobs) {
+  if (freestanding && !target.supportsFreestanding()) {
+    throw std::runtime_error("-ffreestanding is not supported for the " +
+                             target.name() + " target");
+  }
+}
 
-  headerCode << "default rel\n";
+Generator::Generator(const Generator &parent)
+    : target(parent.target), freestanding(parent.freestanding),
+      simd(parent.simd), graph(parent.graph), frame(parent.frame), jobs(1),
+      storage(&parent) {}
 
-  headerCode << "extern ExitProcess\n";
-  headerCode << "extern printf\n";
-  headerCode << "extern scanf\n";
+Module Generator::generate() {
 
-  // declared variables un initialized
-  bss_segment << "section .bss \n";
+  // declared variables initialized go to .data, uninitialized ones to .bss,
+  // printf formats and string literals to .rodata
+  if (!freestanding) {
+    module.defineConstant(module.symbol("fmt_int"), {'%', 'd', 10, 0});
+    module.defineConstant(module.symbol("fmt_long"),
+                          {'%', 'l', 'l', 'd', 10, 0});
+    module.defineConstant(module.symbol("fmt_literal"), {'%', 's', 10, 0});
+    module.defineConstant(module.symbol("fmt_char"), {'%', 'c', 10, 0});
+  }
 
-  // declared variables initialized
-  data_segment << "section .data \n";
-  data_segment << "    input_int db \"%d\", 0\n";
-  data_segment << "    fmt_int db \"%d\", 10, 0\n";
-  data_segment << "    fmt_literal db \"%s\", 10, 0\n";
-  data_segment << "    fmt_char db \"%c\", 10, 0\n";
+  // calls of small functions are replaced by their bodies first
+  Inliner inliner(NODES);
+  inline_stats = inliner.stats();
+  cfg.emplace(inliner.program());
+  cfg->optimize();
+  cfg->layout();
+  loop_stats = cfg->stats();
+  layout.emplace(*cfg);
+  for (const auto &slot : layout->slots()) {
+    uint32_t id = module.symbol(slot.name);
+    if (slot.section == SectionKind::BSS) {
+      module.reserve(id, slot.width, 1, slot.align);
+      continue;
+    }
+    uint64_t value =
+        slot.initializer ? constantValue(*slot.initializer) : 0;
+    std::vector<uint8_t> bytes;
+    for (int i = 0; i < slot.width; i++) {
+      bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+    module.defineData(id, slot.width, std::move(bytes), slot.align);
+  }
+  // zeroed and aligned for the widest vector loads and stores
+  for (const auto &array : cfg->arrays()) {
+    module.reserve(module.symbol(array.name), 4, array.length, 32);
+  }
 
-  // text segment
-  text_segment << "segment .text \n";
-  text_segment << "    " << "global main\n";
-  text_segment << "    " << "main:\n";
-  text_segment << "\t\t" << "push rbp\n";
-  text_segment << "\t\t" << "mov rbp, rsp\n";
+  /*
+    A function that is still called gets a graph of its own, which starts
+    with the declarations of its parameters and ends in a return, so every
+    path out of it returns.
+  */
+  functions.reserve(inliner.functions().size());
+  for (const auto &function : inliner.functions()) {
+    callees[function->identifier->identifier.lexeme] = function;
+    std::vector<std::shared_ptr<node::Node>> body(
+        function->parameters.begin(), function->parameters.end());
+    body.insert(body.end(), function->body->statements.begin(),
+                function->body->statements.end());
+    std::shared_ptr<node::Node> result;
+    if (function->width()) {
+      TOKEN zero{TokenType::CONSTANT, "0", 0};
+      result = std::make_shared<ConstantNode>(zero, 0);
+    }
+    body.push_back(std::make_shared<ReturnNode>(result, 0));
+
+    functions.push_back({function, ControlFlowGraph(body), Frame()});
+    Function &emitted = functions.back();
+    emitted.cfg.optimize();
+    emitted.cfg.layout();
+    emitted.frame = buildFrame(*function, emitted.cfg);
+    loop_stats.loops += emitted.cfg.stats().loops;
+    loop_stats.hoisted += emitted.cfg.stats().hoisted;
+    loop_stats.reduced += emitted.cfg.stats().reduced;
+  }
 
-  for (auto node : NODES) {
-    nodeGenerator(node);
+  graph = &*cfg;
+  for (size_t block : cfg->order()) {
+    for (auto node : cfg->blocks()[block].statements) {
+      assignStorage(node);
+    }
+  }
+  for (const auto &function : functions) {
+    graph = &function.cfg;
+    frame = &function.frame;
+    for (size_t block : function.cfg.order()) {
+      for (auto node : function.cfg.blocks()[block].statements) {
+        assignStorage(node);
+      }
+    }
   }
+  emitLiteralPool();
+
+  // text segment
+  // freestanding programs have no C runtime to call main, so the kernel
+  // enters the program at _start directly, with rsp aligned rather than
+  // just below a return address
+  module.label(module.symbol(freestanding ? "_start" : "main"), true);
+  module.emit(Opcode::PUSH, rbp);
+  module.emit(Opcode::MOV, rbp, rsp);
+  // the spill slots below rbp and the outgoing area of the largest call,
+  // which leave rsp aligned for every call
+  CallArea area = callArea(*cfg);
+  uint32_t size = (area.spills + area.outgoing + 15) / 16 * 16;
+  if (freestanding) {
+    size += 8;
+  }
+  if (size) {
+    module.emit(Opcode::SUB, rsp, imm(size));
+  }
+  if (uses_cpu_dispatch) {
+    module.emit(Opcode::CALL, sym(module.symbol("__mc_detect_cpu")));
+  }
+  graph = &*cfg;
+  frame = nullptr;
+  lowerStatements();
 
   // end of text segment
-  text_segment << std::endl;
-  text_segment << "\t\t" << "mov rcx, 1 \n";
-  text_segment << "\t\t" << "xor rcx, rcx\n";
-  text_segment << "\t\t" << "call ExitProcess";
+  target.exit(module, freestanding);
+
+  for (const auto &function : functions) {
+    graph = &function.cfg;
+    frame = &function.frame;
+    emitPrologue(*function.node);
+    lowerStatements();
+  }
+  graph = nullptr;
+  frame = nullptr;
+
+  // runtime support routines, only emitted when the program needs them
+  if (uses_read_int || uses_read_char) {
+    emitInputRuntime();
+  }
+  if (freestanding) {
+    emitOutputRuntime();
+  }
+  if (uses_cpu_dispatch) {
+    emitDetectCpuRuntime();
+  }
 
-  std::cout << headerCode.str() << std::endl;
-  std::cout << bss_segment.str() << std::endl;
-  std::cout << data_segment.str() << std::endl;
-  std::cout << text_segment.str() << std::endl;
+  return std::move(module);
+}
+
+void Generator::assignStorage(std::shared_ptr<node::Node> node) {
+  if (auto declNode = std::dynamic_pointer_cast<DeclarationNode>(node)) {
+    if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+            declNode->product)) {
+      auto assignmentNode =
+          std::get<std::shared_ptr<AssignmentNode>>(declNode->product);
+      const std::string &name = assignmentNode->identifier->identifier.lexeme;
+      // the storage itself was placed by the StorageLayout
+      if (std::dynamic_pointer_cast<ConstantNode>(
+              assignmentNode->assignment)) {
+        initialized_variables[name] = true;
+      }
+    } else {
+      for (auto &id : std::get<std::vector<std::shared_ptr<IdentifierNode>>>(
+               declNode->product)) {
+        uninitialized_variables[id->identifier.lexeme] = true;
+      }
+    }
+  } else if (auto coutNode = std::dynamic_pointer_cast<CoutNode>(node)) {
+    for (auto &expr : coutNode->operands) {
+      if (auto literalNode =
+              std::dynamic_pointer_cast<StringLiteralNode>(expr)) {
+        const std::string &literal = literalNode->literal.lexeme;
+        if (literal_pool.emplace(literal, LiteralRef()).second) {
+          literals.push_back(literal);
+        }
+      }
+    }
+  } else if (auto cinNode = std::dynamic_pointer_cast<CinNode>(node)) {
+    for (auto &expr : cinNode->operands) {
+      // array elements are ints
+      auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(expr);
+      (identifierNode && width(identifierNode->identifier.lexeme) == 1
+           ? uses_read_char
+           : uses_read_int) = true;
+    }
+  } else if (auto assignNode =
+                 std::dynamic_pointer_cast<AssignmentNode>(node)) {
+    auto array = graph->array(assignNode->identifier->identifier.lexeme);
+    if (array && simd == Simd::AUTO && array->length >= DISPATCH_LENGTH) {
+      uses_cpu_dispatch = true;
+    }
+  }
+}
 
-  return headerCode.str() + bss_segment.str() + data_segment.str() +
-         text_segment.str();
+void Generator::lowerStatements() {
+  std::vector<std::pair<size_t, size_t>> items;
+  for (size_t position = 0; position < graph->order().size(); position++) {
+    const auto &block = graph->blocks()[graph->order()[position]];
+    for (size_t index = 0; index <= block.statements.size(); index++) {
+      items.push_back({position, index});
+    }
+  }
+
+  size_t count = items.size();
+  size_t threads = jobs ? jobs : std::max(1u, std::thread::hardware_concurrency());
+  size_t ranges = std::min(threads, std::max<size_t>(1, count / MIN_RANGE));
+
+  if (ranges == 1) {
+    Generator worker(*this);
+    for (const auto &[position, index] : items) {
+      worker.lowerStatement(position, index);
+    }
+    merge(worker.module);
+    return;
+  }
+
+  std::vector<Module> fragments(ranges);
+  std::vector<std::exception_ptr> errors(ranges);
+  std::vector<std::thread> workers;
+  for (size_t range = 0; range < ranges; range++) {
+    workers.emplace_back([&, range] {
+      try {
+        Generator worker(*this);
+        for (size_t i = count * range / ranges;
+             i < count * (range + 1) / ranges; i++) {
+          worker.lowerStatement(items[i].first, items[i].second);
+        }
+        fragments[range] = std::move(worker.module);
+      } catch (...) {
+        errors[range] = std::current_exception();
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  // the first error in program order wins, as in a serial run
+  for (size_t range = 0; range < ranges; range++) {
+    if (errors[range]) {
+      std::rethrow_exception(errors[range]);
+    }
+    merge(fragments[range]);
+  }
+}
+
+void Generator::lowerStatement(size_t position, size_t index) {
+  size_t id = graph->order()[position];
+  const auto &block = graph->blocks()[id];
+  if (index == 0 && block.label) {
+    module.label(blockLabel(id));
+  }
+  site = labelPrefix() + "simd." + std::to_string(position) + "." +
+         std::to_string(index);
+  if (index < block.statements.size()) {
+    nodeGenerator(block.statements[index]);
+    return;
+  }
+
+  ControlFlowGraph::Terminator end = graph->terminator(position);
+  if (end.condition) {
+    branch(end.condition, end.negate, blockLabel(end.branch));
+  }
+  if (end.jump != ControlFlowGraph::NONE) {
+    module.emit(Opcode::JMP, sym(blockLabel(end.jump)));
+  }
+}
+
+uint32_t Generator::blockLabel(size_t block) {
+  return module.symbol(labelPrefix() + "bb." + std::to_string(block));
+}
+
+std::string Generator::labelPrefix() const {
+  return frame ? frame->name + "." : "";
+}
+
+void Generator::branch(std::shared_ptr<ConditionNode> condition, bool negate,
+                       uint32_t target) {
+  /*
+    Both sides are compared at the width of the wider one, the right side
+    from memory or as an immediate when it can be. An expression on the
+    right is computed first and kept in rdx.
+  */
+  uint8_t size =
+      std::max(valueWidth(condition->left), valueWidth(condition->right));
+  Operand left = reg(Reg::RAX, size);
+  auto right = condition->right;
+
+  if (hasCall(condition->left) || hasCall(right)) {
+    // the left side is kept in a spill slot while the right side calls
+    evaluate(condition->left);
+    if (hasCall(right)) {
+      Operand kept = spill(spilled++);
+      module.emit(Opcode::MOV, kept, rax);
+      evaluate(right, rdx);
+      module.emit(Opcode::MOV, rax, kept);
+      spilled--;
+    } else {
+      evaluate(right, rdx);
+    }
+    module.emit(Opcode::CMP, left, reg(Reg::RDX, size));
+  } else if (std::dynamic_pointer_cast<ExpressionNode>(right) ||
+      std::dynamic_pointer_cast<IndexNode>(right)) {
+    evaluate(right);
+    module.emit(Opcode::MOV, rdx, rax);
+    evaluate(condition->left);
+    module.emit(Opcode::CMP, left, reg(Reg::RDX, size));
+  } else if (auto rightNode =
+                 std::dynamic_pointer_cast<IdentifierNode>(right)) {
+    evaluate(condition->left);
+    const std::string &name = rightNode->identifier.lexeme;
+    if (width(name) == size) {
+      module.emit(Opcode::CMP, left, variable(name, size));
+    } else {
+      load(rcx, name);
+      module.emit(Opcode::CMP, left, reg(Reg::RCX, size));
+    }
+  } else {
+    evaluate(condition->left);
+    auto constantNode = std::dynamic_pointer_cast<ConstantNode>(right);
+    int64_t value = constantValue(constantNode->constant);
+    if (value > INT32_MAX) {
+      module.emit(Opcode::MOV, rcx, imm(value));
+      module.emit(Opcode::CMP, left, rcx);
+    } else {
+      module.emit(Opcode::CMP, left, imm(value));
+    }
+  }
+
+  static const std::unordered_map<std::string, Cond> conditions = {
+      {"<", Cond::L},  {"<=", Cond::LE}, {">", Cond::G},
+      {">=", Cond::GE}, {"==", Cond::E},  {"!=", Cond::NE}};
+  Cond cond = conditions.at(condition->OP);
+  if (negate) {
+    // the encodings of a condition and its opposite differ in the low bit
+    cond = static_cast<Cond>(static_cast<uint8_t>(cond) ^ 1);
+  }
+  module.jump(cond, target);
+}
+
+void Generator::merge(const Module &fragment) {
+  // fragment symbols are interned in the order the fragment met them
+  std::vector<uint32_t> ids(fragment.symbols.size());
+  for (size_t i = 0; i < fragment.symbols.size(); i++) {
+    ids[i] = module.symbol(fragment.symbols[i].name);
+  }
+
+  auto remap = [&](Operand &operand) {
+    if (operand.symbol != NO_SYMBOL) {
+      operand.symbol = ids[operand.symbol];
+    }
+  };
+  for (Instruction insn : fragment.text) {
+    if (insn.op == Opcode::LABEL) {
+      module.label(ids[insn.dst.symbol],
+                   fragment.symbols[insn.dst.symbol].global);
+    } else {
+      remap(insn.dst);
+      remap(insn.src);
+      remap(insn.extra);
+      module.text.push_back(insn);
+    }
+  }
 }
 
 std::optional<std::shared_ptr<node::Node>> Generator::peek() {
@@ -65,68 +391,739 @@ std::optional<std::shared_ptr<node::Node>> Generator::consume() {
   return NODES.at(generator_count++);
 }
 
-std::ostringstream
-Generator::processExpression(std::shared_ptr<ExpressionNode> expressionNode,
-                             bool) {
-  // return output;
-  std::ostringstream output;
+Operand Generator::variable(const std::string &name, uint8_t size) {
+  if (frame) {
+    return mem(frame->base, frame->slots.at(name).offset, size);
+  }
+  return mem(module.symbol(storage->layout->slot(name)), size);
+}
+
+uint8_t Generator::width(const std::string &name) {
+  if (frame) {
+    return frame->slots.at(name).width;
+  }
+  return storage->layout->width(name);
+}
+
+int64_t Generator::constantValue(const TOKEN &constant) {
+  try {
+    return std::stoll(constant.lexeme);
+  } catch (std::out_of_range &) {
+    throw std::runtime_error("Constant " + constant.lexeme +
+                             " is out of range at line " +
+                             std::to_string(constant.line));
+  }
+}
+
+uint8_t Generator::valueWidth(std::shared_ptr<node::Node> node) {
+  if (auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(node)) {
+    return width(identifierNode->identifier.lexeme) == 8 ? 8 : 4;
+  } else if (auto constantNode =
+                 std::dynamic_pointer_cast<ConstantNode>(node)) {
+    return constantValue(constantNode->constant) > INT32_MAX ? 8 : 4;
+  } else if (auto expressionNode =
+                 std::dynamic_pointer_cast<ExpressionNode>(node)) {
+    return std::max(valueWidth(expressionNode->left),
+                    valueWidth(expressionNode->right));
+  } else if (auto callNode = std::dynamic_pointer_cast<CallNode>(node)) {
+    return callee(callNode).width() == 8 ? 8 : 4;
+  }
+  return 4;
+}
+
+const FunctionNode &Generator::callee(std::shared_ptr<CallNode> callNode) {
+  return *storage->callees.at(callNode->identifier->identifier.lexeme);
+}
+
+void Generator::load(Operand into, const std::string &name) {
+  uint8_t size = width(name);
+  Opcode op = size == 8 ? Opcode::MOV
+              : size == 4 ? Opcode::MOVSXD
+                          : Opcode::MOVSX;
+  module.emit(op, into, variable(name, size));
+}
+
+void Generator::evaluate(std::shared_ptr<node::Node> node, Operand into) {
+  if (auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(node)) {
+    load(into, identifierNode->identifier.lexeme);
+    return;
+  } else if (auto constantNode =
+                 std::dynamic_pointer_cast<ConstantNode>(node)) {
+    module.emit(Opcode::MOV, into, imm(constantValue(constantNode->constant)));
+    return;
+  } else if (auto indexNode = std::dynamic_pointer_cast<IndexNode>(node)) {
+    module.emit(Opcode::MOVSXD, into, element(indexNode));
+    return;
+  } else if (auto callNode = std::dynamic_pointer_cast<CallNode>(node)) {
+    call(callNode);
+    if (into.base != Reg::RAX) {
+      module.emit(Opcode::MOV, into, rax);
+    }
+    return;
+  }
+
+  /*
+    An int expression is computed in the low half of the register and sign
+    extended at the end, so it wraps around like the int it is. Operands of
+    the expression's own width are used from memory directly.
+  */
+  auto expressionNode = std::dynamic_pointer_cast<ExpressionNode>(node);
+  uint8_t size = valueWidth(expressionNode);
+  Operand result = reg(into.base, size);
+  Opcode op = expressionNode->OP == '+'   ? Opcode::ADD
+              : expressionNode->OP == '-' ? Opcode::SUB
+                                          : Opcode::IMUL;
+
+  // a call on the right runs first, unless the left side calls too and
+  // its result has to wait for it in a spill slot
+  if (hasCall(expressionNode->right)) {
+    if (hasCall(expressionNode->left)) {
+      evaluate(expressionNode->left, into);
+      Operand kept = spill(spilled++);
+      module.emit(Opcode::MOV, kept, into);
+      evaluate(expressionNode->right, rcx);
+      module.emit(Opcode::MOV, into, kept);
+      spilled--;
+    } else {
+      evaluate(expressionNode->right, rcx);
+      evaluate(expressionNode->left, into);
+    }
+    module.emit(op, result, reg(Reg::RCX, size));
+    if (size == 4) {
+      module.emit(Opcode::MOVSXD, into, result);
+    }
+    return;
+  }
+
+  evaluate(expressionNode->left, into);
+  if (auto rightNode =
+          std::dynamic_pointer_cast<IdentifierNode>(expressionNode->right)) {
+    const std::string &name = rightNode->identifier.lexeme;
+    if (width(name) == size) {
+      module.emit(op, result, variable(name, size));
+    } else {
+      load(rcx, name);
+      module.emit(op, result, reg(Reg::RCX, size));
+    }
+  } else if (auto indexNode =
+                 std::dynamic_pointer_cast<IndexNode>(expressionNode->right)) {
+    Operand address = element(indexNode);
+    if (size == 4) {
+      module.emit(op, result, address);
+    } else {
+      module.emit(Opcode::MOVSXD, rcx, address);
+      module.emit(op, result, rcx);
+    }
+  } else if (auto rightNode = std::dynamic_pointer_cast<ConstantNode>(
+                 expressionNode->right)) {
+    int64_t value = constantValue(rightNode->constant);
+    if (value > INT32_MAX) {
+      // add, sub and imul only take 32-bit immediates
+      module.emit(Opcode::MOV, rcx, imm(value));
+      module.emit(op, result, rcx);
+    } else if (op == Opcode::IMUL) {
+      module.emit(op, result, result, imm(value));
+    } else {
+      module.emit(op, result, imm(value));
+    }
+  }
+
+  if (size == 4) {
+    module.emit(Opcode::MOVSXD, into, result);
+  }
+}
+
+bool Generator::hasCall(std::shared_ptr<node::Node> node) const {
+  if (std::dynamic_pointer_cast<CallNode>(node)) {
+    return true;
+  } else if (auto expressionNode =
+                 std::dynamic_pointer_cast<ExpressionNode>(node)) {
+    return hasCall(expressionNode->left) || hasCall(expressionNode->right);
+  } else if (auto conditionNode =
+                 std::dynamic_pointer_cast<ConditionNode>(node)) {
+    return hasCall(conditionNode->left) || hasCall(conditionNode->right);
+  } else if (auto assignNode =
+                 std::dynamic_pointer_cast<AssignmentNode>(node)) {
+    return hasCall(assignNode->assignment);
+  } else if (auto elementNode =
+                 std::dynamic_pointer_cast<ElementAssignmentNode>(node)) {
+    return hasCall(elementNode->assignment);
+  } else if (auto declNode = std::dynamic_pointer_cast<DeclarationNode>(node)) {
+    return std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+               declNode->product) &&
+           hasCall(std::get<std::shared_ptr<AssignmentNode>>(
+               declNode->product));
+  } else if (auto returnNode = std::dynamic_pointer_cast<ReturnNode>(node)) {
+    return returnNode->value && hasCall(returnNode->value);
+  } else if (auto coutNode = std::dynamic_pointer_cast<CoutNode>(node)) {
+    return std::any_of(coutNode->operands.begin(), coutNode->operands.end(),
+                       [&](const auto &operand) { return hasCall(operand); });
+  }
+  return false;
+}
+
+bool Generator::direct(std::shared_ptr<node::Node> node) {
+  return std::dynamic_pointer_cast<ConstantNode>(node) ||
+         std::dynamic_pointer_cast<IdentifierNode>(node) ||
+         std::dynamic_pointer_cast<IndexNode>(node);
+}
+
+bool Generator::spilledArguments(std::shared_ptr<CallNode> callNode) const {
+  size_t computed = 0;
+  size_t last = 0;
+  for (size_t i = 0; i < callNode->arguments.size(); i++) {
+    if (!direct(callNode->arguments[i])) {
+      computed++;
+      last = i;
+    }
+  }
+  return computed > 1 || (computed && last >= target.argumentCount());
+}
+
+Operand Generator::spill(uint32_t slot) const {
+  int32_t base = frame ? frame->spill_base : 0;
+  return mem(Reg::RBP, base - 8 * static_cast<int32_t>(slot + 1), 8);
+}
+
+void Generator::call(std::shared_ptr<CallNode> callNode) {
+  /*
+    The stack arguments go above the shadow space at the bottom of the
+    frame, which the prologue reserved for the largest call, so rsp does
+    not move. Computed arguments wait in spill slots, as a call or a
+    division in a later one would change the argument registers and the
+    outgoing area, unless one in a register is the only one. Constants,
+    variables and elements are read last.
+  */
+  const auto &arguments = callNode->arguments;
+  size_t registers = std::min(arguments.size(), target.argumentCount());
+  uint32_t shadow = target.shadowSpace();
+  uint32_t first = spilled;
+  std::vector<uint32_t> slots(arguments.size(), UINT32_MAX);
+  bool computed = spilledArguments(callNode);
+  for (size_t i = 0; i < arguments.size(); i++) {
+    if (direct(arguments[i])) {
+      continue;
+    }
+    evaluate(arguments[i]);
+    if (computed) {
+      slots[i] = spilled++;
+      module.emit(Opcode::MOV, spill(slots[i]), rax);
+    } else {
+      module.emit(Opcode::MOV, reg(target.argument(i)), rax);
+    }
+  }
+
+  for (size_t i = registers; i < arguments.size(); i++) {
+    if (slots[i] != UINT32_MAX) {
+      module.emit(Opcode::MOV, rax, spill(slots[i]));
+    } else {
+      evaluate(arguments[i]);
+    }
+    module.emit(Opcode::MOV, mem(Reg::RSP, shadow + 8 * (i - registers), 8),
+                rax);
+  }
+
+  for (size_t i = 0; i < registers; i++) {
+    Operand into = reg(target.argument(i));
+    if (slots[i] != UINT32_MAX) {
+      module.emit(Opcode::MOV, into, spill(slots[i]));
+    } else if (direct(arguments[i])) {
+      evaluate(arguments[i], into);
+    }
+  }
+  spilled = first;
+
+  const std::string &name = callNode->identifier->identifier.lexeme;
+  module.emit(Opcode::CALL, sym(module.symbol("fn." + name)));
+}
+
+Generator::CallArea
+Generator::callArea(std::shared_ptr<node::Node> node) const {
+  // mirrors the lowering of calls, expressions and conditions
+  CallArea area;
+  auto add = [&](const CallArea &inner, uint32_t held) {
+    area.spills = std::max(area.spills, held + inner.spills);
+    area.outgoing = std::max(area.outgoing, inner.outgoing);
+  };
+  if (auto callNode = std::dynamic_pointer_cast<CallNode>(node)) {
+    size_t registers =
+        std::min(callNode->arguments.size(), target.argumentCount());
+    area.outgoing = target.shadowSpace() +
+                    8 * (callNode->arguments.size() - registers);
+    bool spills = spilledArguments(callNode);
+    uint32_t held = 0;
+    for (auto &argument : callNode->arguments) {
+      add(callArea(argument), held);
+      if (spills && !direct(argument)) {
+        held += 8;
+      }
+    }
+    area.spills = std::max(area.spills, held);
+  } else if (auto expressionNode =
+                 std::dynamic_pointer_cast<ExpressionNode>(node)) {
+    add(callArea(expressionNode->left), 0);
+    add(callArea(expressionNode->right), hasCall(expressionNode->left) &&
+                                                 hasCall(expressionNode->right)
+                                             ? 8
+                                             : 0);
+  } else if (auto conditionNode =
+                 std::dynamic_pointer_cast<ConditionNode>(node)) {
+    add(callArea(conditionNode->left), 0);
+    add(callArea(conditionNode->right), hasCall(conditionNode->right) ? 8 : 0);
+  } else if (auto assignNode =
+                 std::dynamic_pointer_cast<AssignmentNode>(node)) {
+    add(callArea(assignNode->assignment), 0);
+  } else if (auto elementNode =
+                 std::dynamic_pointer_cast<ElementAssignmentNode>(node)) {
+    add(callArea(elementNode->assignment), 0);
+  } else if (auto declNode = std::dynamic_pointer_cast<DeclarationNode>(node)) {
+    if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+            declNode->product)) {
+      add(callArea(std::get<std::shared_ptr<AssignmentNode>>(
+              declNode->product)),
+          0);
+    }
+  } else if (auto returnNode = std::dynamic_pointer_cast<ReturnNode>(node)) {
+    if (returnNode->value) {
+      add(callArea(returnNode->value), 0);
+    }
+  } else if (auto coutNode = std::dynamic_pointer_cast<CoutNode>(node)) {
+    area.outgoing = target.shadowSpace(); // printf or the output runtime
+    for (auto &operand : coutNode->operands) {
+      add(callArea(operand), 0);
+    }
+  } else if (std::dynamic_pointer_cast<CinNode>(node)) {
+    area.outgoing = target.shadowSpace();
+  }
+  return area;
+}
+
+Generator::CallArea Generator::callArea(const ControlFlowGraph &cfg) const {
+  CallArea area;
+  for (const auto &block : cfg.blocks()) {
+    std::vector<std::shared_ptr<node::Node>> nodes = block.statements;
+    if (block.condition) {
+      nodes.push_back(block.condition);
+    }
+    for (const auto &node : nodes) {
+      CallArea inner = callArea(node);
+      area.spills = std::max(area.spills, inner.spills);
+      area.outgoing = std::max(area.outgoing, inner.outgoing);
+    }
+  }
+  return area;
+}
+
+void Generator::processReturn(std::shared_ptr<ReturnNode> returnNode) {
+  if (auto value = returnNode->value) {
+    evaluate(value);
+    // narrowed to the return type and sign extended back
+    if (frame->result < valueWidth(value)) {
+      Opcode op = frame->result == 4 ? Opcode::MOVSXD : Opcode::MOVSX;
+      module.emit(op, rax, reg(Reg::RAX, frame->result));
+    }
+  }
+  if (!frame->leaf) {
+    module.emit(Opcode::MOV, rsp, rbp);
+    module.emit(Opcode::POP, rbp);
+  } else if (frame->size) {
+    module.emit(Opcode::ADD, rsp, imm(frame->size));
+  }
+  module.emit(Opcode::RET);
+}
 
-  if (auto leftNode =
-          std::dynamic_pointer_cast<IdentifierNode>(expressionNode->left)) {
-    // if (!isInitialized(leftNode->identifier.lexeme)) {
-    //   data_segment << "    "  << leftNode->identifier.lexeme << " dq 0" <<
-    //   "\n";
-    // }
-    output << "\t\t" << "mov rax, [" << leftNode->identifier.lexeme << "]"
-           << "\n";
-  } else if (auto leftNode = std::dynamic_pointer_cast<ConstantNode>(
-                 expressionNode->left)) {
-    output << "\t\t" << "mov rax, " << leftNode->constant.lexeme << "\n";
+Generator::Frame Generator::buildFrame(const FunctionNode &function,
+                                       const ControlFlowGraph &cfg) {
+  Frame frame;
+  frame.name = "fn." + function.identifier->identifier.lexeme;
+  frame.result = function.width();
+
+  // every variable of the graph, temporaries included, in the order met
+  std::vector<std::pair<std::string, uint8_t>> variables;
+  auto add = [&](const std::string &name, uint8_t width) {
+    if (frame.slots.emplace(name, Slot{0, width}).second) {
+      variables.push_back({name, width});
+    }
+  };
+  for (const auto &block : cfg.blocks()) {
+    if (block.condition && hasCall(block.condition)) {
+      frame.leaf = false;
+    }
+    for (const auto &statement : block.statements) {
+      if (hasCall(statement) ||
+          std::dynamic_pointer_cast<CinNode>(statement) ||
+          std::dynamic_pointer_cast<CoutNode>(statement)) {
+        frame.leaf = false;
+      }
+      auto declNode = std::dynamic_pointer_cast<DeclarationNode>(statement);
+      if (!declNode) {
+        continue;
+      }
+      if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+              declNode->product)) {
+        add(std::get<std::shared_ptr<AssignmentNode>>(declNode->product)
+                ->identifier->identifier.lexeme,
+            declNode->width());
+        continue;
+      }
+      for (auto &id : std::get<std::vector<std::shared_ptr<IdentifierNode>>>(
+               declNode->product)) {
+        add(id->identifier.lexeme, declNode->width());
+      }
+    }
   }
 
-  if (expressionNode->OP == '+') {
-    if (auto rightNode =
-            std::dynamic_pointer_cast<IdentifierNode>(expressionNode->right)) {
-      // if (!isInitialized(rightNode->identifier.lexeme)) {
-      //   data_segment << "    "  << rightNode->identifier.lexeme << " dq 0"
-      //   << "\n";
-      // }
-      output << "\t\t" << "add rax, [" << rightNode->identifier.lexeme << "]"
-             << "\n";
-    } else if (auto rightNode = std::dynamic_pointer_cast<ConstantNode>(
-                   expressionNode->right)) {
-      output << "\t\t" << "add rax, " << rightNode->constant.lexeme << "\n";
+  // the parameters the caller passed on the stack stay there
+  size_t registers = target.argumentCount();
+  std::unordered_set<std::string> stacked;
+  for (size_t i = registers; i < function.parameters.size(); i++) {
+    stacked.insert(function.parameter(i));
+  }
+
+  // widest first, so every slot is aligned to its width
+  std::stable_sort(variables.begin(), variables.end(),
+                   [](const auto &a, const auto &b) {
+                     return a.second > b.second;
+                   });
+  std::vector<std::pair<std::string, uint32_t>> starts;
+  uint32_t total = 0;
+  for (const auto &[name, width] : variables) {
+    if (!stacked.count(name)) {
+      starts.push_back({name, total});
+      total += width;
     }
   }
+  total = (total + 7) / 8 * 8;
 
-  if (expressionNode->OP == '-') {
-    if (auto rightNode =
-            std::dynamic_pointer_cast<IdentifierNode>(expressionNode->right)) {
-      output << "\t\t" << "sub rax, " << rightNode->identifier.lexeme << "\n";
-    } else if (auto rightNode = std::dynamic_pointer_cast<ConstantNode>(
-                   expressionNode->right)) {
-      output << "\t\t" << "sub rax, " << rightNode->constant.lexeme << "\n";
+  uint32_t shadow = target.shadowSpace();
+  int32_t arguments; // offset of the first stack parameter
+  if (!frame.leaf) {
+    // the locals, then the spill slots, then the outgoing area of the
+    // largest call at the aligned rsp
+    CallArea area = callArea(cfg);
+    frame.base = Reg::RBP;
+    frame.spill_base = -static_cast<int32_t>(total);
+    frame.size = (total + area.spills + area.outgoing + 15) / 16 * 16;
+    for (const auto &[name, start] : starts) {
+      frame.slots[name].offset = -static_cast<int32_t>(start) -
+                                 frame.slots[name].width;
+    }
+    arguments = 16 + shadow;
+  } else {
+    frame.base = Reg::RSP;
+    int32_t offset = 0;
+    if (total <= target.redZone()) {
+      offset = -static_cast<int32_t>(total);
+    } else if (total <= shadow) {
+      offset = 8; // the home area above the return address
+    } else {
+      frame.size = total;
+    }
+    for (const auto &[name, start] : starts) {
+      frame.slots[name].offset = offset + static_cast<int32_t>(start);
     }
+    arguments = frame.size + 8 + shadow;
+  }
+  for (size_t i = registers; i < function.parameters.size(); i++) {
+    frame.slots[function.parameter(i)].offset =
+        arguments + 8 * static_cast<int32_t>(i - registers);
   }
 
-  return output;
+  /*
+    A local starts out 0 unless the body declares it with a value before
+    anything can read it. Parameters and the temporaries of the graph, whose
+    names have a dot, are always written first.
+  */
+  std::unordered_set<std::string> assigned;
+  for (size_t i = 0; i < function.parameters.size(); i++) {
+    assigned.insert(function.parameter(i));
+  }
+  for (const auto &statement : function.body->statements) {
+    auto declNode = std::dynamic_pointer_cast<DeclarationNode>(statement);
+    if (declNode && std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+                        declNode->product)) {
+      assigned.insert(
+          std::get<std::shared_ptr<AssignmentNode>>(declNode->product)
+              ->identifier->identifier.lexeme);
+    }
+  }
+  for (const auto &[name, width] : variables) {
+    if (!assigned.count(name) && name.find('.') == std::string::npos) {
+      frame.zeroed.push_back(name);
+    }
+  }
+  return frame;
+}
+
+void Generator::emitPrologue(const FunctionNode &function) {
+  module.label(module.symbol(frame->name));
+  if (!frame->leaf) {
+    module.emit(Opcode::PUSH, rbp);
+    module.emit(Opcode::MOV, rbp, rsp);
+  }
+  if (frame->size) {
+    module.emit(Opcode::SUB, rsp, imm(frame->size));
+  }
+  size_t registers =
+      std::min(function.parameters.size(), target.argumentCount());
+  for (size_t i = 0; i < registers; i++) {
+    const std::string &name = function.parameter(i);
+    uint8_t size = width(name);
+    module.emit(Opcode::MOV, variable(name, size),
+                reg(target.argument(i), size));
+  }
+  for (const auto &name : frame->zeroed) {
+    uint8_t size = width(name);
+    module.emit(Opcode::MOV, variable(name, size), imm(0));
+  }
+}
+
+void Generator::store(const std::string &name) {
+  uint8_t size = width(name);
+  module.emit(Opcode::MOV, variable(name, size), reg(Reg::RAX, size));
+}
+
+uint32_t Generator::array(const std::string &name) {
+  return module.symbol(name);
 }
 
-std::ostringstream
-Generator::processAssignment(std::shared_ptr<AssignmentNode> assignmentNode) {
+Operand Generator::element(std::shared_ptr<IndexNode> indexNode) {
+  uint32_t symbol = array(indexNode->identifier->identifier.lexeme);
+  if (auto constantNode =
+          std::dynamic_pointer_cast<ConstantNode>(indexNode->index)) {
+    Operand address = mem(symbol, 4);
+    address.value = 4 * constantValue(constantNode->constant);
+    return address;
+  }
+  auto identifierNode =
+      std::dynamic_pointer_cast<IdentifierNode>(indexNode->index);
+  load(r10, identifierNode->identifier.lexeme);
+  module.emit(Opcode::LEA, r11, mem(symbol));
+  return mem(Reg::R11, Reg::R10, 4, 0, 4);
+}
 
-  std::ostringstream output;
+void Generator::processAssignment(
+    std::shared_ptr<AssignmentNode> assignmentNode) {
 
   auto assignment = assignmentNode->assignment;
+  const std::string &name = assignmentNode->identifier->identifier.lexeme;
+  if (graph->array(name)) {
+    processArrayAssignment(assignmentNode);
+    return;
+  }
 
   if (auto constantNode = std::dynamic_pointer_cast<ConstantNode>(assignment)) {
-    output << constantNode->constant.lexeme;
-  } else if (auto expressionNode =
-                 std::dynamic_pointer_cast<ExpressionNode>(assignment)) {
-    output << processExpression(expressionNode).str();
+    uint8_t size = width(name);
+    int64_t value = constantValue(constantNode->constant);
+    // narrowed to the variable's type the way a C++ conversion wraps it
+    if (size == 1) {
+      value = static_cast<int8_t>(value);
+    } else if (size == 2) {
+      value = static_cast<int16_t>(value);
+    } else if (size == 4) {
+      value = static_cast<int32_t>(value);
+    }
+    if (value >= INT32_MIN && value <= INT32_MAX) {
+      module.emit(Opcode::MOV, variable(name, size), imm(value));
+      return;
+    }
   }
+  evaluate(assignment);
+  store(name);
+}
 
-  return output;
+void Generator::processElementAssignment(
+    std::shared_ptr<ElementAssignmentNode> elementNode) {
+  // the value is computed first, it may index arrays itself
+  auto assignment = elementNode->assignment;
+  if (auto constantNode = std::dynamic_pointer_cast<ConstantNode>(assignment)) {
+    int32_t value = constantValue(constantNode->constant);
+    module.emit(Opcode::MOV, element(elementNode->element), imm(value));
+    return;
+  }
+  evaluate(assignment);
+  module.emit(Opcode::MOV, element(elementNode->element), eax);
+}
+
+void Generator::processArrayAssignment(
+    std::shared_ptr<AssignmentNode> assignmentNode) {
+  /*
+    Operands that are not arrays are computed once into edx before the
+    loop. When no operand is an array the whole value is, and it is stored
+    to every element.
+  */
+  const auto &destination =
+      *graph->array(assignmentNode->identifier->identifier.lexeme);
+  auto value = assignmentNode->assignment;
+  auto expressionNode = std::dynamic_pointer_cast<ExpressionNode>(value);
+
+  auto arrayOperand = [&](std::shared_ptr<node::Node> operand) {
+    auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(operand);
+    if (!identifierNode ||
+        !graph->array(identifierNode->identifier.lexeme)) {
+      return NO_SYMBOL;
+    }
+    return array(identifierNode->identifier.lexeme);
+  };
+
+  ArrayOperation operation{destination.length, array(destination.name), 0,
+                           NO_SYMBOL, NO_SYMBOL};
+  if (expressionNode) {
+    operation.op = expressionNode->OP;
+    operation.left = arrayOperand(expressionNode->left);
+    operation.right = arrayOperand(expressionNode->right);
+  } else {
+    operation.left = arrayOperand(value);
+  }
+
+  if (operation.left == NO_SYMBOL && operation.right == NO_SYMBOL) {
+    evaluate(value, rdx);
+    operation.op = 0;
+  } else if (operation.left == NO_SYMBOL) {
+    evaluate(expressionNode ? expressionNode->left : value, rdx);
+  } else if (expressionNode && operation.right == NO_SYMBOL) {
+    evaluate(expressionNode->right, rdx);
+  }
+
+  Simd isa = simd;
+  if (isa == Simd::AUTO && destination.length < DISPATCH_LENGTH) {
+    isa = Simd::SSE2;
+  }
+  if (isa != Simd::AUTO) {
+    arrayLoop(operation, isa, site);
+    return;
+  }
+
+  // AVX2 when __mc_detect_cpu found it, SSE2 otherwise
+  uint32_t sse = module.symbol(site + ".sse2");
+  uint32_t done = module.symbol(site + ".done");
+  module.emit(Opcode::CMP, mem(module.symbol("__mc_avx2"), 1), imm(0));
+  module.jump(Cond::E, sse);
+  arrayLoop(operation, Simd::AVX2, site + ".avx2");
+  module.emit(Opcode::JMP, sym(done));
+  module.label(sse);
+  arrayLoop(operation, Simd::SSE2, site);
+  module.label(done);
+}
+
+void Generator::arrayLoop(const ArrayOperation &operation, Simd isa,
+                          const std::string &name) {
+  /*
+    The loop walks the arrays with the byte offset in r10 from the
+    addresses in r8 (destination), r9 (left) and r11 (right), a whole
+    register of lanes at a time. The elements that do not fill a register
+    follow it unrolled. Only registers that are volatile in both calling
+    conventions are used: rax, rdx, r8 to r11 and xmm0 to xmm4.
+  */
+  uint64_t lanes = isa == Simd::AVX2 ? 8 : isa == Simd::SSE2 ? 4 : 1;
+  uint8_t size = 4 * lanes;
+  uint64_t loopBytes = operation.length / lanes * size;
+  Operand scalar = edx;
+  Operand broadcast = xmm(2, size);
+  Operand value = xmm(0, size);
+
+  if (loopBytes) {
+    module.emit(Opcode::LEA, r8, mem(operation.destination));
+    if (operation.left != NO_SYMBOL) {
+      module.emit(Opcode::LEA, r9, mem(operation.left));
+    }
+    if (operation.right != NO_SYMBOL) {
+      module.emit(Opcode::LEA, r11, mem(operation.right));
+    }
+    if (lanes > 1 && (operation.left == NO_SYMBOL ||
+                      (operation.op && operation.right == NO_SYMBOL))) {
+      module.emit(Opcode::MOVD, xmm(2), edx);
+      if (isa == Simd::AVX2) {
+        module.emit(Opcode::VPBROADCASTD, broadcast, xmm(2));
+      } else {
+        module.emit(Opcode::PSHUFD, broadcast, broadcast, imm(0));
+      }
+    }
+    module.emit(Opcode::XOR, reg(Reg::R10, 4), reg(Reg::R10, 4));
+    uint32_t loop = module.symbol(name + ".loop");
+    module.label(loop);
+
+    Operand left = operation.left == NO_SYMBOL
+                       ? broadcast
+                       : mem(Reg::R9, Reg::R10, 1, 0, size);
+    Operand right = operation.right == NO_SYMBOL
+                        ? broadcast
+                        : mem(Reg::R11, Reg::R10, 1, 0, size);
+    Operand destination = mem(Reg::R8, Reg::R10, 1, 0, size);
+
+    if (lanes == 1) {
+      left = operation.left == NO_SYMBOL ? scalar : left;
+      right = operation.right == NO_SYMBOL ? scalar : right;
+      module.emit(Opcode::MOV, eax, left);
+      if (operation.op == '*') {
+        module.emit(Opcode::IMUL, eax, right);
+      } else if (operation.op) {
+        module.emit(operation.op == '+' ? Opcode::ADD : Opcode::SUB, eax,
+                    right);
+      }
+      module.emit(Opcode::MOV, destination, eax);
+    } else {
+      if (operation.op || operation.left != NO_SYMBOL) {
+        module.emit(Opcode::MOVDQA, value, left);
+      } else {
+        value = broadcast; // the value is stored as it is
+      }
+      if (operation.op == '*' && isa == Simd::SSE2) {
+        /*
+          SSE2 only multiplies the even lanes, into 64-bit products. The
+          odd lanes are moved down for a second multiplication and the
+          low halves of both are put back together.
+        */
+        module.emit(Opcode::MOVDQA, xmm(1), right);
+        module.emit(Opcode::PSHUFD, xmm(3), xmm(0), imm(0xF5));
+        module.emit(Opcode::PSHUFD, xmm(4), xmm(1), imm(0xF5));
+        module.emit(Opcode::PMULUDQ, xmm(0), xmm(1));
+        module.emit(Opcode::PMULUDQ, xmm(3), xmm(4));
+        module.emit(Opcode::PSHUFD, xmm(0), xmm(0), imm(0x08));
+        module.emit(Opcode::PSHUFD, xmm(3), xmm(3), imm(0x08));
+        module.emit(Opcode::PUNPCKLDQ, xmm(0), xmm(3));
+      } else if (operation.op) {
+        Opcode op = operation.op == '+'   ? Opcode::PADDD
+                    : operation.op == '-' ? Opcode::PSUBD
+                                          : Opcode::PMULLD;
+        if (isa == Simd::AVX2) {
+          module.emit(op, value, value, right);
+        } else {
+          module.emit(op, value, right);
+        }
+      }
+      module.emit(Opcode::MOVDQA, destination, value);
+    }
+
+    module.emit(Opcode::ADD, r10, imm(size));
+    module.emit(Opcode::CMP, r10, imm(loopBytes));
+    module.jump(Cond::B, loop);
+    if (isa == Simd::AVX2) {
+      // SSE code after dirty upper halves of ymm registers runs slowly
+      module.emit(Opcode::VZEROUPPER);
+    }
+  }
+
+  // the tail, addressed directly
+  for (uint64_t i = operation.length / lanes * lanes; i < operation.length;
+       i++) {
+    auto at = [&](uint32_t symbol) {
+      if (symbol == NO_SYMBOL) {
+        return scalar;
+      }
+      Operand address = mem(symbol, 4);
+      address.value = 4 * i;
+      return address;
+    };
+    module.emit(Opcode::MOV, eax, at(operation.left));
+    if (operation.op == '*') {
+      module.emit(Opcode::IMUL, eax, at(operation.right));
+    } else if (operation.op) {
+      module.emit(operation.op == '+' ? Opcode::ADD : Opcode::SUB, eax,
+                  at(operation.right));
+    }
+    module.emit(Opcode::MOV, at(operation.destination), eax);
+  }
 }
 
 bool Generator::isInitialized(std::string key) {
@@ -147,122 +1144,185 @@ void Generator::processDeclaration(
     std::shared_ptr<DeclarationNode> declarationNode) {
   /*
     The process declaration function is used to generate code for variable
-    declarations. If the product of the declaration node is an assignment
-    node, it will generate code for that assignment. (.data section) Else if
-    the product of the declaration node is an identifier node, it will
-    generate code for that identifier. (.bss section)
+    declarations. Their storage was already placed by the StorageLayout with
+    the width of their type, so only a declaration whose product is an
+    assignment of a variable or an expression generates code here: the
+    variable is assigned the value after computing it.
   */
   if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
           declarationNode->product)) {
     auto assignmentNode =
         std::get<std::shared_ptr<AssignmentNode>>(declarationNode->product);
-    if (auto constNode = std::dynamic_pointer_cast<ConstantNode>(
-            assignmentNode->assignment)) {
-      data_segment << "    " << assignmentNode->identifier->identifier.lexeme
-                   << " dd " << constNode->constant.lexeme << "\n";
-      initialized_variables[assignmentNode->identifier->identifier.lexeme] =
-          true;
-    } else if (auto expressionNode = std::dynamic_pointer_cast<ExpressionNode>(
-                   assignmentNode->assignment)) {
-      /*
-        if the declaration is an expression node, it will generate code for
-        that expression. first it will declare the variable with a value of 0
-        then it will assign the value of the expression to the variable after
-        perform the expression
-      */
-      data_segment << "    " << assignmentNode->identifier->identifier.lexeme
-                   << " dd 0" << "\n";
-      text_segment << processExpression(expressionNode).str() << "\n";
-      text_segment << "\t\t" << "mov ["
-                   << assignmentNode->identifier->identifier.lexeme << "], rax"
-                   << "\n";
-    }
-
-  } else if (std::holds_alternative<
-                 std::vector<std::shared_ptr<IdentifierNode>>>(
-                 declarationNode->product)) {
-    auto identNodes = std::get<std::vector<std::shared_ptr<IdentifierNode>>>(
-        declarationNode->product);
-    for (auto &id : identNodes) {
-      // indentifier nodes under declaration node indicates uninitialized
-      // variables these variables are declared in the bss segment
-      bss_segment << "    " << id->identifier.lexeme
-                  << " resd 1 ;  Reserve 4 bytes for int"
-                  << id->identifier.lexeme << std::endl;
-      uninitialized_variables[id->identifier.lexeme] = true;
-    }
-  }
-}
-
-std::string remove_literal_whitespace(std::string str) {
-  std::string result;
-  std::string::iterator it = str.begin();
-  while (it != str.end()) {
-    /* Checks if the current character is a letter */
-    if (!std::isalpha(*it)) {
-      result += '_';
-      ++it;
+    const std::string &name = assignmentNode->identifier->identifier.lexeme;
+    // a constant is already in the slot, unless the slot started out with
+    // the value of a variable before this one or the declaration is in a
+    // block that may run more than once
+    if (frame ||
+        !std::dynamic_pointer_cast<ConstantNode>(
+            assignmentNode->assignment) ||
+        !storage->layout->preloaded(name)) {
+      processAssignment(assignmentNode);
+    }
+  }
+}
+
+void Generator::emitLiteralPool() {
+  /*
+    Every distinct literal is stored once with its terminator. A literal that
+    is the tail of a longer one points into it instead of getting a copy:
+    sorted by their reversed bytes, a string is a suffix of its successor
+    whenever it is a suffix of any string at all. Labels are a hash of the
+    bytes, so they neither collide with each other nor depend on the order
+    the literals were met in.
+  */
+  std::vector<std::string> strings;
+  for (const auto &literal : literals) {
+    // freestanding strings end in the newline instead of a terminator, so
+    // one copy prints both
+    strings.push_back(literal + static_cast<char>(freestanding ? 10 : 0));
+  }
+
+  std::vector<size_t> order(strings.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return std::lexicographical_compare(strings[a].rbegin(), strings[a].rend(),
+                                        strings[b].rbegin(), strings[b].rend());
+  });
+
+  std::vector<size_t> host(strings.size());
+  for (size_t k = order.size(); k-- > 0;) {
+    size_t i = order[k];
+    host[i] = i;
+    if (k + 1 < order.size()) {
+      const std::string &next = strings[order[k + 1]];
+      if (next.size() >= strings[i].size() &&
+          next.compare(next.size() - strings[i].size(), strings[i].size(),
+                       strings[i]) == 0) {
+        host[i] = host[order[k + 1]];
+      }
+    }
+  }
+
+  // the pool keeps the order of first use
+  for (size_t i = 0; i < strings.size(); i++) {
+    if (host[i] != i) {
       continue;
     }
-    result += *it;
-    ++it;
+    uint64_t hash = 0xCBF29CE484222325; // FNV-1a
+    for (unsigned char byte : strings[i]) {
+      hash = (hash ^ byte) * 0x100000001B3;
+    }
+    static const char *hexDigits = "0123456789abcdef";
+    std::string name = "lit.";
+    for (int shift = 60; shift >= 0; shift -= 4) {
+      name += hexDigits[hash >> shift & 0xF];
+    }
+    uint32_t label = module.symbol(name);
+    for (int n = 1; module.isDefined(label); n++) {
+      label = module.symbol(name + "." + std::to_string(n));
+    }
+    uint8_t align = strings[i].size() >= LITERAL_ALIGN_LENGTH ? 16 : 1;
+    module.defineConstant(
+        label, std::vector<uint8_t>(strings[i].begin(), strings[i].end()),
+        align);
+    literal_pool[literals[i]].symbol = label;
+  }
+
+  for (size_t i = 0; i < strings.size(); i++) {
+    LiteralRef &ref = literal_pool[literals[i]];
+    ref.symbol = literal_pool[literals[host[i]]].symbol;
+    ref.offset = strings[host[i]].size() - strings[i].size();
   }
-  std::cout<<result<<std::endl;
-  return result;
 }
 
-std::ostringstream Generator::processCout(std::shared_ptr<CoutNode> coutNode) {
+Operand Generator::literalAddress(const std::string &literal) {
+  // workers refer to the pool assignStorage built by name
+  const LiteralRef &ref = storage->literal_pool.at(literal);
+  Operand address =
+      mem(module.symbol(storage->module.symbols[ref.symbol].name));
+  address.value = ref.offset;
+  return address;
+}
 
-  std::ostringstream output;
+void Generator::processCout(std::shared_ptr<CoutNode> coutNode) {
+
+  /*
+    Hosted programs print with printf, the format string goes in the first
+    argument register and the value in the second. Freestanding programs
+    pass values to the __mc_print_int and __mc_print_char runtime routines
+    in rdx. A char variable prints as a character, anything else as the
+    int or long it evaluates to.
+  */
+  Operand format = reg(target.argument(0));
+  Operand value = freestanding ? rdx : reg(target.argument(1));
+
+  auto print = [&](const char *fmt, const char *routine) {
+    if (freestanding) {
+      module.emit(Opcode::CALL, sym(module.symbol(routine)));
+      return;
+    }
+    module.emit(Opcode::LEA, format, mem(module.symbol(fmt)));
+    target.call(module, "printf", true);
+  };
 
   for (auto &expr : coutNode->operands) {
-    if (auto expressionNode = std::dynamic_pointer_cast<ExpressionNode>(expr)) {
-      output << processExpression(expressionNode).str() << "\n";
-      output << "\t\t" << "mov rcx, fmt_int" << "\n";
-      output << "\t\t" << "mov rdx, rax" << "\n";
-      output << "\t\t" << "call printf" << "\n";
-    } else if (auto identifierNode =
-                   std::dynamic_pointer_cast<IdentifierNode>(expr)) {
-      output << "\t\t" << "mov rcx, fmt_int" << "\n";
-      output << "\t\t" << "mov rdx, [" << identifierNode->identifier.lexeme
-             << "]" << "\n";
-      output << "\t\t" << "call printf" << "\n";
-    } else if (auto literalNode =
-                   std::dynamic_pointer_cast<StringLiteralNode>(expr)) {
-
-      // we add a string in the datasegment first
-      // then we refernce it when invoking lea rdx
-      data_segment << "    " << remove_literal_whitespace(literalNode->literal.lexeme) << " db \""
-                   << literalNode->literal.lexeme << "\", 0" << "\n";
-      output << "\t\t" << "mov rcx, fmt_literal" << "\n";
-      output << "\t\t" << "lea rdx, [" << remove_literal_whitespace(literalNode->literal.lexeme) << "]"
-             << "\n";
-      output << "\t\t" << "call printf" << "\n";
-    } else if (auto constantLiteral =
-                   std::dynamic_pointer_cast<ConstantNode>(expr)) {
-      output << "\t\t" << "mov rcx, fmt_int" << "\n";
-      output << "\t\t" << "mov rdx, " << constantLiteral->constant.lexeme
-             << "\n";
-      output << "\t\t" << "call printf" << "\n";
-    }
-  }
-
-  return output;
-}
-
-std::ostringstream Generator::processCin(std::shared_ptr<CinNode> cinNode) {
-
-  std::ostringstream output;
+    if (auto literalNode = std::dynamic_pointer_cast<StringLiteralNode>(expr)) {
 
-  for (auto &expr : cinNode->operands) {
+      // the string was pooled in .rodata by assignStorage
+      Operand address = literalAddress(literalNode->literal.lexeme);
+      if (freestanding) {
+        module.emit(Opcode::LEA, rsi, address);
+        module.emit(Opcode::MOV, edx,
+                    imm(literalNode->literal.lexeme.size() + 1));
+        module.emit(Opcode::CALL, sym(module.symbol("__mc_write")));
+        continue;
+      }
+      module.emit(Opcode::LEA, value, address);
+      print("fmt_literal", nullptr);
+      continue;
+    }
+
+    evaluate(expr, value);
     auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(expr);
-    output << "\t\t" << "lea rcx, [input_int]" << "\n";
-    output << "\t\t" << "lea rdx, [" << identifierNode->identifier.lexeme << "]"
-           << "\n";
-    output << "\t\t" << "call scanf" << "\n";
+    auto callNode = std::dynamic_pointer_cast<CallNode>(expr);
+    if ((identifierNode && width(identifierNode->identifier.lexeme) == 1) ||
+        (callNode && callee(callNode).width() == 1)) {
+      print("fmt_char", "__mc_print_char");
+    } else if (valueWidth(expr) == 8) {
+      print("fmt_long", "__mc_print_int");
+    } else {
+      print("fmt_int", "__mc_print_int");
+    }
   }
+}
 
-  return output;
+void Generator::processCin(std::shared_ptr<CinNode> cinNode) {
+  /*
+    Every operand is read by the buffered __mc_read_int runtime routine
+    instead of scanf. The routine only takes the address of the variable
+    and its width in edx, so there is no format string to parse on each
+    read. A char reads the next character that is not whitespace through
+    __mc_read_char instead.
+  */
+  for (auto &expr : cinNode->operands) {
+    if (auto indexNode = std::dynamic_pointer_cast<IndexNode>(expr)) {
+      module.emit(Opcode::LEA, rcx, element(indexNode));
+      module.emit(Opcode::MOV, edx, imm(4));
+      module.emit(Opcode::CALL, sym(module.symbol("__mc_read_int")));
+      continue;
+    }
+    auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(expr);
+    const std::string &name = identifierNode->identifier.lexeme;
+    module.emit(Opcode::LEA, rcx, variable(name));
+    if (width(name) == 1) {
+      module.emit(Opcode::CALL, sym(module.symbol("__mc_read_char")));
+      continue;
+    }
+    module.emit(Opcode::MOV, edx, imm(width(name)));
+    module.emit(Opcode::CALL, sym(module.symbol("__mc_read_int")));
+  }
 }
 
 void Generator::nodeGenerator(std::shared_ptr<node::Node> node) {
@@ -277,31 +1337,18 @@ void Generator::nodeGenerator(std::shared_ptr<node::Node> node) {
 
   } else if (auto assignNode =
                  std::dynamic_pointer_cast<AssignmentNode>(node)) {
-    // TODO: process assignment
-    if (auto constNode =
-            std::dynamic_pointer_cast<ConstantNode>(assignNode->assignment)) {
-      text_segment << "\t" << "mov dword ["
-                   << assignNode->identifier->identifier.lexeme << "], "
-                   << constNode->constant.lexeme << "\n";
-    } else if (auto expressionNode = std::dynamic_pointer_cast<ExpressionNode>(
-                   assignNode->assignment)) {
-      text_segment << processAssignment(assignNode).str() << "\n";
-      text_segment << "\t\t" << "mov ["
-                   << assignNode->identifier->identifier.lexeme << "], rax\n";
-    }
-
+    processAssignment(assignNode);
+  } else if (auto elementNode =
+                 std::dynamic_pointer_cast<ElementAssignmentNode>(node)) {
+    processElementAssignment(elementNode);
   } else if (auto cinNode = std::dynamic_pointer_cast<CinNode>(node)) {
-    // TODO: process cin
-    /**
-     *
-     * ; Call scanf to read an integer
-      lea rdi, [fmt]        ; Load the address of the format string
-      lea rsi, [x]         ; Load the address of the variable to store the
-     integer call scanf
-     */
-    text_segment << processCin(cinNode).str() << "\n";
+    processCin(cinNode);
   } else if (auto coutNode = std::dynamic_pointer_cast<CoutNode>(node)) {
-    text_segment << processCout(coutNode).str() << "\n";
+    processCout(coutNode);
+  } else if (auto callNode = std::dynamic_pointer_cast<CallNode>(node)) {
+    call(callNode); // the result is dropped
+  } else if (auto returnNode = std::dynamic_pointer_cast<ReturnNode>(node)) {
+    processReturn(returnNode);
   } else if (auto sequenceNode =
                  std::dynamic_pointer_cast<SequenceNode>(node)) {
     for (auto statement : sequenceNode->statements) {
@@ -309,3 +1356,436 @@ void Generator::nodeGenerator(std::shared_ptr<node::Node> node) {
     }
   }
 }
+
+void Generator::emitInputRuntime() {
+  // the read routines of cin share one input buffer and its refill routine
+  uint32_t buffer = module.symbol("__mc_in_buf");
+  module.reserve(buffer, 1, MC_INPUT_BUFFER);
+  module.reserve(module.symbol("__mc_in_pos"), 4, 1);
+  module.reserve(module.symbol("__mc_in_len"), 4, 1);
+  if (uses_read_int) {
+    emitReadIntRuntime();
+  }
+  if (uses_read_char) {
+    emitReadCharRuntime();
+  }
+
+  /*
+    Refills the input buffer, returns the number of bytes read (0 at EOF).
+    rsi and rdi hold the caller's buffer position and are not preserved by
+    the read syscall or the System V read, so they are saved here.
+  */
+  uint32_t fill = module.symbol("__mc_fill_input");
+  uint32_t filled = module.symbol("__mc_fill_input.filled");
+  module.label(fill);
+  module.emit(Opcode::PUSH, rsi);
+  module.emit(Opcode::PUSH, rdi);
+  module.emit(Opcode::SUB, rsp, imm(40));
+  if (freestanding) {
+    // pending output is flushed first so prompts show up before the program
+    // blocks on input
+    module.emit(Opcode::CALL, sym(module.symbol("__mc_flush")));
+    module.emit(Opcode::XOR, eax, eax); // read
+    module.emit(Opcode::XOR, edi, edi);
+    module.emit(Opcode::LEA, rsi, mem(buffer));
+    module.emit(Opcode::MOV, edx, imm(MC_INPUT_BUFFER));
+    module.emit(Opcode::SYSCALL);
+  } else {
+    module.emit(Opcode::XOR, reg(target.argument(0), 4),
+                reg(target.argument(0), 4));
+    module.emit(Opcode::LEA, reg(target.argument(1)), mem(buffer));
+    module.emit(Opcode::MOV, reg(target.argument(2), 4), imm(MC_INPUT_BUFFER));
+    target.call(module, target.readFunction());
+  }
+  module.emit(Opcode::TEST, eax, eax);
+  module.jump(Cond::G, filled);
+  module.emit(Opcode::XOR, eax, eax);
+  module.label(filled);
+  module.emit(Opcode::ADD, rsp, imm(40));
+  module.emit(Opcode::POP, rdi);
+  module.emit(Opcode::POP, rsi);
+  module.emit(Opcode::RET);
+}
+
+void Generator::emitReadIntRuntime() {
+  /*
+    Buffered integer input used by cin.
+
+    stdin is read in MC_INPUT_BUFFER sized blocks and integers are parsed by
+    hand. When eight bytes are left in the buffer they are checked and
+    converted at once (SWAR), otherwise one digit is handled at a time.
+
+    It behaves like scanf("%lld"): leading whitespace is skipped, an
+    optional sign is accepted, and on malformed input or end of file the
+    variable is left untouched and the offending character is not consumed,
+    so every following read fails as well. The value is truncated to the
+    width of the variable like a C++ conversion. eax is 1 on success and 0
+    on failure.
+
+    rbx = destination, esi = position, edi = length, r12 = buffer,
+    r13 = negative flag, r14 = value, r15 = width
+  */
+  uint32_t buffer = module.symbol("__mc_in_buf");
+  uint32_t position = module.symbol("__mc_in_pos");
+  uint32_t length = module.symbol("__mc_in_len");
+
+  auto local = [&](const char *name) {
+    return module.symbol(std::string("__mc_read_int.") + name);
+  };
+  uint32_t skip = local("skip"), skip_have = local("skip_have"),
+           skip_next = local("skip_next"), sign = local("sign"),
+           sign_next = local("sign_next"), sign_have = local("sign_have"),
+           first = local("first"), digits = local("digits"),
+           digit = local("digit"), digit_have = local("digit_have"),
+           store = local("store"), positive = local("positive"),
+           fail = local("fail"), done = local("done"), word = local("word"),
+           dword = local("dword"), stored = local("stored");
+
+  module.label(module.symbol("__mc_read_int"));
+  module.emit(Opcode::PUSH, rbx);
+  module.emit(Opcode::PUSH, rsi);
+  module.emit(Opcode::PUSH, rdi);
+  module.emit(Opcode::PUSH, r12);
+  module.emit(Opcode::PUSH, r13);
+  module.emit(Opcode::PUSH, r14);
+  module.emit(Opcode::PUSH, r15);
+  module.emit(Opcode::SUB, rsp, imm(32));
+  module.emit(Opcode::MOV, rbx, rcx);
+  module.emit(Opcode::MOV, r15d, edx);
+  module.emit(Opcode::MOV, esi, mem(position, 4));
+  module.emit(Opcode::MOV, edi, mem(length, 4));
+  module.emit(Opcode::LEA, r12, mem(buffer));
+  module.emit(Opcode::XOR, r13d, r13d);
+  module.emit(Opcode::XOR, r14d, r14d);
+
+  // skip leading whitespace
+  module.label(skip);
+  refillInput(skip_have, fail);
+  module.emit(Opcode::MOVZX, eax, mem(Reg::R12, Reg::RSI, 0, 1));
+  module.emit(Opcode::CMP, eax, imm(' '));
+  module.jump(Cond::E, skip_next);
+  module.emit(Opcode::LEA, ecx, mem(Reg::RAX, -9, 4));
+  module.emit(Opcode::CMP, ecx, imm(4));
+  module.jump(Cond::A, sign);
+  module.label(skip_next);
+  module.emit(Opcode::INC, esi);
+  module.emit(Opcode::JMP, sym(skip));
+
+  // optional sign
+  module.label(sign);
+  module.emit(Opcode::CMP, eax, imm('+'));
+  module.jump(Cond::E, sign_next);
+  module.emit(Opcode::CMP, eax, imm('-'));
+  module.jump(Cond::NE, first);
+  module.emit(Opcode::MOV, r13d, imm(1));
+  module.label(sign_next);
+  module.emit(Opcode::INC, esi);
+  refillInput(sign_have, fail);
+  module.emit(Opcode::MOVZX, eax, mem(Reg::R12, Reg::RSI, 0, 1));
+
+  // at least one digit is required
+  module.label(first);
+  module.emit(Opcode::SUB, eax, imm('0'));
+  module.emit(Opcode::CMP, eax, imm(9));
+  module.jump(Cond::A, fail);
+
+  // eight digits at once while the buffer has them
+  module.label(digits);
+  module.emit(Opcode::LEA, eax, mem(Reg::RSI, 8, 4));
+  module.emit(Opcode::CMP, eax, edi);
+  module.jump(Cond::A, digit);
+  module.emit(Opcode::MOV, rax, mem(Reg::R12, Reg::RSI, 0, 8));
+  module.emit(Opcode::MOV, rcx, imm(0x0606060606060606));
+  module.emit(Opcode::ADD, rcx, rax);
+  module.emit(Opcode::MOV, rdx, imm(static_cast<int64_t>(0xF0F0F0F0F0F0F0F0)));
+  module.emit(Opcode::AND, rcx, rdx);
+  module.emit(Opcode::SHR, rcx, imm(4));
+  module.emit(Opcode::AND, rdx, rax);
+  module.emit(Opcode::OR, rcx, rdx);
+  module.emit(Opcode::MOV, rdx, imm(0x3333333333333333));
+  module.emit(Opcode::CMP, rcx, rdx);
+  module.jump(Cond::NE, digit);
+  module.emit(Opcode::MOV, rdx, imm(0x0F0F0F0F0F0F0F0F));
+  module.emit(Opcode::AND, rax, rdx);
+  module.emit(Opcode::IMUL, rax, rax, imm(2561));
+  module.emit(Opcode::SHR, rax, imm(8));
+  module.emit(Opcode::MOV, rdx, imm(0x00FF00FF00FF00FF));
+  module.emit(Opcode::AND, rax, rdx);
+  module.emit(Opcode::IMUL, rax, rax, imm(6553601));
+  module.emit(Opcode::SHR, rax, imm(16));
+  module.emit(Opcode::MOV, rdx, imm(0x0000FFFF0000FFFF));
+  module.emit(Opcode::AND, rax, rdx);
+  module.emit(Opcode::MOV, rdx, imm(42949672960001));
+  module.emit(Opcode::IMUL, rax, rdx);
+  module.emit(Opcode::SHR, rax, imm(32));
+  module.emit(Opcode::IMUL, r14, r14, imm(100000000));
+  module.emit(Opcode::ADD, r14, rax);
+  module.emit(Opcode::ADD, esi, imm(8));
+  module.emit(Opcode::JMP, sym(digits));
+
+  // one digit at a time, refilling the buffer when it runs out
+  module.label(digit);
+  refillInput(digit_have, store);
+  module.emit(Opcode::MOVZX, eax, mem(Reg::R12, Reg::RSI, 0, 1));
+  module.emit(Opcode::SUB, eax, imm('0'));
+  module.emit(Opcode::CMP, eax, imm(9));
+  module.jump(Cond::A, store);
+  module.emit(Opcode::IMUL, r14, r14, imm(10));
+  module.emit(Opcode::ADD, r14, rax);
+  module.emit(Opcode::INC, esi);
+  module.emit(Opcode::JMP, sym(digits));
+
+  module.label(store);
+  module.emit(Opcode::MOV, rax, r14);
+  module.emit(Opcode::TEST, r13d, r13d);
+  module.jump(Cond::E, positive);
+  module.emit(Opcode::NEG, rax);
+  module.label(positive);
+  module.emit(Opcode::CMP, r15d, imm(4));
+  module.jump(Cond::B, word);
+  module.jump(Cond::E, dword);
+  module.emit(Opcode::MOV, mem(Reg::RBX, 0, 8), rax);
+  module.emit(Opcode::JMP, sym(stored));
+  module.label(word);
+  module.emit(Opcode::MOV, mem(Reg::RBX, 0, 2), ax);
+  module.emit(Opcode::JMP, sym(stored));
+  module.label(dword);
+  module.emit(Opcode::MOV, mem(Reg::RBX, 0, 4), eax);
+  module.label(stored);
+  module.emit(Opcode::MOV, eax, imm(1));
+  module.emit(Opcode::JMP, sym(done));
+  module.label(fail);
+  module.emit(Opcode::XOR, eax, eax);
+  module.label(done);
+  module.emit(Opcode::MOV, mem(position, 4), esi);
+  module.emit(Opcode::MOV, mem(length, 4), edi);
+  module.emit(Opcode::ADD, rsp, imm(32));
+  module.emit(Opcode::POP, r15);
+  module.emit(Opcode::POP, r14);
+  module.emit(Opcode::POP, r13);
+  module.emit(Opcode::POP, r12);
+  module.emit(Opcode::POP, rdi);
+  module.emit(Opcode::POP, rsi);
+  module.emit(Opcode::POP, rbx);
+  module.emit(Opcode::RET);
+}
+
+void Generator::refillInput(uint32_t have, uint32_t empty) {
+  // refills the buffer, continuing at `empty` when stdin is exhausted
+  module.emit(Opcode::CMP, esi, edi);
+  module.jump(Cond::B, have);
+  module.emit(Opcode::CALL, sym(module.symbol("__mc_fill_input")));
+  module.emit(Opcode::XOR, esi, esi);
+  module.emit(Opcode::MOV, edi, eax);
+  module.emit(Opcode::TEST, eax, eax);
+  module.jump(Cond::E, empty);
+  module.label(have);
+}
+
+void Generator::emitReadCharRuntime() {
+  /*
+    Reads a char like cin does: whitespace is skipped and the next byte is
+    stored. At end of file the variable is left untouched. eax is 1 on
+    success and 0 on failure.
+
+    rbx = destination, esi = position, edi = length, r12 = buffer
+  */
+  uint32_t position = module.symbol("__mc_in_pos");
+  uint32_t length = module.symbol("__mc_in_len");
+  auto local = [&](const char *name) {
+    return module.symbol(std::string("__mc_read_char.") + name);
+  };
+  uint32_t skip = local("skip"), skip_have = local("skip_have"),
+           skip_next = local("skip_next"), found = local("found"),
+           fail = local("fail"), done = local("done");
+
+  module.label(module.symbol("__mc_read_char"));
+  module.emit(Opcode::PUSH, rbx);
+  module.emit(Opcode::PUSH, rsi);
+  module.emit(Opcode::PUSH, rdi);
+  module.emit(Opcode::PUSH, r12);
+  module.emit(Opcode::SUB, rsp, imm(40));
+  module.emit(Opcode::MOV, rbx, rcx);
+  module.emit(Opcode::MOV, esi, mem(position, 4));
+  module.emit(Opcode::MOV, edi, mem(length, 4));
+  module.emit(Opcode::LEA, r12, mem(module.symbol("__mc_in_buf")));
+
+  module.label(skip);
+  refillInput(skip_have, fail);
+  module.emit(Opcode::MOVZX, eax, mem(Reg::R12, Reg::RSI, 0, 1));
+  module.emit(Opcode::CMP, eax, imm(' '));
+  module.jump(Cond::E, skip_next);
+  module.emit(Opcode::LEA, ecx, mem(Reg::RAX, -9, 4));
+  module.emit(Opcode::CMP, ecx, imm(4));
+  module.jump(Cond::A, found);
+  module.label(skip_next);
+  module.emit(Opcode::INC, esi);
+  module.emit(Opcode::JMP, sym(skip));
+
+  module.label(found);
+  module.emit(Opcode::MOV, mem(Reg::RBX, 0, 1), al);
+  module.emit(Opcode::INC, esi);
+  module.emit(Opcode::MOV, eax, imm(1));
+  module.emit(Opcode::JMP, sym(done));
+  module.label(fail);
+  module.emit(Opcode::XOR, eax, eax);
+  module.label(done);
+  module.emit(Opcode::MOV, mem(position, 4), esi);
+  module.emit(Opcode::MOV, mem(length, 4), edi);
+  module.emit(Opcode::ADD, rsp, imm(40));
+  module.emit(Opcode::POP, r12);
+  module.emit(Opcode::POP, rdi);
+  module.emit(Opcode::POP, rsi);
+  module.emit(Opcode::POP, rbx);
+  module.emit(Opcode::RET);
+}
+
+void Generator::emitOutputRuntime() {
+  /*
+    Output for freestanding programs. cout appends to a MC_OUTPUT_BUFFER
+    sized buffer which is written to stdout with the write syscall when it
+    fills up, before reading input and at exit.
+
+    __mc_write:      rsi = bytes, edx = length
+    __mc_print_int:  rdx = value, printed in decimal followed by a newline
+    __mc_print_char: dl = character, printed followed by a newline
+    __mc_flush:      writes out the buffer
+
+    All of them clobber rax, rcx, rdx, rsi, rdi, r8 to r11.
+  */
+  uint32_t buffer = module.symbol("__mc_out_buf");
+  uint32_t length = module.symbol("__mc_out_len");
+  uint32_t write = module.symbol("__mc_write");
+  uint32_t flush = module.symbol("__mc_flush");
+  uint32_t write_all = module.symbol("__mc_write_all");
+  module.reserve(buffer, 1, MC_OUTPUT_BUFFER);
+  module.reserve(length, 4, 1);
+
+  uint32_t convert = module.symbol("__mc_print_int.convert");
+  uint32_t digit = module.symbol("__mc_print_int.digit");
+  uint32_t emit = module.symbol("__mc_print_int.emit");
+  module.label(module.symbol("__mc_print_int"));
+  module.emit(Opcode::SUB, rsp, imm(24));
+  module.emit(Opcode::MOV, rax, rdx);
+  module.emit(Opcode::MOV, r8, rax);
+  module.emit(Opcode::LEA, rsi, mem(Reg::RSP, 24, 8));
+  module.emit(Opcode::DEC, rsi);
+  module.emit(Opcode::MOV, mem(Reg::RSI, 0, 1), imm(10));
+  module.emit(Opcode::TEST, rax, rax);
+  module.jump(Cond::NS, convert);
+  module.emit(Opcode::NEG, rax);
+  module.label(convert);
+  module.emit(Opcode::MOV, ecx, imm(10));
+  module.label(digit);
+  module.emit(Opcode::XOR, edx, edx);
+  module.emit(Opcode::DIV, rcx);
+  module.emit(Opcode::ADD, dl, imm('0'));
+  module.emit(Opcode::DEC, rsi);
+  module.emit(Opcode::MOV, mem(Reg::RSI, 0, 1), dl);
+  module.emit(Opcode::TEST, rax, rax);
+  module.jump(Cond::NE, digit);
+  module.emit(Opcode::TEST, r8, r8);
+  module.jump(Cond::NS, emit);
+  module.emit(Opcode::DEC, rsi);
+  module.emit(Opcode::MOV, mem(Reg::RSI, 0, 1), imm('-'));
+  module.label(emit);
+  module.emit(Opcode::LEA, rdx, mem(Reg::RSP, 24, 8));
+  module.emit(Opcode::SUB, rdx, rsi);
+  module.emit(Opcode::CALL, sym(write));
+  module.emit(Opcode::ADD, rsp, imm(24));
+  module.emit(Opcode::RET);
+
+  module.label(module.symbol("__mc_print_char"));
+  module.emit(Opcode::SUB, rsp, imm(24));
+  module.emit(Opcode::MOV, mem(Reg::RSP, 0, 1), dl);
+  module.emit(Opcode::MOV, mem(Reg::RSP, 1, 1), imm(10));
+  module.emit(Opcode::MOV, rsi, rsp);
+  module.emit(Opcode::MOV, edx, imm(2));
+  module.emit(Opcode::CALL, sym(write));
+  module.emit(Opcode::ADD, rsp, imm(24));
+  module.emit(Opcode::RET);
+
+  uint32_t copy = module.symbol("__mc_write.copy");
+  module.label(write);
+  module.emit(Opcode::MOV, eax, mem(length, 4));
+  module.emit(Opcode::LEA, ecx, mem(Reg::RAX, Reg::RDX, 0, 4));
+  module.emit(Opcode::CMP, ecx, imm(MC_OUTPUT_BUFFER));
+  module.jump(Cond::BE, copy);
+  module.emit(Opcode::PUSH, rsi);
+  module.emit(Opcode::PUSH, rdx);
+  module.emit(Opcode::CALL, sym(flush));
+  module.emit(Opcode::POP, rdx);
+  module.emit(Opcode::POP, rsi);
+  module.emit(Opcode::XOR, eax, eax);
+  module.emit(Opcode::CMP, edx, imm(MC_OUTPUT_BUFFER));
+  module.jump(Cond::BE, copy);
+  // larger than the whole buffer, write it out directly
+  module.emit(Opcode::JMP, sym(write_all));
+  module.label(copy);
+  module.emit(Opcode::LEA, rdi, mem(buffer));
+  module.emit(Opcode::ADD, rdi, rax);
+  module.emit(Opcode::ADD, eax, edx);
+  module.emit(Opcode::MOV, mem(length, 4), eax);
+  module.emit(Opcode::MOV, ecx, edx);
+  module.emit(Opcode::REP_MOVSB);
+  module.emit(Opcode::RET);
+
+  module.label(flush);
+  module.emit(Opcode::MOV, edx, mem(length, 4));
+  module.emit(Opcode::MOV, mem(length, 4), imm(0));
+  module.emit(Opcode::LEA, rsi, mem(buffer));
+
+  // writes rdx bytes from rsi to stdout, retrying after short writes
+  uint32_t written = module.symbol("__mc_write_all.done");
+  module.label(write_all);
+  module.emit(Opcode::TEST, rdx, rdx);
+  module.jump(Cond::E, written);
+  module.emit(Opcode::MOV, eax, imm(1)); // write
+  module.emit(Opcode::MOV, edi, imm(1));
+  module.emit(Opcode::SYSCALL);
+  module.emit(Opcode::TEST, rax, rax);
+  module.jump(Cond::LE, written);
+  module.emit(Opcode::ADD, rsi, rax);
+  module.emit(Opcode::SUB, rdx, rax);
+  module.emit(Opcode::JMP, sym(write_all));
+  module.label(written);
+  module.emit(Opcode::RET);
+}
+
+void Generator::emitDetectCpuRuntime() {
+  /*
+    Sets __mc_avx2 when the CPU has AVX2 and the OS saves the ymm
+    registers: cpuid leaf 1 reports OSXSAVE (ecx bit 27) and AVX (bit 28),
+    xgetbv that the xmm and ymm state is enabled (XCR0 bits 1 and 2) and
+    leaf 7 AVX2 (ebx bit 5). cpuid overwrites rbx, which is saved.
+  */
+  uint32_t avx2 = module.symbol("__mc_avx2");
+  uint32_t done = module.symbol("__mc_detect_cpu.done");
+  module.reserve(avx2, 1, 1);
+
+  module.label(module.symbol("__mc_detect_cpu"));
+  module.emit(Opcode::PUSH, rbx);
+  module.emit(Opcode::XOR, eax, eax);
+  module.emit(Opcode::CPUID);
+  module.emit(Opcode::CMP, eax, imm(7));
+  module.jump(Cond::B, done);
+  module.emit(Opcode::MOV, eax, imm(1));
+  module.emit(Opcode::CPUID);
+  module.emit(Opcode::AND, ecx, imm(0x18000000));
+  module.emit(Opcode::CMP, ecx, imm(0x18000000));
+  module.jump(Cond::NE, done);
+  module.emit(Opcode::XOR, ecx, ecx);
+  module.emit(Opcode::XGETBV);
+  module.emit(Opcode::AND, eax, imm(6));
+  module.emit(Opcode::CMP, eax, imm(6));
+  module.jump(Cond::NE, done);
+  module.emit(Opcode::MOV, eax, imm(7));
+  module.emit(Opcode::XOR, ecx, ecx);
+  module.emit(Opcode::CPUID);
+  module.emit(Opcode::TEST, ebx, imm(0x20));
+  module.jump(Cond::E, done);
+  module.emit(Opcode::MOV, mem(avx2, 1), imm(1));
+  module.label(done);
+  module.emit(Opcode::POP, rbx);
+  module.emit(Opcode::RET);
+}
@@ -1,40 +1,291 @@
 #ifndef GENERATOR_HPP
 #define GENERATOR_HPP
 
+#include "../assembler/Module.hpp"
 #include "../parser/Node.hpp"
 #include "../parser/Parser.hpp"
+#include "ControlFlowGraph.hpp"
+#include "Inliner.hpp"
+#include "StorageLayout.hpp"
+#include "Target.hpp"
 
 #include <optional>
-#include <sstream>
 #include <unordered_map>
 
 class Generator {
 public:
-  Generator(std::vector<std::shared_ptr<node::Node>> nodes);
+  /*
+    Instruction set of the loops whole-array assignments are lowered to.
+    AUTO emits SSE2 and AVX2 loops and picks one at run time from what the
+    CPU supports, SSE2 being part of every x86-64 CPU.
+  */
+  enum class Simd { SCALAR, SSE2, AVX2, AUTO };
 
-  std::string generate();
+  // jobs: threads lowering statements, 0 picks one per hardware thread
+  Generator(std::vector<std::shared_ptr<node::Node>> nodes,
+            const Target &target, bool freestanding = false,
+            unsigned jobs = 0, Simd simd = Simd::AUTO);
+
+  assembler::Module generate();
+
+  // memory taken by the program's variables, set by generate()
+  const StorageLayout::Report &storageReport() const {
+    return layout->report();
+  }
+
+  // loops found and optimized in the program and its functions, set by
+  // generate()
+  const ControlFlowGraph::Stats &loopReport() const { return loop_stats; }
+
+  // functions inlined and emitted, set by generate()
+  const Inliner::Stats &inlineReport() const { return inline_stats; }
 
 private:
+  // a worker lowering statements against the storage of `parent`
+  Generator(const Generator &parent);
+
   std::vector<std::shared_ptr<node::Node>> NODES;
   size_t generator_count = 0; // for incrementing the nodes / parse tree
 
   std::unordered_map<std::string, bool> initialized_variables;
   std::unordered_map<std::string, bool> uninitialized_variables;
 
-  std::ostringstream bss_segment;
-  std::ostringstream data_segment;
-  std::ostringstream text_segment;
+  // calling convention, exit and object format of the output
+  const Target &target;
+
+  // freestanding programs use raw Linux syscalls instead of the C runtime
+  bool freestanding;
+
+  // size of the block read from stdin by the cin runtime
+  static constexpr int MC_INPUT_BUFFER = 65536;
+  // size of the buffer cout collects output in when freestanding
+  static constexpr int MC_OUTPUT_BUFFER = 65536;
+  bool uses_read_int = false;
+  bool uses_read_char = false;
+
+  Simd simd;
+  // set when an array loop is chosen at run time by __mc_detect_cpu
+  bool uses_cpu_dispatch = false;
+
+  // arrays at least this long get an AVX2 loop next to the SSE2 one
+  static constexpr uint64_t DISPATCH_LENGTH = 8;
+
+  // names the labels of the statement being lowered
+  std::string site;
+
+  // the program being built: its sections and their symbols
+  assembler::Module module;
+
+  // the program's basic blocks in the order they are emitted
+  std::optional<ControlFlowGraph> cfg;
+
+  // where every variable lives, shared by the workers
+  std::optional<StorageLayout> layout;
+
+  ControlFlowGraph::Stats loop_stats;
+  Inliner::Stats inline_stats;
+
+  /*
+    The variables of a function live in its stack frame, addressed from
+    rbp. A leaf function, which calls nothing (no function, no cin or cout),
+    sets up no frame: its variables are addressed from rsp, below it in the
+    System V red zone or above the return address in the home area its
+    caller reserved on Windows, and rsp only moves when they do not fit.
+    Parameters past the argument registers stay where the caller put them.
+  */
+  struct Slot {
+    int32_t offset; // from the base register
+    uint8_t width;
+  };
+
+  struct Frame {
+    std::string name;   // symbol of the function, prefixing its labels
+    uint8_t result = 0; // width of the returned value, 0 for void
+    bool leaf = true;
+    assembler::Reg base = assembler::Reg::RBP;
+    uint32_t size = 0; // bytes subtracted from rsp on entry
+    int32_t spill_base = 0; // rbp offset the spill slots grow down from
+    std::unordered_map<std::string, Slot> slots;
+    std::vector<std::string> zeroed; // variables set to 0 on entry
+  };
+
+  struct Function {
+    std::shared_ptr<FunctionNode> node;
+    ControlFlowGraph cfg;
+    Frame frame;
+  };
+
+  // the functions still called after inlining, and all of them by name
+  std::vector<Function> functions;
+  std::unordered_map<std::string, std::shared_ptr<FunctionNode>> callees;
+
+  // the graph being lowered and, in a function, its frame
+  const ControlFlowGraph *graph = nullptr;
+  const Frame *frame = nullptr;
+
+  /*
+    Values that must survive a call wait in 8-byte spill slots below the
+    locals, `spilled` of them being in use. Together with the outgoing
+    arguments they are reserved by the prologue, so rsp stays aligned.
+  */
+  uint32_t spilled = 0;
+
+  assembler::Operand spill(uint32_t slot) const;
+
+  // the most spill slot bytes and the largest outgoing argument area,
+  // shadow space included, that lowering a node or a graph needs
+  struct CallArea {
+    uint32_t spills = 0;
+    uint32_t outgoing = 0;
+  };
+
+  CallArea callArea(std::shared_ptr<node::Node> node) const;
+
+  CallArea callArea(const ControlFlowGraph &cfg) const;
+
+  /*
+    String literals are interned into a pool in .rodata. A literal lives at
+    an offset into a pooled string, which is not 0 when it shares the tail of
+    a longer literal.
+  */
+  struct LiteralRef {
+    uint32_t symbol = assembler::NO_SYMBOL;
+    uint32_t offset = 0;
+  };
+  std::unordered_map<std::string, LiteralRef> literal_pool;
+  std::vector<std::string> literals; // distinct literals in order of use
+
+  // pooled strings at least this long start on a cache friendly boundary
+  static constexpr size_t LITERAL_ALIGN_LENGTH = 16;
+
+  /*
+    Statements are lowered in two phases. assignStorage walks the program
+    serially and defines every variable and literal in the data sections.
+    The statements of the laid out blocks, each block followed by its
+    branches, are then split into ranges that workers lower into their own
+    modules, which only hold text and refer to the storage and the blocks
+    by name. The ranges are merged back in order, so the result does not
+    depend on the number of threads.
+  */
+  unsigned jobs;
+  const Generator *storage = this;
+
+  // statements per range below which a range is not worth a thread
+  static constexpr size_t MIN_RANGE = 1024;
+
+  void assignStorage(std::shared_ptr<node::Node> node);
+
+  // the frame of a function whose graph is laid out
+  Frame buildFrame(const FunctionNode &function, const ControlFlowGraph &cfg);
+
+  // entry of the function of `frame`: its frame and parameters
+  void emitPrologue(const FunctionNode &function);
+
+  // lowers the statements of `graph`, in the frame of `frame`
+  void lowerStatements();
+
+  // statement `index` of the block at `position` in the layout, the index
+  // past its last statement being the branches that end the block
+  void lowerStatement(size_t position, size_t index);
+
+  uint32_t blockLabel(size_t block);
+
+  // prefix of the labels of the function being lowered
+  std::string labelPrefix() const;
+
+  // jumps to `target` when the condition holds, or when it does not
+  void branch(std::shared_ptr<ConditionNode> condition, bool negate,
+              uint32_t target);
+
+  void merge(const assembler::Module &fragment);
 
   std::optional<std::shared_ptr<node::Node>> peek();
 
   std::optional<std::shared_ptr<node::Node>> consume();
 
-  std::ostringstream
-  processExpression(std::shared_ptr<ExpressionNode> expressionNode,
-                    bool isIn = false);
+  // the memory a variable lives in: its slot in the data sections, or in
+  // the frame of the function being lowered
+  assembler::Operand variable(const std::string &name, uint8_t size = 0);
+
+  // size in bytes of the declared type of a variable
+  uint8_t width(const std::string &name);
+
+  int64_t constantValue(const TOKEN &constant);
+
+  // the function a call that was not inlined calls
+  const FunctionNode &callee(std::shared_ptr<CallNode> callNode);
+
+  /*
+    Values are computed in the type C++ gives them: char and short operands
+    are promoted to int, and an expression is long when one of its operands
+    is, a constant being long when it does not fit in an int. Returns 4 or 8.
+  */
+  uint8_t valueWidth(std::shared_ptr<node::Node> node);
+
+  // sign extends the variable to the 64-bit register `into`
+  void load(assembler::Operand into, const std::string &name);
+
+  // computes a constant, variable, call or expression into the 64-bit
+  // register `into`, sign extended from its type, with rcx as scratch
+  void evaluate(std::shared_ptr<node::Node> node,
+                assembler::Operand into = assembler::regs::rax);
+
+  // whether computing a value calls a function, which changes every
+  // register the generated code uses
+  bool hasCall(std::shared_ptr<node::Node> node) const;
+
+  // constants, variables and elements, which a call cannot change
+  static bool direct(std::shared_ptr<node::Node> node);
+
+  // whether the computed arguments of a call wait in spill slots
+  bool spilledArguments(std::shared_ptr<CallNode> callNode) const;
+
+  /*
+    Calls a function, leaving its result in rax sign extended from the
+    return type. The arguments are computed from left to right. Constants,
+    variables and elements go straight to their registers, anything else
+    is computed first. The arguments past the argument registers are
+    stored above the shadow space at rsp.
+  */
+  void call(std::shared_ptr<CallNode> callNode);
+
+  // returns from the function being lowered, with rax as the result
+  void processReturn(std::shared_ptr<ReturnNode> returnNode);
 
-  std::ostringstream
-  processAssignment(std::shared_ptr<AssignmentNode> assignmentNode);
+  // stores rax, truncated to the width of the variable
+  void store(const std::string &name);
+
+  // symbol of the 32-byte aligned storage of an array
+  uint32_t array(const std::string &name);
+
+  // the dword of an array element, a variable index is loaded into r10 and
+  // the address of the array into r11
+  assembler::Operand element(std::shared_ptr<IndexNode> indexNode);
+
+  void processAssignment(std::shared_ptr<AssignmentNode> assignmentNode);
+
+  void processElementAssignment(
+      std::shared_ptr<ElementAssignmentNode> elementNode);
+
+  /*
+    `c = left op right` on every element of an array. The operands are
+    arrays or NO_SYMBOL for the value in edx, which every element gets, and
+    op is '+', '-', '*' or 0 to copy left.
+  */
+  struct ArrayOperation {
+    uint64_t length;
+    uint32_t destination;
+    char op;
+    uint32_t left;
+    uint32_t right;
+  };
+
+  void processArrayAssignment(std::shared_ptr<AssignmentNode> assignmentNode);
+
+  // the loop over the elements with one instruction set, `name` naming its
+  // labels
+  void arrayLoop(const ArrayOperation &operation, Simd isa,
+                 const std::string &name);
 
   bool isInitialized(std::string key);
 
@@ -42,11 +293,29 @@ private:
 
   void processDeclaration(std::shared_ptr<DeclarationNode> declarationNode);
 
-  std::ostringstream processCout(std::shared_ptr<CoutNode> coutNode);
+  void emitLiteralPool();
+
+  assembler::Operand literalAddress(const std::string &literal);
 
-  std::ostringstream processCin(std::shared_ptr<CinNode> cinNode);
+  void processCout(std::shared_ptr<CoutNode> coutNode);
+
+  void processCin(std::shared_ptr<CinNode> cinNode);
 
   void nodeGenerator(std::shared_ptr<node::Node> node);
+
+  void emitInputRuntime();
+
+  void emitReadIntRuntime();
+
+  void emitReadCharRuntime();
+
+  // refills the input buffer when esi reached edi, continuing at `empty`
+  // when stdin is exhausted and at `have` otherwise
+  void refillInput(uint32_t have, uint32_t empty);
+
+  void emitOutputRuntime();
+
+  void emitDetectCpuRuntime();
 };
 
 #endif // !GENERATOR_HPP
@@ -0,0 +1,740 @@
+#include "Inliner.hpp"
+
+#include <stdexcept>
+
+namespace {
+
+using NodeList = std::vector<std::shared_ptr<node::Node>>;
+
+std::shared_ptr<IdentifierNode> identifier(const std::string &name) {
+  TOKEN token{TokenType::IDENTIFIER, name, 0};
+  return std::make_shared<IdentifierNode>(token, 0);
+}
+
+std::shared_ptr<ConstantNode> zero() {
+  TOKEN token{TokenType::CONSTANT, "0", 0};
+  return std::make_shared<ConstantNode>(token, 0);
+}
+
+/*
+  The storage layout tells declarations apart by the constant they start
+  out with, so every declaration the inliner makes gets a constant node of
+  its own, even when it copies the same argument or body twice.
+*/
+std::shared_ptr<node::Node> fresh(const std::shared_ptr<node::Node> &value) {
+  if (auto constantNode = std::dynamic_pointer_cast<ConstantNode>(value)) {
+    return std::make_shared<ConstantNode>(constantNode->constant,
+                                          constantNode->line);
+  }
+  return value;
+}
+
+std::shared_ptr<DeclarationNode>
+declaration(TokenType type, const std::string &name,
+            std::shared_ptr<node::Node> value) {
+  value = fresh(value);
+  return std::make_shared<DeclarationNode>(
+      type, std::make_shared<AssignmentNode>(identifier(name), value));
+}
+
+TokenType typeOf(uint8_t width) {
+  return width == 1   ? TokenType::CHAR_KEYWORD
+         : width == 2 ? TokenType::SHORT_KEYWORD
+         : width == 8 ? TokenType::LONG_KEYWORD
+                      : TokenType::INT_KEYWORD;
+}
+
+// names a copy gives its variables contain a dot, like the temporaries of
+// the control flow graph
+bool generated(const std::string &name) {
+  return name.find('.') != std::string::npos;
+}
+
+// estimated instructions of a value or statement
+size_t cost(const std::shared_ptr<node::Node> &node) {
+  if (!node) {
+    return 0;
+  }
+  if (auto expressionNode = std::dynamic_pointer_cast<ExpressionNode>(node)) {
+    return 1 + cost(expressionNode->left) + cost(expressionNode->right);
+  } else if (auto callNode = std::dynamic_pointer_cast<CallNode>(node)) {
+    size_t total = 3 + callNode->arguments.size();
+    for (auto &argument : callNode->arguments) {
+      total += cost(argument);
+    }
+    return total;
+  } else if (std::dynamic_pointer_cast<IndexNode>(node)) {
+    return 1;
+  } else if (auto sequenceNode =
+                 std::dynamic_pointer_cast<SequenceNode>(node)) {
+    size_t total = 0;
+    for (auto &statement : sequenceNode->statements) {
+      total += cost(statement);
+    }
+    return total;
+  } else if (auto declNode = std::dynamic_pointer_cast<DeclarationNode>(node)) {
+    if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+            declNode->product)) {
+      return cost(std::get<std::shared_ptr<AssignmentNode>>(declNode->product));
+    }
+    return 0;
+  } else if (auto assignNode =
+                 std::dynamic_pointer_cast<AssignmentNode>(node)) {
+    return 1 + cost(assignNode->assignment);
+  } else if (auto elementNode =
+                 std::dynamic_pointer_cast<ElementAssignmentNode>(node)) {
+    return 2 + cost(elementNode->assignment);
+  } else if (auto coutNode = std::dynamic_pointer_cast<CoutNode>(node)) {
+    size_t total = 0;
+    for (auto &operand : coutNode->operands) {
+      total += 3 + cost(operand);
+    }
+    return total;
+  } else if (auto cinNode = std::dynamic_pointer_cast<CinNode>(node)) {
+    return 3 * cinNode->operands.size();
+  } else if (auto conditionNode =
+                 std::dynamic_pointer_cast<ConditionNode>(node)) {
+    return 2 + cost(conditionNode->left) + cost(conditionNode->right);
+  } else if (auto ifNode = std::dynamic_pointer_cast<IfNode>(node)) {
+    return cost(ifNode->condition) + cost(ifNode->then) +
+           cost(ifNode->otherwise) + (ifNode->otherwise ? 1 : 0);
+  } else if (auto whileNode = std::dynamic_pointer_cast<WhileNode>(node)) {
+    return 2 * cost(whileNode->condition) + cost(whileNode->body);
+  } else if (auto returnNode = std::dynamic_pointer_cast<ReturnNode>(node)) {
+    return 1 + cost(returnNode->value);
+  }
+  return 0;
+}
+
+// calls `visit` on every node of a statement or value
+template <typename Visit>
+void walk(const std::shared_ptr<node::Node> &node, Visit &&visit) {
+  if (!node) {
+    return;
+  }
+  visit(node);
+  if (auto expressionNode = std::dynamic_pointer_cast<ExpressionNode>(node)) {
+    walk(expressionNode->left, visit);
+    walk(expressionNode->right, visit);
+  } else if (auto callNode = std::dynamic_pointer_cast<CallNode>(node)) {
+    for (auto &argument : callNode->arguments) {
+      walk(argument, visit);
+    }
+  } else if (auto sequenceNode =
+                 std::dynamic_pointer_cast<SequenceNode>(node)) {
+    for (auto &statement : sequenceNode->statements) {
+      walk(statement, visit);
+    }
+  } else if (auto declNode = std::dynamic_pointer_cast<DeclarationNode>(node)) {
+    if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+            declNode->product)) {
+      walk(std::get<std::shared_ptr<AssignmentNode>>(declNode->product),
+           visit);
+    }
+  } else if (auto assignNode =
+                 std::dynamic_pointer_cast<AssignmentNode>(node)) {
+    walk(assignNode->assignment, visit);
+  } else if (auto elementNode =
+                 std::dynamic_pointer_cast<ElementAssignmentNode>(node)) {
+    walk(elementNode->element, visit);
+    walk(elementNode->assignment, visit);
+  } else if (auto coutNode = std::dynamic_pointer_cast<CoutNode>(node)) {
+    for (auto &operand : coutNode->operands) {
+      walk(operand, visit);
+    }
+  } else if (auto cinNode = std::dynamic_pointer_cast<CinNode>(node)) {
+    for (auto &operand : cinNode->operands) {
+      walk(operand, visit);
+    }
+  } else if (auto conditionNode =
+                 std::dynamic_pointer_cast<ConditionNode>(node)) {
+    walk(conditionNode->left, visit);
+    walk(conditionNode->right, visit);
+  } else if (auto ifNode = std::dynamic_pointer_cast<IfNode>(node)) {
+    walk(ifNode->condition, visit);
+    walk(ifNode->then, visit);
+    walk(ifNode->otherwise, visit);
+  } else if (auto whileNode = std::dynamic_pointer_cast<WhileNode>(node)) {
+    walk(whileNode->condition, visit);
+    walk(whileNode->body, visit);
+  } else if (auto returnNode = std::dynamic_pointer_cast<ReturnNode>(node)) {
+    walk(returnNode->value, visit);
+  }
+}
+
+/*
+  The copy of a function body: every parameter and variable stands for a
+  node of the caller, a renamed variable or an argument.
+*/
+struct Copy {
+  std::unordered_map<std::string, std::shared_ptr<node::Node>> names;
+  // variables set to 0 at the start, their declarations become assignments
+  std::unordered_set<std::string> zeroed;
+
+  std::shared_ptr<node::Node> value(const std::shared_ptr<node::Node> &node) {
+    if (!node) {
+      return node;
+    }
+    if (auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(node)) {
+      return names.at(identifierNode->identifier.lexeme);
+    } else if (auto expressionNode =
+                   std::dynamic_pointer_cast<ExpressionNode>(node)) {
+      return std::make_shared<ExpressionNode>(expressionNode->OP,
+                                              value(expressionNode->left),
+                                              value(expressionNode->right));
+    } else if (auto callNode = std::dynamic_pointer_cast<CallNode>(node)) {
+      NodeList arguments;
+      for (auto &argument : callNode->arguments) {
+        arguments.push_back(value(argument));
+      }
+      return std::make_shared<CallNode>(callNode->identifier, arguments);
+    }
+    return fresh(node); // constants and string literals
+  }
+
+  // a variable that is assigned, which is never replaced by an argument
+  std::shared_ptr<IdentifierNode>
+  variable(const std::shared_ptr<IdentifierNode> &node) {
+    return std::dynamic_pointer_cast<IdentifierNode>(value(node));
+  }
+
+  std::shared_ptr<SequenceNode>
+  block(const std::shared_ptr<SequenceNode> &sequence) {
+    if (!sequence) {
+      return sequence;
+    }
+    auto copy = std::make_shared<SequenceNode>();
+    for (auto &statement : sequence->statements) {
+      if (auto copied = this->statement(statement)) {
+        copy->addStatement(copied);
+      }
+    }
+    return copy;
+  }
+
+  std::shared_ptr<ConditionNode>
+  condition(const std::shared_ptr<ConditionNode> &node) {
+    return std::make_shared<ConditionNode>(value(node->left), node->OP,
+                                           value(node->right), node->line);
+  }
+
+  // null for a declaration without a value, the variable already being 0
+  std::shared_ptr<node::Node>
+  statement(const std::shared_ptr<node::Node> &node) {
+    if (auto declNode = std::dynamic_pointer_cast<DeclarationNode>(node)) {
+      if (!std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+              declNode->product)) {
+        return nullptr;
+      }
+      auto assignment =
+          std::get<std::shared_ptr<AssignmentNode>>(declNode->product);
+      auto copied =
+          std::dynamic_pointer_cast<AssignmentNode>(statement(assignment));
+      if (zeroed.count(assignment->identifier->identifier.lexeme)) {
+        return copied;
+      }
+      return std::make_shared<DeclarationNode>(declNode->type, copied);
+    } else if (auto assignNode =
+                   std::dynamic_pointer_cast<AssignmentNode>(node)) {
+      return std::make_shared<AssignmentNode>(
+          variable(assignNode->identifier), value(assignNode->assignment));
+    } else if (auto sequenceNode =
+                   std::dynamic_pointer_cast<SequenceNode>(node)) {
+      return block(sequenceNode);
+    } else if (auto coutNode = std::dynamic_pointer_cast<CoutNode>(node)) {
+      NodeList operands;
+      for (auto &operand : coutNode->operands) {
+        operands.push_back(value(operand));
+      }
+      return std::make_shared<CoutNode>(operands);
+    } else if (auto cinNode = std::dynamic_pointer_cast<CinNode>(node)) {
+      NodeList operands;
+      for (auto &operand : cinNode->operands) {
+        operands.push_back(value(operand));
+      }
+      return std::make_shared<CinNode>(operands);
+    } else if (auto ifNode = std::dynamic_pointer_cast<IfNode>(node)) {
+      return std::make_shared<IfNode>(condition(ifNode->condition),
+                                      block(ifNode->then),
+                                      block(ifNode->otherwise));
+    } else if (auto whileNode = std::dynamic_pointer_cast<WhileNode>(node)) {
+      return std::make_shared<WhileNode>(condition(whileNode->condition),
+                                         block(whileNode->body));
+    } else if (std::dynamic_pointer_cast<CallNode>(node)) {
+      return value(node);
+    }
+    // returns, arrays and nested functions never get this far
+    throw std::runtime_error("Cannot copy a statement of an inlined function");
+  }
+};
+
+} // namespace
+
+Inliner::Inliner(const std::vector<std::shared_ptr<node::Node>> &nodes) {
+  std::vector<std::shared_ptr<FunctionNode>> order;
+  NodeList program;
+  for (auto &node : nodes) {
+    if (auto functionNode = std::dynamic_pointer_cast<FunctionNode>(node)) {
+      order.push_back(functionNode);
+      table[functionNode->identifier->identifier.lexeme].node = functionNode;
+    } else {
+      program.push_back(node);
+    }
+  }
+  summary.functions = order.size();
+  for (auto &function : order) {
+    count(function->body, false);
+  }
+  for (auto &node : program) {
+    count(node, true);
+  }
+
+  for (auto &function : order) {
+    widths.clear();
+    for (size_t i = 0; i < function->parameters.size(); i++) {
+      widths[function->parameter(i)] = function->parameters[i]->width();
+    }
+    Function &entry = table[function->identifier->identifier.lexeme];
+    entry.node = std::make_shared<FunctionNode>(
+        function->type, function->identifier, function->parameters,
+        block(function->body));
+    entry.inline_ = decide(*entry.node);
+  }
+
+  widths.clear();
+  statements = statementList(program);
+
+  // what is left of the calls decides which functions are emitted
+  std::unordered_set<std::string> called;
+  std::vector<std::string> pending;
+  auto calls = [&](const std::shared_ptr<node::Node> &node) {
+    walk(node, [&](const std::shared_ptr<node::Node> &n) {
+      if (auto callNode = std::dynamic_pointer_cast<CallNode>(n)) {
+        const std::string &name = callNode->identifier->identifier.lexeme;
+        if (called.insert(name).second) {
+          pending.push_back(name);
+        }
+      }
+    });
+  };
+  for (auto &node : statements) {
+    calls(node);
+  }
+  while (!pending.empty()) {
+    std::string name = pending.back();
+    pending.pop_back();
+    calls(table.at(name).node->body);
+  }
+  for (auto &function : order) {
+    if (called.count(function->identifier->identifier.lexeme)) {
+      emitted.push_back(table.at(function->identifier->identifier.lexeme).node);
+    }
+  }
+  summary.emitted = emitted.size();
+}
+
+void Inliner::count(const std::shared_ptr<node::Node> &node, bool program) {
+  walk(node, [&](const std::shared_ptr<node::Node> &n) {
+    if (auto callNode = std::dynamic_pointer_cast<CallNode>(n)) {
+      Function &callee = table[callNode->identifier->identifier.lexeme];
+      callee.callers++;
+      callee.called_by_program |= program;
+    }
+  });
+}
+
+bool Inliner::decide(const FunctionNode &function) const {
+  const std::string &name = function.identifier->identifier.lexeme;
+  const auto &body = function.body->statements;
+  size_t returns = 0;
+  bool recursive = false;
+  walk(function.body, [&](const std::shared_ptr<node::Node> &n) {
+    if (std::dynamic_pointer_cast<ReturnNode>(n)) {
+      returns++;
+    } else if (auto callNode = std::dynamic_pointer_cast<CallNode>(n)) {
+      recursive |= callNode->identifier->identifier.lexeme == name;
+    }
+  });
+  bool last =
+      !body.empty() && std::dynamic_pointer_cast<ReturnNode>(body.back());
+  if (recursive || returns > (last ? 1 : 0)) {
+    return false;
+  }
+
+  // moving the arguments in, the call, the frame and taking the result out
+  size_t overhead = 4 + function.parameters.size();
+  const Function &entry = table.at(name);
+  return cost(function.body) <= overhead + INLINE_BUDGET ||
+         (entry.callers == 1 && entry.called_by_program);
+}
+
+std::vector<std::shared_ptr<node::Node>>
+Inliner::statementList(const std::vector<std::shared_ptr<node::Node>> &list) {
+  NodeList out;
+  for (auto &node : list) {
+    statement(node, out);
+  }
+  return out;
+}
+
+std::shared_ptr<SequenceNode>
+Inliner::block(const std::shared_ptr<SequenceNode> &sequence) {
+  if (!sequence) {
+    return sequence;
+  }
+  auto result = std::make_shared<SequenceNode>();
+  result->statements = statementList(sequence->statements);
+  return result;
+}
+
+void Inliner::statement(const std::shared_ptr<node::Node> &node,
+                        std::vector<std::shared_ptr<node::Node>> &out) {
+  if (auto sequenceNode = std::dynamic_pointer_cast<SequenceNode>(node)) {
+    // blocks do not open scopes, so the statements can stand on their own
+    for (auto &statement : sequenceNode->statements) {
+      this->statement(statement, out);
+    }
+  } else if (auto declNode = std::dynamic_pointer_cast<DeclarationNode>(node)) {
+    if (!std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+            declNode->product)) {
+      for (auto &id : std::get<std::vector<std::shared_ptr<IdentifierNode>>>(
+               declNode->product)) {
+        widths[id->identifier.lexeme] = declNode->width();
+      }
+      out.push_back(node);
+      return;
+    }
+    auto assignmentNode =
+        std::get<std::shared_ptr<AssignmentNode>>(declNode->product);
+    const std::string &name = assignmentNode->identifier->identifier.lexeme;
+    if (!hasInlinedCall(assignmentNode->assignment)) {
+      widths[name] = declNode->width();
+      out.push_back(node);
+      return;
+    }
+    auto value = extract(assignmentNode->assignment, out, name,
+                         declNode->width(), true);
+    widths[name] = declNode->width();
+    if (value) {
+      out.push_back(std::make_shared<DeclarationNode>(
+          declNode->type,
+          std::make_shared<AssignmentNode>(assignmentNode->identifier, value)));
+    }
+  } else if (auto arrayNode =
+                 std::dynamic_pointer_cast<ArrayDeclarationNode>(node)) {
+    widths[arrayNode->identifier->identifier.lexeme] = 0; // never a target
+    out.push_back(node);
+  } else if (auto assignNode =
+                 std::dynamic_pointer_cast<AssignmentNode>(node)) {
+    if (!hasInlinedCall(assignNode->assignment)) {
+      out.push_back(node);
+      return;
+    }
+    const std::string &name = assignNode->identifier->identifier.lexeme;
+    auto value = extract(assignNode->assignment, out, name, widths.at(name));
+    if (value) {
+      out.push_back(
+          std::make_shared<AssignmentNode>(assignNode->identifier, value));
+    }
+  } else if (auto elementNode =
+                 std::dynamic_pointer_cast<ElementAssignmentNode>(node)) {
+    if (!hasInlinedCall(elementNode->assignment)) {
+      out.push_back(node);
+      return;
+    }
+    out.push_back(std::make_shared<ElementAssignmentNode>(
+        elementNode->element, extract(elementNode->assignment, out)));
+  } else if (auto coutNode = std::dynamic_pointer_cast<CoutNode>(node)) {
+    if (!hasInlinedCall(coutNode)) {
+      out.push_back(node);
+      return;
+    }
+    // what comes before a copy is printed before it runs
+    NodeList operands;
+    for (auto &operand : coutNode->operands) {
+      if (hasInlinedCall(operand)) {
+        if (!operands.empty()) {
+          out.push_back(std::make_shared<CoutNode>(operands));
+          operands.clear();
+        }
+        operands.push_back(extract(operand, out));
+      } else {
+        operands.push_back(operand);
+      }
+    }
+    out.push_back(std::make_shared<CoutNode>(operands));
+  } else if (auto ifNode = std::dynamic_pointer_cast<IfNode>(node)) {
+    // in source order, arguments of a call are not evaluated in any order
+    auto condition = ifNode->condition;
+    if (hasInlinedCall(condition)) {
+      auto left = extract(condition->left, out);
+      auto right = extract(condition->right, out);
+      condition = std::make_shared<ConditionNode>(left, condition->OP, right,
+                                                  condition->line);
+    }
+    auto then = block(ifNode->then);
+    auto otherwise = block(ifNode->otherwise);
+    out.push_back(std::make_shared<IfNode>(condition, then, otherwise));
+  } else if (auto whileNode = std::dynamic_pointer_cast<WhileNode>(node)) {
+    auto condition = whileNode->condition;
+    auto body = block(whileNode->body);
+    if (hasInlinedCall(condition)) {
+      /*
+        The condition is computed before the loop and again at the end of
+        the body, each side that changed going to a variable both copies
+        assign.
+      */
+      auto side = [&](const std::shared_ptr<node::Node> &operand) {
+        if (!hasInlinedCall(operand)) {
+          return operand;
+        }
+        std::string name = "cond." + std::to_string(copies++);
+        uint8_t size = width(operand);
+        auto value = extract(operand, out);
+        out.push_back(declaration(typeOf(size), name, value));
+        body->addStatement(std::make_shared<AssignmentNode>(
+            identifier(name), extract(operand, body->statements)));
+        widths[name] = size;
+        return std::shared_ptr<node::Node>(identifier(name));
+      };
+      auto left = side(condition->left);
+      auto right = side(condition->right);
+      condition = std::make_shared<ConditionNode>(left, condition->OP, right,
+                                                  condition->line);
+    }
+    out.push_back(std::make_shared<WhileNode>(condition, body));
+  } else if (auto callNode = std::dynamic_pointer_cast<CallNode>(node)) {
+    if (!hasInlinedCall(callNode)) {
+      out.push_back(node);
+      return;
+    }
+    NodeList arguments;
+    for (auto &argument : callNode->arguments) {
+      arguments.push_back(extract(argument, out));
+    }
+    auto call = std::make_shared<CallNode>(callNode->identifier, arguments);
+    if (table.at(call->identifier->identifier.lexeme).inline_) {
+      expand(call, out, "", false);
+    } else {
+      out.push_back(call);
+    }
+  } else if (auto returnNode = std::dynamic_pointer_cast<ReturnNode>(node)) {
+    if (!returnNode->value || !hasInlinedCall(returnNode->value)) {
+      out.push_back(node);
+      return;
+    }
+    out.push_back(std::make_shared<ReturnNode>(extract(returnNode->value, out),
+                                               returnNode->line));
+  } else {
+    out.push_back(node); // cin
+  }
+}
+
+bool Inliner::hasInlinedCall(const std::shared_ptr<node::Node> &node) const {
+  bool found = false;
+  walk(node, [&](const std::shared_ptr<node::Node> &n) {
+    if (auto callNode = std::dynamic_pointer_cast<CallNode>(n)) {
+      auto it = table.find(callNode->identifier->identifier.lexeme);
+      found |= it != table.end() && it->second.inline_;
+    }
+  });
+  return found;
+}
+
+std::shared_ptr<node::Node>
+Inliner::extract(const std::shared_ptr<node::Node> &value,
+                 std::vector<std::shared_ptr<node::Node>> &out,
+                 const std::string &target, uint8_t width, bool declare) {
+  if (auto expressionNode = std::dynamic_pointer_cast<ExpressionNode>(value)) {
+    auto left = extract(expressionNode->left, out);
+    auto right = extract(expressionNode->right, out);
+    if (left == expressionNode->left && right == expressionNode->right) {
+      return value;
+    }
+    return std::make_shared<ExpressionNode>(expressionNode->OP, left, right);
+  }
+  auto callNode = std::dynamic_pointer_cast<CallNode>(value);
+  if (!callNode) {
+    return value;
+  }
+
+  NodeList arguments;
+  for (auto &argument : callNode->arguments) {
+    arguments.push_back(extract(argument, out));
+  }
+  auto call = std::make_shared<CallNode>(callNode->identifier, arguments);
+  const std::string &name = call->identifier->identifier.lexeme;
+  const Function &callee = table.at(name);
+  uint8_t result = callee.node->width();
+
+  if (callee.inline_ && !target.empty() && width == result) {
+    // the copy assigns the target itself
+    expand(call, out, target, declare);
+    return nullptr;
+  }
+  if (!callee.inline_ && !target.empty()) {
+    return call; // the last call of the statement keeps its place
+  }
+
+  // the result goes to a variable, which keeps the calls in order
+  std::string temp = name + "." + std::to_string(copies++) + ".return";
+  if (callee.inline_) {
+    expand(call, out, temp, true);
+  } else {
+    out.push_back(declaration(callee.node->type, temp, call));
+  }
+  widths[temp] = result;
+  return identifier(temp);
+}
+
+void Inliner::expand(const std::shared_ptr<CallNode> &call,
+                     std::vector<std::shared_ptr<node::Node>> &out,
+                     const std::string &result, bool declare) {
+  const FunctionNode &function =
+      *table.at(call->identifier->identifier.lexeme).node;
+  std::string prefix = function.identifier->identifier.lexeme + "." +
+                       std::to_string(copies++) + ".";
+  summary.inlined++;
+  Copy copy;
+
+  // parameters the body assigns get a variable of their own
+  std::unordered_set<std::string> assigned;
+  walk(function.body, [&](const std::shared_ptr<node::Node> &n) {
+    if (auto assignNode = std::dynamic_pointer_cast<AssignmentNode>(n)) {
+      assigned.insert(assignNode->identifier->identifier.lexeme);
+    } else if (auto cinNode = std::dynamic_pointer_cast<CinNode>(n)) {
+      for (auto &operand : cinNode->operands) {
+        if (auto identifierNode =
+                std::dynamic_pointer_cast<IdentifierNode>(operand)) {
+          assigned.insert(identifierNode->identifier.lexeme);
+        }
+      }
+    }
+  });
+
+  for (size_t i = 0; i < function.parameters.size(); i++) {
+    const std::string &name = function.parameter(i);
+    uint8_t size = function.parameters[i]->width();
+    auto argument = call->arguments[i];
+    bool same = false;
+    if (auto identifierNode =
+            std::dynamic_pointer_cast<IdentifierNode>(argument)) {
+      auto it = widths.find(identifierNode->identifier.lexeme);
+      same = it != widths.end() && it->second == size;
+    } else if (auto constantNode =
+                   std::dynamic_pointer_cast<ConstantNode>(argument)) {
+      // the constant has to keep its value and type in place of the
+      // parameter, long constants are the ones that do not fit in an int;
+      // a char parameter prints as a character, which no constant does
+      try {
+        int64_t value = std::stoll(constantNode->constant.lexeme);
+        same = size == 8   ? value > INT32_MAX
+               : size == 4 ? value <= INT32_MAX
+                           : size == 2 && value <= INT16_MAX;
+      } catch (std::out_of_range &) {
+      }
+    }
+    if (same && !assigned.count(name)) {
+      copy.names[name] = argument;
+      continue;
+    }
+    copy.names[name] = identifier(prefix + name);
+    out.push_back(declaration(function.parameters[i]->type, prefix + name,
+                              argument));
+    widths[prefix + name] = size;
+  }
+
+  // the variables start out 0 like in a fresh frame, unless the body
+  // declares them with a value before anything else can read them
+  std::unordered_set<std::string> initialized;
+  for (auto &statement : function.body->statements) {
+    auto declNode = std::dynamic_pointer_cast<DeclarationNode>(statement);
+    if (declNode && std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+                        declNode->product)) {
+      initialized.insert(
+          std::get<std::shared_ptr<AssignmentNode>>(declNode->product)
+              ->identifier->identifier.lexeme);
+    }
+  }
+  walk(function.body, [&](const std::shared_ptr<node::Node> &n) {
+    auto declNode = std::dynamic_pointer_cast<DeclarationNode>(n);
+    if (!declNode) {
+      return;
+    }
+    std::vector<std::string> names;
+    if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+            declNode->product)) {
+      names.push_back(
+          std::get<std::shared_ptr<AssignmentNode>>(declNode->product)
+              ->identifier->identifier.lexeme);
+    } else {
+      for (auto &id : std::get<std::vector<std::shared_ptr<IdentifierNode>>>(
+               declNode->product)) {
+        names.push_back(id->identifier.lexeme);
+      }
+    }
+    for (const auto &name : names) {
+      copy.names[name] = identifier(prefix + name);
+      widths[prefix + name] = declNode->width();
+      if (!initialized.count(name) && !generated(name)) {
+        copy.zeroed.insert(name);
+        out.push_back(declaration(declNode->type, prefix + name, zero()));
+      }
+    }
+  });
+
+  const auto &body = function.body->statements;
+  std::shared_ptr<node::Node> value;
+  size_t end = body.size();
+  if (end && std::dynamic_pointer_cast<ReturnNode>(body.back())) {
+    value = std::dynamic_pointer_cast<ReturnNode>(body.back())->value;
+    end--;
+  }
+  for (size_t i = 0; i < end; i++) {
+    if (auto copied = copy.statement(body[i])) {
+      out.push_back(copied);
+    }
+  }
+
+  if (result.empty()) {
+    // a dropped value still makes the calls in it
+    bool calls = false;
+    walk(value, [&](const std::shared_ptr<node::Node> &n) {
+      calls |= static_cast<bool>(std::dynamic_pointer_cast<CallNode>(n));
+    });
+    if (calls) {
+      out.push_back(
+          declaration(function.type, prefix + "return", copy.value(value)));
+    }
+    return;
+  }
+  auto returned = value ? copy.value(value) : zero();
+  if (declare) {
+    out.push_back(declaration(function.type, result, returned));
+  } else {
+    out.push_back(std::make_shared<AssignmentNode>(identifier(result),
+                                                   returned));
+  }
+}
+
+uint8_t Inliner::width(const std::shared_ptr<node::Node> &value) const {
+  if (auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(value)) {
+    auto it = widths.find(identifierNode->identifier.lexeme);
+    return it != widths.end() && it->second == 8 ? 8 : 4;
+  } else if (auto constantNode =
+                 std::dynamic_pointer_cast<ConstantNode>(value)) {
+    try {
+      return std::stoll(constantNode->constant.lexeme) > INT32_MAX ? 8 : 4;
+    } catch (std::out_of_range &) {
+      return 8;
+    }
+  } else if (auto expressionNode =
+                 std::dynamic_pointer_cast<ExpressionNode>(value)) {
+    return std::max(width(expressionNode->left), width(expressionNode->right));
+  } else if (auto callNode = std::dynamic_pointer_cast<CallNode>(value)) {
+    return table.at(callNode->identifier->identifier.lexeme).node->width() == 8
+               ? 8
+               : 4;
+  }
+  return 4;
+}
@@ -0,0 +1,115 @@
+#ifndef INLINER_HPP
+#define INLINER_HPP
+
+#include "../parser/Node.hpp"
+#include "../parser/Parser.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/*
+  Replaces calls of small functions by a copy of their body before the
+  control flow graphs are built, so the loop optimizations and the storage
+  layout see through them. Functions are handled in definition order, the
+  ones they call having been inlined into them already.
+
+  A function is inlined when its body costs no more than the call would
+  plus INLINE_BUDGET, or when the program calls it from a single place. It
+  must not call itself and must have a single exit: its only return is the
+  last statement of the body. The copy declares the parameters as
+  variables set to the arguments, or uses an argument in place of a
+  parameter that is never assigned when it is a constant or variable of
+  the same type. The variables of the function start out 0 as in a fresh
+  frame and all of them get names no program variable can have.
+
+  The calls of a statement run from left to right. A statement with an
+  inlined call is split up: the calls before it run first, their results
+  kept in variables, then the copy, then the rest of the statement. The
+  calls in the condition of a loop are copied before the loop and again at
+  the end of its body.
+*/
+class Inliner {
+public:
+  // estimated instructions a body may add over the call it replaces
+  static constexpr size_t INLINE_BUDGET = 8;
+
+  struct Stats {
+    size_t functions = 0; // defined by the program
+    size_t inlined = 0;   // call sites replaced by a copy of the body
+    size_t emitted = 0;   // functions still called out of line
+  };
+
+  Inliner(const std::vector<std::shared_ptr<node::Node>> &nodes);
+
+  // the statements of the program, function definitions left out
+  const std::vector<std::shared_ptr<node::Node>> &program() const {
+    return statements;
+  }
+
+  // the functions that are still called, in definition order
+  const std::vector<std::shared_ptr<FunctionNode>> &functions() const {
+    return emitted;
+  }
+
+  const Stats &stats() const { return summary; }
+
+private:
+  struct Function {
+    std::shared_ptr<FunctionNode> node; // with the calls in it inlined
+    bool inline_ = false;
+    size_t callers = 0; // call sites in the program and other functions
+    bool called_by_program = false;
+  };
+
+  std::unordered_map<std::string, Function> table;
+  std::vector<std::shared_ptr<node::Node>> statements;
+  std::vector<std::shared_ptr<FunctionNode>> emitted;
+  Stats summary;
+
+  // copies made so far, numbering the names of their variables
+  size_t copies = 0;
+
+  // declared width of the variables in scope of the code being rewritten
+  std::unordered_map<std::string, uint8_t> widths;
+
+  void count(const std::shared_ptr<node::Node> &node, bool program);
+
+  bool decide(const FunctionNode &function) const;
+
+  // the statements with the calls in them inlined
+  std::vector<std::shared_ptr<node::Node>>
+  statementList(const std::vector<std::shared_ptr<node::Node>> &list);
+
+  std::shared_ptr<SequenceNode>
+  block(const std::shared_ptr<SequenceNode> &sequence);
+
+  void statement(const std::shared_ptr<node::Node> &node,
+                 std::vector<std::shared_ptr<node::Node>> &out);
+
+  bool hasInlinedCall(const std::shared_ptr<node::Node> &node) const;
+
+  /*
+    Moves the calls of a value out in front of the statement, into `out`,
+    and returns the value reading their results. `target` is the variable
+    of `width` bytes the whole value is assigned to, or declared with, or
+    empty. The copy of a call assigns it directly when the widths match,
+    and null is returned.
+  */
+  std::shared_ptr<node::Node>
+  extract(const std::shared_ptr<node::Node> &value,
+          std::vector<std::shared_ptr<node::Node>> &out,
+          const std::string &target = "", uint8_t width = 0,
+          bool declare = false);
+
+  // the copy of a call's body, its result in `result` unless that is empty
+  void expand(const std::shared_ptr<CallNode> &call,
+              std::vector<std::shared_ptr<node::Node>> &out,
+              const std::string &result, bool declare);
+
+  uint8_t width(const std::shared_ptr<node::Node> &value) const;
+};
+
+#endif // !INLINER_HPP
@@ -0,0 +1,359 @@
+#include "StorageLayout.hpp"
+
+#include <algorithm>
+#include <queue>
+#include <stdexcept>
+
+using assembler::SectionKind;
+
+namespace {
+
+uint64_t pairKey(size_t a, size_t b) {
+  if (a > b) {
+    std::swap(a, b);
+  }
+  return static_cast<uint64_t>(a) << 32 | b;
+}
+
+uint64_t lines(uint64_t bytes) {
+  return (bytes + StorageLayout::CACHE_LINE - 1) / StorageLayout::CACHE_LINE;
+}
+
+// statements touching many variables only pair each with its neighbours
+constexpr size_t AFFINITY_WINDOW = 8;
+
+} // namespace
+
+StorageLayout::StorageLayout(const ControlFlowGraph &cfg) : cfg(cfg) {
+  const auto &loops = cfg.loops();
+  for (size_t i = 0; i < loops.size(); i++) {
+    outermost.push_back(loops[i].parent == ControlFlowGraph::NONE
+                            ? i
+                            : outermost[loops[i].parent]);
+  }
+
+  // positions the outermost loops span, the condition of a block counting
+  // as a statement
+  spans.assign(loops.size(), {UINT64_MAX, 0});
+  uint64_t at = 0;
+  for (size_t id : cfg.order()) {
+    const auto &b = cfg.blocks()[id];
+    uint64_t size = b.statements.size() + (b.condition ? 1 : 0);
+    if (b.loop != ControlFlowGraph::NONE && size) {
+      auto &span = spans[outermost[b.loop]];
+      span.first = std::min(span.first, 2 * at);
+      span.second = std::max(span.second, 2 * (at + size) - 1);
+    }
+    at += size;
+  }
+
+  for (size_t id : cfg.order()) {
+    block = &cfg.blocks()[id];
+    for (auto node : block->statements) {
+      collect(node);
+    }
+    if (block->condition) {
+      statement.clear();
+      reads(block->condition->left);
+      reads(block->condition->right);
+      finish();
+    }
+  }
+  assignSlots();
+}
+
+const std::string &StorageLayout::slot(const std::string &name) const {
+  const Variable &var = variables.at(variable_index.at(name));
+  return placed.at(var.slot).name;
+}
+
+uint8_t StorageLayout::width(const std::string &name) const {
+  return variables.at(variable_index.at(name)).width;
+}
+
+bool StorageLayout::preloaded(const std::string &name) const {
+  const Variable &var = variables.at(variable_index.at(name));
+  return var.initializer && placed.at(var.slot).initializer == var.initializer;
+}
+
+size_t StorageLayout::variable(const std::string &name) {
+  auto it = variable_index.find(name);
+  if (it != variable_index.end()) {
+    return it->second;
+  }
+  variables.push_back({name});
+  variable_index.emplace(name, variables.size() - 1);
+  return variables.size() - 1;
+}
+
+void StorageLayout::access(const std::string &name, bool write) {
+  Variable &var = variables[variable(name)];
+  uint64_t at = 2 * position + (write ? 1 : 0);
+  if (!var.accessed) {
+    // a value read before any store is the one the program starts with, and
+    // so is the one a store that may not run leaves in place
+    var.accessed = true;
+    var.start = write && !block->conditional ? at : 0;
+  }
+  var.end = std::max(var.end, at);
+  if (block->loop != ControlFlowGraph::NONE) {
+    // the next iteration reads what this one left behind
+    const auto &span = spans[outermost[block->loop]];
+    var.start = std::min(var.start, span.first);
+    var.end = std::max(var.end, span.second);
+  }
+  var.accesses++;
+  statement.push_back(variable(name));
+}
+
+void StorageLayout::reads(std::shared_ptr<node::Node> node) {
+  if (auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(node)) {
+    if (!cfg.array(identifierNode->identifier.lexeme)) {
+      access(identifierNode->identifier.lexeme, false);
+    }
+  } else if (auto indexNode = std::dynamic_pointer_cast<IndexNode>(node)) {
+    reads(indexNode->index);
+  } else if (auto expressionNode =
+                 std::dynamic_pointer_cast<ExpressionNode>(node)) {
+    reads(expressionNode->left);
+    reads(expressionNode->right);
+  } else if (auto callNode = std::dynamic_pointer_cast<CallNode>(node)) {
+    for (auto &argument : callNode->arguments) {
+      reads(argument);
+    }
+  }
+}
+
+void StorageLayout::collect(std::shared_ptr<node::Node> node) {
+  statement.clear();
+  if (auto declNode = std::dynamic_pointer_cast<DeclarationNode>(node)) {
+    if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+            declNode->product)) {
+      auto assignmentNode =
+          std::get<std::shared_ptr<AssignmentNode>>(declNode->product);
+      const std::string &name = assignmentNode->identifier->identifier.lexeme;
+      variables[variable(name)].width = declNode->width();
+      auto constNode =
+          std::dynamic_pointer_cast<ConstantNode>(assignmentNode->assignment);
+      if (constNode && !block->conditional) {
+        variables[variable(name)].initializer = &constNode->constant;
+      } else if (!constNode) {
+        reads(assignmentNode->assignment);
+      }
+      variables[variable(name)].data = true;
+      access(name, true);
+    } else {
+      for (auto &id : std::get<std::vector<std::shared_ptr<IdentifierNode>>>(
+               declNode->product)) {
+        variables[variable(id->identifier.lexeme)].width = declNode->width();
+      }
+    }
+  } else if (auto assignNode =
+                 std::dynamic_pointer_cast<AssignmentNode>(node)) {
+    reads(assignNode->assignment);
+    if (!cfg.array(assignNode->identifier->identifier.lexeme)) {
+      access(assignNode->identifier->identifier.lexeme, true);
+    }
+  } else if (auto elementNode =
+                 std::dynamic_pointer_cast<ElementAssignmentNode>(node)) {
+    reads(elementNode->assignment);
+    reads(elementNode->element);
+  } else if (auto cinNode = std::dynamic_pointer_cast<CinNode>(node)) {
+    // a failed read leaves the old value in place
+    for (auto &expr : cinNode->operands) {
+      if (auto identifierNode =
+              std::dynamic_pointer_cast<IdentifierNode>(expr)) {
+        access(identifierNode->identifier.lexeme, false);
+        access(identifierNode->identifier.lexeme, true);
+      } else {
+        reads(expr);
+      }
+    }
+  } else if (auto coutNode = std::dynamic_pointer_cast<CoutNode>(node)) {
+    for (auto &expr : coutNode->operands) {
+      reads(expr);
+    }
+  } else if (std::dynamic_pointer_cast<CallNode>(node)) {
+    reads(node);
+  }
+  finish();
+}
+
+void StorageLayout::finish() {
+  // variables of one statement are wanted on the same cache line
+  std::sort(statement.begin(), statement.end());
+  statement.erase(std::unique(statement.begin(), statement.end()),
+                  statement.end());
+  for (size_t i = 0; i < statement.size(); i++) {
+    for (size_t j = i + 1;
+         j < std::min(statement.size(), i + 1 + AFFINITY_WINDOW); j++) {
+      affinity[pairKey(statement[i], statement[j])]++;
+    }
+  }
+  position++;
+}
+
+void StorageLayout::assignSlots() {
+  /*
+    Slot sharing is interval scheduling: variables are taken by the start of
+    their lifetime and reuse the slot that became free first, as long as the
+    widths match. The first variable of a slot decides its initial contents,
+    later ones that are declared with a constant store it when declared.
+  */
+  std::vector<size_t> order;
+  for (size_t i = 0; i < variables.size(); i++) {
+    summary.bytes_before += variables[i].width;
+    if (variables[i].accessed) {
+      order.push_back(i);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return variables[a].start < variables[b].start;
+  });
+
+  struct Owner {
+    size_t variable;
+    uint64_t heat = 0;
+  };
+  std::vector<Owner> owners;
+  using Free = std::pair<uint64_t, size_t>; // end of lifetime, slot
+  std::unordered_map<uint8_t,
+                     std::priority_queue<Free, std::vector<Free>,
+                                         std::greater<Free>>>
+      free;
+  for (size_t i : order) {
+    Variable &var = variables[i];
+    auto &candidates = free[var.width];
+    if (!candidates.empty() && candidates.top().first < var.start) {
+      var.slot = candidates.top().second;
+      candidates.pop();
+    } else {
+      var.slot = owners.size();
+      owners.push_back({i});
+    }
+    owners[var.slot].heat += var.accesses;
+    candidates.push({var.end, var.slot});
+  }
+
+  // co-access between slots
+  std::vector<std::vector<std::pair<size_t, uint32_t>>> neighbours(
+      owners.size());
+  {
+    std::unordered_map<uint64_t, uint32_t> weights;
+    for (const auto &[key, count] : affinity) {
+      size_t a = variables[key >> 32].slot;
+      size_t b = variables[key & 0xFFFFFFFF].slot;
+      if (a != b) {
+        weights[pairKey(a, b)] += count;
+      }
+    }
+    for (const auto &[key, count] : weights) {
+      neighbours[key >> 32].push_back({key & 0xFFFFFFFF, count});
+      neighbours[key & 0xFFFFFFFF].push_back({key >> 32, count});
+    }
+    // the hash map order must not leak into the layout
+    for (auto &list : neighbours) {
+      std::sort(list.begin(), list.end());
+    }
+  }
+
+  /*
+    Cache lines are filled greedily: a line is seeded with the hottest slot
+    left, then takes the slots sharing the most statements with what is on
+    it so far.
+  */
+  std::vector<size_t> hottest(owners.size());
+  for (size_t i = 0; i < hottest.size(); i++) {
+    hottest[i] = i;
+  }
+  std::stable_sort(hottest.begin(), hottest.end(), [&](size_t a, size_t b) {
+    return owners[a].heat > owners[b].heat;
+  });
+
+  std::vector<bool> done(owners.size(), false);
+  std::vector<size_t> sequence;
+  std::unordered_map<size_t, uint64_t> candidates;
+  size_t next_hot = 0;
+  uint64_t line_used = CACHE_LINE;
+  while (sequence.size() < owners.size()) {
+    size_t pick = owners.size();
+    uint64_t best = 0;
+    for (const auto &[slot, score] : candidates) {
+      if (pick == owners.size() || score > best ||
+          (score == best &&
+           (owners[slot].heat > owners[pick].heat ||
+            (owners[slot].heat == owners[pick].heat && slot < pick)))) {
+        pick = slot;
+        best = score;
+      }
+    }
+    if (pick == owners.size()) {
+      while (done[hottest[next_hot]]) {
+        next_hot++;
+      }
+      pick = hottest[next_hot];
+    }
+
+    uint8_t width = variables[owners[pick].variable].width;
+    line_used = (line_used + width - 1) / width * width;
+    if (line_used + width > CACHE_LINE) {
+      line_used = 0;
+      candidates.clear();
+    }
+    line_used += width;
+
+    done[pick] = true;
+    candidates.erase(pick);
+    sequence.push_back(pick);
+    for (const auto &[slot, count] : neighbours[pick]) {
+      if (!done[slot]) {
+        candidates[slot] += count;
+      }
+    }
+  }
+
+  // one .data block unless it gets big enough for zeros to cost file size
+  uint64_t block = 0;
+  for (size_t slot : sequence) {
+    uint8_t width = variables[owners[slot].variable].width;
+    block = (block + width - 1) / width * width + width;
+  }
+  bool split = block > BLOCK_LIMIT;
+
+  std::vector<size_t> slot_position(owners.size());
+  uint64_t sizes[2] = {0, 0};
+  bool first[2] = {true, true};
+  for (int pass = 0; pass < 2; pass++) {
+    for (size_t slot : sequence) {
+      const Variable &var = variables[owners[slot].variable];
+      bool bss = split && !var.initializer;
+      if (bss != (pass == 1)) {
+        continue;
+      }
+      uint8_t align = first[pass] ? CACHE_LINE : 1;
+      first[pass] = false;
+      slot_position[slot] = placed.size();
+      placed.push_back({var.name, var.width, var.initializer,
+                        bss ? SectionKind::BSS : SectionKind::DATA, align});
+      sizes[pass] = (sizes[pass] + var.width - 1) / var.width * var.width +
+                    var.width;
+    }
+  }
+  for (auto &var : variables) {
+    if (var.accessed) {
+      var.slot = slot_position[var.slot];
+    }
+  }
+
+  // before: every declared variable in .data or .bss in declaration order
+  uint64_t data_before = 0;
+  uint64_t bss_before = 0;
+  for (const auto &var : variables) {
+    (var.data ? data_before : bss_before) += var.width;
+  }
+  summary.variables = variables.size();
+  summary.slots = placed.size();
+  summary.bytes_after = sizes[0] + sizes[1];
+  summary.lines_before = lines(data_before) + lines(bss_before);
+  summary.lines_after = lines(sizes[0]) + lines(sizes[1]);
+}
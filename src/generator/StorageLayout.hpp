@@ -0,0 +1,113 @@
+#ifndef STORAGE_LAYOUT_HPP
+#define STORAGE_LAYOUT_HPP
+
+#include "../assembler/Module.hpp"
+#include "../parser/Node.hpp"
+#include "../parser/Parser.hpp"
+#include "ControlFlowGraph.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+  Places the program's variables before any code is generated. A variable
+  is live from its first store, or from the start of the program when it
+  may be read before one, up to its last access. Statements are walked in
+  the order of the laid out blocks, a store in a block that may not run
+  does not start a lifetime, and a variable accessed in a loop lives for
+  the whole loop. Variables whose lifetimes do not overlap share a slot,
+  and slots accessed by the same statements are packed onto the same cache
+  lines, the most used ones first. Arrays get storage of their own.
+*/
+class StorageLayout {
+public:
+  static constexpr size_t CACHE_LINE = 64;
+
+  // above this many bytes zero slots go to .bss instead of the .data block
+  static constexpr size_t BLOCK_LIMIT = 4096;
+
+  struct Slot {
+    std::string name; // symbol of the slot, its first variable
+    uint8_t width;
+    const TOKEN *initializer; // constant the slot starts out with, or none
+    assembler::SectionKind section;
+    uint8_t align;
+  };
+
+  struct Report {
+    size_t variables = 0;
+    size_t slots = 0;
+    uint64_t bytes_before = 0;
+    uint64_t bytes_after = 0;
+    uint64_t lines_before = 0;
+    uint64_t lines_after = 0;
+  };
+
+  // the blocks of `cfg` have to be laid out
+  StorageLayout(const ControlFlowGraph &cfg);
+
+  // slots in address order
+  const std::vector<Slot> &slots() const { return placed; }
+
+  // symbol of the slot holding `variable`
+  const std::string &slot(const std::string &variable) const;
+
+  // size in bytes of the declared type of `variable`
+  uint8_t width(const std::string &variable) const;
+
+  // whether the slot already starts out with the constant `variable` is
+  // declared with, so the declaration needs no store
+  bool preloaded(const std::string &variable) const;
+
+  const Report &report() const { return summary; }
+
+private:
+  struct Variable {
+    std::string name;
+    uint8_t width = 4;
+    const TOKEN *initializer = nullptr;
+    bool data = false; // declared with a value, so it used to live in .data
+    bool accessed = false;
+    uint64_t start = 0; // first and last position the value is live at
+    uint64_t end = 0;
+    uint64_t accesses = 0;
+    size_t slot = 0;
+  };
+
+  std::vector<Variable> variables;
+  std::unordered_map<std::string, size_t> variable_index;
+
+  // statement being walked, reads happen at 2 * position, writes after them
+  uint64_t position = 0;
+  std::vector<size_t> statement; // variables the statement accesses
+
+  const ControlFlowGraph &cfg;
+
+  // the block being walked
+  const ControlFlowGraph::Block *block = nullptr;
+  std::vector<size_t> outermost; // outermost loop of every loop
+  std::vector<std::pair<uint64_t, uint64_t>> spans; // of outermost loops
+
+  // co-access counts of variable pairs, keyed by both indices
+  std::unordered_map<uint64_t, uint32_t> affinity;
+
+  std::vector<Slot> placed;
+  Report summary;
+
+  size_t variable(const std::string &name);
+
+  void access(const std::string &name, bool write);
+
+  void reads(std::shared_ptr<node::Node> node);
+
+  void collect(std::shared_ptr<node::Node> node);
+
+  // co-access of the variables of one statement, then the next position
+  void finish();
+
+  void assignSlots();
+};
+
+#endif // !STORAGE_LAYOUT_HPP
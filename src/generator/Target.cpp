@@ -0,0 +1,144 @@
+#include "Target.hpp"
+#include "../assembler/ObjectWriter.hpp"
+
+#include <stdexcept>
+
+using namespace assembler;
+using namespace assembler::regs;
+
+std::unique_ptr<Target> Target::create(const std::string &name) {
+  if (name == "win64") {
+    return std::make_unique<Win64Target>();
+  }
+  if (name == "linux") {
+    return std::make_unique<SysVTarget>();
+  }
+  throw std::runtime_error("Unknown target: " + name);
+}
+
+std::string Target::host() {
+#ifdef _WIN32
+  return "win64";
+#else
+  return "linux";
+#endif
+}
+
+std::string Win64Target::name() const { return "win64"; }
+
+Reg Win64Target::argument(size_t index) const {
+  static const Reg registers[] = {Reg::RCX, Reg::RDX, Reg::R8, Reg::R9};
+  return registers[index];
+}
+
+size_t Win64Target::argumentCount() const { return 4; }
+
+uint32_t Win64Target::shadowSpace() const { return 32; }
+
+uint32_t Win64Target::redZone() const { return 0; }
+
+void Win64Target::call(Module &module, const std::string &function,
+                       bool) const {
+  // variadic callees find integer arguments in the same registers
+  module.emit(Opcode::CALL, sym(module.symbol(function)));
+}
+
+std::string Win64Target::readFunction() const { return "_read"; }
+
+void Win64Target::exit(Module &module, bool) const {
+  module.emit(Opcode::MOV, rcx, imm(1));
+  module.emit(Opcode::XOR, rcx, rcx);
+  call(module, "ExitProcess", false);
+}
+
+bool Win64Target::supportsFreestanding() const { return false; }
+
+std::vector<uint8_t> Win64Target::object(const Module &module,
+                                         const ObjectCode &code,
+                                         const std::string &source) const {
+  return ObjectWriter(module, code, source).coff();
+}
+
+std::string Win64Target::readOnlySection() const { return ".rdata"; }
+
+std::vector<std::string> Win64Target::link(const std::string &object,
+                                           std::string exename, bool) const {
+  size_t dotPos = exename.rfind('.');
+  if (dotPos != std::string::npos && dotPos != 0) {
+    exename = exename.substr(0, dotPos) + ".exe";
+  }
+  return {"gcc", "-o", exename, object};
+}
+
+std::string SysVTarget::name() const { return "linux"; }
+
+Reg SysVTarget::argument(size_t index) const {
+  static const Reg registers[] = {Reg::RDI, Reg::RSI, Reg::RDX,
+                                  Reg::RCX, Reg::R8,  Reg::R9};
+  return registers[index];
+}
+
+size_t SysVTarget::argumentCount() const { return 6; }
+
+uint32_t SysVTarget::shadowSpace() const { return 0; }
+
+uint32_t SysVTarget::redZone() const { return 128; }
+
+void SysVTarget::call(Module &module, const std::string &function,
+                      bool varargs) const {
+  // al holds the number of vector registers used by a variadic call
+  if (varargs) {
+    module.emit(Opcode::XOR, eax, eax);
+  }
+  module.emit(Opcode::CALL, sym(module.symbol(function)));
+}
+
+std::string SysVTarget::readFunction() const { return "read"; }
+
+void SysVTarget::exit(Module &module, bool freestanding) const {
+  if (freestanding) {
+    module.emit(Opcode::CALL, sym(module.symbol("__mc_flush")));
+    module.emit(Opcode::XOR, edi, edi);
+    module.emit(Opcode::MOV, eax, imm(231)); // exit_group
+    module.emit(Opcode::SYSCALL);
+    return;
+  }
+  // exit rather than returning, so stdio buffers are flushed
+  module.emit(Opcode::XOR, edi, edi);
+  call(module, "exit", false);
+}
+
+bool SysVTarget::supportsFreestanding() const { return true; }
+
+std::vector<uint8_t> SysVTarget::object(const Module &module,
+                                        const ObjectCode &code,
+                                        const std::string &source) const {
+  return ObjectWriter(module, code, source).elf64();
+}
+
+std::string SysVTarget::readOnlySection() const { return ".rodata"; }
+
+std::vector<std::string> SysVTarget::link(const std::string &object,
+                                          std::string exename,
+                                          bool freestanding) const {
+  if (freestanding) {
+    // nothing to link against, ld only has to lay out the static image
+    return {"ld", "-static", "-o", exename, object};
+  }
+  return {"gcc", "-o", exename, object};
+}
+
+std::string JitTarget::name() const { return "jit"; }
+
+void JitTarget::exit(Module &module, bool) const {
+  module.emit(Opcode::MOV, rsp, rbp);
+  module.emit(Opcode::POP, rbp);
+  module.emit(Opcode::RET);
+}
+
+bool JitTarget::supportsFreestanding() const { return false; }
+
+std::vector<std::string> JitTarget::link(const std::string &, std::string,
+                                         bool) const {
+  throw std::runtime_error("Programs run with --run are not linked");
+}
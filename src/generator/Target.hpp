@@ -0,0 +1,126 @@
+#ifndef TARGET_HPP
+#define TARGET_HPP
+
+#include "../assembler/Encoder.hpp"
+#include "../assembler/Module.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+  The platform the generated program runs on: how the C library is called,
+  how the program exits, which object format it is written in and how it is
+  linked. The Generator only emits calls through the target.
+*/
+class Target {
+public:
+  virtual ~Target() = default;
+
+  // "win64" or "linux", throws for anything else
+  static std::unique_ptr<Target> create(const std::string &name);
+
+  // the target of the machine the compiler runs on
+  static std::string host();
+
+  virtual std::string name() const = 0;
+
+  // integer argument registers of C library calls, in order
+  virtual assembler::Reg argument(size_t index) const = 0;
+
+  // how many arguments are passed in registers, the rest go on the stack
+  virtual size_t argumentCount() const = 0;
+
+  // bytes a caller reserves above the stack arguments for the callee to
+  // spill its register arguments to
+  virtual uint32_t shadowSpace() const = 0;
+
+  // bytes below rsp a function may use without moving rsp
+  virtual uint32_t redZone() const = 0;
+
+  // calls a C library function whose arguments are already in place
+  virtual void call(assembler::Module &module, const std::string &function,
+                    bool varargs = false) const = 0;
+
+  // the C library's read(fd, buffer, count)
+  virtual std::string readFunction() const = 0;
+
+  // ends the program with status 0
+  virtual void exit(assembler::Module &module, bool freestanding) const = 0;
+
+  // whether programs can be built without the C runtime (-ffreestanding)
+  virtual bool supportsFreestanding() const = 0;
+
+  // source: the program's file name, recorded in the object
+  virtual std::vector<uint8_t>
+  object(const assembler::Module &module, const assembler::ObjectCode &code,
+         const std::string &source) const = 0;
+
+  // name of the read-only data section in -S output
+  virtual std::string readOnlySection() const = 0;
+
+  // linker command line turning the object into an executable
+  virtual std::vector<std::string> link(const std::string &object,
+                                        std::string exename,
+                                        bool freestanding) const = 0;
+};
+
+// Windows x64: rcx, rdx, r8, r9, COFF objects
+class Win64Target : public Target {
+public:
+  std::string name() const override;
+  assembler::Reg argument(size_t index) const override;
+  size_t argumentCount() const override;
+  uint32_t shadowSpace() const override;
+  uint32_t redZone() const override;
+  void call(assembler::Module &module, const std::string &function,
+            bool varargs) const override;
+  std::string readFunction() const override;
+  void exit(assembler::Module &module, bool freestanding) const override;
+  bool supportsFreestanding() const override;
+  std::vector<uint8_t> object(const assembler::Module &module,
+                              const assembler::ObjectCode &code,
+                              const std::string &source) const override;
+  std::string readOnlySection() const override;
+  std::vector<std::string> link(const std::string &object,
+                                std::string exename,
+                                bool freestanding) const override;
+};
+
+// Linux System V x86-64: rdi, rsi, rdx, rcx, r8, r9, ELF64 objects
+class SysVTarget : public Target {
+public:
+  std::string name() const override;
+  assembler::Reg argument(size_t index) const override;
+  size_t argumentCount() const override;
+  uint32_t shadowSpace() const override;
+  uint32_t redZone() const override;
+  void call(assembler::Module &module, const std::string &function,
+            bool varargs) const override;
+  std::string readFunction() const override;
+  void exit(assembler::Module &module, bool freestanding) const override;
+  bool supportsFreestanding() const override;
+  std::vector<uint8_t> object(const assembler::Module &module,
+                              const assembler::ObjectCode &code,
+                              const std::string &source) const override;
+  std::string readOnlySection() const override;
+  std::vector<std::string> link(const std::string &object,
+                                std::string exename,
+                                bool freestanding) const override;
+};
+
+/*
+  System V code run inside the compiler by --run: main returns to the caller
+  instead of exiting the process, and nothing is written out or linked.
+*/
+class JitTarget : public SysVTarget {
+public:
+  std::string name() const override;
+  void exit(assembler::Module &module, bool freestanding) const override;
+  bool supportsFreestanding() const override;
+  std::vector<std::string> link(const std::string &object,
+                                std::string exename,
+                                bool freestanding) const override;
+};
+
+#endif // !TARGET_HPP
@@ -0,0 +1,166 @@
+#include "Jit.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace assembler;
+
+namespace {
+
+// jmp [rip + 0] followed by the absolute address of the host function
+constexpr size_t STUB_SIZE = 14;
+
+size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+#ifdef _WIN32
+
+Jit::Jit(const Module &module, const ObjectCode &) : module(module) {
+  throw std::runtime_error("--run is only supported on Linux and macOS");
+}
+
+Jit::~Jit() {}
+
+void Jit::run(const std::string &) {}
+
+void *Jit::hostFunction(const std::string &) { return nullptr; }
+
+uint8_t *Jit::address(uint32_t) { return nullptr; }
+
+#else
+
+Jit::Jit(const Module &module, const ObjectCode &code) : module(module) {
+  /*
+    One mapping holds, page aligned: the text section followed by a stub for
+    every external function (read + execute), read-only data (read), then
+    data and bss (read + write). Everything is within 2GB, so the rel32
+    fields of the encoded text reach their targets.
+  */
+  std::vector<uint32_t> externals;
+  for (uint32_t id = 0; id < module.symbols.size(); id++) {
+    if (module.symbols[id].section == SectionKind::NONE) {
+      externals.push_back(id);
+    }
+  }
+
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t text_size =
+      alignUp(code.text.size() + externals.size() * STUB_SIZE, page);
+  size_t rodata_size = alignUp(code.rodata.size(), page);
+  size_t bss_offset = alignUp(code.data.size(), code.bss_align);
+  size_t data_size = alignUp(bss_offset + code.bss_size, page);
+  size = text_size + rodata_size + data_size;
+
+  void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("Could not map memory for the program");
+  }
+  memory = static_cast<uint8_t *>(mapping);
+  // the destructor does not run when the constructor throws
+  try {
+    text = memory;
+    stubs = text + code.text.size();
+    rodata = memory + text_size;
+    data = rodata + rodata_size;
+    bss = data + bss_offset;
+
+    std::memcpy(text, code.text.data(), code.text.size());
+    std::memcpy(rodata, code.rodata.data(), code.rodata.size());
+    std::memcpy(data, code.data.data(), code.data.size());
+
+    // the mapping is zero filled, so bss needs no clearing
+    std::vector<uint8_t *> stub_of(module.symbols.size(), nullptr);
+    for (size_t i = 0; i < externals.size(); i++) {
+      uint8_t *stub = stubs + i * STUB_SIZE;
+      void *function = hostFunction(module.symbols[externals[i]].name);
+      stub[0] = 0xFF;
+      stub[1] = 0x25;
+      std::memset(stub + 2, 0, 4);
+      std::memcpy(stub + 6, &function, 8);
+      stub_of[externals[i]] = stub;
+    }
+
+    for (const auto &reloc : code.relocations) {
+      uint8_t *target = stub_of[reloc.symbol] ? stub_of[reloc.symbol]
+                                              : address(reloc.symbol);
+      uint8_t *field = text + reloc.offset;
+      int64_t value = (target + reloc.addend) - (field + 4 + reloc.trailing);
+      int32_t value32 = static_cast<int32_t>(value);
+      std::memcpy(field, &value32, 4);
+    }
+
+    if (mprotect(text, text_size, PROT_READ | PROT_EXEC) != 0) {
+      throw std::runtime_error("Could not make the program executable");
+    }
+    if (rodata_size && mprotect(rodata, rodata_size, PROT_READ) != 0) {
+      throw std::runtime_error("Could not protect the program's constants");
+    }
+  } catch (...) {
+    munmap(memory, size);
+    memory = nullptr;
+    throw;
+  }
+}
+
+Jit::~Jit() {
+  if (memory) {
+    munmap(memory, size);
+  }
+}
+
+void Jit::run(const std::string &entry) {
+  for (uint32_t id = 0; id < module.symbols.size(); id++) {
+    if (module.symbols[id].name == entry) {
+      auto function = reinterpret_cast<void (*)()>(address(id));
+      function();
+      // printf output is still sitting in stdio
+      std::fflush(stdout);
+      return;
+    }
+  }
+  throw std::runtime_error("Entry point '" + entry + "' is not defined.");
+}
+
+void *Jit::hostFunction(const std::string &name) {
+  if (name == "printf") {
+    return reinterpret_cast<void *>(&std::printf);
+  }
+  if (name == "read") {
+    return reinterpret_cast<void *>(&::read);
+  }
+  if (name == "exit") {
+    return reinterpret_cast<void *>(&std::exit);
+  }
+  throw std::runtime_error("Undefined symbol '" + name + "'.");
+}
+
+uint8_t *Jit::address(uint32_t symbol) {
+  const Symbol &target = module.symbols[symbol];
+  switch (target.section) {
+  case SectionKind::TEXT:
+    return text + target.offset;
+  case SectionKind::DATA:
+    return data + target.offset;
+  case SectionKind::RODATA:
+    return rodata + target.offset;
+  case SectionKind::BSS:
+    return bss + target.offset;
+  case SectionKind::NONE:
+    break;
+  }
+  throw std::runtime_error("Undefined symbol '" + target.name + "'.");
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#include "../assembler/Encoder.hpp"
+#include "../assembler/Module.hpp"
+
+#include <cstdint>
+#include <string>
+
+/*
+  Loads an encoded Module into executable memory of this process and runs it
+  (--run). References to functions outside the module are bound to the
+  compiler's own C library through a table of jump stubs, so cin and cout
+  use the host's read and printf.
+*/
+class Jit {
+public:
+  Jit(const assembler::Module &module, const assembler::ObjectCode &code);
+  ~Jit();
+
+  Jit(const Jit &) = delete;
+  Jit &operator=(const Jit &) = delete;
+
+  // calls the function at the symbol `entry`
+  void run(const std::string &entry);
+
+private:
+  const assembler::Module &module;
+  uint8_t *memory = nullptr;
+  size_t size = 0;
+
+  uint8_t *text = nullptr;
+  uint8_t *stubs = nullptr;
+  uint8_t *rodata = nullptr;
+  uint8_t *data = nullptr;
+  uint8_t *bss = nullptr;
+
+  void *hostFunction(const std::string &name);
+
+  uint8_t *address(uint32_t symbol);
+};
+
+#endif // !JIT_HPP
@@ -35,11 +35,34 @@ std::vector<TOKEN> Lexer::lex() {
       continue;
     }
 
+    if (isBracket(peek().value())) {
+      buffer.push_back(consume());
+      tokens.push_back({getBracketTokenType(buffer[0]), buffer, PROGRAM_LINE});
+      buffer.clear();
+      continue;
+    }
+
+    /* == and != before = and ! are taken as operators */
+    if ((peek().value() == '=' || peek().value() == '!') &&
+        LEX_COUNTER + 1 < SRC_CODE.size() &&
+        SRC_CODE[LEX_COUNTER + 1] == '=') {
+      buffer.push_back(consume());
+      buffer.push_back(consume());
+      tokens.push_back({TokenType::RELATIONAL_OPERATOR, buffer, PROGRAM_LINE});
+      buffer.clear();
+      continue;
+    }
+
     /* check for literal */
     if (peek().value() == '"') {
       consume();
       while (peek().has_value() && peek().value() != '"') {
-        buffer.push_back(consume());
+        char ch = consume();
+        /* escape sequences are stored as the byte they stand for */
+        if (ch == '\\' && peek().has_value()) {
+          ch = escapeSequence(consume());
+        }
+        buffer.push_back(ch);
       }
       if (peek().has_value() && peek().value() == '"') {
         consume(); // Consume closing quote
@@ -79,16 +102,19 @@ std::vector<TOKEN> Lexer::lex() {
       continue;
     }
 
-    /* Check for CIN and COUT operators */
+    /* Check for CIN and COUT operators, otherwise a comparison */
     if (peek().value() == '<') {
       buffer.push_back(consume());
-      if (peek().value() == '<') {
+      if (peek().has_value() && peek().value() == '<') {
         buffer.push_back(consume());
         tokens.push_back({TokenType::COUT_OPERATOR, buffer, PROGRAM_LINE});
         buffer.clear();
         continue;
       }
-      tokens.push_back({TokenType::UNKNOWN, buffer, PROGRAM_LINE});
+      if (peek().has_value() && peek().value() == '=') {
+        buffer.push_back(consume());
+      }
+      tokens.push_back({TokenType::RELATIONAL_OPERATOR, buffer, PROGRAM_LINE});
       buffer.clear();
       continue;
     }
@@ -96,13 +122,16 @@ std::vector<TOKEN> Lexer::lex() {
     if (peek().value() == '>') {
 
       buffer.push_back(consume());
-      if (peek().value() == '>') {
+      if (peek().has_value() && peek().value() == '>') {
         buffer.push_back(consume());
         tokens.push_back({TokenType::CIN_OPERATOR, buffer, PROGRAM_LINE});
         buffer.clear();
         continue;
       }
-      tokens.push_back({TokenType::UNKNOWN, buffer, PROGRAM_LINE});
+      if (peek().has_value() && peek().value() == '=') {
+        buffer.push_back(consume());
+      }
+      tokens.push_back({TokenType::RELATIONAL_OPERATOR, buffer, PROGRAM_LINE});
       buffer.clear();
       continue;
     }
@@ -148,19 +177,57 @@ TokenType Lexer::getOpTokenType(char ch) {
     return TokenType::ADDITION_OPERATOR;
   case '-':
     return TokenType::SUBTRACTION_OPERATOR;
+  case '*':
+    return TokenType::MULTIPLICATION_OPERATOR;
   case '=':
     return TokenType::ASSIGNMENT_OPERATOR;
   }
   return TokenType::IDENTIFIER;
 }
 
+char Lexer::escapeSequence(char ch) {
+  switch (ch) {
+  case 'n':
+    return '\n';
+  case 't':
+    return '\t';
+  case 'r':
+    return '\r';
+  case 'a':
+    return '\a';
+  case 'b':
+    return '\b';
+  case 'f':
+    return '\f';
+  case 'v':
+    return '\v';
+  }
+  return ch; // \\, \" and \' stand for the character itself
+}
+
 TokenType Lexer::getKeywordTokenType(std::string keyword) {
   if (keyword == "cin") {
     return TokenType::CIN_KEYWORD;
   } else if (keyword == "cout") {
     return TokenType::COUT_KEYWORD;
+  } else if (keyword == "if") {
+    return TokenType::IF_KEYWORD;
+  } else if (keyword == "else") {
+    return TokenType::ELSE_KEYWORD;
+  } else if (keyword == "while") {
+    return TokenType::WHILE_KEYWORD;
+  } else if (keyword == "char") {
+    return TokenType::CHAR_KEYWORD;
+  } else if (keyword == "short") {
+    return TokenType::SHORT_KEYWORD;
   } else if (keyword == "int") {
     return TokenType::INT_KEYWORD;
+  } else if (keyword == "long") {
+    return TokenType::LONG_KEYWORD;
+  } else if (keyword == "void") {
+    return TokenType::VOID_KEYWORD;
+  } else if (keyword == "return") {
+    return TokenType::RETURN_KEYWORD;
   }
   return TokenType::IDENTIFIER;
 }
@@ -169,3 +236,24 @@ bool Lexer::isOperator(char ch) {
   return (ch == '+' || ch == '-' || ch == '*' || ch == '/' || ch == '%' ||
           ch == '^' || ch == '=' || ch == '!');
 }
+
+bool Lexer::isBracket(char ch) {
+  return ch == '(' || ch == ')' || ch == '{' || ch == '}' || ch == '[' ||
+         ch == ']';
+}
+
+TokenType Lexer::getBracketTokenType(char ch) {
+  switch (ch) {
+  case '(':
+    return TokenType::LEFT_PARENTHESIS;
+  case ')':
+    return TokenType::RIGHT_PARENTHESIS;
+  case '{':
+    return TokenType::LEFT_BRACE;
+  case '[':
+    return TokenType::LEFT_BRACKET;
+  case ']':
+    return TokenType::RIGHT_BRACKET;
+  }
+  return TokenType::RIGHT_BRACE;
+}
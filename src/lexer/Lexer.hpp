@@ -26,9 +26,16 @@ private:
 
   TokenType getOpTokenType(char ch);
 
+  // the byte a backslash followed by `ch` stands for in a string literal
+  char escapeSequence(char ch);
+
   TokenType getKeywordTokenType(std::string keyword);
 
   bool isOperator(char ch);
+
+  bool isBracket(char ch);
+
+  TokenType getBracketTokenType(char ch);
 };
 
 #endif // !LEXER_HPP
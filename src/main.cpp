@@ -1,86 +1,271 @@
-#include <fstream>
-#include <iomanip>
+#include <cstdlib>
 #include <iostream>
-#include <sstream>
 #include <string>
 
-#include "generator/Generator.hpp"
-#include "lexer/Lexer.hpp"
-#include "parser/Parser.hpp"
-#include "semantic/SymbolTable.hpp"
-#include "semantic/SyntaxAnalyzer.hpp"
+#include "assembler/Encoder.hpp"
+#include "common/Diagnostics.hpp"
+#include "driver/Batch.hpp"
+#include "driver/Cache.hpp"
+#include "driver/Compilation.hpp"
+#include "jit/Jit.hpp"
+#include "server/Server.hpp"
+#include "vm/BytecodeCompiler.hpp"
+#include "vm/VM.hpp"
 
-std::string printTokenType(
-    TokenType type); // helper function to print token type (Debugging purposes)
-std::string fetchSourceCode(std::string filename);
-void writeAssembly(std::string filename, std::string src);
-std::string changeExtension(const std::string &filename,
-                            const std::string &newExtension);
-void assembleCode(std::string &filename, std::string &exename);
+unsigned jobCount(const std::string &value);
 
 int main(int argc, char *argv[]) {
 
-  if (argc < 2) {
-    std::cout << "Usage: ./main <file>" << std::endl;
-    return 1;
+  CompileOptions options;
+  // --interpret: run the program on the bytecode VM instead
+  bool interpret = false;
+  // --batch <directory>: compile every .mcpp file under it, with -j N
+  // threads, 0 for one per core
+  std::string batch;
+  // --serve <socket>: compile the requests of the client, with -j N threads
+  std::string serve;
+  unsigned jobs = 0;
+  // $MCOMPILER_CACHE_DIR, unless --cache-dir= is given
+  if (const char *cache_env = std::getenv("MCOMPILER_CACHE_DIR")) {
+    options.cache_dir = cache_env;
   }
-
-  std::string CODE;
-  std::string filename = argv[1];
-  std::string exename = argv[2];
-
-  CODE = fetchSourceCode(filename);
+  // --cache-stats: print the hits, misses and size of the cache
+  bool cache_stats = false;
+  bool codegen_jobs_set = false;
+  std::vector<std::string> arguments;
 
   try {
-    Lexer lexer(CODE);
+    for (int i = 1; i < argc; i++) {
+      std::string arg = argv[i];
+      if (options.set(arg)) {
+        codegen_jobs_set |= arg.rfind("--codegen-jobs=", 0) == 0;
+      } else if (arg == "--run") {
+        options.run = true;
+      } else if (arg == "--interpret") {
+        interpret = true;
+      } else if (arg == "--cache-stats") {
+        cache_stats = true;
+      } else if (arg == "--batch" || arg == "--serve" || arg == "-j") {
+        if (i + 1 == argc) {
+          throw std::runtime_error(arg + " needs an argument");
+        }
+        if (arg == "--batch") {
+          batch = argv[++i];
+        } else if (arg == "--serve") {
+          serve = argv[++i];
+        } else {
+          jobs = jobCount(argv[++i]);
+        }
+      } else if (arg.rfind("-j", 0) == 0) {
+        jobs = jobCount(arg.substr(2));
+      } else if (arg.size() > 1 && arg[0] == '-') {
+        throw std::runtime_error("Unknown option: " + arg);
+      } else {
+        arguments.push_back(arg);
+      }
+    }
+    options.check();
+    diagnostics::setLevel(options.verbosity);
+  } catch (std::exception &e) {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
 
-    std::vector<TOKEN> TOKENS = lexer.lex();
+  if (interpret) {
+    options.run = true;
+  }
+  bool run = options.run;
+  // -S and -c write a file next to the source instead of the executable
+  bool file_only = options.assembly_only || options.object_only;
 
-    parser::Parser parser(TOKENS);
-    std::vector<std::shared_ptr<node::Node>> NODES = parser.parse();
-    SyntaxAnalyzer analyzer(NODES);
-    Generator generator(NODES);
+  if (cache_stats) {
+    if (options.cache_dir.empty()) {
+      std::cout << "--cache-stats needs --cache-dir or MCOMPILER_CACHE_DIR"
+                << std::endl;
+      return 1;
+    }
+    try {
+      Cache cache(options.cache_dir, options.cache_size);
+      Cache::Stats stats = cache.stats();
+      uint64_t lookups = stats.hits + stats.misses;
+      std::cout << "cache: " << options.cache_dir << std::endl
+                << "hits: " << stats.hits << ", misses: " << stats.misses
+                << ", hit rate: "
+                << (lookups ? 100 * stats.hits / lookups : 0) << "%"
+                << std::endl
+                << "files: " << stats.files << ", " << stats.bytes
+                << " of " << cache.limit() << " bytes, evictions: "
+                << stats.evictions << std::endl;
+    } catch (std::exception &e) {
+      std::cout << "Error: " << e.what() << std::endl;
+      return -1;
+    }
+    if (arguments.empty() && batch.empty() && serve.empty()) {
+      return 0;
+    }
+  }
 
-    // Print tokens for debugging
-    // Representation
-    std::cout << std::endl << "Tokens: " << std::endl;
-    std::cout << std::left << std::setw(30) << "Token Type" << std::setw(20)
-              << "Lexeme" << std::setw(10) << "Line" << std::endl;
-    std::cout << std::string(60, '-') << std::endl;
+  if (!batch.empty()) {
+    if (run || !arguments.empty()) {
+      std::cout << "--batch compiles a directory, without --run, "
+                   "--interpret or files"
+                << std::endl;
+      return 1;
+    }
+    // the files are compiled in parallel already
+    if (!codegen_jobs_set) {
+      options.codegen_jobs = 1;
+    }
+    // the phases print as they go, only the report is shown
+    std::cout.setstate(std::ios::failbit);
+    try {
+      Batch::Report report = Batch(options, batch, jobs).run();
+      std::cout.clear();
+      Batch::print(report, std::cout);
+      return report.failed ? 1 : 0;
+    } catch (std::exception &e) {
+      std::cout.clear();
+      std::cout << "Error: " << e.what() << std::endl;
+      return -1;
+    }
+  }
 
-    for (const auto &token : TOKENS) {
-      std::cout << std::left << std::setw(30) << printTokenType(token.type)
-                << std::setw(20) << token.lexeme << std::setw(10) << token.line
+  if (!serve.empty()) {
+    // the options come with each request
+    if (run || !batch.empty() || !arguments.empty()) {
+      std::cout << "--serve takes no files, --run, --interpret or --batch"
                 << std::endl;
+      return 1;
+    }
+    std::cout.setstate(std::ios::failbit);
+    try {
+      Server(serve, jobs).run();
+    } catch (std::exception &e) {
+      std::cout.clear();
+      std::cout << "Error: " << e.what() << std::endl;
+      return -1;
     }
+    return 0;
+  }
+
+  if (arguments.size() < (file_only || run ? 1u : 2u)) {
+    std::cout << "Usage: ./main [-ffreestanding] [-S|-c] "
+                 "[--target=win64|linux] [--backend=native|c]"
+              << std::endl
+              << "              [--simd=scalar|sse2|avx2|auto] <file> "
+                 "<executable>"
+              << std::endl
+              << "       ./main --run|--interpret <file>" << std::endl
+              << "       ./main --batch <directory> [-j N] [options]"
+              << std::endl
+              << "       ./main --serve <socket> [-j N]" << std::endl
+              << "       [--cache-dir=<directory>] [--cache-size=<MB>] "
+                 "[--cache-stats]"
+              << std::endl
+              << "       [-ftime-report[=json]] [-fmem-report[=json]] "
+                 "[-fperf-report[=json]]"
+              << std::endl
+              << "       [-v|-vv] [--dump-tokens] [--dump-ast] [--dump-asm]"
+              << std::endl;
+    return 1;
+  }
 
-    std::cout << std::endl << std::string(60, '+') << std::endl;
-    std::cout << std::endl << "Parse Tree: " << std::endl;
+  std::string filename = arguments[0];
+  std::string exename = file_only || run ? "" : arguments[1];
 
-    for (auto node : NODES) {
-      node->print();
-      std::cout << std::endl;
+  try {
+    Compilation compilation(options, filename, exename);
+    PhaseReport &phases = compilation.phases();
+    if (options.report_columns.memory) {
+      phases.measureMemory();
+    }
+    if (options.report_columns.counters) {
+      phases.measureCounters();
     }
+    auto report = [&]() {
+      if (options.report_columns.any()) {
+        phases.print(std::cerr, options.report_columns,
+                     options.report_format);
+      }
+    };
 
-    std::cout << std::endl << std::string(60, '+') << std::endl;
-    std::cout << std::endl << "Semantic Analyzer Results: " << std::endl;
+    // a file compiled before with the same options is copied from the
+    // cache, before it is even lexed. What -v and the dumps print comes
+    // from the phases, so they bypass it.
+    std::optional<Cache> cache;
+    std::string key, kind;
+    if (!options.cache_dir.empty() && !run && !options.prints()) {
+      cache.emplace(options.cache_dir, options.cache_size);
+      key = Cache::key(compilation.sourceCode(), options);
+      kind = Cache::kind(options);
+      std::string output =
+          file_only ? compilation.outputName() : compilation.executable();
+      bool hit;
+      {
+        PhaseReport::Scope phase(phases, "cache");
+        hit = cache->fetch(key, kind, output);
+      }
+      if (hit) {
+        std::cout << "Cache hit: " << output << std::endl;
+        report();
+        return 0;
+      }
+    }
+    // the output is built already, a cache that cannot keep it is not an
+    // error
+    auto store = [&](const std::string &output) {
+      if (!cache) {
+        return;
+      }
+      try {
+        PhaseReport::Scope phase(phases, "cache");
+        cache->store(key, kind, output);
+      } catch (std::exception &e) {
+        std::cout << "Warning: not cached: " << e.what() << std::endl;
+      }
+    };
 
-    analyzer.analyzeSemantics();
+    compilation.parse();
+    compilation.analyze();
 
-    std::cout << std::endl << std::string(60, '+') << std::endl;
-    std::cout << std::endl
-              << "Code Generator Results: " << std::endl
-              << std::endl;
-    std::string asm_generated = generator.generate();
+    if (interpret) {
+      vm::Program program =
+          vm::BytecodeCompiler(compilation.nodes()).compile();
+      vm::VM machine(program);
+      machine.run();
+      return 0;
+    }
 
-    std::string newFile = changeExtension(filename, ".asm");
-    writeAssembly(newFile, asm_generated);
+    compilation.generate();
 
-    assembleCode(filename, exename); // assemble the ASM file
+    if (file_only) {
+      std::string written = compilation.write();
+      std::cout << "Wrote " << written << std::endl;
+      store(written);
+      report();
+      return 0;
+    }
+
+    if (run) {
+      assembler::Module &module = compilation.module();
+      std::optional<Jit> jit;
+      {
+        PhaseReport::Scope phase(phases, "assemble");
+        assembler::ObjectCode code = assembler::Encoder(module).encode();
+        jit.emplace(module, code);
+      }
+      report();
+      jit->run("main");
+      return 0;
+    }
+
+    compilation.link(); // encode and link, or gcc -O2 for the C backend
+    store(compilation.executable());
+    report();
 
   } catch (std::exception &e) {
     if (std::string(e.what()) == "bad optional access") {
-      std::cerr << "Error: Missing Delimiter at the end of File" << std::endl;
+      std::cerr << "Error: " << Compilation::message(e) << std::endl;
     } else {
       std::cout << "Error: " << e.what() << std::endl;
     }
@@ -91,85 +276,10 @@ int main(int argc, char *argv[]) {
   return 0;
 }
 
-std::string fetchSourceCode(std::string fileName) {
-  std::ifstream file(fileName);
-
-  if (!file) {
-    std::cout << "Could not open file: " << fileName << std::endl;
-    exit(EXIT_FAILURE);
+unsigned jobCount(const std::string &value) {
+  if (value.empty() ||
+      value.find_first_not_of("0123456789") != std::string::npos) {
+    throw std::runtime_error("Invalid number of jobs: " + value);
   }
-
-  std::ostringstream ss;
-  ss << file.rdbuf(); // Reading Code
-  return ss.str();    // Code as string
-}
-
-std::string printTokenType(TokenType type) {
-  switch (type) {
-  case TokenType::IDENTIFIER:
-    return "IDENTIFIER";
-  case TokenType::CONSTANT:
-    return "CONSTANT";
-  case TokenType::CIN_KEYWORD:
-    return "CIN_KEYWORD";
-  case TokenType::COUT_KEYWORD:
-    return "COUT_KEYWORD";
-  case TokenType::PUNCTUATOR:
-    return "PUNCTUATOR";
-  case TokenType::LITERAL:
-    return "LITERAL";
-  case TokenType::ADDITION_OPERATOR:
-    return "ADDITION_OPERATOR";
-  case TokenType::SUBTRACTION_OPERATOR:
-    return "SUBTRACTION_OPERATOR";
-    return "DIVISION_OPERATOR";
-  case TokenType::DELIMITER:
-    return "DELIMITER";
-  case TokenType::ASSIGNMENT_OPERATOR:
-    return "ASSIGNMENT_OPERATOR";
-  case TokenType::INT_KEYWORD:
-    return "INT_KEYWORD";
-  case TokenType::CIN_OPERATOR:
-    return "CIN_OPERATOR";
-  case TokenType::COUT_OPERATOR:
-    return "COUT_OPERATOR";
-  case TokenType::UNKNOWN:
-    return "UNKNOWN";
-  }
-  return "UNKNOWN";
-}
-
-void writeAssembly(std::string filename, std::string src) {
-  std::ofstream file;
-  file.open(filename);
-  file << src;
-  file.close();
-}
-
-std::string changeExtension(const std::string &filename,
-                            const std::string &newExtension) {
-  // Find the last dot in the filename
-  size_t dotPos = filename.rfind('.');
-
-  // If there's no dot or it's the first character, return the filename
-  // unchanged
-  if (dotPos == std::string::npos || dotPos == 0) {
-    return filename;
-  }
-
-  // Return the filename up to the dot, then add the new extension
-  return filename.substr(0, dotPos) + newExtension;
-}
-
-void assembleCode(std::string &filename, std::string &exename) {
-  std::string file_asm = changeExtension(filename, ".asm");
-  std::string file_o = changeExtension(filename, ".o");
-  std::string file_exe = changeExtension(exename, ".exe");
-
-  std::string nasm = "nasm -f win64 -o " + file_o + " " + file_asm;
-  std::cout << nasm << std::endl;
-  std::system(nasm.c_str());
-  std::string gcc = "gcc -o " + file_exe + " " + file_o;
-  std::cout << gcc << std::endl;
-  std::system(gcc.c_str());
+  return std::stoul(value);
 }
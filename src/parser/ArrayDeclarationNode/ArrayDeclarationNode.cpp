@@ -0,0 +1,21 @@
+#include "ArrayDeclarationNode.hpp"
+
+#include <string>
+
+ArrayDeclarationNode::ArrayDeclarationNode(
+    TokenType type, std::shared_ptr<IdentifierNode> identifier, TOKEN length)
+    : type(type), identifier(std::move(identifier)),
+      length(std::move(length)) {}
+
+uint64_t ArrayDeclarationNode::size() const {
+  return std::stoull(length.lexeme);
+}
+
+void ArrayDeclarationNode::print() const {
+  std::cout << "ArrayDeclarationNode " << identifier->identifier.lexeme << "["
+            << length.lexeme << "]" << std::endl;
+}
+
+void ArrayDeclarationNode::toString() const {
+  std::cout << "ArrayDeclarationNode" << std::endl;
+}
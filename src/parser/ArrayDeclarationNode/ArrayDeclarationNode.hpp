@@ -0,0 +1,31 @@
+#ifndef ARRAY_DECLARATION_NODE_HPP
+#define ARRAY_DECLARATION_NODE_HPP
+
+#include "../IdentifierNode/IdentifierNode.hpp"
+#include "../Node.hpp"
+
+#include <cstdint>
+
+// `int a[1024];`, a fixed-size array whose elements start out as 0
+class ArrayDeclarationNode : public node::Node {
+public:
+  // elements an array may have, so byte offsets into it fit in an int
+  static constexpr uint64_t MAX_LENGTH = 1 << 28;
+
+  TokenType type;
+  std::shared_ptr<IdentifierNode> identifier;
+  TOKEN length; // the constant between the brackets
+
+  ArrayDeclarationNode(TokenType type,
+                       std::shared_ptr<IdentifierNode> identifier,
+                       TOKEN length);
+
+  // number of elements, checked by the SyntaxAnalyzer
+  uint64_t size() const;
+
+  void print() const override;
+
+  void toString() const override;
+};
+
+#endif // !ARRAY_DECLARATION_NODE_HPP
@@ -0,0 +1,15 @@
+#include "CallNode.hpp"
+
+CallNode::CallNode(std::shared_ptr<IdentifierNode> identifier,
+                   std::vector<std::shared_ptr<Node>> arguments)
+    : identifier(std::move(identifier)), arguments(std::move(arguments)) {}
+
+void CallNode::print() const {
+  std::cout << "\t - CallNode :: " << identifier->identifier.lexeme
+            << std::endl;
+  for (const auto &argument : arguments) {
+    argument->print();
+  }
+}
+
+void CallNode::toString() const { std::cout << "CallNode" << std::endl; }
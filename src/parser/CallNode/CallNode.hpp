@@ -0,0 +1,23 @@
+#ifndef CALL_NODE_HPP
+#define CALL_NODE_HPP
+
+#include "../IdentifierNode/IdentifierNode.hpp"
+#include "../Node.hpp"
+
+#include <vector>
+
+// `f(a, b)`: a call of a function, as a value or as a statement of its own
+class CallNode : public node::Node {
+public:
+  std::shared_ptr<IdentifierNode> identifier;
+  std::vector<std::shared_ptr<Node>> arguments;
+
+  CallNode(std::shared_ptr<IdentifierNode> identifier,
+           std::vector<std::shared_ptr<Node>> arguments);
+
+  void print() const override;
+
+  void toString() const override;
+};
+
+#endif // !CALL_NODE_HPP
@@ -0,0 +1,18 @@
+#include "ConditionNode.hpp"
+
+ConditionNode::ConditionNode(std::shared_ptr<Node> left, std::string OP,
+                             std::shared_ptr<Node> right, int line)
+    : left(std::move(left)), OP(std::move(OP)), right(std::move(right)),
+      line(line) {}
+
+void ConditionNode::print() const {
+  std::cout << "\t - ConditionNode " << OP << std::endl;
+  std::cout << "\t\t - left: ";
+  left->print();
+  std::cout << "\t\t - right: ";
+  right->print();
+}
+
+void ConditionNode::toString() const {
+  std::cout << "ConditionNode" << std::endl;
+}
@@ -0,0 +1,27 @@
+#ifndef CONDITION_NODE_HPP
+#define CONDITION_NODE_HPP
+
+#include "../Node.hpp"
+
+#include <string>
+
+class ConditionNode : public node::Node {
+  /*
+      The condition of an if or while statement: two operands compared with
+      one of < <= > >= == !=. A bare operand `x` is parsed as `x != 0`.
+  */
+public:
+  std::shared_ptr<Node> left;
+  std::string OP;
+  std::shared_ptr<Node> right;
+  int line; /* Line number of the condition */
+
+  ConditionNode(std::shared_ptr<Node> left, std::string OP,
+                std::shared_ptr<Node> right, int line);
+
+  void print() const override;
+
+  void toString() const override;
+};
+
+#endif // !CONDITION_NODE_HPP
@@ -7,6 +7,19 @@ DeclarationNode::DeclarationNode(
                         product)
     : type(type), product(std::move(product)) {}
 
+uint8_t DeclarationNode::width() const {
+  switch (type) {
+  case TokenType::CHAR_KEYWORD:
+    return 1;
+  case TokenType::SHORT_KEYWORD:
+    return 2;
+  case TokenType::LONG_KEYWORD:
+    return 8;
+  default:
+    return 4;
+  }
+}
+
 void DeclarationNode::print() const {
   std::cout << "DeclarationNode" << std::endl;
   if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(product)) {
@@ -5,6 +5,8 @@
 #include "../IdentifierNode/IdentifierNode.hpp"
 #include "../Node.hpp"
 
+#include <cstdint>
+
 class DeclarationNode : public node::Node {
 public:
   TokenType type;
@@ -18,6 +20,9 @@ public:
                                std::shared_ptr<AssignmentNode>>
                       product);
 
+  // bytes a variable of the declared type occupies: 1, 2, 4 or 8
+  uint8_t width() const;
+
   void print() const override;
 
   void toString() const override;
@@ -0,0 +1,15 @@
+#include "ElementAssignmentNode.hpp"
+
+ElementAssignmentNode::ElementAssignmentNode(std::shared_ptr<IndexNode> element,
+                                             std::shared_ptr<Node> assignment)
+    : element(std::move(element)), assignment(std::move(assignment)) {}
+
+void ElementAssignmentNode::print() const {
+  std::cout << "- ElementAssignmentNode" << std::endl;
+  element->print();
+  assignment->print();
+}
+
+void ElementAssignmentNode::toString() const {
+  std::cout << "ElementAssignmentNode" << std::endl;
+}
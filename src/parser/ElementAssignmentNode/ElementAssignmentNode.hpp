@@ -0,0 +1,21 @@
+#ifndef ELEMENT_ASSIGNMENT_NODE_HPP
+#define ELEMENT_ASSIGNMENT_NODE_HPP
+
+#include "../IndexNode/IndexNode.hpp"
+#include "../Node.hpp"
+
+// `a[i] = value;`
+class ElementAssignmentNode : public node::Node {
+public:
+  std::shared_ptr<IndexNode> element;
+  std::shared_ptr<Node> assignment;
+
+  ElementAssignmentNode(std::shared_ptr<IndexNode> element,
+                        std::shared_ptr<Node> assignment);
+
+  void print() const override;
+
+  void toString() const override;
+};
+
+#endif // !ELEMENT_ASSIGNMENT_NODE_HPP
@@ -0,0 +1,43 @@
+#include "FunctionNode.hpp"
+
+FunctionNode::FunctionNode(
+    TokenType type, std::shared_ptr<IdentifierNode> identifier,
+    std::vector<std::shared_ptr<DeclarationNode>> parameters,
+    std::shared_ptr<SequenceNode> body)
+    : type(type), identifier(std::move(identifier)),
+      parameters(std::move(parameters)), body(std::move(body)) {}
+
+uint8_t FunctionNode::width() const {
+  switch (type) {
+  case TokenType::VOID_KEYWORD:
+    return 0;
+  case TokenType::CHAR_KEYWORD:
+    return 1;
+  case TokenType::SHORT_KEYWORD:
+    return 2;
+  case TokenType::LONG_KEYWORD:
+    return 8;
+  default:
+    return 4;
+  }
+}
+
+const std::string &FunctionNode::parameter(size_t index) const {
+  return std::get<std::vector<std::shared_ptr<IdentifierNode>>>(
+             parameters.at(index)->product)
+      .front()
+      ->identifier.lexeme;
+}
+
+void FunctionNode::print() const {
+  std::cout << "FunctionNode :: " << identifier->identifier.lexeme
+            << std::endl;
+  for (const auto &parameter : parameters) {
+    parameter->print();
+  }
+  body->print();
+}
+
+void FunctionNode::toString() const {
+  std::cout << "FunctionNode" << std::endl;
+}
@@ -0,0 +1,37 @@
+#ifndef FUNCTION_NODE_HPP
+#define FUNCTION_NODE_HPP
+
+#include "../DeclarationNode/DeclarationNode.hpp"
+#include "../IdentifierNode/IdentifierNode.hpp"
+#include "../Node.hpp"
+#include "../SequenceNode/SequenceNode.hpp"
+
+#include <cstdint>
+
+/*
+  `int f(int a, long b) { ... }`: the definition of a function at the top
+  level of the program. Every parameter is the declaration of one variable.
+*/
+class FunctionNode : public node::Node {
+public:
+  TokenType type; // the return type, VOID_KEYWORD when there is none
+  std::shared_ptr<IdentifierNode> identifier;
+  std::vector<std::shared_ptr<DeclarationNode>> parameters;
+  std::shared_ptr<SequenceNode> body;
+
+  FunctionNode(TokenType type, std::shared_ptr<IdentifierNode> identifier,
+               std::vector<std::shared_ptr<DeclarationNode>> parameters,
+               std::shared_ptr<SequenceNode> body);
+
+  // bytes of the returned value, 0 for a void function
+  uint8_t width() const;
+
+  // the identifier declared by parameter `index`
+  const std::string &parameter(size_t index) const;
+
+  void print() const override;
+
+  void toString() const override;
+};
+
+#endif // !FUNCTION_NODE_HPP
@@ -0,0 +1,19 @@
+#include "IfNode.hpp"
+
+IfNode::IfNode(std::shared_ptr<ConditionNode> condition,
+               std::shared_ptr<SequenceNode> then,
+               std::shared_ptr<SequenceNode> otherwise)
+    : condition(std::move(condition)), then(std::move(then)),
+      otherwise(std::move(otherwise)) {}
+
+void IfNode::print() const {
+  std::cout << "IfNode" << std::endl;
+  condition->print();
+  then->print();
+  if (otherwise) {
+    std::cout << "- else" << std::endl;
+    otherwise->print();
+  }
+}
+
+void IfNode::toString() const { std::cout << "IfNode" << std::endl; }
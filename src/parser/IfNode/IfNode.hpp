@@ -0,0 +1,23 @@
+#ifndef IF_NODE_HPP
+#define IF_NODE_HPP
+
+#include "../ConditionNode/ConditionNode.hpp"
+#include "../Node.hpp"
+#include "../SequenceNode/SequenceNode.hpp"
+
+class IfNode : public node::Node {
+public:
+  std::shared_ptr<ConditionNode> condition;
+  std::shared_ptr<SequenceNode> then;
+  std::shared_ptr<SequenceNode> otherwise; // the else branch, or null
+
+  IfNode(std::shared_ptr<ConditionNode> condition,
+         std::shared_ptr<SequenceNode> then,
+         std::shared_ptr<SequenceNode> otherwise);
+
+  void print() const override;
+
+  void toString() const override;
+};
+
+#endif // !IF_NODE_HPP
@@ -0,0 +1,13 @@
+#include "IndexNode.hpp"
+
+IndexNode::IndexNode(std::shared_ptr<IdentifierNode> identifier,
+                     std::shared_ptr<Node> index)
+    : identifier(std::move(identifier)), index(std::move(index)) {}
+
+void IndexNode::print() const {
+  std::cout << "\t - IndexNode :: " << identifier->identifier.lexeme
+            << std::endl;
+  index->print();
+}
+
+void IndexNode::toString() const { std::cout << "IndexNode" << std::endl; }
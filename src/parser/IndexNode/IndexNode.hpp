@@ -0,0 +1,21 @@
+#ifndef INDEX_NODE_HPP
+#define INDEX_NODE_HPP
+
+#include "../IdentifierNode/IdentifierNode.hpp"
+#include "../Node.hpp"
+
+// `a[i]`: an element of an array, indexed by a constant or a variable
+class IndexNode : public node::Node {
+public:
+  std::shared_ptr<IdentifierNode> identifier;
+  std::shared_ptr<Node> index;
+
+  IndexNode(std::shared_ptr<IdentifierNode> identifier,
+            std::shared_ptr<Node> index);
+
+  void print() const override;
+
+  void toString() const override;
+};
+
+#endif // !INDEX_NODE_HPP
@@ -1,4 +1,4 @@
-#include "parser.hpp"
+#include "Parser.hpp"
 
 namespace parser {
 Parser::Parser(std::vector<TOKEN> tokens)
@@ -7,9 +7,19 @@ Parser::Parser(std::vector<TOKEN> tokens)
 std::vector<std::shared_ptr<node::Node>> Parser::parse() {
   // Parse all the statements from the tokens vector
   while (peek().has_value()) {
-    if (auto node = parseStatement(); node.has_value()) {
-      NODES.push_back(*node);
+    auto token = peek().value();
+    if (isFunctionDefinition()) {
+      NODES.push_back(parseFunction());
+      continue;
+    }
+    auto node = parseStatement();
+    if (!node.has_value()) {
+      // nothing was consumed, so skipping it would loop forever
+      throw std::runtime_error("Syntax Error: Unexpected " +
+                               printTokenType(token.type) + " at line " +
+                               std::to_string(token.line));
     }
+    NODES.push_back(*node);
   }
   return NODES;
 }
@@ -43,11 +53,57 @@ std::shared_ptr<IdentifierNode> Parser::parseIdentifier() {
   return std::make_shared<IdentifierNode>(token, token.line);
 }
 
+std::shared_ptr<node::Node> Parser::parseOperand() {
+  auto identifier = parseIdentifier();
+  if (peek().has_value() &&
+      peek().value().type == TokenType::LEFT_PARENTHESIS) {
+    return parseCall(identifier);
+  }
+  if (!peek().has_value() ||
+      peek().value().type != TokenType::LEFT_BRACKET) {
+    return identifier;
+  }
+  consume(); // Consume '['
+  if (peek().value().type != TokenType::CONSTANT &&
+      peek().value().type != TokenType::IDENTIFIER) {
+    throw std::runtime_error(
+        "Syntax Error: Expected a constant or identifier as index at line " +
+        std::to_string(peek().value().line));
+  }
+  auto index = peek().value().type == TokenType::CONSTANT
+                   ? std::shared_ptr<node::Node>(parseConstant())
+                   : parseIdentifier();
+  auto token = peek().value();
+  expect(TokenType::RIGHT_BRACKET, token);
+  consume();
+  return std::make_shared<IndexNode>(identifier, index);
+}
+
+std::shared_ptr<CallNode>
+Parser::parseCall(std::shared_ptr<IdentifierNode> identifier) {
+  auto token = peek().value();
+  expect(TokenType::LEFT_PARENTHESIS, token);
+  consume();
+
+  std::vector<std::shared_ptr<node::Node>> arguments;
+  if (peek().value().type != TokenType::RIGHT_PARENTHESIS) {
+    arguments.push_back(parseExpression());
+    while (peek().value().type == TokenType::PUNCTUATOR) {
+      consume(); // Consume ','
+      arguments.push_back(parseExpression());
+    }
+  }
+  token = peek().value();
+  expect(TokenType::RIGHT_PARENTHESIS, token);
+  consume();
+  return std::make_shared<CallNode>(identifier, arguments);
+}
+
 std::shared_ptr<node::Node> Parser::parseConstantOrIdentifier() {
   if (peek().value().type == TokenType::CONSTANT) {
     return parseConstant();
   } else if (peek().value().type == TokenType::IDENTIFIER) {
-    return parseIdentifier();
+    return parseOperand();
   } else {
     throw std::runtime_error("Invalid token");
   }
@@ -66,6 +122,10 @@ std::shared_ptr<node::Node> Parser::parseExpression() {
     consume(); // Consume '-'
     auto right = parseConstantOrIdentifier();
     return std::make_shared<ExpressionNode>('-', left, right);
+  } else if (peek().value().type == TokenType::MULTIPLICATION_OPERATOR) {
+    consume(); // Consume '*'
+    auto right = parseConstantOrIdentifier();
+    return std::make_shared<ExpressionNode>('*', left, right);
   }
   // Check if the next token is a delimiter (e.g., ';')
   // auto token = peek().value();
@@ -100,6 +160,19 @@ std::shared_ptr<AssignmentNode> Parser::parseAssignment() {
   return std::make_shared<AssignmentNode>(identifier, expression);
 }
 
+std::shared_ptr<node::Node> Parser::parseElementAssignment() {
+  auto element = std::dynamic_pointer_cast<IndexNode>(parseOperand());
+  TOKEN token = peek().value();
+  expect(TokenType::ASSIGNMENT_OPERATOR, token);
+  consume();
+
+  auto expression = parseExpression();
+  token = peek().value();
+  expect(TokenType::DELIMITER, token);
+  consume();
+  return std::make_shared<ElementAssignmentNode>(element, expression);
+}
+
 std::shared_ptr<node::Node> Parser::parseDeclaration() {
   std::vector<std::shared_ptr<IdentifierNode>> identifiers;
 
@@ -114,6 +187,23 @@ std::shared_ptr<node::Node> Parser::parseDeclaration() {
     if (peek().value().type == TokenType::IDENTIFIER) {
       auto identifier = parseIdentifier(); // simply parse the identifier
 
+      // `int a[1024];` declares an array on its own
+      if (identifiers.empty() &&
+          peek().value().type == TokenType::LEFT_BRACKET) {
+        consume();
+        auto length = peek().value();
+        expect(TokenType::CONSTANT, length);
+        consume();
+        auto token = peek().value();
+        expect(TokenType::RIGHT_BRACKET, token);
+        consume();
+        token = peek().value();
+        expect(TokenType::DELIMITER, token);
+        consume();
+        return std::make_shared<ArrayDeclarationNode>(declarationType,
+                                                      identifier, length);
+      }
+
       // after consumption of the parseIdentifier, we check if the next token
       // is an assignment operator
       if (peek().value().type == TokenType::ASSIGNMENT_OPERATOR) {
@@ -214,8 +304,7 @@ std::shared_ptr<node::Node> Parser::parseCin() {
          peek().value().type == TokenType::CIN_OPERATOR) {
 
     if (peek().value().type == TokenType::IDENTIFIER) {
-      auto identifier = parseIdentifier();
-      inputOperands.push_back(identifier);
+      inputOperands.push_back(parseOperand());
     } else if (peek().value().type == TokenType::CIN_OPERATOR) {
       consume();
       // we always expect an identifier after the CIN operator
@@ -234,11 +323,181 @@ std::shared_ptr<node::Node> Parser::parseCin() {
   return std::make_shared<CinNode>(inputOperands);
 }
 
+std::shared_ptr<ConditionNode> Parser::parseCondition() {
+  auto token = peek().value();
+  expect(TokenType::LEFT_PARENTHESIS, token);
+  consume();
+
+  auto left = parseExpression();
+  std::string op = "!=";
+  std::shared_ptr<node::Node> right;
+  if (peek().value().type == TokenType::RELATIONAL_OPERATOR) {
+    op = consume().value().lexeme;
+    right = parseExpression();
+  } else {
+    // `if (x)` tests x against zero
+    right = std::make_shared<ConstantNode>(
+        TOKEN{TokenType::CONSTANT, "0", token.line}, token.line);
+  }
+
+  auto closing = peek().value();
+  expect(TokenType::RIGHT_PARENTHESIS, closing);
+  consume();
+  return std::make_shared<ConditionNode>(left, op, right, token.line);
+}
+
+std::shared_ptr<SequenceNode> Parser::parseBlock() {
+  auto sequenceNode = std::make_shared<SequenceNode>();
+  if (peek().value().type != TokenType::LEFT_BRACE) {
+    auto token = peek().value();
+    auto statement = parseStatement();
+    if (!statement.has_value()) {
+      throw std::runtime_error("Syntax Error: Expected a statement at line " +
+                               std::to_string(token.line));
+    }
+    sequenceNode->addStatement(*statement);
+    return sequenceNode;
+  }
+
+  consume(); // Consume '{'
+  while (peek().has_value() &&
+         peek().value().type != TokenType::RIGHT_BRACE) {
+    auto token = peek().value();
+    auto statement = parseStatement();
+    if (!statement.has_value()) {
+      throw std::runtime_error("Syntax Error: Unexpected " +
+                               printTokenType(token.type) + " at line " +
+                               std::to_string(token.line));
+    }
+    sequenceNode->addStatement(*statement);
+  }
+  if (!peek().has_value()) {
+    throw std::runtime_error("Syntax Error: Missing } at the end of input.");
+  }
+  consume(); // Consume '}'
+  return sequenceNode;
+}
+
+std::shared_ptr<node::Node> Parser::parseIf() {
+  auto token = peek().value();
+  expect(TokenType::IF_KEYWORD, token);
+  consume();
+
+  auto condition = parseCondition();
+  auto then = parseBlock();
+  std::shared_ptr<SequenceNode> otherwise;
+  if (peek().has_value() && peek().value().type == TokenType::ELSE_KEYWORD) {
+    consume();
+    otherwise = parseBlock();
+  }
+  return std::make_shared<IfNode>(condition, then, otherwise);
+}
+
+std::shared_ptr<node::Node> Parser::parseWhile() {
+  auto token = peek().value();
+  expect(TokenType::WHILE_KEYWORD, token);
+  consume();
+
+  auto condition = parseCondition();
+  return std::make_shared<WhileNode>(condition, parseBlock());
+}
+
+bool Parser::isFunctionDefinition() {
+  // a type, a name and the opening parenthesis of the parameters
+  if (P_COUNTER + 2 >= TOKENS.size()) {
+    return false;
+  }
+  switch (TOKENS[P_COUNTER].type) {
+  case TokenType::VOID_KEYWORD:
+  case TokenType::CHAR_KEYWORD:
+  case TokenType::SHORT_KEYWORD:
+  case TokenType::INT_KEYWORD:
+  case TokenType::LONG_KEYWORD:
+    break;
+  default:
+    return false;
+  }
+  return TOKENS[P_COUNTER + 1].type == TokenType::IDENTIFIER &&
+         TOKENS[P_COUNTER + 2].type == TokenType::LEFT_PARENTHESIS;
+}
+
+std::shared_ptr<FunctionNode> Parser::parseFunction() {
+  TokenType type = consume().value().type;
+  auto identifier = parseIdentifier();
+  auto token = peek().value();
+  expect(TokenType::LEFT_PARENTHESIS, token);
+  consume();
+
+  std::vector<std::shared_ptr<DeclarationNode>> parameters;
+  while (peek().value().type != TokenType::RIGHT_PARENTHESIS) {
+    if (!parameters.empty()) {
+      token = peek().value();
+      expect(TokenType::PUNCTUATOR, token);
+      consume(); // Consume ','
+    }
+    token = peek().value();
+    if (token.type != TokenType::CHAR_KEYWORD &&
+        token.type != TokenType::SHORT_KEYWORD &&
+        token.type != TokenType::INT_KEYWORD &&
+        token.type != TokenType::LONG_KEYWORD) {
+      throw std::runtime_error("Syntax Error: Expected the type of a "
+                               "parameter but got " +
+                               printTokenType(token.type) + " at line " +
+                               std::to_string(token.line));
+    }
+    consume();
+    std::vector<std::shared_ptr<IdentifierNode>> name = {parseIdentifier()};
+    parameters.push_back(std::make_shared<DeclarationNode>(token.type, name));
+  }
+  consume(); // Consume ')'
+
+  // the body always has braces
+  token = peek().value();
+  expect(TokenType::LEFT_BRACE, token);
+  return std::make_shared<FunctionNode>(type, identifier, parameters,
+                                        parseBlock());
+}
+
+std::shared_ptr<node::Node> Parser::parseReturn() {
+  auto token = peek().value();
+  expect(TokenType::RETURN_KEYWORD, token);
+  consume();
+
+  std::shared_ptr<node::Node> value;
+  if (peek().value().type != TokenType::DELIMITER) {
+    value = parseExpression();
+  }
+  auto delimiter = peek().value();
+  expect(TokenType::DELIMITER, delimiter);
+  consume();
+  return std::make_shared<ReturnNode>(value, token.line);
+}
+
 std::optional<std::shared_ptr<node::Node>> Parser::parseStatement() {
   TOKEN token = peek().value();
 
+  if (isFunctionDefinition()) {
+    throw std::runtime_error(
+        "Syntax Error: Functions can only be defined at the top level, at "
+        "line " +
+        std::to_string(token.line));
+  }
+
   switch (token.type) {
   case TokenType::IDENTIFIER: {
+    if (P_COUNTER + 1 < TOKENS.size() &&
+        TOKENS[P_COUNTER + 1].type == TokenType::LEFT_BRACKET) {
+      return parseElementAssignment();
+    }
+    if (P_COUNTER + 1 < TOKENS.size() &&
+        TOKENS[P_COUNTER + 1].type == TokenType::LEFT_PARENTHESIS) {
+      // a call for its side effects, the value is dropped
+      auto callNode = parseCall(parseIdentifier());
+      auto delimiter = peek().value();
+      expect(TokenType::DELIMITER, delimiter);
+      consume();
+      return callNode;
+    }
     auto assignmentNode = parseAssignment();
 
     if (assignmentNode) {
@@ -251,7 +510,10 @@ std::optional<std::shared_ptr<node::Node>> Parser::parseStatement() {
                                std::to_string(token.line));
     }
   } break;
-  case TokenType::INT_KEYWORD: {
+  case TokenType::CHAR_KEYWORD:
+  case TokenType::SHORT_KEYWORD:
+  case TokenType::INT_KEYWORD:
+  case TokenType::LONG_KEYWORD: {
 
     auto declarationNode = parseDeclaration();
 
@@ -286,6 +548,12 @@ std::optional<std::shared_ptr<node::Node>> Parser::parseStatement() {
                                std::to_string(token.line));
     }
   }
+  case TokenType::RETURN_KEYWORD:
+    return parseReturn();
+  case TokenType::IF_KEYWORD:
+    return parseIf();
+  case TokenType::WHILE_KEYWORD:
+    return parseWhile();
   default: {
   }
   }
@@ -302,6 +570,14 @@ std::string Parser::printTokenType(TokenType type) {
     return "CIN_KEYWORD";
   case TokenType::COUT_KEYWORD:
     return "COUT_KEYWORD";
+  case TokenType::CHAR_KEYWORD:
+    return "CHAR_KEYWORD";
+  case TokenType::SHORT_KEYWORD:
+    return "SHORT_KEYWORD";
+  case TokenType::INT_KEYWORD:
+    return "INT_KEYWORD";
+  case TokenType::LONG_KEYWORD:
+    return "LONG_KEYWORD";
   case TokenType::PUNCTUATOR:
     return "PUNCTUATOR";
   case TokenType::LITERAL:
@@ -310,6 +586,32 @@ std::string Parser::printTokenType(TokenType type) {
     return "ADDITION_OPERATOR";
   case TokenType::SUBTRACTION_OPERATOR:
     return "SUBTRACTION_OPERATOR";
+  case TokenType::MULTIPLICATION_OPERATOR:
+    return "MULTIPLICATION_OPERATOR";
+  case TokenType::RELATIONAL_OPERATOR:
+    return "RELATIONAL_OPERATOR";
+  case TokenType::IF_KEYWORD:
+    return "IF_KEYWORD";
+  case TokenType::ELSE_KEYWORD:
+    return "ELSE_KEYWORD";
+  case TokenType::WHILE_KEYWORD:
+    return "WHILE_KEYWORD";
+  case TokenType::VOID_KEYWORD:
+    return "VOID_KEYWORD";
+  case TokenType::RETURN_KEYWORD:
+    return "RETURN_KEYWORD";
+  case TokenType::LEFT_PARENTHESIS:
+    return "LEFT_PARENTHESIS";
+  case TokenType::RIGHT_PARENTHESIS:
+    return "RIGHT_PARENTHESIS";
+  case TokenType::LEFT_BRACE:
+    return "LEFT_BRACE";
+  case TokenType::RIGHT_BRACE:
+    return "RIGHT_BRACE";
+  case TokenType::LEFT_BRACKET:
+    return "LEFT_BRACKET";
+  case TokenType::RIGHT_BRACKET:
+    return "RIGHT_BRACKET";
   case TokenType::DELIMITER:
     return "DELIMITER";
   case TokenType::ASSIGNMENT_OPERATOR:
@@ -2,15 +2,24 @@
 #define PARSER_HPP
 
 #include "../common/Token.hpp"
+#include "ArrayDeclarationNode/ArrayDeclarationNode.hpp"
 #include "AssignmentNode/AssignmentNode.hpp"
+#include "CallNode/CallNode.hpp"
 #include "CinNode/CinNode.hpp"
+#include "ConditionNode/ConditionNode.hpp"
 #include "ConstantNode/ConstantNode.hpp"
 #include "CoutNode/CoutNode.hpp"
 #include "DeclarationNode/DeclarationNode.hpp"
+#include "ElementAssignmentNode/ElementAssignmentNode.hpp"
 #include "ExpressionNode/ExpressionNode.hpp"
+#include "FunctionNode/FunctionNode.hpp"
+#include "IfNode/IfNode.hpp"
+#include "IndexNode/IndexNode.hpp"
 #include "Node.hpp"
+#include "ReturnNode/ReturnNode.hpp"
 #include "SequenceNode/SequenceNode.hpp"
 #include "StringLiteralNode/StringLiteralNode.hpp"
+#include "WhileNode/WhileNode.hpp"
 #include <optional>
 #include <vector>
 
@@ -20,6 +29,9 @@ public:
   Parser(std::vector<TOKEN> tokens);
   std::vector<std::shared_ptr<node::Node>> parse();
 
+  // the name of a token type, as in the errors and --dump-tokens
+  static std::string printTokenType(TokenType type);
+
 private:
   std::vector<TOKEN> TOKENS;
   std::vector<std::shared_ptr<node::Node>> NODES;
@@ -34,12 +46,21 @@ private:
 
   std::shared_ptr<IdentifierNode> parseIdentifier();
 
+  // a variable, or an element of an array when a `[` follows it
+  std::shared_ptr<node::Node> parseOperand();
+
+  // `name(arguments)` after the name was parsed
+  std::shared_ptr<CallNode>
+  parseCall(std::shared_ptr<IdentifierNode> identifier);
+
   std::shared_ptr<node::Node> parseConstantOrIdentifier();
 
   std::shared_ptr<node::Node> parseExpression();
 
   std::shared_ptr<AssignmentNode> parseAssignment();
 
+  std::shared_ptr<node::Node> parseElementAssignment();
+
   std::shared_ptr<node::Node> parseDeclaration();
 
   std::shared_ptr<node::Node> parseLiteral();
@@ -48,9 +69,23 @@ private:
 
   std::shared_ptr<node::Node> parseCin();
 
-  std::optional<std::shared_ptr<node::Node>> parseStatement();
+  std::shared_ptr<ConditionNode> parseCondition();
+
+  // a statement, or statements in braces
+  std::shared_ptr<SequenceNode> parseBlock();
 
-  std::string printTokenType(TokenType type);
+  std::shared_ptr<node::Node> parseIf();
+
+  std::shared_ptr<node::Node> parseWhile();
+
+  // whether the next tokens start `type name(`
+  bool isFunctionDefinition();
+
+  std::shared_ptr<FunctionNode> parseFunction();
+
+  std::shared_ptr<node::Node> parseReturn();
+
+  std::optional<std::shared_ptr<node::Node>> parseStatement();
 
   void expect(TokenType type, TOKEN &token);
 };
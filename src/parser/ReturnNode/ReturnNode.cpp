@@ -0,0 +1,13 @@
+#include "ReturnNode.hpp"
+
+ReturnNode::ReturnNode(std::shared_ptr<Node> value, int line)
+    : value(std::move(value)), line(line) {}
+
+void ReturnNode::print() const {
+  std::cout << "- ReturnNode" << std::endl;
+  if (value) {
+    value->print();
+  }
+}
+
+void ReturnNode::toString() const { std::cout << "ReturnNode" << std::endl; }
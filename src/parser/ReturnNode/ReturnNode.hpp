@@ -0,0 +1,19 @@
+#ifndef RETURN_NODE_HPP
+#define RETURN_NODE_HPP
+
+#include "../Node.hpp"
+
+// `return value;`, or `return;` in a void function
+class ReturnNode : public node::Node {
+public:
+  std::shared_ptr<Node> value; // null without a value
+  int line;
+
+  ReturnNode(std::shared_ptr<Node> value, int line);
+
+  void print() const override;
+
+  void toString() const override;
+};
+
+#endif // !RETURN_NODE_HPP
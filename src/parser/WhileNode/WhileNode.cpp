@@ -0,0 +1,13 @@
+#include "WhileNode.hpp"
+
+WhileNode::WhileNode(std::shared_ptr<ConditionNode> condition,
+                     std::shared_ptr<SequenceNode> body)
+    : condition(std::move(condition)), body(std::move(body)) {}
+
+void WhileNode::print() const {
+  std::cout << "WhileNode" << std::endl;
+  condition->print();
+  body->print();
+}
+
+void WhileNode::toString() const { std::cout << "WhileNode" << std::endl; }
@@ -0,0 +1,21 @@
+#ifndef WHILE_NODE_HPP
+#define WHILE_NODE_HPP
+
+#include "../ConditionNode/ConditionNode.hpp"
+#include "../Node.hpp"
+#include "../SequenceNode/SequenceNode.hpp"
+
+class WhileNode : public node::Node {
+public:
+  std::shared_ptr<ConditionNode> condition;
+  std::shared_ptr<SequenceNode> body;
+
+  WhileNode(std::shared_ptr<ConditionNode> condition,
+            std::shared_ptr<SequenceNode> body);
+
+  void print() const override;
+
+  void toString() const override;
+};
+
+#endif // !WHILE_NODE_HPP
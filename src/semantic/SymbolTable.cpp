@@ -1,20 +1,38 @@
 #include "SymbolTable.hpp"
 
-void SymbolTable::declareVariable(TOKEN &token) {
+void SymbolTable::declareVariable(TOKEN &token, TokenType type) {
+  if (functions.find(token.lexeme) != functions.end()) {
+    throw std::runtime_error("Semantic Error: '" + token.lexeme +
+                             "' is already declared as a function.");
+  }
   if (declared_variables.find(token.lexeme) != declared_variables.end()) {
     throw std::runtime_error("Semantic Error: Variable '" + token.lexeme +
                              "' is already declared.");
   }
-  declared_variables[token.lexeme] = token.type;
+  declared_variables[token.lexeme] = type;
   initialized_variables[token.lexeme] = false;
 }
 
+void SymbolTable::declareArray(TOKEN &token, TokenType type,
+                               uint64_t length) {
+  declareVariable(token, type);
+  array_lengths[token.lexeme] = length;
+  initialized_variables[token.lexeme] = true;
+}
+
 TokenType SymbolTable::lookupVariable(TOKEN &token) {
-  if (declared_variables.find(token.lexeme) == declared_variables.end()) {
+  auto it = declared_variables.find(token.lexeme);
+  if (it == declared_variables.end()) {
     throw std::runtime_error("Semantic Error: Variable '" + token.lexeme +
                              "' is not declared.");
   }
-  return token.type;
+  return it->second;
+}
+
+uint64_t SymbolTable::arrayLength(TOKEN &token) {
+  lookupVariable(token);
+  auto it = array_lengths.find(token.lexeme);
+  return it == array_lengths.end() ? 0 : it->second;
 }
 
 void SymbolTable::setInitialized(TOKEN &token) {
@@ -34,3 +52,38 @@ void SymbolTable::printInitialized() {
     std::cout << var.first << " :: " << var.second << std::endl;
   }
 }
+
+void SymbolTable::declareFunction(TOKEN &token, TokenType type,
+                                  size_t parameters) {
+  if (functions.find(token.lexeme) != functions.end() ||
+      declared_variables.find(token.lexeme) != declared_variables.end()) {
+    throw std::runtime_error("Semantic Error: '" + token.lexeme +
+                             "' is already declared.");
+  }
+  functions[token.lexeme] = {type, parameters};
+}
+
+const SymbolTable::Function &SymbolTable::lookupFunction(TOKEN &token) {
+  auto it = functions.find(token.lexeme);
+  if (it == functions.end()) {
+    throw std::runtime_error("Semantic Error: Function '" + token.lexeme +
+                             "' is not declared.");
+  }
+  return it->second;
+}
+
+void SymbolTable::enterScope() {
+  enclosing.push_back({std::move(declared_variables),
+                       std::move(initialized_variables),
+                       std::move(array_lengths)});
+  declared_variables.clear();
+  initialized_variables.clear();
+  array_lengths.clear();
+}
+
+void SymbolTable::exitScope() {
+  declared_variables = std::move(enclosing.back().declared_variables);
+  initialized_variables = std::move(enclosing.back().initialized_variables);
+  array_lengths = std::move(enclosing.back().array_lengths);
+  enclosing.pop_back();
+}
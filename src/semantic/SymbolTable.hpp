@@ -8,19 +8,55 @@
 
 class SymbolTable {
 public:
-  void declareVariable(TOKEN &token);
+  // type is the keyword the variable was declared with
+  void declareVariable(TOKEN &token, TokenType type);
+
+  // arrays are declared with their number of elements, which start out 0
+  void declareArray(TOKEN &token, TokenType type, uint64_t length);
 
   TokenType lookupVariable(TOKEN &token);
 
+  // number of elements of an array, 0 for a variable
+  uint64_t arrayLength(TOKEN &token);
+
   void setInitialized(TOKEN &token);
 
   void isInitialized(TOKEN &token);
   // for debugging
   void printInitialized();
 
+  struct Function {
+    TokenType type; // the return type, VOID_KEYWORD for none
+    size_t parameters;
+  };
+
+  // functions share one namespace with the program's variables
+  void declareFunction(TOKEN &token, TokenType type, size_t parameters);
+
+  const Function &lookupFunction(TOKEN &token);
+
+  /*
+    A function body is a scope of its own: it sees its parameters and
+    variables but not the ones of the program, which are back in view when
+    the scope is left.
+  */
+  void enterScope();
+
+  void exitScope();
+
 private:
   std::unordered_map<std::string, TokenType> declared_variables;
   std::unordered_map<std::string, bool> initialized_variables;
+  std::unordered_map<std::string, uint64_t> array_lengths;
+
+  std::unordered_map<std::string, Function> functions;
+
+  struct Scope {
+    std::unordered_map<std::string, TokenType> declared_variables;
+    std::unordered_map<std::string, bool> initialized_variables;
+    std::unordered_map<std::string, uint64_t> array_lengths;
+  };
+  std::vector<Scope> enclosing; // the scopes left to enter a function
 };
 
 #endif //! SYMBOL_TABLE_HPP
@@ -1,4 +1,5 @@
 #include "SyntaxAnalyzer.hpp"
+#include "../common/Diagnostics.hpp"
 
 SyntaxAnalyzer::SyntaxAnalyzer(
     const std::vector<std::shared_ptr<node::Node>> &Nodes)
@@ -6,12 +7,13 @@ SyntaxAnalyzer::SyntaxAnalyzer(
 
 void SyntaxAnalyzer::analyzeSemantics() {
   for (auto &node : Nodes) {
-    std::cout << "Analyzing: ";
-    node->toString();
+    if (diagnostics::enabled(diagnostics::TRACE)) {
+      std::cout << "Analyzing: ";
+      node->toString();
+    }
     analyzeNode(node);
-    // symbolTable.printInitialized();
   }
-  std::cout << "Semantics Analyzed: No errors." << std::endl;
+  DIAGNOSE(VERBOSE, "Semantics Analyzed: No errors.");
 }
 
 void SyntaxAnalyzer::analyzeDeclaration(std::shared_ptr<DeclarationNode> node) {
@@ -22,50 +24,165 @@ void SyntaxAnalyzer::analyzeDeclaration(std::shared_ptr<DeclarationNode> node) {
         std::get<std::vector<std::shared_ptr<IdentifierNode>>>(node->product);
     for (auto &id : identifiers) {
       // process identifier
-      symbolTable.declareVariable(id->identifier);
+      symbolTable.declareVariable(id->identifier, node->type);
     }
   } else if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
                  node->product)) {
     auto assignment = std::get<std::shared_ptr<AssignmentNode>>(node->product);
     // process assignment
     // LMAO AHSJDAKJDKAJSDLAWKDJLAKWDJLAKWD
-    symbolTable.declareVariable(assignment->identifier->identifier);
+    symbolTable.declareVariable(assignment->identifier->identifier,
+                                node->type);
     analyzeAssignment(assignment);
   }
 }
 
-void SyntaxAnalyzer::analyzeExpression(std::shared_ptr<ExpressionNode> node) {
-  std::shared_ptr<node::Node> left = node->left;
-  std::shared_ptr<node::Node> right = node->right;
+void SyntaxAnalyzer::analyzeFunction(std::shared_ptr<FunctionNode> node) {
+  /*
+    The function is declared before its body is analyzed, so it can call
+    itself. It can call the functions defined before it but not the ones
+    after it, like in C++ without forward declarations.
+  */
+  symbolTable.declareFunction(node->identifier->identifier, node->type,
+                              node->parameters.size());
+  symbolTable.enterScope();
+  function = node;
+  for (size_t i = 0; i < node->parameters.size(); i++) {
+    analyzeDeclaration(node->parameters[i]);
+    TOKEN &parameter = std::get<std::vector<std::shared_ptr<IdentifierNode>>>(
+                           node->parameters[i]->product)
+                           .front()
+                           ->identifier;
+    symbolTable.setInitialized(parameter);
+  }
+  analyzeNode(node->body);
+  function = nullptr;
+  symbolTable.exitScope();
+}
 
-  // process left
-  if (auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(left)) {
-    symbolTable.isInitialized(identifierNode->identifier);
-    symbolTable.lookupVariable(identifierNode->identifier);
+void SyntaxAnalyzer::analyzeCall(std::shared_ptr<CallNode> node, bool value) {
+  TOKEN &name = node->identifier->identifier;
+  const SymbolTable::Function &callee = symbolTable.lookupFunction(name);
+  if (node->arguments.size() != callee.parameters) {
+    throw std::runtime_error(
+        "Semantic Error: Function '" + name.lexeme + "' takes " +
+        std::to_string(callee.parameters) + " arguments but got " +
+        std::to_string(node->arguments.size()) + " at line " +
+        std::to_string(name.line));
+  }
+  if (value && callee.type == TokenType::VOID_KEYWORD) {
+    throw std::runtime_error("Semantic Error: Function '" + name.lexeme +
+                             "' does not return a value at line " +
+                             std::to_string(name.line));
   }
+  for (auto &argument : node->arguments) {
+    analyzeValue(argument);
+  }
+}
 
-  // process right
-  if (auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(right)) {
-    symbolTable.isInitialized(identifierNode->identifier);
-    symbolTable.lookupVariable(identifierNode->identifier);
+void SyntaxAnalyzer::analyzeReturn(std::shared_ptr<ReturnNode> node) {
+  std::string line = std::to_string(node->line);
+  if (!function) {
+    throw std::runtime_error(
+        "Semantic Error: return outside of a function at line " + line);
+  }
+  const std::string &name = function->identifier->identifier.lexeme;
+  if (function->type == TokenType::VOID_KEYWORD && node->value) {
+    throw std::runtime_error("Semantic Error: void function '" + name +
+                             "' returns a value at line " + line);
+  }
+  if (function->type != TokenType::VOID_KEYWORD && !node->value) {
+    throw std::runtime_error("Semantic Error: Function '" + name +
+                             "' has to return a value at line " + line);
+  }
+  if (node->value) {
+    analyzeValue(node->value);
   }
 }
 
-void SyntaxAnalyzer::analyzeIdentifier(std::shared_ptr<IdentifierNode> node) {
-  symbolTable.lookupVariable(node->identifier);
+void SyntaxAnalyzer::analyzeArrayDeclaration(
+    std::shared_ptr<ArrayDeclarationNode> node) {
+  TOKEN &name = node->identifier->identifier;
+  // arrays are static storage of the program, functions only have locals
+  if (function) {
+    throw std::runtime_error("Semantic Error: Array '" + name.lexeme +
+                             "' cannot be declared in a function at line " +
+                             std::to_string(name.line));
+  }
+  // elements are lowered as int lanes of vector registers
+  if (node->type != TokenType::INT_KEYWORD) {
+    throw std::runtime_error("Semantic Error: Array '" + name.lexeme +
+                             "' must be of type int at line " +
+                             std::to_string(name.line));
+  }
+  uint64_t length = 0;
+  try {
+    length = std::stoull(node->length.lexeme);
+  } catch (std::out_of_range &) {
+  }
+  if (length == 0 || length > ArrayDeclarationNode::MAX_LENGTH) {
+    throw std::runtime_error(
+        "Semantic Error: Array '" + name.lexeme + "' must have 1 to " +
+        std::to_string(ArrayDeclarationNode::MAX_LENGTH) +
+        " elements at line " + std::to_string(name.line));
+  }
+  symbolTable.declareArray(name, node->type, length);
 }
 
-void SyntaxAnalyzer::analyzeAssignment(std::shared_ptr<AssignmentNode> node) {
+void SyntaxAnalyzer::analyzeExpression(std::shared_ptr<ExpressionNode> node) {
+  analyzeOperand(node->left);
+  analyzeOperand(node->right);
+}
+
+void SyntaxAnalyzer::analyzeOperand(std::shared_ptr<node::Node> node) {
+  if (auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(node)) {
+    TOKEN &token = identifierNode->identifier;
+    if (symbolTable.arrayLength(token)) {
+      throw std::runtime_error("Semantic Error: Array '" + token.lexeme +
+                               "' used as a value at line " +
+                               std::to_string(token.line));
+    }
+    symbolTable.isInitialized(token);
+  } else if (auto indexNode = std::dynamic_pointer_cast<IndexNode>(node)) {
+    analyzeIndex(indexNode);
+  } else if (auto callNode = std::dynamic_pointer_cast<CallNode>(node)) {
+    analyzeCall(callNode, true);
+  }
+}
+
+void SyntaxAnalyzer::analyzeIndex(std::shared_ptr<IndexNode> node) {
+  TOKEN &array = node->identifier->identifier;
+  uint64_t length = symbolTable.arrayLength(array);
+  if (!length) {
+    throw std::runtime_error("Semantic Error: Variable '" + array.lexeme +
+                             "' is not an array.");
+  }
+  if (auto constantNode =
+          std::dynamic_pointer_cast<ConstantNode>(node->index)) {
+    // a variable index is not checked, like in C++
+    uint64_t index = UINT64_MAX;
+    try {
+      index = std::stoull(constantNode->constant.lexeme);
+    } catch (std::out_of_range &) {
+    }
+    if (index >= length) {
+      throw std::runtime_error("Semantic Error: Index " +
+                               constantNode->constant.lexeme +
+                               " is out of bounds of array '" + array.lexeme +
+                               "' at line " + std::to_string(array.line));
+    }
+  } else {
+    analyzeOperand(node->index);
+  }
+}
+
+void SyntaxAnalyzer::analyzeValue(std::shared_ptr<node::Node> value) {
   /*
     An assingment in the Assignment node can be a
-    Constant Node, Identifier Node or Expression Node.
+    Constant Node, Identifier Node, Index Node or Expression Node.
     We nee to analyze each of these nodes individually.
   */
-  symbolTable.setInitialized(
-      node->identifier->identifier); // we set the initialized flag as true
-
-  if (auto constantNode =
-          std::dynamic_pointer_cast<ConstantNode>(node->assignment)) {
+  if (auto constantNode = std::dynamic_pointer_cast<ConstantNode>(value)) {
     // maybe a bit redundant lmao
     // since we already know that it's a constant
     // Just incase
@@ -74,16 +191,13 @@ void SyntaxAnalyzer::analyzeAssignment(std::shared_ptr<AssignmentNode> node) {
           "Semantic Error: Type mismatch in assignment at line " +
           std::to_string(constantNode->constant.line));
     }
-  } else if (auto identifierNode =
-                 std::dynamic_pointer_cast<IdentifierNode>(node->assignment)) {
-    TokenType type = symbolTable.lookupVariable(identifierNode->identifier);
-    if (type != node->identifier->identifier.type) {
-      throw std::runtime_error(
-          "Semantic Error: Type mismatch in assignment at line " +
-          std::to_string(identifierNode->identifier.line));
-    }
+  } else if (std::dynamic_pointer_cast<IdentifierNode>(value) ||
+             std::dynamic_pointer_cast<IndexNode>(value) ||
+             std::dynamic_pointer_cast<CallNode>(value)) {
+    // all integer types convert to each other, narrowing wraps around
+    analyzeOperand(value);
   } else if (auto expressionNode =
-                 std::dynamic_pointer_cast<ExpressionNode>(node->assignment)) {
+                 std::dynamic_pointer_cast<ExpressionNode>(value)) {
     analyzeExpression(expressionNode);
   } else {
     throw std::runtime_error(
@@ -91,6 +205,56 @@ void SyntaxAnalyzer::analyzeAssignment(std::shared_ptr<AssignmentNode> node) {
   }
 }
 
+void SyntaxAnalyzer::analyzeIdentifier(std::shared_ptr<IdentifierNode> node) {
+  symbolTable.lookupVariable(node->identifier);
+}
+
+void SyntaxAnalyzer::analyzeAssignment(std::shared_ptr<AssignmentNode> node) {
+  if (uint64_t length =
+          symbolTable.arrayLength(node->identifier->identifier)) {
+    analyzeArrayAssignment(node, length);
+    return;
+  }
+  analyzeValue(node->assignment);
+
+  // set last, so the value cannot read the variable it initializes
+  symbolTable.setInitialized(node->identifier->identifier);
+}
+
+void SyntaxAnalyzer::analyzeArrayAssignment(
+    std::shared_ptr<AssignmentNode> node, uint64_t length) {
+  /*
+    The operands of a whole-array assignment are arrays of the same length,
+    taken element by element, or values that every element gets.
+  */
+  auto operand = [&](std::shared_ptr<node::Node> value) {
+    auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(value);
+    if (!identifierNode) {
+      analyzeOperand(value);
+      return;
+    }
+    TOKEN &token = identifierNode->identifier;
+    uint64_t other = symbolTable.arrayLength(token);
+    if (!other) {
+      symbolTable.isInitialized(token);
+    } else if (other != length) {
+      throw std::runtime_error("Semantic Error: Arrays '" +
+                               node->identifier->identifier.lexeme +
+                               "' and '" + token.lexeme +
+                               "' differ in length at line " +
+                               std::to_string(token.line));
+    }
+  };
+
+  if (auto expressionNode =
+          std::dynamic_pointer_cast<ExpressionNode>(node->assignment)) {
+    operand(expressionNode->left);
+    operand(expressionNode->right);
+  } else {
+    operand(node->assignment);
+  }
+}
+
 void SyntaxAnalyzer::analyzeNode(const std::shared_ptr<node::Node> &node,
                                  bool isInCin) {
   if (auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(node)) {
@@ -103,7 +267,9 @@ void SyntaxAnalyzer::analyzeNode(const std::shared_ptr<node::Node> &node,
           identifierNode->identifier); // we cheat by making it seem that the
                                        // variable is initialized already
     }
-    symbolTable.isInitialized(identifierNode->identifier);
+    analyzeOperand(identifierNode);
+  } else if (auto indexNode = std::dynamic_pointer_cast<IndexNode>(node)) {
+    analyzeIndex(indexNode);
   } else if (auto stringLiteralNode =
                  std::dynamic_pointer_cast<StringLiteralNode>(node)) {
     // hatdog
@@ -112,9 +278,16 @@ void SyntaxAnalyzer::analyzeNode(const std::shared_ptr<node::Node> &node,
     // hatdog
   } else if (auto declNode = std::dynamic_pointer_cast<DeclarationNode>(node)) {
     analyzeDeclaration(declNode);
+  } else if (auto arrayNode =
+                 std::dynamic_pointer_cast<ArrayDeclarationNode>(node)) {
+    analyzeArrayDeclaration(arrayNode);
   } else if (auto assignNode =
                  std::dynamic_pointer_cast<AssignmentNode>(node)) {
     analyzeAssignment(assignNode);
+  } else if (auto elementNode =
+                 std::dynamic_pointer_cast<ElementAssignmentNode>(node)) {
+    analyzeIndex(elementNode->element);
+    analyzeValue(elementNode->assignment);
   } else if (auto exprNode = std::dynamic_pointer_cast<ExpressionNode>(node)) {
     analyzeExpression(exprNode);
   } else if (auto sequenceNode =
@@ -122,14 +295,42 @@ void SyntaxAnalyzer::analyzeNode(const std::shared_ptr<node::Node> &node,
     for (auto statement : sequenceNode->statements) {
       analyzeNode(statement);
     }
+  } else if (auto conditionNode =
+                 std::dynamic_pointer_cast<ConditionNode>(node)) {
+    analyzeValue(conditionNode->left);
+    analyzeValue(conditionNode->right);
+  } else if (auto ifNode = std::dynamic_pointer_cast<IfNode>(node)) {
+    /*
+      Blocks do not open a scope yet, their variables belong to the whole
+      program. A variable assigned in only one branch counts as initialized
+      after the if, it keeps its previous value (0 if none) otherwise.
+    */
+    analyzeNode(ifNode->condition);
+    analyzeNode(ifNode->then);
+    if (ifNode->otherwise) {
+      analyzeNode(ifNode->otherwise);
+    }
+  } else if (auto whileNode = std::dynamic_pointer_cast<WhileNode>(node)) {
+    analyzeNode(whileNode->condition);
+    analyzeNode(whileNode->body);
   } else if (auto cinNode = std::dynamic_pointer_cast<CinNode>(node)) {
     for (auto operand : cinNode->operands) {
       analyzeNode(operand, true);
     }
   } else if (auto coutNode = std::dynamic_pointer_cast<CoutNode>(node)) {
     for (auto operand : coutNode->operands) {
-      analyzeNode(operand);
+      if (!std::dynamic_pointer_cast<StringLiteralNode>(operand)) {
+        analyzeValue(operand);
+      }
     }
+  } else if (auto functionNode =
+                 std::dynamic_pointer_cast<FunctionNode>(node)) {
+    analyzeFunction(functionNode);
+  } else if (auto callNode = std::dynamic_pointer_cast<CallNode>(node)) {
+    // a call as a statement of its own, any result is dropped
+    analyzeCall(callNode, false);
+  } else if (auto returnNode = std::dynamic_pointer_cast<ReturnNode>(node)) {
+    analyzeReturn(returnNode);
   } else {
     throw std::runtime_error("Semantic Error: Unknown node type.");
   }
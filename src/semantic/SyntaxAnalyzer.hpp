@@ -17,14 +17,38 @@ private:
   SymbolTable symbolTable;
   std::vector<std::shared_ptr<node::Node>> Nodes;
 
+  // the function whose body is analyzed, null at the top level
+  std::shared_ptr<FunctionNode> function;
+
+  void analyzeFunction(std::shared_ptr<FunctionNode> node);
+
+  // `value` when the result is used, which a void function has none of
+  void analyzeCall(std::shared_ptr<CallNode> node, bool value);
+
+  void analyzeReturn(std::shared_ptr<ReturnNode> node);
+
   void analyzeDeclaration(std::shared_ptr<DeclarationNode> node);
 
+  void analyzeArrayDeclaration(std::shared_ptr<ArrayDeclarationNode> node);
+
   void analyzeExpression(std::shared_ptr<ExpressionNode> node);
 
+  // a variable or array element read as a value
+  void analyzeOperand(std::shared_ptr<node::Node> node);
+
+  void analyzeIndex(std::shared_ptr<IndexNode> node);
+
+  // the value assigned to a variable or an array element
+  void analyzeValue(std::shared_ptr<node::Node> value);
+
   void analyzeIdentifier(std::shared_ptr<IdentifierNode> node);
 
   void analyzeAssignment(std::shared_ptr<AssignmentNode> node);
 
+  // `c = a + b;` on whole arrays of `length` elements
+  void analyzeArrayAssignment(std::shared_ptr<AssignmentNode> node,
+                              uint64_t length);
+
   void analyzeNode(const std::shared_ptr<node::Node> &node,
                    bool isInCin = false);
 };
@@ -0,0 +1,93 @@
+/*
+  The client of mcompiler --serve, taking the same command line as
+  mcompiler itself: the options and the source file go to the daemon, and
+  the executable, object or source it sends back is written where
+  mcompiler would have written it. The daemon is found on the socket of
+  --server=<path>, or of the MCOMPILER_SERVER environment variable.
+*/
+#include "Protocol.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+int main(int argc, char *argv[]) {
+  std::string server;
+  if (const char *variable = std::getenv("MCOMPILER_SERVER")) {
+    server = variable;
+  }
+
+  protocol::Request request;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind("--server=", 0) == 0) {
+      server = arg.substr(9);
+    } else if (arg == "--run" || arg == "--interpret" || arg == "--batch" ||
+               arg == "--serve" || arg.rfind("-j", 0) == 0) {
+      std::cout << arg << " is not supported by the client" << std::endl;
+      return 1;
+    } else if (arg.size() > 1 && arg[0] == '-') {
+      request.options.push_back(arg); // checked by the daemon
+    } else {
+      request.arguments.push_back(arg);
+    }
+  }
+
+  if (server.empty() || request.arguments.empty()) {
+    std::cout << "Usage: ./client [--server=<socket>] [mcompiler options] "
+                 "<file> [<executable>]"
+              << std::endl
+              << "       the socket defaults to $MCOMPILER_SERVER"
+              << std::endl;
+    return 1;
+  }
+
+  std::ifstream file(request.arguments[0], std::ios::binary);
+  if (!file) {
+    std::cout << "Error: Could not open file: " << request.arguments[0]
+              << std::endl;
+    return -1;
+  }
+  std::ostringstream source;
+  source << file.rdbuf();
+  request.source = source.str();
+
+  protocol::Response response;
+  try {
+    int fd = protocol::connect(server);
+    protocol::send(fd, request);
+    response = protocol::receiveResponse(fd);
+#ifndef _WIN32
+    close(fd);
+#endif
+  } catch (std::exception &e) {
+    std::cout << "Error: " << e.what() << std::endl;
+    return -1;
+  }
+
+  std::cout << response.log;
+  std::cerr << response.report;
+  if (!response.ok) {
+    return -1;
+  }
+
+  std::ofstream output(response.path, std::ios::binary | std::ios::trunc);
+  output.write(response.output.data(), response.output.size());
+  output.close();
+  if (!output) {
+    std::cout << "Error: Could not write " << response.path << std::endl;
+    return -1;
+  }
+#ifndef _WIN32
+  if (response.executable) {
+    chmod(response.path.c_str(), 0755);
+  }
+#endif
+  return 0;
+}
@@ -0,0 +1,199 @@
+#include "Protocol.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // the programs ignore SIGPIPE instead
+#endif
+#endif
+
+namespace protocol {
+
+#ifdef _WIN32
+
+int connect(const std::string &) {
+  throw std::runtime_error("The compile server needs Unix domain sockets");
+}
+
+void send(int, const Request &) {}
+
+Request receiveRequest(int) { return Request(); }
+
+void send(int, const Response &) {}
+
+Response receiveResponse(int) { return Response(); }
+
+#else
+
+namespace {
+
+// limits on what a peer may make the other end allocate
+constexpr uint32_t MAX_LIST = 256;          // options or arguments
+constexpr uint32_t MAX_ARGUMENT = 4096;     // bytes of one of them
+constexpr uint32_t MAX_SOURCE = 16u << 20;  // bytes of the source file
+constexpr uint32_t MAX_RESPONSE = 1u << 30; // bytes of the log or output
+
+void writeAll(int fd, const void *data, size_t size) {
+  const char *bytes = static_cast<const char *>(data);
+  while (size) {
+    // MSG_NOSIGNAL: a peer that went away is an error, not a SIGPIPE
+    ssize_t written = ::send(fd, bytes, size, MSG_NOSIGNAL);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      throw std::runtime_error(std::string("Could not send: ") +
+                               std::strerror(errno));
+    }
+    bytes += written;
+    size -= written;
+  }
+}
+
+void readAll(int fd, void *data, size_t size) {
+  char *bytes = static_cast<char *>(data);
+  while (size) {
+    ssize_t got = read(fd, bytes, size);
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      throw std::runtime_error("The connection timed out mid-message");
+    }
+    if (got <= 0) {
+      throw std::runtime_error("The connection closed mid-message");
+    }
+    bytes += got;
+    size -= got;
+  }
+}
+
+void writeNumber(int fd, uint32_t value) {
+  writeAll(fd, &value, sizeof(value));
+}
+
+uint32_t readNumber(int fd) {
+  uint32_t value;
+  readAll(fd, &value, sizeof(value));
+  return value;
+}
+
+void writeString(int fd, const std::string &text) {
+  writeNumber(fd, text.size());
+  writeAll(fd, text.data(), text.size());
+}
+
+std::string readString(int fd, uint32_t limit) {
+  uint32_t size = readNumber(fd);
+  if (size > limit) {
+    throw std::runtime_error("Message string of " + std::to_string(size) +
+                             " bytes exceeds the limit of " +
+                             std::to_string(limit));
+  }
+  std::string text(size, '\0');
+  readAll(fd, text.data(), text.size());
+  return text;
+}
+
+void writeList(int fd, const std::vector<std::string> &list) {
+  writeNumber(fd, list.size());
+  for (const auto &text : list) {
+    writeString(fd, text);
+  }
+}
+
+std::vector<std::string> readList(int fd) {
+  uint32_t size = readNumber(fd);
+  if (size > MAX_LIST) {
+    throw std::runtime_error("Message list of " + std::to_string(size) +
+                             " strings exceeds the limit of " +
+                             std::to_string(MAX_LIST));
+  }
+  std::vector<std::string> list(size);
+  for (auto &text : list) {
+    text = readString(fd, MAX_ARGUMENT);
+  }
+  return list;
+}
+
+} // namespace
+
+int connect(const std::string &path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path too long: " + path);
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    throw std::runtime_error(std::string("Could not create a socket: ") +
+                             std::strerror(errno));
+  }
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&address),
+                sizeof(address)) < 0) {
+    int error = errno;
+    close(fd);
+    throw std::runtime_error("Could not connect to " + path + ": " +
+                             std::strerror(error));
+  }
+  return fd;
+}
+
+void send(int fd, const Request &request) {
+  if (request.source.size() > MAX_SOURCE) {
+    throw std::runtime_error("The compile server takes sources of up to " +
+                             std::to_string(MAX_SOURCE >> 20) + " MB");
+  }
+  writeAll(fd, MAGIC, sizeof(MAGIC));
+  writeList(fd, request.options);
+  writeList(fd, request.arguments);
+  writeString(fd, request.source);
+}
+
+Request receiveRequest(int fd) {
+  char magic[sizeof(MAGIC)];
+  readAll(fd, magic, sizeof(magic));
+  if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw std::runtime_error("Not a compile request");
+  }
+  Request request;
+  request.options = readList(fd);
+  request.arguments = readList(fd);
+  request.source = readString(fd, MAX_SOURCE);
+  return request;
+}
+
+void send(int fd, const Response &response) {
+  writeNumber(fd, response.ok);
+  writeString(fd, response.log);
+  writeString(fd, response.report);
+  writeString(fd, response.path);
+  writeNumber(fd, response.executable);
+  writeString(fd, response.output);
+}
+
+Response receiveResponse(int fd) {
+  Response response;
+  response.ok = readNumber(fd);
+  response.log = readString(fd, MAX_RESPONSE);
+  response.report = readString(fd, MAX_RESPONSE);
+  response.path = readString(fd, MAX_RESPONSE);
+  response.executable = readNumber(fd);
+  response.output = readString(fd, MAX_RESPONSE);
+  return response;
+}
+
+#endif
+
+} // namespace protocol
@@ -0,0 +1,51 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+  Messages between the --serve daemon and its client over a Unix domain
+  socket, one request and one response per connection. Strings are a
+  32-bit length in host byte order followed by their bytes, as both ends
+  run on the same machine. The reading end checks lengths against fixed
+  limits, a few MB for the source, before allocating for them.
+
+    request:  "MCC2", options, arguments, source
+    response: status, log, phase report, output path, executable flag,
+              output bytes
+*/
+namespace protocol {
+
+constexpr char MAGIC[4] = {'M', 'C', 'C', '2'};
+
+struct Request {
+  std::vector<std::string> options;   // the command line options
+  std::vector<std::string> arguments; // the source file, the executable
+  std::string source;                 // bytes of the source file
+};
+
+struct Response {
+  bool ok = false;
+  std::string log;    // what the compiler prints, the error when not ok
+  std::string report; // -ftime-report and the like, printed on stderr
+  std::string path;   // where the client writes the output
+  bool executable = false;
+  std::string output; // the executable, object, assembly or C
+};
+
+// connects to the daemon listening on `path`
+int connect(const std::string &path);
+
+void send(int fd, const Request &request);
+
+Request receiveRequest(int fd);
+
+void send(int fd, const Response &response);
+
+Response receiveResponse(int fd);
+
+} // namespace protocol
+
+#endif // !PROTOCOL_HPP
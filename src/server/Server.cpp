@@ -0,0 +1,348 @@
+#include "Server.hpp"
+#include "../common/Diagnostics.hpp"
+#include "../driver/Cache.hpp"
+#include "../driver/ThreadPool.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// the directory an executable is linked in, removed with what is left
+struct Scratch {
+  std::filesystem::path directory;
+
+  ~Scratch() {
+    std::error_code error;
+    if (!directory.empty()) {
+      std::filesystem::remove_all(directory, error);
+    }
+  }
+};
+
+// the analyzer's trace and the parse tree print themselves on std::cout,
+// so a request asking for them has it to itself while it compiles. The
+// other requests print nothing there, their level is quiet.
+std::mutex stdout_mutex;
+
+struct Capture {
+  std::lock_guard<std::mutex> lock{stdout_mutex};
+  std::streambuf *saved;
+  std::ios::iostate state;
+
+  explicit Capture(std::ostream &log)
+      : saved(std::cout.rdbuf(log.rdbuf())), state(std::cout.rdstate()) {
+    std::cout.clear();
+  }
+
+  ~Capture() {
+    std::cout.flush();
+    std::cout.rdbuf(saved);
+    std::cout.setstate(state);
+  }
+};
+
+std::string readFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::ostringstream bytes;
+  bytes << file.rdbuf();
+  return bytes.str();
+}
+
+} // namespace
+
+Server::Server(std::string path, unsigned jobs)
+    : path(std::move(path)), jobs(jobs) {}
+
+protocol::Response Server::compile(const protocol::Request &request,
+                                   std::ostream &log) {
+  // the connections are compiled in parallel already
+  CompileOptions options;
+  options.codegen_jobs = 1;
+  for (const auto &option : request.options) {
+    if (!options.set(option)) {
+      throw std::runtime_error("Unknown option: " + option);
+    }
+  }
+  options.check();
+  bool file_only = options.assembly_only || options.object_only;
+  if (request.arguments.size() < (file_only ? 1u : 2u)) {
+    throw std::runtime_error(file_only ? "No source file"
+                                       : "No source file or executable");
+  }
+
+  // -v for this request only, the level is the thread's
+  diagnostics::setLevel(options.verbosity);
+  std::optional<Capture> capture;
+  if (options.prints()) {
+    capture.emplace(log);
+  }
+
+  bool cached = !options.cache_dir.empty() && !options.prints();
+  Scratch scratch;
+  if (!file_only || cached) {
+    std::string name =
+        (std::filesystem::temp_directory_path() / "mcompiler-XXXXXX")
+            .string();
+#ifndef _WIN32
+    if (!mkdtemp(name.data())) {
+      throw std::runtime_error("Could not create a directory to link in");
+    }
+#endif
+    scratch.directory = name;
+  }
+  std::string exename =
+      file_only ? "" : (scratch.directory / "a.out").string();
+
+  Compilation compilation(options, request.arguments[0], exename);
+  if (diagnostics::enabled(diagnostics::VERBOSE)) {
+    compilation.logTo(log);
+  }
+  PhaseReport &phases = compilation.phases();
+  if (options.report_columns.memory) {
+    phases.measureMemory();
+  }
+  if (options.report_columns.counters) {
+    phases.measureCounters();
+  }
+
+  protocol::Response response;
+  response.executable = !file_only;
+  if (file_only) {
+    response.path = compilation.outputName();
+  } else {
+    response.path = request.arguments[1];
+    if (compilation.executable() != exename) {
+      response.path = changeExtension(response.path, ".exe");
+    }
+  }
+  auto finish = [&] {
+    if (options.report_columns.any()) {
+      std::ostringstream report;
+      phases.print(report, options.report_columns, options.report_format);
+      response.report = report.str();
+    }
+    response.ok = true;
+    return response;
+  };
+
+  // the same cache as the compiler's own, the file goes through the
+  // scratch directory
+  std::optional<Cache> cache;
+  std::string key, kind, output;
+  if (cached) {
+    cache.emplace(options.cache_dir, options.cache_size);
+    key = Cache::key(request.source, options);
+    kind = Cache::kind(options);
+    output = (scratch.directory / ("output." + kind)).string();
+    bool hit;
+    {
+      PhaseReport::Scope phase(phases, "cache");
+      hit = cache->fetch(key, kind, output);
+    }
+    if (hit) {
+      response.output = readFile(output);
+      log << "Cache hit: " << response.path << std::endl;
+      return finish();
+    }
+  }
+
+  compilation.parse(request.source);
+  compilation.analyze();
+  compilation.generate();
+
+  if (options.assembly_only) {
+    response.output = compilation.source().str();
+  } else if (options.object_only) {
+    std::vector<uint8_t> object = compilation.object();
+    response.output.assign(object.begin(), object.end());
+  } else {
+    compilation.link();
+    output = compilation.executable();
+    response.output = readFile(output);
+  }
+
+  if (cache) {
+    try {
+      PhaseReport::Scope phase(phases, "cache");
+      if (file_only) {
+        std::ofstream(output, std::ios::binary) << response.output;
+      }
+      cache->store(key, kind, output);
+    } catch (std::exception &e) {
+      log << "Warning: not cached: " << e.what() << std::endl;
+    }
+  }
+  if (file_only) {
+    log << "Wrote " << response.path << std::endl;
+  }
+  return finish();
+}
+
+void Server::warmUp() {
+  // pages in the pipeline and grows the heap before the first request
+  static const char *const PROGRAM = R"(int square(int n) {
+  return n * n;
+}
+int a[64];
+int i = 0;
+long total = 0;
+while (i < 64) {
+  total = total + square(i);
+  i = i + 1;
+}
+a = a + a;
+cout << total;
+cout << "done";
+)";
+  protocol::Request request;
+  request.options = {"-c"};
+  request.arguments = {"warmup.mcpp"};
+  request.source = PROGRAM;
+  std::ostringstream log;
+  compile(request, log);
+}
+
+#ifdef _WIN32
+
+void Server::serve(int) {}
+
+void Server::run() {
+  throw std::runtime_error("--serve needs Unix domain sockets");
+}
+
+#else
+
+namespace {
+
+volatile std::sig_atomic_t stopping = 0;
+
+// a client that stops sending or reading mid-message is dropped after this
+// long instead of holding a pool thread forever
+const time_t CONNECTION_TIMEOUT_SECONDS = 10;
+
+void stop(int) { stopping = 1; }
+
+} // namespace
+
+void Server::serve(int fd) {
+  protocol::Request request;
+  try {
+    request = protocol::receiveRequest(fd);
+  } catch (std::exception &) {
+    // timed out, closed or not a request: nothing to answer
+    close(fd);
+    return;
+  }
+
+  protocol::Response response;
+  std::ostringstream log;
+  try {
+    response = compile(request, log);
+  } catch (std::exception &e) {
+    response = protocol::Response();
+    response.log = log.str() + "Error: " + Compilation::message(e) + "\n";
+  }
+  if (response.ok) {
+    response.log = log.str();
+  }
+  try {
+    protocol::send(fd, response);
+  } catch (std::exception &) {
+    // the client went away
+  }
+  close(fd);
+}
+
+void Server::run() {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path too long: " + path);
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+  // a socket left behind by a daemon that is gone is replaced
+  int probe = -1;
+  try {
+    probe = protocol::connect(path);
+  } catch (std::runtime_error &) {
+  }
+  if (probe >= 0) {
+    close(probe);
+    throw std::runtime_error("A server is running on " + path + " already");
+  }
+  struct stat status;
+  if (lstat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+    unlink(path.c_str());
+  }
+
+  std::signal(SIGPIPE, SIG_IGN);
+  warmUp();
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    throw std::runtime_error(std::string("Could not create a socket: ") +
+                             std::strerror(errno));
+  }
+  fcntl(listener, F_SETFD, FD_CLOEXEC);
+  if (bind(listener, reinterpret_cast<sockaddr *>(&address),
+           sizeof(address)) < 0 ||
+      listen(listener, SOMAXCONN) < 0) {
+    int error = errno;
+    close(listener);
+    throw std::runtime_error("Could not listen on " + path + ": " +
+                             std::strerror(error));
+  }
+
+  // without SA_RESTART, so the signal interrupts accept
+  struct sigaction action {};
+  action.sa_handler = stop;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  {
+    ThreadPool pool(jobs);
+    std::cerr << "Serving on " << path << " with " << pool.size()
+              << " threads" << std::endl;
+    while (!stopping) {
+      // close-on-exec from the start, the linkers of other connections
+      // are spawned meanwhile
+      int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) {
+          continue;
+        }
+        break;
+      }
+      timeval timeout{};
+      timeout.tv_sec = CONNECTION_TIMEOUT_SECONDS;
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+      pool.submit([this, fd] { serve(fd); });
+    }
+  }
+  close(listener);
+  unlink(path.c_str());
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include "../driver/Compilation.hpp"
+#include "Protocol.hpp"
+
+#include <ostream>
+#include <string>
+
+/*
+  --serve: a daemon compiling the requests of the client on a Unix domain
+  socket, so a build that compiles many small programs pays for starting
+  the compiler once. The process stays warm between requests, and a first
+  program is compiled before the socket opens to page in the pipeline and
+  grow the heap. Connections are tasks on a ThreadPool, each compiled by a
+  pipeline of its own. Executables are linked in a private temporary
+  directory and sent back as bytes, objects and sources without touching
+  the disk. SIGINT and SIGTERM stop it after the requests in progress,
+  removing the socket.
+*/
+class Server {
+public:
+  // 0 jobs picks one per hardware thread
+  Server(std::string path, unsigned jobs = 0);
+
+  // serves until a signal stops it, throws when the socket cannot be
+  // opened
+  void run();
+
+private:
+  std::string path;
+  unsigned jobs;
+
+  void serve(int fd);
+
+  // compiles a request, the log getting what the compiler prints
+  protocol::Response compile(const protocol::Request &request,
+                             std::ostream &log);
+
+  void warmUp();
+};
+
+#endif // !SERVER_HPP
@@ -0,0 +1,73 @@
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vm {
+
+/*
+  Register based bytecode run by the VM (--interpret). Every variable lives
+  in its own register and expressions write straight into their destination,
+  so a load-add-store statement like `x = a + b;` is a single ADD.
+
+  Instructions are stored in a flat array of 32-bit words: the opcode
+  followed by its operands. r/a/b are register numbers, k an immediate,
+  s an index into the string table and t the index of the instruction a
+  jump continues at.
+*/
+enum class Op : int32_t {
+  HALT,   //
+  LOADK,  // r, k       r = k
+  MOVE,   // r, a       r = a
+  ADD,    // r, a, b    r = a + b
+  ADDK,   // r, a, k    r = a + k
+  SUB,    // r, a, b    r = a - b
+  SUBK,   // r, a, k    r = a - k
+  RSUBK,  // r, k, a    r = k - a
+  MUL,    // r, a, b    r = a * b
+  MULK,   // r, a, k    r = a * k
+  READ,   // r          cin >> r
+  PRINT,  // a          cout << a
+  PRINTK, // k          cout << k
+  PRINTS, // s          cout << strings[s]
+
+  // superinstructions for `cout << a + b` and friends
+  ADD_PRINT,  // a, b
+  ADDK_PRINT, // a, k
+  SUB_PRINT,  // a, b
+  SUBK_PRINT, // a, k
+  RSUBK_PRINT, // k, a
+
+  JUMP, // t
+
+  // compare and branch to t when the relation holds
+  BLT,  // a, b, t    a < b
+  BLE,  // a, b, t    a <= b
+  BEQ,  // a, b, t    a == b
+  BNE,  // a, b, t    a != b
+  BLTK, // a, k, t    a < k
+  BLEK, // a, k, t    a <= k
+  BGTK, // a, k, t    a > k
+  BGEK, // a, k, t    a >= k
+  BEQK, // a, k, t    a == k
+  BNEK  // a, k, t    a != k
+};
+
+constexpr int OP_COUNT = static_cast<int>(Op::BNEK) + 1;
+
+// number of operand words following each opcode
+constexpr int OPERANDS[OP_COUNT] = {0, 2, 2, 3, 3, 3, 3, 3, 3, 3,
+                                    1, 1, 1, 1, 2, 2, 2, 2, 2, 1,
+                                    3, 3, 3, 3, 3, 3, 3, 3, 3, 3};
+
+struct Program {
+  std::vector<int32_t> code;
+  std::vector<std::string> strings;
+  int32_t registers = 0;
+};
+
+} // namespace vm
+
+#endif // !BYTECODE_HPP
@@ -0,0 +1,336 @@
+#include "BytecodeCompiler.hpp"
+
+#include <stdexcept>
+
+namespace vm {
+
+BytecodeCompiler::BytecodeCompiler(
+    std::vector<std::shared_ptr<node::Node>> nodes)
+    : NODES(std::move(nodes)) {}
+
+Program BytecodeCompiler::compile() {
+  for (auto node : NODES) {
+    nodeGenerator(node);
+  }
+  emit(Op::HALT, {});
+  program.registers = registers.size();
+  return std::move(program);
+}
+
+void BytecodeCompiler::emit(Op op, std::initializer_list<int32_t> operands) {
+  program.code.push_back(static_cast<int32_t>(op));
+  program.code.insert(program.code.end(), operands);
+}
+
+int32_t BytecodeCompiler::variable(const std::string &name) {
+  auto it = registers.find(name);
+  if (it != registers.end()) {
+    return it->second;
+  }
+  int32_t reg = registers.size();
+  registers.emplace(name, reg);
+  return reg;
+}
+
+int32_t BytecodeCompiler::constantValue(const TOKEN &constant) {
+  unsigned long long value;
+  try {
+    value = std::stoull(constant.lexeme);
+  } catch (std::out_of_range &) {
+    throw std::runtime_error("Constant " + constant.lexeme +
+                             " is out of range at line " +
+                             std::to_string(constant.line));
+  }
+  // a wider constant is a long in C++, which the registers do not hold
+  if (value > INT32_MAX) {
+    throw std::runtime_error("--interpret only supports int constants, " +
+                             constant.lexeme + " at line " +
+                             std::to_string(constant.line));
+  }
+  return static_cast<int32_t>(value);
+}
+
+void BytecodeCompiler::processExpression(std::shared_ptr<node::Node> expression,
+                                         int32_t destination) {
+  if (auto constantNode = std::dynamic_pointer_cast<ConstantNode>(expression)) {
+    emit(Op::LOADK, {destination, constantValue(constantNode->constant)});
+    return;
+  }
+  if (auto identifierNode =
+          std::dynamic_pointer_cast<IdentifierNode>(expression)) {
+    emit(Op::MOVE,
+         {destination, variable(identifierNode->identifier.lexeme)});
+    return;
+  }
+
+  auto expressionNode = std::dynamic_pointer_cast<ExpressionNode>(expression);
+  auto leftConstant =
+      std::dynamic_pointer_cast<ConstantNode>(expressionNode->left);
+  auto rightConstant =
+      std::dynamic_pointer_cast<ConstantNode>(expressionNode->right);
+  bool add = expressionNode->OP == '+';
+
+  if (leftConstant && rightConstant) {
+    // folded, both sides are known
+    uint32_t left = constantValue(leftConstant->constant);
+    uint32_t right = constantValue(rightConstant->constant);
+    uint32_t value = add                        ? left + right
+                     : expressionNode->OP == '-' ? left - right
+                                                 : left * right;
+    emit(Op::LOADK, {destination, static_cast<int32_t>(value)});
+  } else if (expressionNode->OP == '*') {
+    // products commute, a constant goes on the right
+    auto left = leftConstant ? expressionNode->right : expressionNode->left;
+    auto right = leftConstant ? expressionNode->left : expressionNode->right;
+    int32_t a = variable(
+        std::dynamic_pointer_cast<IdentifierNode>(left)->identifier.lexeme);
+    if (auto constantNode = std::dynamic_pointer_cast<ConstantNode>(right)) {
+      emit(Op::MULK, {destination, a, constantValue(constantNode->constant)});
+    } else {
+      emit(Op::MUL,
+           {destination, a,
+            variable(std::dynamic_pointer_cast<IdentifierNode>(right)
+                         ->identifier.lexeme)});
+    }
+  } else if (rightConstant) {
+    int32_t left = variable(
+        std::dynamic_pointer_cast<IdentifierNode>(expressionNode->left)
+            ->identifier.lexeme);
+    emit(add ? Op::ADDK : Op::SUBK,
+         {destination, left, constantValue(rightConstant->constant)});
+  } else if (leftConstant) {
+    int32_t right = variable(
+        std::dynamic_pointer_cast<IdentifierNode>(expressionNode->right)
+            ->identifier.lexeme);
+    if (add) {
+      emit(Op::ADDK,
+           {destination, right, constantValue(leftConstant->constant)});
+    } else {
+      emit(Op::RSUBK,
+           {destination, constantValue(leftConstant->constant), right});
+    }
+  } else {
+    int32_t left = variable(
+        std::dynamic_pointer_cast<IdentifierNode>(expressionNode->left)
+            ->identifier.lexeme);
+    int32_t right = variable(
+        std::dynamic_pointer_cast<IdentifierNode>(expressionNode->right)
+            ->identifier.lexeme);
+    emit(add ? Op::ADD : Op::SUB, {destination, left, right});
+  }
+}
+
+void BytecodeCompiler::processDeclaration(
+    std::shared_ptr<DeclarationNode> declarationNode) {
+  // registers are 32-bit ints, other widths would need narrowing everywhere
+  if (declarationNode->type != TokenType::INT_KEYWORD) {
+    throw std::runtime_error(
+        "--interpret only supports int variables, use the native backends "
+        "for char, short and long");
+  }
+  if (std::holds_alternative<std::shared_ptr<AssignmentNode>>(
+          declarationNode->product)) {
+    auto assignmentNode =
+        std::get<std::shared_ptr<AssignmentNode>>(declarationNode->product);
+    processExpression(
+        assignmentNode->assignment,
+        variable(assignmentNode->identifier->identifier.lexeme));
+  } else {
+    // registers start out as 0, like the bss variables of the native code
+    for (auto &id : std::get<std::vector<std::shared_ptr<IdentifierNode>>>(
+             declarationNode->product)) {
+      variable(id->identifier.lexeme);
+    }
+  }
+}
+
+void BytecodeCompiler::processCout(std::shared_ptr<CoutNode> coutNode) {
+  for (auto &expr : coutNode->operands) {
+    if (auto literalNode = std::dynamic_pointer_cast<StringLiteralNode>(expr)) {
+      const std::string &literal = literalNode->literal.lexeme;
+      auto it = strings.find(literal);
+      if (it == strings.end()) {
+        it = strings.emplace(literal, program.strings.size()).first;
+        program.strings.push_back(literal);
+      }
+      emit(Op::PRINTS, {it->second});
+    } else if (auto constantNode =
+                   std::dynamic_pointer_cast<ConstantNode>(expr)) {
+      emit(Op::PRINTK, {constantValue(constantNode->constant)});
+    } else if (auto identifierNode =
+                   std::dynamic_pointer_cast<IdentifierNode>(expr)) {
+      emit(Op::PRINT, {variable(identifierNode->identifier.lexeme)});
+    } else if (auto expressionNode =
+                   std::dynamic_pointer_cast<ExpressionNode>(expr)) {
+      /*
+        Printed expressions become one superinstruction instead of an
+        arithmetic instruction into a scratch register followed by PRINT.
+      */
+      size_t start = program.code.size();
+      processExpression(expressionNode, 0);
+      std::vector<int32_t> words(program.code.begin() + start,
+                                 program.code.end());
+      program.code.resize(start);
+
+      switch (static_cast<Op>(words[0])) {
+      case Op::LOADK:
+        emit(Op::PRINTK, {words[2]});
+        break;
+      case Op::ADD:
+        emit(Op::ADD_PRINT, {words[2], words[3]});
+        break;
+      case Op::ADDK:
+        emit(Op::ADDK_PRINT, {words[2], words[3]});
+        break;
+      case Op::SUB:
+        emit(Op::SUB_PRINT, {words[2], words[3]});
+        break;
+      case Op::SUBK:
+        emit(Op::SUBK_PRINT, {words[2], words[3]});
+        break;
+      case Op::RSUBK:
+        emit(Op::RSUBK_PRINT, {words[2], words[3]});
+        break;
+      default:
+        // no superinstruction, the value goes through a scratch register
+        words[1] = variable(".print");
+        program.code.insert(program.code.end(), words.begin(), words.end());
+        emit(Op::PRINT, {words[1]});
+      }
+    }
+  }
+}
+
+void BytecodeCompiler::processCin(std::shared_ptr<CinNode> cinNode) {
+  for (auto &expr : cinNode->operands) {
+    auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(expr);
+    emit(Op::READ, {variable(identifierNode->identifier.lexeme)});
+  }
+}
+
+int32_t BytecodeCompiler::operand(std::shared_ptr<node::Node> node,
+                                   const char *scratch) {
+  if (auto identifierNode = std::dynamic_pointer_cast<IdentifierNode>(node)) {
+    return variable(identifierNode->identifier.lexeme);
+  }
+  // the name cannot clash with a variable of the program
+  int32_t reg = variable(scratch);
+  processExpression(node, reg);
+  return reg;
+}
+
+size_t BytecodeCompiler::branch(std::shared_ptr<ConditionNode> condition,
+                                bool when) {
+  static const std::unordered_map<std::string, std::string> opposite = {
+      {"<", ">="}, {"<=", ">"}, {">", "<="},
+      {">=", "<"}, {"==", "!="}, {"!=", "=="}};
+  static const std::unordered_map<std::string, std::string> swapped = {
+      {"<", ">"}, {"<=", ">="}, {">", "<"},
+      {">=", "<="}, {"==", "=="}, {"!=", "!="}};
+
+  std::string relation = when ? condition->OP : opposite.at(condition->OP);
+  auto left = condition->left;
+  auto right = condition->right;
+  if (std::dynamic_pointer_cast<ConstantNode>(left)) {
+    std::swap(left, right);
+    relation = swapped.at(relation);
+  }
+
+  auto constant = [&](std::shared_ptr<node::Node> node) {
+    const TOKEN &token =
+        std::dynamic_pointer_cast<ConstantNode>(node)->constant;
+    return constantValue(token);
+  };
+
+  if (std::dynamic_pointer_cast<ConstantNode>(right)) {
+    int32_t k = constant(right);
+    if (std::dynamic_pointer_cast<ConstantNode>(left)) {
+      int32_t value = constant(left);
+      bool holds = relation == "<"    ? value < k
+                   : relation == "<=" ? value <= k
+                   : relation == ">"  ? value > k
+                   : relation == ">=" ? value >= k
+                   : relation == "==" ? value == k
+                                      : value != k;
+      if (!holds) {
+        return NONE;
+      }
+      emit(Op::JUMP, {0});
+      return program.code.size() - 1;
+    }
+    static const std::unordered_map<std::string, Op> ops = {
+        {"<", Op::BLTK}, {"<=", Op::BLEK}, {">", Op::BGTK},
+        {">=", Op::BGEK}, {"==", Op::BEQK}, {"!=", Op::BNEK}};
+    emit(ops.at(relation), {operand(left, ".left"), k, 0});
+    return program.code.size() - 1;
+  }
+
+  int32_t a = operand(left, ".left");
+  int32_t b = operand(right, ".right");
+  if (relation[0] == '>') {
+    std::swap(a, b);
+    relation = swapped.at(relation);
+  }
+  static const std::unordered_map<std::string, Op> ops = {
+      {"<", Op::BLT}, {"<=", Op::BLE}, {"==", Op::BEQ}, {"!=", Op::BNE}};
+  emit(ops.at(relation), {a, b, 0});
+  return program.code.size() - 1;
+}
+
+void BytecodeCompiler::patch(size_t site) {
+  if (site != NONE) {
+    program.code[site] = program.code.size();
+  }
+}
+
+void BytecodeCompiler::nodeGenerator(std::shared_ptr<node::Node> node) {
+  if (auto declNode = std::dynamic_pointer_cast<DeclarationNode>(node)) {
+    processDeclaration(declNode);
+  } else if (std::dynamic_pointer_cast<ArrayDeclarationNode>(node)) {
+    // the register file has no addressable memory
+    throw std::runtime_error(
+        "--interpret does not support arrays, use the native backends");
+  } else if (std::dynamic_pointer_cast<FunctionNode>(node)) {
+    // every call site would need a frame of registers of its own
+    throw std::runtime_error(
+        "--interpret does not support functions, use the native backends");
+  } else if (auto assignNode =
+                 std::dynamic_pointer_cast<AssignmentNode>(node)) {
+    processExpression(assignNode->assignment,
+                      variable(assignNode->identifier->identifier.lexeme));
+  } else if (auto cinNode = std::dynamic_pointer_cast<CinNode>(node)) {
+    processCin(cinNode);
+  } else if (auto coutNode = std::dynamic_pointer_cast<CoutNode>(node)) {
+    processCout(coutNode);
+  } else if (auto ifNode = std::dynamic_pointer_cast<IfNode>(node)) {
+    size_t skip = branch(ifNode->condition, false);
+    nodeGenerator(ifNode->then);
+    if (ifNode->otherwise) {
+      emit(Op::JUMP, {0});
+      size_t end = program.code.size() - 1;
+      patch(skip);
+      nodeGenerator(ifNode->otherwise);
+      patch(end);
+    } else {
+      patch(skip);
+    }
+  } else if (auto whileNode = std::dynamic_pointer_cast<WhileNode>(node)) {
+    // tested before the first iteration and then at the bottom, so every
+    // iteration takes a single branch
+    size_t exit = branch(whileNode->condition, false);
+    int32_t body = program.code.size();
+    nodeGenerator(whileNode->body);
+    size_t repeat = branch(whileNode->condition, true);
+    if (repeat != NONE) {
+      program.code[repeat] = body;
+    }
+    patch(exit);
+  } else if (auto sequenceNode =
+                 std::dynamic_pointer_cast<SequenceNode>(node)) {
+    for (auto statement : sequenceNode->statements) {
+      nodeGenerator(statement);
+    }
+  }
+}
+
+} // namespace vm
@@ -0,0 +1,63 @@
+#ifndef BYTECODE_COMPILER_HPP
+#define BYTECODE_COMPILER_HPP
+
+#include "../parser/Node.hpp"
+#include "../parser/Parser.hpp"
+#include "Bytecode.hpp"
+
+#include <unordered_map>
+
+namespace vm {
+
+// lowers the parse tree to bytecode for the VM, next to the Generator
+class BytecodeCompiler {
+public:
+  BytecodeCompiler(std::vector<std::shared_ptr<node::Node>> nodes);
+
+  Program compile();
+
+private:
+  std::vector<std::shared_ptr<node::Node>> NODES;
+  Program program;
+
+  // variable name to its register
+  std::unordered_map<std::string, int32_t> registers;
+  // string literal to its index in the string table
+  std::unordered_map<std::string, int32_t> strings;
+
+  void emit(Op op, std::initializer_list<int32_t> operands);
+
+  int32_t variable(const std::string &name);
+
+  int32_t constantValue(const TOKEN &constant);
+
+  void processExpression(std::shared_ptr<node::Node> expression,
+                         int32_t destination);
+
+  void processDeclaration(std::shared_ptr<DeclarationNode> declarationNode);
+
+  void processCout(std::shared_ptr<CoutNode> coutNode);
+
+  void processCin(std::shared_ptr<CinNode> cinNode);
+
+  // register holding an identifier or expression operand, computed into
+  // the scratch register `scratch` when needed
+  int32_t operand(std::shared_ptr<node::Node> node, const char *scratch);
+
+  /*
+    Emits a branch taken when the condition is `when`, returning the index
+    of its target word to patch, or NONE when the condition is constant and
+    never branches.
+  */
+  static constexpr size_t NONE = SIZE_MAX;
+  size_t branch(std::shared_ptr<ConditionNode> condition, bool when);
+
+  // points a branch at the next instruction to be emitted
+  void patch(size_t site);
+
+  void nodeGenerator(std::shared_ptr<node::Node> node);
+};
+
+} // namespace vm
+
+#endif // !BYTECODE_COMPILER_HPP
@@ -0,0 +1,313 @@
+#include "VM.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#define MC_READ _read
+#else
+#include <unistd.h>
+#define MC_READ ::read
+#endif
+
+#if defined(__GNUC__)
+#define VM_THREADED 1
+#endif
+
+namespace vm {
+
+namespace {
+
+// one word of threaded code: a handler address or an operand
+union Slot {
+  const void *handler;
+  Op op;
+  int32_t operand;
+};
+
+// arithmetic wraps around like the 32-bit registers of the native code
+int32_t add(int32_t a, int32_t b) {
+  return static_cast<int32_t>(static_cast<uint32_t>(a) +
+                              static_cast<uint32_t>(b));
+}
+
+int32_t sub(int32_t a, int32_t b) {
+  return static_cast<int32_t>(static_cast<uint32_t>(a) -
+                              static_cast<uint32_t>(b));
+}
+
+int32_t mul(int32_t a, int32_t b) {
+  return static_cast<int32_t>(static_cast<uint32_t>(a) *
+                              static_cast<uint32_t>(b));
+}
+
+} // namespace
+
+VM::VM(const Program &program)
+    : program(program), registers(program.registers, 0), input(VM_BUFFER),
+      output(VM_BUFFER) {}
+
+void VM::run() {
+#ifdef VM_THREADED
+  static const void *const handlers[OP_COUNT] = {
+      &&HALT,      &&LOADK,      &&MOVE,      &&ADD,       &&ADDK,
+      &&SUB,       &&SUBK,       &&RSUBK,     &&MUL,       &&MULK,
+      &&READ,      &&PRINT,      &&PRINTK,    &&PRINTS,    &&ADD_PRINT,
+      &&ADDK_PRINT, &&SUB_PRINT, &&SUBK_PRINT, &&RSUBK_PRINT, &&JUMP,
+      &&BLT,       &&BLE,        &&BEQ,       &&BNE,       &&BLTK,
+      &&BLEK,      &&BGTK,       &&BGEK,      &&BEQK,      &&BNEK};
+#define CASE(name) name:
+#define DISPATCH() goto *ip->handler
+#else
+#define CASE(name) case Op::name:
+#define DISPATCH() continue
+#endif
+
+  // translate the bytecode into threaded code
+  std::vector<Slot> code(program.code.size());
+  for (size_t pc = 0; pc < program.code.size();) {
+    int op = program.code[pc];
+#ifdef VM_THREADED
+    code[pc].handler = handlers[op];
+#else
+    code[pc].op = static_cast<Op>(op);
+#endif
+    for (int i = 1; i <= OPERANDS[op]; i++) {
+      code[pc + i].operand = program.code[pc + i];
+    }
+    pc += 1 + OPERANDS[op];
+  }
+
+  int32_t *r = registers.data();
+  const Slot *ip = code.data();
+
+#ifdef VM_THREADED
+  DISPATCH();
+#else
+  for (;;) {
+    switch (ip->op) {
+#endif
+
+  CASE(LOADK)
+  r[ip[1].operand] = ip[2].operand;
+  ip += 3;
+  DISPATCH();
+
+  CASE(MOVE)
+  r[ip[1].operand] = r[ip[2].operand];
+  ip += 3;
+  DISPATCH();
+
+  CASE(ADD)
+  r[ip[1].operand] = add(r[ip[2].operand], r[ip[3].operand]);
+  ip += 4;
+  DISPATCH();
+
+  CASE(ADDK)
+  r[ip[1].operand] = add(r[ip[2].operand], ip[3].operand);
+  ip += 4;
+  DISPATCH();
+
+  CASE(SUB)
+  r[ip[1].operand] = sub(r[ip[2].operand], r[ip[3].operand]);
+  ip += 4;
+  DISPATCH();
+
+  CASE(SUBK)
+  r[ip[1].operand] = sub(r[ip[2].operand], ip[3].operand);
+  ip += 4;
+  DISPATCH();
+
+  CASE(RSUBK)
+  r[ip[1].operand] = sub(ip[2].operand, r[ip[3].operand]);
+  ip += 4;
+  DISPATCH();
+
+  CASE(MUL)
+  r[ip[1].operand] = mul(r[ip[2].operand], r[ip[3].operand]);
+  ip += 4;
+  DISPATCH();
+
+  CASE(MULK)
+  r[ip[1].operand] = mul(r[ip[2].operand], ip[3].operand);
+  ip += 4;
+  DISPATCH();
+
+  CASE(READ)
+  readInt(r[ip[1].operand]);
+  ip += 2;
+  DISPATCH();
+
+  CASE(PRINT)
+  printInt(r[ip[1].operand]);
+  ip += 2;
+  DISPATCH();
+
+  CASE(PRINTK)
+  printInt(ip[1].operand);
+  ip += 2;
+  DISPATCH();
+
+  CASE(PRINTS)
+  printString(program.strings[ip[1].operand]);
+  ip += 2;
+  DISPATCH();
+
+  CASE(ADD_PRINT)
+  printInt(add(r[ip[1].operand], r[ip[2].operand]));
+  ip += 3;
+  DISPATCH();
+
+  CASE(ADDK_PRINT)
+  printInt(add(r[ip[1].operand], ip[2].operand));
+  ip += 3;
+  DISPATCH();
+
+  CASE(SUB_PRINT)
+  printInt(sub(r[ip[1].operand], r[ip[2].operand]));
+  ip += 3;
+  DISPATCH();
+
+  CASE(SUBK_PRINT)
+  printInt(sub(r[ip[1].operand], ip[2].operand));
+  ip += 3;
+  DISPATCH();
+
+  CASE(RSUBK_PRINT)
+  printInt(sub(ip[1].operand, r[ip[2].operand]));
+  ip += 3;
+  DISPATCH();
+
+  CASE(JUMP)
+  ip = code.data() + ip[1].operand;
+  DISPATCH();
+
+#define BRANCH(name, a, relation, b)                                          \
+  CASE(name)                                                                   \
+  ip = a relation b ? code.data() + ip[3].operand : ip + 4;                    \
+  DISPATCH();
+
+  BRANCH(BLT, r[ip[1].operand], <, r[ip[2].operand])
+  BRANCH(BLE, r[ip[1].operand], <=, r[ip[2].operand])
+  BRANCH(BEQ, r[ip[1].operand], ==, r[ip[2].operand])
+  BRANCH(BNE, r[ip[1].operand], !=, r[ip[2].operand])
+  BRANCH(BLTK, r[ip[1].operand], <, ip[2].operand)
+  BRANCH(BLEK, r[ip[1].operand], <=, ip[2].operand)
+  BRANCH(BGTK, r[ip[1].operand], >, ip[2].operand)
+  BRANCH(BGEK, r[ip[1].operand], >=, ip[2].operand)
+  BRANCH(BEQK, r[ip[1].operand], ==, ip[2].operand)
+  BRANCH(BNEK, r[ip[1].operand], !=, ip[2].operand)
+#undef BRANCH
+
+  CASE(HALT)
+#ifndef VM_THREADED
+  break;
+    }
+    break;
+  }
+#endif
+
+#undef CASE
+#undef DISPATCH
+
+  flush();
+}
+
+bool VM::fillInput() {
+  // prompts written so far show up before blocking on input
+  flush();
+  int count = MC_READ(0, input.data(), VM_BUFFER);
+  input_pos = 0;
+  input_len = count > 0 ? count : 0;
+  return input_len > 0;
+}
+
+void VM::readInt(int32_t &destination) {
+  /*
+    Same rules as scanf("%d") and the native __mc_read_int: leading
+    whitespace is skipped, a sign is optional, and without a digit the
+    variable is left untouched and the character is not consumed.
+  */
+  for (;;) {
+    if (input_pos == input_len && !fillInput()) {
+      return;
+    }
+    char c = input[input_pos];
+    if (c != ' ' && (c < '\t' || c > '\r')) {
+      break;
+    }
+    input_pos++;
+  }
+
+  bool negative = false;
+  if (input[input_pos] == '+' || input[input_pos] == '-') {
+    negative = input[input_pos] == '-';
+    input_pos++;
+    if (input_pos == input_len && !fillInput()) {
+      return;
+    }
+  }
+
+  if (static_cast<unsigned>(input[input_pos] - '0') > 9) {
+    return;
+  }
+
+  uint64_t value = 0;
+  for (;;) {
+    if (input_pos == input_len && !fillInput()) {
+      break;
+    }
+    unsigned digit = static_cast<unsigned>(input[input_pos] - '0');
+    if (digit > 9) {
+      break;
+    }
+    value = value * 10 + digit;
+    input_pos++;
+  }
+  destination = static_cast<int32_t>(negative ? 0 - value : value);
+}
+
+void VM::printInt(int32_t value) {
+  char digits[16];
+  char *end = digits + sizeof(digits);
+  char *p = end;
+  *--p = '\n';
+  uint32_t magnitude = value < 0 ? 0u - static_cast<uint32_t>(value) : value;
+  do {
+    *--p = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude);
+  if (value < 0) {
+    *--p = '-';
+  }
+  write(p, end - p);
+}
+
+void VM::printString(const std::string &value) {
+  write(value.data(), value.size());
+  write("\n", 1);
+}
+
+void VM::write(const char *bytes, size_t length) {
+  if (output_len + length > VM_BUFFER) {
+    flush();
+    if (length > VM_BUFFER) {
+      std::fwrite(bytes, 1, length, stdout);
+      std::fflush(stdout);
+      return;
+    }
+  }
+  std::memcpy(output.data() + output_len, bytes, length);
+  output_len += length;
+}
+
+void VM::flush() {
+  if (output_len) {
+    std::fwrite(output.data(), 1, output_len, stdout);
+    std::fflush(stdout);
+    output_len = 0;
+  }
+}
+
+} // namespace vm
@@ -0,0 +1,55 @@
+#ifndef VM_HPP
+#define VM_HPP
+
+#include "Bytecode.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace vm {
+
+/*
+  Runs a Program. The bytecode is first translated into direct threaded code
+  where every opcode is replaced by the address of its handler, so each
+  handler jumps straight to the next one (computed goto). Compilers without
+  label addresses fall back to a switch over the opcodes.
+
+  cin and cout behave like the native runtime: buffered reads parsed like
+  scanf("%d"), and every value printed on its own line.
+*/
+class VM {
+public:
+  VM(const Program &program);
+
+  void run();
+
+private:
+  const Program &program;
+  std::vector<int32_t> registers;
+
+  // size of the stdin block and of the output buffer
+  static constexpr size_t VM_BUFFER = 65536;
+
+  std::vector<char> input;
+  size_t input_pos = 0;
+  size_t input_len = 0;
+
+  std::vector<char> output;
+  size_t output_len = 0;
+
+  bool fillInput();
+
+  void readInt(int32_t &destination);
+
+  void printInt(int32_t value);
+
+  void printString(const std::string &value);
+
+  void write(const char *bytes, size_t length);
+
+  void flush();
+};
+
+} // namespace vm
+
+#endif // !VM_HPP
@@ -0,0 +1,93 @@
+#!/bin/sh
+# The client and the --serve daemon against the compiler itself: for each
+# set of options below, tests/parity.mcpp compiled both ways must give the
+# same files and the same stdout, and the phase reports the same phases.
+# A cache directory is given as @cache, each side gets its own and
+# compiles twice, the second time from the cache.
+#
+# Usage: tests/client_parity.sh <compiler> <client>
+
+compiler=$(realpath "$1")
+client=$(realpath "$2")
+program=$(realpath "$(dirname "$0")/parity.mcpp")
+work=$(mktemp -d)
+socket=$work/socket
+
+"$compiler" --serve "$socket" -j 2 2>/dev/null &
+server=$!
+trap 'kill $server 2>/dev/null; wait $server 2>/dev/null; rm -rf "$work"' EXIT
+tries=0
+while [ ! -S "$socket" ]; do
+  tries=$((tries + 1))
+  if [ $tries -gt 100 ]; then
+    echo "the daemon did not start"
+    exit 1
+  fi
+  sleep 0.1
+done
+
+# compile <side> <command> <options...>: in a directory of its own
+compile() {
+  directory=$work/$1
+  command=$2
+  shift 2
+  mkdir -p "$directory"
+  cp "$program" "$directory/p.mcpp"
+  (
+    cd "$directory" || exit 1
+    options=$(printf '%s\n' "$@" | sed "s|@cache|$directory/cache|")
+    # with a cache the second compilation is a hit
+    runs=1
+    case "$*" in *@cache*) runs=2 ;; esac
+    : >stdout
+    : >status
+    while [ $runs -gt 0 ]; do
+      # shellcheck disable=SC2086
+      $command $options p.mcpp p >>stdout 2>stderr
+      echo $? >>status
+      runs=$((runs - 1))
+    done
+  )
+}
+
+failed=0
+check() {
+  rm -rf "$work/direct" "$work/client"
+  compile direct "$compiler" "$@"
+  compile client "$client --server=$socket" "$@"
+  # the daemon is sent the source and sends the file back, it has no read
+  # or write phase
+  grep -v -e '^read ' -e '^write ' "$work/direct/stderr" |
+    awk '{ print $1 }' >"$work/direct/phases"
+  awk '{ print $1 }' "$work/client/stderr" >"$work/client/phases"
+  # and links in a directory of its own
+  sed -i 's|[^ ]*/mcompiler-[^/ ]*/a.out|p|' "$work/client/stdout"
+  if diff -r -x stderr -x cache "$work/direct" "$work/client" >"$work/diff"
+  then
+    echo "ok     $*"
+  else
+    echo "FAILED $*"
+    cat "$work/diff"
+    failed=1
+  fi
+}
+
+check
+check -S
+check -c
+check -ffreestanding
+check --backend=c
+check --backend=c -S
+check --simd=scalar -S
+check -v
+check -vv -S
+check --dump-tokens -S
+check --dump-ast -c
+check --dump-asm
+check -ftime-report
+check -fmem-report -S
+check -fperf-report -c
+check --cache-dir=@cache
+check --cache-dir=@cache -S
+check --cache-dir=@cache --cache-size=1 -c
+exit $failed
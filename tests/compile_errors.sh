@@ -0,0 +1,27 @@
+#!/bin/sh
+# Programs the compiler must reject: each tests/errors/<name>.mcpp has to
+# fail, printing the line in <name>.expected.
+#
+# Usage: tests/compile_errors.sh <compiler>
+
+compiler=$(realpath "$1")
+errors=$(dirname "$0")/errors
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+failed=0
+for program in "$errors"/*.mcpp; do
+  name=$(basename "$program" .mcpp)
+  expected=$(cat "$errors/$name.expected")
+  if output=$("$compiler" "$program" "$work/$name"); then
+    echo "FAILED $name: compiled"
+    failed=1
+  elif [ "$output" != "$expected" ]; then
+    echo "FAILED $name: $output"
+    echo "       expected: $expected"
+    failed=1
+  else
+    echo "ok     $name"
+  fi
+done
+exit $failed